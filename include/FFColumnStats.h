@@ -0,0 +1,165 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFColumnStats                                                        //
+//                                                                      //
+// Class calculating statistics of data columns in a single pass.       //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFColumnStats
+#define FOOFIT_FFColumnStats
+
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include "TNamed.h"
+#include "TMatrixDSym.h"
+
+class TTree;
+class TH1;
+class RooAbsData;
+
+class FFColumnStats : public TNamed
+{
+
+protected:
+
+    class Digest
+    {
+    public:
+        Double_t fCompression;                              // compression parameter
+        Double_t fTotW;                                     // total weight of centroids
+        std::vector<Double_t> fMean;                        // centroid means
+        std::vector<Double_t> fW;                           // centroid weights
+        std::vector<std::pair<Double_t, Double_t> > fBuf;   // unmerged values and weights
+
+        Digest(Double_t comp = 200) : fCompression(comp), fTotW(0) { }
+        void Add(Double_t x, Double_t w)
+        {
+            fBuf.push_back(std::make_pair(x, w));
+            if (fBuf.size() >= 10*fCompression) Compress();
+        }
+        void Compress();
+        void Merge(const Digest& d);
+        Double_t Quantile(Double_t q, Double_t min, Double_t max) const;
+        Double_t CDF(Double_t x, Double_t min, Double_t max) const;
+    };
+
+    class Sketch
+    {
+    public:
+        Int_t fExp;                     // binary exponent of the bin width
+        Long64_t fFirst;                // index of the first bin
+        Long64_t fLo;                   // index of the first filled bin
+        Long64_t fHi;                   // index of the last filled bin
+        std::vector<Double_t> fCont;    // bin contents (sums of weights)
+
+        Sketch() : fExp(0), fFirst(0), fLo(0), fHi(0) { }
+        void Add(Double_t x, Double_t w);
+        void Rebin(Double_t min, Double_t max, Int_t exp);
+        void Merge(const Sketch& s);
+    };
+
+    class Accumulator
+    {
+    public:
+        Int_t fN;                       // number of columns
+        Long64_t fCount;                // number of rows
+        Double_t fSumW;                 // sum of weights
+        std::vector<Double_t> fMean;    // weighted means
+        std::vector<Double_t> fCoMom;   // weighted co-moments [fN*fN]
+        std::vector<Double_t> fDelta;   // deviations from mean (workspace)
+        std::vector<Double_t> fMin;     // minima
+        std::vector<Double_t> fMax;     // maxima
+        std::vector<Long64_t> fNValid;  // numbers of valid values
+        std::vector<Long64_t> fNNaN;    // numbers of NaN values
+        std::vector<Digest> fDigest;    // quantile sketches
+        std::vector<Sketch> fSketch;    // histogram sketches
+        Long64_t fNNaNW;                // number of NaN weights
+        Long64_t fNZeroW;               // number of zero weights
+
+        Accumulator(Int_t n = 0) : fN(n), fCount(0), fSumW(0),
+                                   fMean(n, 0), fCoMom(n*n, 0), fDelta(n, 0),
+                                   fMin(n, 1e300), fMax(n, -1e300),
+                                   fNValid(n, 0), fNNaN(n, 0), fDigest(n), fSketch(n),
+                                   fNNaNW(0), fNZeroW(0) { }
+        void Add(const Double_t* x, Double_t w);
+        void AddRow(const Double_t* x, Double_t w);
+        void Merge(const Accumulator& a);
+    };
+
+    std::vector<TString> fColName;      // column names
+    Long64_t fNRow;                     // number of processed rows
+    Long64_t fNRowSkip;                 // number of skipped rows (NaN values)
+    Accumulator fAcc;                   //! accumulated statistics
+    const TObject* fSource;             //! source of the accumulated statistics
+
+    static const Int_t fgBlockSize;     // number of rows per block
+    static const Int_t fgNSketchBin;    // number of bins of histogram sketches
+
+    Bool_t CheckColumnBounds(Int_t i, const Char_t* loc) const;
+    void AccumulateBlock(const Double_t* x, const Double_t* w, Int_t n,
+                         std::vector<Accumulator>& acc) const;
+    void MergeResults(std::vector<Accumulator>& acc, Long64_t nRow, const TObject* src);
+    Long64_t ReadBranches(TTree* tree, const Char_t* weight,
+                          std::function<void(const Double_t*, Double_t)> row) const;
+    Long64_t FillBranches(TTree* tree, const Char_t* weight,
+                          std::vector<Accumulator>& acc) const;
+    Long64_t FillFormulas(TTree* tree, const Char_t* weight,
+                          std::vector<Accumulator>& acc) const;
+
+public:
+    FFColumnStats() : TNamed(),
+                      fNRow(0), fNRowSkip(0), fSource(0) { }
+    FFColumnStats(const Char_t* name, const Char_t* title);
+    virtual ~FFColumnStats() { }
+
+    Int_t GetNColumn() const { return fColName.size(); }
+    const Char_t* GetColumnName(Int_t i) const;
+    Int_t GetColumnIndex(const Char_t* name) const;
+    Long64_t GetNRow() const { return fNRow; }
+    Long64_t GetNRowSkipped() const { return fNRowSkip; }
+    Long64_t GetNNaNWeight() const { return fAcc.fNNaNW; }
+    Long64_t GetNZeroWeight() const { return fAcc.fNZeroW; }
+    Double_t GetSumOfWeights() const { return fAcc.fSumW; }
+    Long64_t GetNValid(Int_t i) const;
+    Long64_t GetNNaN(Int_t i) const;
+    Double_t GetMinimum(Int_t i) const;
+    Double_t GetMaximum(Int_t i) const;
+    Double_t GetMean(Int_t i) const;
+    Double_t GetVariance(Int_t i) const;
+    Double_t GetCovariance(Int_t i, Int_t j) const;
+    Double_t GetCorrelation(Int_t i, Int_t j) const;
+    TMatrixDSym GetCovarianceMatrix() const;
+    TMatrixDSym GetCorrelationMatrix() const;
+    Double_t GetQuantile(Int_t i, Double_t q) const;
+    Double_t GetCDF(Int_t i, Double_t x) const;
+    TH1* CreateHistogram(Int_t i, const Char_t* name, Int_t nBins,
+                         Double_t min, Double_t max) const;
+    TH1* CreateSketchHistogram(Int_t i, const Char_t* name, Int_t nBins,
+                               Double_t min, Double_t max) const;
+
+    Bool_t IsCached(const TObject* src, Long64_t nEntries) const
+    {
+        return fSource && fSource == src && fNRow == nEntries;
+    }
+    Bool_t IsCached(const RooAbsData* data) const;
+    Bool_t IsCached(const TTree* tree) const;
+
+    Int_t AddColumn(const Char_t* name);
+    void Reset();
+    Bool_t Fill(RooAbsData* data, Int_t nThreads = 1);
+    Bool_t Fill(TTree* tree, const Char_t* weight = 0, Int_t nThreads = 1);
+
+    virtual void Print(Option_t* option = "") const;
+
+    ClassDef(FFColumnStats, 0)  // Single-pass statistics of data columns
+};
+
+#endif
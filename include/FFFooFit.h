@@ -14,27 +14,51 @@
 #ifndef FOOFIT_FFFooFit
 #define FOOFIT_FFFooFit
 
+#include <functional>
+#include <vector>
+
 #include "Rtypes.h"
+#include "TString.h"
 
 # define FOOFIT_VERSION "0.1.0"
 
 class TChain;
+class TTree;
+class RooRealVar;
+class RooArgSet;
+class RooArgList;
 
 namespace FFFooFit
 {
-    extern Int_t gUseNCPU;      // number of CPUs to use
+    extern Int_t gUseNCPU;      // number of CPUs to use (see SetNCPU())
     extern Int_t gParStrat;     // parallelization strategy
+    extern TString gCacheDir;   // directory of the fit-result cache
 
     Int_t GetNumberOfCPUs();
+    void SetNCPU(Int_t n);
+    Bool_t IsThreadSafe();
     Bool_t LoadFilesToChain(const Char_t* loc, TChain* chain,
                             const Char_t* wildCard = 0);
     Bool_t FileExists(const Char_t* f);
+    Bool_t IsTreeLeaf(TTree* tree, const Char_t* name);
+    Long64_t ReadTreeColumns(TTree* tree, Int_t n, const Char_t** cols,
+                             std::function<void(const Double_t*)> row);
+    Bool_t SolveCholesky(Int_t n, Double_t* a, Double_t* b);
+    Bool_t IsYieldOnly(const std::vector<std::vector<RooRealVar*> >& compPar,
+                       const std::vector<RooArgSet*>& constrNorm,
+                       const std::vector<RooRealVar*>& par, const RooArgList& coef);
+    Int_t ParallelFor(Long64_t n, Int_t nThreads,
+                      std::function<void(Int_t, Long64_t, Long64_t)> work,
+                      Long64_t minPerThread = 4096);
 
     Int_t IndexOf(const Char_t* s1, const Char_t* s2, UInt_t p = 0);
     Int_t LastIndexOf(const Char_t* s, Char_t c);
     TString ExpandPath(const Char_t* s);
     TString ExtractFileName(const Char_t* s);
     TString ExtractDirectory(const Char_t* s);
+    TString MD5(const Char_t* s);
+    TString EscapeJSON(const Char_t* s);
+    TString GetCacheDirectory();
 }
 
 #endif
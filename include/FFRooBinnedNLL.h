@@ -0,0 +1,121 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooBinnedNLL                                                       //
+//                                                                      //
+// Native extended Poisson negative log-likelihood of a sum of models   //
+// and binned data.                                                     //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooBinnedNLL
+#define FOOFIT_FFRooBinnedNLL
+
+#include <vector>
+
+#include "RooAbsReal.h"
+#include "RooListProxy.h"
+#include "RooArgSet.h"
+
+class RooRealVar;
+class RooAbsData;
+class RooDataHist;
+class FFRooModel;
+class FFRooModelSum;
+
+class FFRooBinnedNLL : public RooAbsReal
+{
+
+protected:
+    RooListProxy fComp;                                     // component pdfs
+    RooListProxy fCoef;                                     // component yields
+    RooListProxy fConstr;                                   // constraint pdfs
+    FFRooModelSum* fModel;                                  //! model (not owned)
+    Int_t fNComp;                                           // number of components
+    Int_t fNObs;                                            // number of observables
+    RooRealVar** fObs;                                      //[fNObs] observables (elements not owned)
+    RooArgSet fObsSet;                                      // set of observables
+    Int_t fNBin;                                            // number of non-empty bins
+    Double_t* fBinX;                                        //[fNBin*fNObs] bin centers
+    Double_t* fBinVol;                                      //[fNBin] bin volumes
+    Double_t* fBinW;                                        //[fNBin] bin contents
+    Double_t* fBinW2;                                       //[fNBin] squared weights of bin contents
+    Double_t fSumW;                                         // sum of bin contents
+    Double_t fSumW2;                                        // sum of squared weights of bin contents
+    Int_t* fBinIdx;                                         //[fNBin*fNObs] bin indices per observable
+    Int_t* fNEdge;                                          //[fNObs] number of bin edges per observable
+    Double_t** fEdge;                                       //! bin edges per observable [fNObs][fNEdge]
+    Double_t** fInt;                                        //! bin integrals per observable [fNObs][fNEdge-1]
+    std::vector<Int_t> fCompCDF;                            //! CDF integration modes of components
+    Double_t* fProb;                                        //! cached bin probabilities of components [fNComp*fNBin]
+    Double_t* fMu;                                          //! bin expectations [fNBin]
+    Bool_t fWeightSq;                                       // flag for using squared weights
+    Bool_t fBBLite;                                         // flag for Barlow-Beeston-lite template uncertainties
+    Double_t* fRelErr2;                                     //! squared relative template errors of components [fNComp*fNBin]
+    Double_t* fBeta;                                        //! Barlow-Beeston-lite scale factors of bins [fNBin]
+    Double_t* fSig2;                                        //! Barlow-Beeston-lite squared relative uncertainties of bins [fNBin]
+    std::vector<RooArgSet*> fConstrNorm;                    //! normalization sets of constraints
+    std::vector<std::vector<RooRealVar*> > fCompPar;        //! floating parameters of components
+    mutable std::vector<std::vector<Double_t> > fCompVal;   //! parameter values of cached bin probabilities
+    mutable std::vector<Bool_t> fCompValid;                 //! flags for valid cached bin probabilities
+    std::vector<RooRealVar*> fPar;                          //! all floating parameters
+    mutable std::vector<Double_t> fParVal;                  //! parameter values of cached likelihood value
+    mutable Double_t fLastVal;                              //! cached likelihood value
+    mutable Bool_t fLastValid;                              //! flag for valid cached likelihood value
+    mutable Long64_t fNCompEval;                            //! number of component re-evaluations
+    Int_t fNSolverIter;                                     //! number of iterations of the yield solver
+    Double_t fSolverEDM;                                    //! estimated distance to minimum of the yield solver
+
+    void Init();
+    void LoadBins(RooDataHist& data);
+    void CollectParameters();
+    Bool_t IntegrateComponent(Int_t comp) const;
+    void ComputeProbabilities(Int_t comp) const;
+    void LoadTemplateErrors();
+    Double_t ComputeBBLite() const;
+    void ComputeYieldDerivatives(Int_t nFree, const Int_t* idx, const Double_t* n,
+                                 Double_t* g, Double_t* h) const;
+
+    virtual Double_t evaluate() const;
+
+public:
+    FFRooBinnedNLL() : RooAbsReal(),
+                       fModel(0), fNComp(0),
+                       fNObs(0), fObs(0),
+                       fNBin(0), fBinX(0), fBinVol(0), fBinW(0), fBinW2(0),
+                       fSumW(0), fSumW2(0), fBinIdx(0), fNEdge(0), fEdge(0), fInt(0),
+                       fProb(0), fMu(0), fWeightSq(kFALSE),
+                       fBBLite(kFALSE), fRelErr2(0), fBeta(0), fSig2(0),
+                       fLastVal(0), fLastValid(kFALSE), fNCompEval(0),
+                       fNSolverIter(0), fSolverEDM(0) { }
+    FFRooBinnedNLL(const Char_t* name, const Char_t* title, FFRooModelSum* model,
+                   RooDataHist& data, RooRealVar** obs, Int_t nObs,
+                   const RooArgSet& constr, Bool_t bbLite = kFALSE);
+    FFRooBinnedNLL(const FFRooBinnedNLL& other, const Char_t* name = 0);
+    virtual ~FFRooBinnedNLL();
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooBinnedNLL(*this, newname); }
+
+    Int_t GetNBin() const { return fNBin; }
+    Int_t GetNComp() const { return fNComp; }
+    Long64_t GetNCompEval() const { return fNCompEval; }
+    Int_t GetNCompCDF() const;
+    Int_t GetNCompBBLite() const;
+    Bool_t IsBBLite() const { return fBBLite; }
+    Int_t GetNSolverIter() const { return fNSolverIter; }
+    Double_t GetSolverEDM() const { return fSolverEDM; }
+
+    void ApplyWeightSquared(Bool_t flag);
+    Bool_t IsYieldOnly() const;
+    Bool_t SolveYields(Int_t maxIter = 100, Double_t tol = 1e-6);
+
+    static Bool_t IsApplicable(FFRooModel* model, RooAbsData* data);
+
+    ClassDef(FFRooBinnedNLL, 0)  // Native binned Poisson likelihood
+};
+
+#endif
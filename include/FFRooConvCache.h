@@ -0,0 +1,53 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooConvCache                                                       //
+//                                                                      //
+// Manager of shared FFT plans and convolution cache binnings.          //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooConvCache
+#define FOOFIT_FFRooConvCache
+
+#include <atomic>
+#include <mutex>
+
+#include "Rtypes.h"
+
+class TVirtualFFT;
+class RooAbsReal;
+class RooRealVar;
+
+class FFRooConvCache
+{
+
+protected:
+    static std::mutex fgMutex;                          // lock of plan creation and deletion
+    static std::atomic<Long64_t> fgNRequest;            // number of plan requests
+    static Int_t fgOversampling;                        // cache bins per variable bin
+    static Int_t fgMaxBins;                             // maximum number of cache bins
+
+public:
+    FFRooConvCache() { }
+    virtual ~FFRooConvCache() { }
+
+    static TVirtualFFT* GetPlan(Int_t nDim, const Int_t* n, const Char_t* opt);
+    static Int_t GetNPlans();
+    static Long64_t GetNPlanRequests() { return fgNRequest; }
+    static void ClearPlans();
+
+    static Int_t GetGoodSize(Int_t n);
+    static Int_t GetCacheBins(const RooRealVar* var, const RooAbsReal* sigma, Int_t nBins = 0);
+    static Int_t SetCacheBinning(RooRealVar* var, const RooAbsReal* sigma, Int_t nBins = 0);
+    static void SetOversampling(Int_t n) { fgOversampling = n > 0 ? n : 1; }
+    static void SetMaxBins(Int_t n) { fgMaxBins = n; }
+
+    ClassDef(FFRooConvCache, 0)  // Shared FFT plans and convolution cache binnings
+};
+
+#endif
@@ -20,9 +20,13 @@
 class RooRealVar;
 class RooAbsData;
 class RooAbsPdf;
+class RooArgSet;
 class RooPlot;
 class RooFitResult;
 class FFRooModel;
+class FFRooFitProfile;
+class FFRooFitTrace;
+class FFColumnStats;
 class TCanvas;
 class TH1;
 class TH2;
@@ -61,15 +65,35 @@ public:
     };
     typedef EFFMinimizer FFMinimizer_t;
 
+    // Fit-result cache matches
+    enum EFFCacheMatch {
+        kCacheNone,         // no cached fit result found
+        kCacheCompatible,   // cached fit result of same model but other data
+        kCacheExact         // cached fit result of same model and data
+    };
+
+    // Binning types of fit variables
+    enum EFFBinning {
+        kBinningUniform,    // uniform bins (see SetVariable())
+        kBinningQuantile,   // bins of equal population
+        kBinningMinContent  // uniform bins merged until a minimum content is reached
+    };
+    typedef EFFBinning FFBinning_t;
+
 protected:
     Int_t fNVar;                    // number of fit variables
     RooRealVar** fVar;              //[fNVar] array of fit variables
+    FFBinning_t* fBinType;          //[fNVar] binning types of fit variables
+    Double_t* fBinPar;              //[fNVar] binning parameters of fit variables
+    Int_t* fBinNUni;                //[fNVar] numbers of uniform bins of fit variables
     Int_t fNVarAux;                 // number of auxiliary variables (not to be fitted)
     RooRealVar** fVarAux;           //[fNVarAux] array of auxiliary variables (elements not owned)
     Int_t fNVarCtrl;                // number of control variables
     RooRealVar** fVarCtrl;          //[fNCtrlVar] array of control variables (subset of aux. vars.)
     Int_t fNConstr;                 // number of constraints
     FFRooModel** fConstr;           //[fNConstr] array of constraints (elements not owned)
+    RooAbsPdf* fConstrGauss;        //! combined Gaussian constraint pdf
+    TString fConstrGaussSig;        //! signature of combined Gaussian constraint pdf
     RooAbsData* fData;              // dataset
     FFRooModel* fModel;             // model (not owned)
     RooFitResult* fResult;          // result of last fit
@@ -78,17 +102,33 @@ protected:
     FFMinimizer_t fMinimizerPreFit; // type of minimizer (chi2 pre-fit)
     Double_t fRangeMin;             // fit range minimum
     Double_t fRangeMax;             // fit range maximum
+    FFRooFitProfile* fProfile;      // profile of last fit
+    FFRooFitTrace* fTrace;          // trace of last fit (0 if disabled)
+    FFColumnStats* fStats;          // statistics of the data columns
+    TString fTraceFile;             // output file of trace
 
     Bool_t CheckVarBounds(Int_t var, const Char_t* loc) const;
     Bool_t CheckVariables() const;
+    Bool_t HasAdaptiveBinning() const;
+    Bool_t ApplyAdaptiveBinning(RooAbsData* data);
+    Bool_t UpdateColumnStats();
     Bool_t CheckFitResult(RooFitResult* res, FFMinimizer_t minimizer,
                           Bool_t verbose = kTRUE) const;
     Bool_t ContainsVariable(RooAbsPdf* pdf, Int_t var, Bool_t excl = kFALSE) const;
     RooCmdArg CreateMinimizerArg(FFMinimizer_t min);
+    RooFitResult* Minimize(RooAbsReal* fcn, FFMinimizer_t min,
+                           Bool_t sumW2Error = kFALSE, Bool_t verbose = kTRUE);
+    void StartPhase(Int_t phase);
+    void StopPhase();
     virtual Bool_t LoadData() = 0;
     virtual Bool_t PrepareFit();
     virtual Bool_t PostFit();
     Bool_t Chi2PreFit();
+    Bool_t PerformFit(const Char_t* opt);
+    void CollectConstraints(RooArgSet& set);
+    TString GetCacheFile(const Char_t* modelKey, const Char_t* dataKey) const;
+    EFFCacheMatch LoadCachedResult();
+    Bool_t SaveCachedResult();
 
     static const Color_t fgColors[8];    // some colors
     static const Style_t fgLStyle[3];    // line styles
@@ -96,15 +136,20 @@ protected:
 public:
     FFRooFit() : TNamed(),
                  fNVar(0), fVar(0),
+                 fBinType(0), fBinPar(0), fBinNUni(0),
                  fNVarAux(0), fVarAux(0),
                  fNVarCtrl(0), fVarCtrl(0),
                  fNConstr(0), fConstr(0),
+                 fConstrGauss(0), fConstrGaussSig(""),
                  fData(0), fModel(0),
                  fResult(0),
                  fNChi2PreFit(0),
                  fMinimizer(kMinuit2_Migrad),
                  fMinimizerPreFit(kMinuit2_Migrad),
-                 fRangeMin(0), fRangeMax(0) { }
+                 fRangeMin(0), fRangeMax(0),
+                 fProfile(0),
+                 fTrace(0), fStats(0),
+                 fTraceFile("") { }
     FFRooFit(Int_t nVar, const Char_t* name = "FFRooFit", const Char_t* title = "a FooFit RooFit");
     virtual ~FFRooFit();
 
@@ -117,17 +162,26 @@ public:
     Int_t GetNChi2PreFit() const { return fNChi2PreFit; }
     FFMinimizer_t GetMinimizer() const { return fMinimizer; }
     FFMinimizer_t GetMinimizerPreFit() const { return fMinimizerPreFit; }
+    FFBinning_t GetBinningType(Int_t i) const;
+    FFRooFitProfile* GetProfile() const { return fProfile; }
+    FFRooFitTrace* GetTrace() const { return fTrace; }
+    FFColumnStats* GetColumnStats() const { return fStats; }
+    TString GetModelFingerprint() const;
+    TString GetDataFingerprint();
     void SetFitRange(Double_t min, Double_t max) { fRangeMin = min; fRangeMax = max; }
 
     void SetVariable(Int_t i, const Char_t* name, const Char_t* title,
                      Double_t min, Double_t max, Int_t nbins = 0);
-    void SetModel(FFRooModel* model) { fModel = model; }
+    void SetAdaptiveBinning(Int_t i, FFBinning_t type, Double_t par = 0);
+    void SetModel(FFRooModel* model);
     void AddAuxVariable(RooRealVar* aux_var);
     void AddControlVariable(const Char_t* name, const Char_t* title);
     void AddConstraint(FFRooModel* c);
     void SetNChi2PreFit(Int_t n) { fNChi2PreFit = n; }
     void SetMinimizer(FFMinimizer_t min) { fMinimizer = min; }
     void SetMinimizerPreFit(FFMinimizer_t min) { fMinimizerPreFit = min; }
+    void EnableTrace(const Char_t* file = "");
+    void DisableTrace();
 
     virtual Bool_t Fit(const Char_t* opt = "");
 
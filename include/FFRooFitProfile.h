@@ -0,0 +1,88 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooFitProfile                                                      //
+//                                                                      //
+// Class collecting phase timings and evaluation counters of a fit.     //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooFitProfile
+#define FOOFIT_FFRooFitProfile
+
+#include "TNamed.h"
+
+class FFRooFitProfile : public TNamed
+{
+
+public:
+    // fit phases
+    enum EFFPhase {
+        kLoadData,
+        kPrepareFit,
+        kBuildModel,
+        kChi2PreFit,
+        kMigrad,
+        kHesse,
+        kPostFit,
+        kNPhase
+    };
+
+    // evaluation counters (all but kNLLEval are estimated from the
+    // parameter changes of the components, see FFRooNLLMonitor)
+    enum EFFCounter {
+        kNLLEval,
+        kNormIntegral,
+        kFFTConvol,
+        kCacheHit,
+        kNCounter
+    };
+
+protected:
+    Double_t fPhaseTime[kNPhase];   // accumulated wall time of phases [s]
+    Int_t fPhaseCalls[kNPhase];     // number of times the phases were entered
+    Long64_t fCounter[kNCounter];   // evaluation counters
+    Int_t fPhase;                   // currently running phase (-1 if none)
+    Double_t fPhaseStart;           // start time of currently running phase [s]
+    Double_t fTotalTime;            // total wall time [s]
+    Double_t fTotalStart;           // start time of total timer [s] (-1 if stopped)
+
+    static const Char_t* fgPhaseName[kNPhase];      // phase names
+    static const Char_t* fgCounterName[kNCounter];  // counter names
+
+public:
+    FFRooFitProfile() : TNamed() { Reset(); }
+    FFRooFitProfile(const Char_t* name, const Char_t* title);
+    virtual ~FFRooFitProfile() { }
+
+    Int_t GetPhase() const { return fPhase; }
+    Double_t GetPhaseTime(EFFPhase p) const { return fPhaseTime[p]; }
+    Int_t GetPhaseCalls(EFFPhase p) const { return fPhaseCalls[p]; }
+    Long64_t GetCount(EFFCounter c) const { return fCounter[c]; }
+    Double_t GetTotalTime() const;
+
+    void Reset();
+    void Start();
+    void Stop();
+    void StartPhase(EFFPhase p);
+    void StopPhase();
+    void Count(EFFCounter c, Long64_t n = 1) { fCounter[c] += n; }
+
+    TString GetSummary() const;
+    Bool_t WriteSummary(const Char_t* file) const;
+
+    virtual void Print(Option_t* option = "") const;
+
+    static Double_t Now();
+    static const Char_t* GetPhaseName(Int_t p);
+    static const Char_t* GetCounterName(Int_t c);
+
+    ClassDef(FFRooFitProfile, 0)  // Fit phase timings and evaluation counters
+};
+
+#endif
+
@@ -0,0 +1,75 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooFitTrace                                                        //
+//                                                                      //
+// Class recording a trace of a fit (spans and minimized function       //
+// calls) exportable as Chrome trace-event JSON or ROOT tree.           //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooFitTrace
+#define FOOFIT_FFRooFitTrace
+
+#include <vector>
+
+#include "TNamed.h"
+
+class FFRooFitTrace : public TNamed
+{
+
+protected:
+    Double_t fStart;                                // start time of trace [s]
+    Int_t fPid;                                     // process id
+    std::vector<Int_t> fSpanOpen;                   //! indices of running (nested) spans
+    std::vector<TString> fSpanName;                 //! span names
+    std::vector<ULong64_t> fSpanThread;             //! span thread ids
+    std::vector<Double_t> fSpanStart;               //! span start times [s]
+    std::vector<Double_t> fSpanEnd;                 //! span end times [s]
+    std::vector<TString> fFcnName;                  //! names of traced functions
+    std::vector<std::vector<TString> > fFcnPar;     //! parameter names of traced functions
+    std::vector<Int_t> fCallFcn;                    //! function indices of calls
+    std::vector<Int_t> fCallPhase;                  //! fit phases of calls
+    std::vector<ULong64_t> fCallThread;             //! thread ids of calls
+    std::vector<Double_t> fCallStart;               //! start times of calls [s]
+    std::vector<Double_t> fCallDur;                 //! durations of calls [s]
+    std::vector<Double_t> fCallVal;                 //! function values of calls
+    std::vector<std::vector<Double_t> > fCallPar;   //! parameter values of calls
+
+    static TString FormatNumber(Double_t v);
+
+public:
+    FFRooFitTrace() : TNamed(),
+                      fStart(0), fPid(0) { }
+    FFRooFitTrace(const Char_t* name, const Char_t* title);
+    virtual ~FFRooFitTrace() { }
+
+    Int_t GetNSpans() const { return fSpanName.size(); }
+    Int_t GetNFunctions() const { return fFcnName.size(); }
+    Long64_t GetNCalls() const { return fCallFcn.size(); }
+
+    void Reset();
+    void StartSpan(const Char_t* name);
+    void StopSpan();
+    void StopAllSpans();
+    Int_t AddFunction(const Char_t* name, const std::vector<TString>& parNames);
+    void AddCall(Int_t fcn, Int_t phase, Double_t start, Double_t dur,
+                 Double_t val, const std::vector<Double_t>& par);
+
+    Bool_t WriteJSON(const Char_t* file) const;
+    Bool_t WriteTree(const Char_t* file) const;
+    Bool_t Save(const Char_t* file) const;
+
+    virtual void Print(Option_t* option = "") const;
+
+    static ULong64_t GetThreadID();
+
+    ClassDef(FFRooFitTrace, 0)  // Fit trace recorder
+};
+
+#endif
+
@@ -64,8 +64,10 @@ public:
     virtual ~FFRooFitTree();
 
     TTree* GetTree() const { return fTree; }
+    Bool_t IsBinnedFit() const { return fIsBinnedFit; }
 
     void SetTree(TTree* tree) { fTree = tree; }
+    void SetBinnedFit(Bool_t binnedFit) { fIsBinnedFit = binnedFit; }
     void AddWeightedTree(TTree* tree, const Char_t* weight);
 
     ClassDef(FFRooFitTree, 0)  // Fit trees using RooFit
@@ -26,6 +26,7 @@ class TH1;
 class RooAbsReal;
 class FFRooFit;
 class FFRooFitterSpecies;
+class FFColumnStats;
 
 class FFRooFitter : public TNamed
 {
@@ -39,6 +40,11 @@ protected:
     FFRooModel* fModel;             // total model
     Int_t fNSpec;                   // number of species
     FFRooFitterSpecies** fSpec;     //[fNSpec] array of species
+    std::vector<FFColumnStats*> fTreeStats; // statistics of the unbinned input data (per variable)
+    Double_t fAutoRangeTailLow;     // excluded lower tail fraction of automatic ranges
+    Double_t fAutoRangeTailHigh;    // excluded upper tail fraction of automatic ranges
+    Bool_t fTemplateCache;          // flag for caching histogram templates of trees
+    Double_t fKeysMaxRelErr;        // maximum relative error of indexed keys pdfs
 
     TString BuildModelName(const Char_t* name);
     TChain* LoadChainSpecies(const Char_t* name, const Char_t* treeLoc);
@@ -52,13 +58,18 @@ public:
                    fWeightVar(""),
                    fFitter(0),
                    fModel(0),
-                   fNSpec(0), fSpec(0) { }
+                   fNSpec(0), fSpec(0),
+                   fTreeStats(),
+                   fAutoRangeTailLow(0.005), fAutoRangeTailHigh(0),
+                   fTemplateCache(kFALSE), fKeysMaxRelErr(0) { }
     FFRooFitter(const Char_t* name, const Char_t* title);
     virtual ~FFRooFitter();
 
     void AddWeightedTree(const Char_t* treeLoc, Double_t weightScale);
 
     FFRooModel* GetModel() const { return fModel; }
+    FFRooFitProfile* GetProfile() const;
+    FFRooFitTrace* GetTrace() const;
 
     Int_t GetNSpecies() const { return fNSpec; }
     FFRooFitterSpecies* GetSpecies(Int_t i) const;
@@ -78,6 +89,8 @@ public:
                              RooAbsReal** convolPar, Int_t intOrder = 0);
     Bool_t AddSpeciesHistPdf(const Char_t* name, const Char_t* title, TH1* hist,
                              Bool_t gaussConvol = kFALSE, Int_t intOrder = 0);
+    Bool_t AddSpeciesHistMorphPdf(const Char_t* name, const Char_t* title, Int_t nPoint,
+                                  const Double_t* points, const Char_t** treeLoc, Int_t intOrder = 0);
     Bool_t AddSpeciesKeysPdf(const Char_t* name, const Char_t* title, const Char_t* treeLoc,
                              const Char_t* opt = "a", Double_t rho = 1, Int_t nSigma = 3, Bool_t rotate = kTRUE);
     Bool_t AddSpeciesKeysPdf(const Char_t* name, const Char_t* title, const Char_t* treeLoc,
@@ -87,12 +100,18 @@ public:
                      Double_t min, Double_t max, Int_t nbins);
     void SetVariableAutoRange(Int_t i, const Char_t* name, const Char_t* title,
                               Int_t nbins);
+    void SetAutoRangeTails(Double_t low, Double_t high = 0);
+    void SetTemplateCache(Bool_t use = kTRUE) { fTemplateCache = use; }
+    void SetKeysMaxRelError(Double_t err) { fKeysMaxRelErr = err; }
+    void SetAdaptiveBinning(Int_t i, FFRooFit::FFBinning_t type, Double_t par = 0);
     void AddAuxVariable(RooRealVar* aux_var);
     void AddControlVariable(const Char_t* name, const Char_t* title);
     void AddConstraint(FFRooModel* c);
     void SetNChi2PreFit(Int_t n);
     void SetMinimizer(FFRooFit::FFMinimizer_t min);
     void SetMinimizerPreFit(FFRooFit::FFMinimizer_t min);
+    void EnableTrace(const Char_t* file = "");
+    void DisableTrace();
     void SetFitRange(Double_t min, Double_t max);
 
     virtual Bool_t Fit(const Char_t* opt = "");
@@ -0,0 +1,59 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooFitterAuto                                                      //
+//                                                                      //
+// Class for fitting multiple species to data choosing automatically    //
+// between an unbinned and a binned fit.                                //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooFitterAuto
+#define FOOFIT_FFRooFitterAuto
+
+#include "FFRooFitterUnbinned.h"
+
+class FFRooFitterAuto : public FFRooFitterUnbinned
+{
+
+protected:
+    Int_t fNVar;                    // number of fit variables
+    Double_t* fVarRes;              //[fNVar] resolutions of the fit variables
+    Double_t fBinsPerRes;           // number of bins per resolution
+    Bool_t fIsBinnedFit;            // binned fit flag of last decision
+    Double_t fSpeedup;              // estimated speedup of last decision
+
+    void Init(Int_t nVar);
+    Bool_t ChooseFitType();
+
+public:
+    FFRooFitterAuto() : FFRooFitterUnbinned(),
+                        fNVar(0), fVarRes(0),
+                        fBinsPerRes(2),
+                        fIsBinnedFit(kFALSE), fSpeedup(1) { }
+    FFRooFitterAuto(TTree* tree, Int_t nVar,
+                    const Char_t* name, const Char_t* title,
+                    const Char_t* weightVar = 0);
+    FFRooFitterAuto(const Char_t* treeName, const Char_t* treeLoc, Int_t nVar,
+                    const Char_t* name, const Char_t* title,
+                    const Char_t* weightVar = 0);
+    virtual ~FFRooFitterAuto();
+
+    Double_t GetVariableResolution(Int_t i) const;
+    Double_t GetBinsPerResolution() const { return fBinsPerRes; }
+    Bool_t IsBinnedFit() const { return fIsBinnedFit; }
+    Double_t GetEstimatedSpeedup() const { return fSpeedup; }
+
+    void SetVariableResolution(Int_t i, Double_t res);
+    void SetBinsPerResolution(Double_t n) { fBinsPerRes = n; }
+
+    virtual Bool_t Fit(const Char_t* opt = "");
+
+    ClassDef(FFRooFitterAuto, 0)  // Class for species fitting choosing binned or unbinned data
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooGridConvPdf                                                     //
+//                                                                      //
+// Histogram pdf convolved with Gaussians in all dimensions via FFT.    //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooGridConvPdf
+#define FOOFIT_FFRooGridConvPdf
+
+#include <vector>
+
+#include "RooAbsPdf.h"
+#include "RooListProxy.h"
+
+class TH1;
+class RooArgList;
+
+class FFRooGridConvPdf : public RooAbsPdf
+{
+
+protected:
+    RooListProxy fObs;                          // observables
+    RooListProxy fMean;                         // Gaussian means
+    RooListProxy fSigma;                        // Gaussian sigmas
+    Int_t fNDim;                                // number of dimensions
+    Int_t* fNBin;                               //[fNDim] number of bins per dimension
+    Double_t* fMin;                             //[fNDim] lower bounds
+    Double_t* fMax;                             //[fNDim] upper bounds
+    Double_t* fBinW;                            //[fNDim] bin widths
+    Int_t* fNPad;                               //[fNDim] number of bins of the padded grid
+    Int_t fNCell;                               // number of grid cells
+    Double_t* fGrid;                            //[fNCell] intrinsic grid
+    Int_t fInterpolOrder;                       // order of interpolation (0 or 1)
+    Double_t fBinVol;                           // bin volume
+
+    mutable std::vector<Double_t> fConv;        //! convolved grid
+    mutable std::vector<Double_t> fConvMean;    //! means used for the convolved grid
+    mutable std::vector<Double_t> fConvSigma;   //! sigmas used for the convolved grid
+    mutable std::vector<Double_t> fFwdRe;       //! transform of the padded grid (real part)
+    mutable std::vector<Double_t> fFwdIm;       //! transform of the padded grid (imag. part)
+    mutable std::vector<std::vector<Double_t> > fKerRe; //! transforms of the kernels (real part)
+    mutable std::vector<std::vector<Double_t> > fKerIm; //! transforms of the kernels (imag. part)
+    mutable Long64_t fNConv;                    //! number of convolutions
+
+    void Init(const Int_t* nBin, const Double_t* min, const Double_t* max);
+    void UpdateConvolution() const;
+    Double_t GetConvContent(const Int_t* bin) const;
+
+    virtual Double_t evaluate() const;
+
+public:
+    FFRooGridConvPdf() : RooAbsPdf(),
+                         fNDim(0), fNBin(0), fMin(0), fMax(0), fBinW(0), fNPad(0),
+                         fNCell(0), fGrid(0), fInterpolOrder(0), fBinVol(0),
+                         fNConv(0) { }
+    FFRooGridConvPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                     const RooArgList& mean, const RooArgList& sigma, const TH1* hist,
+                     Int_t intOrder = 0);
+    FFRooGridConvPdf(const FFRooGridConvPdf& other, const Char_t* name = 0);
+    virtual ~FFRooGridConvPdf();
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooGridConvPdf(*this, newname); }
+
+    Int_t GetNDim() const { return fNDim; }
+    Int_t GetNPaddedBins(Int_t i) const { return fNPad[i]; }
+    Long64_t GetNConvolutions() const { return fNConv; }
+
+    Bool_t CheckFFT() const;
+
+    virtual Int_t getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars,
+                                        const char* rangeName = 0) const;
+    virtual Double_t analyticalIntegral(Int_t code, const char* rangeName = 0) const;
+
+    ClassDef(FFRooGridConvPdf, 0)  // Histogram pdf convolved with Gaussians via FFT
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooGridKeysPdf                                                     //
+//                                                                      //
+// Kernel estimation pdf tabulated on a grid via FFT.                   //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooGridKeysPdf
+#define FOOFIT_FFRooGridKeysPdf
+
+#include <vector>
+
+#include "FFRooTemplatePdf.h"
+
+class RooDataSet;
+
+class FFRooGridKeysPdf : public FFRooTemplatePdf
+{
+
+protected:
+    TString fOpt;                       // options
+    Double_t fRho;                      // bandwidth scaling factor
+    Int_t fNSigma;                      // kernel range in units of the bandwidth
+    Double_t fBandwidth[3];             // global bandwidths per dimension
+    Int_t fNKernel;                     // number of used kernel classes
+    Double_t fSumW;                     // sum of event weights
+    Bool_t fValid;                      // flag for a successfully tabulated density
+
+    Bool_t TransformKernels(Double_t scale, const Int_t* nPad, const Int_t* pad,
+                            std::vector<Double_t>* kRe, std::vector<Double_t>* kIm) const;
+    Bool_t BuildGrid(Long64_t nEntries, const Double_t* x, const Double_t* w, Int_t nBin);
+
+public:
+    FFRooGridKeysPdf() : FFRooTemplatePdf(),
+                         fOpt(""), fRho(0), fNSigma(0), fNKernel(0), fSumW(0), fValid(kFALSE)
+                         { fBandwidth[0] = fBandwidth[1] = fBandwidth[2] = 0; }
+    FFRooGridKeysPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                     RooDataSet& data, const Char_t* opt = "a", Double_t rho = 1,
+                     Int_t nSigma = 3, Int_t nBin = 0, Int_t intOrder = 1);
+    FFRooGridKeysPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                     Long64_t n, const Double_t* x, const Double_t* w = 0, const Char_t* opt = "a",
+                     Double_t rho = 1, Int_t nSigma = 3, Int_t nBin = 0, Int_t intOrder = 1);
+    FFRooGridKeysPdf(const FFRooGridKeysPdf& other, const Char_t* name = 0);
+    virtual ~FFRooGridKeysPdf() { }
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooGridKeysPdf(*this, newname); }
+
+    Double_t GetBandwidth(Int_t i) const { return fBandwidth[i]; }
+    Int_t GetNKernel() const { return fNKernel; }
+    Double_t GetSumOfWeights() const { return fSumW; }
+    Bool_t IsValid() const { return fValid; }
+
+    static Int_t GetDefaultBins(Int_t nDim);
+
+    ClassDef(FFRooGridKeysPdf, 0)  // Kernel estimation pdf tabulated on a grid via FFT
+};
+
+#endif
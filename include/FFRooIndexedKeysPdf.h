@@ -0,0 +1,99 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooIndexedKeysPdf                                                  //
+//                                                                      //
+// N-dimensional kernel estimation pdf with truncated kernels evaluated //
+// via a spatial index.                                                 //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooIndexedKeysPdf
+#define FOOFIT_FFRooIndexedKeysPdf
+
+#include <vector>
+
+#include "RooAbsPdf.h"
+#include "RooListProxy.h"
+
+class RooArgList;
+class RooDataSet;
+
+class FFRooIndexedKeysPdf : public RooAbsPdf
+{
+
+protected:
+    RooListProxy fObs;                  // observables
+    Int_t fNDim;                        // number of dimensions
+    TString fOpt;                       // options
+    Double_t fRho;                      // bandwidth scaling factor
+    Int_t fNSigma;                      // kernel range in units of the bandwidth
+    Double_t fMaxRelErr;                // maximum relative error of subsampling (0: exact)
+    Double_t fMin[3];                   // lower bounds of the observables
+    Double_t fMax[3];                   // upper bounds of the observables
+    Double_t fBandwidth[3];             // global bandwidths per dimension
+    Double_t fSumW;                     // sum of event weights
+    Long64_t fNKernel;                  // number of kernels (including mirrored events)
+    std::vector<Double_t> fKerX;        // kernel centers [kernel][dim]
+    std::vector<Double_t> fKerInvH;     // inverse kernel widths [kernel][dim]
+    std::vector<Double_t> fKerW;        // weights times kernel normalizations [kernel]
+    Int_t fNClass;                      // number of kernel width classes
+    std::vector<Double_t> fClassMax;    // maximum kernel scales of the classes [class]
+    std::vector<Int_t> fCellN;          // number of cells [class][dim]
+    std::vector<Double_t> fCellW;       // cell widths [class][dim]
+    std::vector<Double_t> fCellMin;     // lower edges of the cell grids [class][dim]
+    std::vector<Long64_t> fCellOff;     // first cell of each class [class+1]
+    std::vector<Long64_t> fCellStart;   // first kernel of each cell [cell+1]
+    std::vector<Double_t> fCellMaxW;    // maximum kernel weight of each cell [cell]
+    Double_t fIntegral;                 // integral over the full ranges
+    Bool_t fValid;                      // flag for successfully built kernels
+
+    static const Int_t fgNClass = 12;   // number of kernel width classes of adaptive kernels
+
+    void Init(const Char_t* opt, Double_t rho, Int_t nSigma, Double_t maxRelErr);
+    Bool_t Build(Long64_t nEntries, const Double_t* x, const Double_t* w);
+    void BuildIndex(Long64_t nEvent, const Double_t* x, const Double_t* w,
+                    const Double_t* scale, Int_t nClass);
+    Double_t ComputeIntegral(Int_t mask, const Double_t* lo, const Double_t* hi,
+                             const Double_t* x) const;
+
+    virtual Double_t evaluate() const;
+
+public:
+    FFRooIndexedKeysPdf() : RooAbsPdf(),
+                            fNDim(0), fOpt(""), fRho(0), fNSigma(0), fMaxRelErr(0),
+                            fSumW(0), fNKernel(0), fNClass(0), fIntegral(0), fValid(kFALSE) { }
+    FFRooIndexedKeysPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                        RooDataSet& data, const Char_t* opt = "a", Double_t rho = 1,
+                        Int_t nSigma = 3, Double_t maxRelErr = 0);
+    FFRooIndexedKeysPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                        Long64_t n, const Double_t* x, const Double_t* w = 0, const Char_t* opt = "a",
+                        Double_t rho = 1, Int_t nSigma = 3, Double_t maxRelErr = 0);
+    FFRooIndexedKeysPdf(const FFRooIndexedKeysPdf& other, const Char_t* name = 0);
+    virtual ~FFRooIndexedKeysPdf() { }
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooIndexedKeysPdf(*this, newname); }
+
+    Int_t GetNDim() const { return fNDim; }
+    const RooArgList& GetObservables() const { return fObs; }
+    Double_t GetBandwidth(Int_t i) const { return fBandwidth[i]; }
+    Long64_t GetNKernel() const { return fNKernel; }
+    Int_t GetNClass() const { return fNClass; }
+    Double_t GetSumOfWeights() const { return fSumW; }
+    Bool_t IsValid() const { return fValid; }
+
+    Double_t Evaluate(const Double_t* x) const;
+    void EvaluateEvents(Long64_t n, const Double_t* x, Double_t* out, const char* rangeName = 0) const;
+
+    virtual Int_t getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars,
+                                        const char* rangeName = 0) const;
+    virtual Double_t analyticalIntegral(Int_t code, const char* rangeName = 0) const;
+
+    ClassDef(FFRooIndexedKeysPdf, 0)  // N-dim. kernel estimation pdf with spatial index
+};
+
+#endif
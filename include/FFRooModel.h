@@ -19,6 +19,7 @@
 class RooAbsPdf;
 class RooAbsReal;
 class RooRealVar;
+class FFTemplateFiller;
 
 class FFRooModel : public TNamed
 {
@@ -35,6 +36,9 @@ protected:
     Bool_t fIsConvol;               // flag for convolution with other function
     RooAbsPdf* fPdfIntr;            //! intrinsic pdf
     RooAbsPdf* fPdfConv;            //! convolution pdf
+    Int_t fConvCacheBins;           // number of convolution cache bins (0: automatic)
+    TString fBuildSig;              //! build signature of last build
+    Bool_t fIsDirty;                //! flag forcing a rebuild
 
     Bool_t CheckParBounds(Int_t par, const Char_t* loc) const;
     void AddParameter(Int_t i, const Char_t* name, const Char_t* title);
@@ -47,7 +51,8 @@ public:
                    fNPar(0), fPar(0), fParIsOwned(0),
                    fNVarTrans(0), fVarTrans(0),
                    fNConstr(0), fConstr(0),
-                   fIsConvol(kFALSE), fPdfIntr(0), fPdfConv(0) { }
+                   fIsConvol(kFALSE), fPdfIntr(0), fPdfConv(0), fConvCacheBins(0),
+                   fBuildSig(""), fIsDirty(kTRUE) { }
     FFRooModel(const Char_t* name, const Char_t* title, Int_t nPar);
     virtual ~FFRooModel();
 
@@ -62,6 +67,9 @@ public:
     const Char_t* GetParTitle(Int_t i) const;
     Int_t GetNVarTrans() const { return fNVarTrans; }
     RooAbsReal* GetVarTrans(Int_t i) const { return fVarTrans[i]; }
+    virtual Int_t GetNDim() const { return 1; }
+    Int_t GetConvCacheBins() const { return fConvCacheBins; }
+    Bool_t IsDirty() const { return fIsDirty; }
 
     void SetParameter(Int_t i, RooAbsReal* par);
     void SetParameter(Int_t i, Double_t v);
@@ -70,16 +78,32 @@ public:
     void SetParName(Int_t i, const Char_t* name);
     void SetParTitle(Int_t i, const Char_t* title);
     void FixParameter(Int_t i, Double_t v);
+    void SetConvCacheBins(Int_t n) { fConvCacheBins = n; }
 
     void AddParConstrGauss(Int_t i, Double_t mean, Double_t sigma);
+    void RemoveParConstr(Int_t i);
     void FindAllConstraints(TList* list);
 
+    void MarkDirty() { fIsDirty = kTRUE; }
+
+    virtual TString GetFingerprint() const;
+    virtual TString GetBuildSignature(RooAbsReal** vars) const;
+
+    virtual void PrepareTemplates(RooAbsReal** vars, FFTemplateFiller& filler) { }
     virtual void BuildModel(RooAbsReal** vars) = 0;
-    void BuildModel(RooRealVar** vars, Int_t nVars);
+    Bool_t BuildModel(RooRealVar** vars, Int_t nVars);
+    Bool_t NeedsBuild(RooAbsReal** vars) const;
+    Bool_t Build(RooAbsReal** vars);
+
+    virtual Bool_t HasCDF() const { return kFALSE; }
+    virtual void EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                             Double_t min, Double_t max) const;
+    Bool_t IntegrateBins(Int_t nBins, const Double_t* edges,
+                         Double_t min, Double_t max, Double_t* integral) const;
 
     virtual void Print(Option_t* option = "") const;
 
-    ClassDef(FFRooModel, 1)  // Abstract RooFit model class
+    ClassDef(FFRooModel, 2)  // Abstract RooFit model class
 };
 
 #endif
@@ -24,6 +24,7 @@ protected:
     FFRooModel** fModelList;                //[fNModel] list of sub-models (elements not owned)
 
     Bool_t CheckModelBounds(Int_t mod, const Char_t* loc) const;
+    virtual Int_t GetModelVarOffset(Int_t i) const = 0;
 
 public:
     FFRooModelComp() : FFRooModel(),
@@ -38,6 +39,12 @@ public:
     void SetModelList(FFRooModel** list);
     void SetModel(Int_t i, FFRooModel* model);
 
+    virtual Int_t GetNDim() const;
+
+    virtual TString GetFingerprint() const;
+    virtual TString GetBuildSignature(RooAbsReal** vars) const;
+
+    virtual void PrepareTemplates(RooAbsReal** vars, FFTemplateFiller& filler);
     virtual void BuildModel(RooAbsReal** vars) = 0;
 
     ClassDef(FFRooModelComp, 0)  // RooFit composite model class
@@ -26,6 +26,10 @@ public:
 
     virtual void BuildModel(RooAbsReal** vars);
 
+    virtual Bool_t HasCDF() const { return kTRUE; }
+    virtual void EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                             Double_t min, Double_t max) const;
+
     ClassDef(FFRooModelExpo, 0)  // 1-dim. exponential RooFit model
 };
 
@@ -19,13 +19,22 @@
 class FFRooModelGauss : public FFRooModel
 {
 
+protected:
+    RooAbsReal* fVar;               //! variable of the model pdf
+
 public:
-    FFRooModelGauss() : FFRooModel() { }
+    FFRooModelGauss() : FFRooModel(), fVar(0) { }
     FFRooModelGauss(const Char_t* name, const Char_t* title);
     virtual ~FFRooModelGauss() { }
 
+    RooAbsReal* GetVariable() const { return fVar; }
+
     virtual void BuildModel(RooAbsReal** vars);
 
+    virtual Bool_t HasCDF() const { return kTRUE; }
+    virtual void EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                             Double_t min, Double_t max) const;
+
     ClassDef(FFRooModelGauss, 0)  // 1-dim. Gaussian RooFit model
 };
 
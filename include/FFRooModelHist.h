@@ -19,6 +19,7 @@
 class TH1;
 class TTree;
 class RooDataHist;
+class FFRooSparseHistPdf;
 
 class FFRooModelHist : public FFRooModel
 {
@@ -30,10 +31,22 @@ protected:
     TString fWeightVar;             // event weight variable for unbin. input data
     Int_t fInterpolOrder;           // order of interpolation
     RooDataHist* fDataHist;         // data histogram
+    Bool_t fHistNew;                //! flag for a newly filled, not yet used histogram
+    Bool_t fSparse;                 // flag for using a sparse histogram
+    FFRooSparseHistPdf* fSparseHist;//! sparse histogram of unbinned input data
+    Bool_t fUseCache;               // flag for using the template cache
+    Bool_t fHistCached;             //! flag for a histogram loaded from the template cache
 
     void DetermineHistoBinning(RooRealVar* var, RooRealVar* par,
                                Int_t* nBin, Double_t* min, Double_t* max);
     void AddGaussConvolPars();
+    void PrepareSparseTemplate(RooAbsReal** vars, FFTemplateFiller& filler);
+    TString GetTemplateName(RooAbsReal** vars) const;
+    TString GetTemplateFingerprint(RooAbsReal** vars, const Int_t* nBin,
+                                   const Double_t* min, const Double_t* max) const;
+    TString GetTemplateCacheFile(const Char_t* fp) const;
+    Bool_t LoadCachedTemplate(RooAbsReal** vars, const Char_t* fp);
+    Bool_t SaveCachedTemplate(RooAbsReal** vars);
 
 public:
     FFRooModelHist() : FFRooModel(),
@@ -41,7 +54,9 @@ public:
                        fHist(0), fTree(0),
                        fWeightVar(""),
                        fInterpolOrder(0),
-                       fDataHist(0) { }
+                       fDataHist(0), fHistNew(kFALSE),
+                       fSparse(kFALSE), fSparseHist(0),
+                       fUseCache(kFALSE), fHistCached(kFALSE) { }
     FFRooModelHist(const Char_t* name, const Char_t* title, TH1* hist,
                    Bool_t gaussConvol = kFALSE, Int_t intOrder = 0);
     FFRooModelHist(const Char_t* name, const Char_t* title, Int_t Dim, TTree* tree,
@@ -54,9 +69,19 @@ public:
 
     TH1* GetHistogram() const { return fHist; }
     RooDataHist* GetDataHistogram() const { return fDataHist; }
+    FFRooSparseHistPdf* GetSparseHistogram() const { return fSparseHist; }
+    Bool_t IsSparse() const { return fTree && (fSparse || fNDim > 3); }
 
     void SetInterpolationOrder(Int_t order) { fInterpolOrder = order; }
+    void SetSparse(Bool_t sparse = kTRUE) { fSparse = sparse; }
+    void SetTemplateCache(Bool_t use = kTRUE) { fUseCache = use; }
 
+    virtual Int_t GetNDim() const { return fNDim; }
+
+    virtual TString GetFingerprint() const;
+    virtual TString GetBuildSignature(RooAbsReal** vars) const;
+
+    virtual void PrepareTemplates(RooAbsReal** vars, FFTemplateFiller& filler);
     virtual void BuildModel(RooAbsReal** vars);
 
     ClassDef(FFRooModelHist, 0)  // RooFit histogram model class
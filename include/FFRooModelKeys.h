@@ -6,8 +6,8 @@
 //                                                                      //
 // FFRooModelKeys                                                       //
 //                                                                      //
-// Class representing a model for RooFit using the n-dimensional kernel //
-// estimation pdf of RooNDKeysPdf.                                      //
+// Class representing a model for RooFit using an n-dimensional kernel  //
+// estimation pdf.                                                      //
 //                                                                      //
 //////////////////////////////////////////////////////////////////////////
 
@@ -21,6 +21,7 @@
 
 class TTree;
 class RooDataSet;
+class RooArgList;
 
 class FFRooModelKeys : public FFRooModel
 {
@@ -29,7 +30,9 @@ protected:
     enum EKeysPdfType {
         kUndef,
         kRooKeys,
-        kRooNDKeys
+        kRooNDKeys,
+        kGridKeys,
+        kIndexedKeys
     };
 
     EKeysPdfType fType;             // type of underlying pdf
@@ -41,6 +44,9 @@ protected:
     Int_t fNSigma;                  // nSigma parameter for RooNDKeysPdf
     Bool_t fRotate;                 // rotate parameter for RooNDKeysPdf
     RooKeysPdf::Mirror fMirror;     // mirror parameter for RooKeysPdf
+    Double_t fMaxRelErr;            // maximum relative error for FFRooIndexedKeysPdf
+
+    void BuildTreeModel(RooAbsReal** vars, const RooArgList& varList);
 
 public:
     FFRooModelKeys() : FFRooModel(),
@@ -48,13 +54,20 @@ public:
                        fNDim(0),
                        fTree(0), fDataSet(0),
                        fOpt(""), fRho(0), fNSigma(0), fRotate(kTRUE),
-                       fMirror(RooKeysPdf::NoMirror) { }
+                       fMirror(RooKeysPdf::NoMirror), fMaxRelErr(0) { }
     FFRooModelKeys(const Char_t* name, const Char_t* title, Int_t nDim, TTree* tree,
                    const Char_t* opt = "a", Double_t rho = 1, Int_t nSigma = 3, Bool_t rotate = kTRUE);
     FFRooModelKeys(const Char_t* name, const Char_t* title, TTree* tree, Bool_t addShiftPar = kFALSE,
                    RooKeysPdf::Mirror mirror = RooKeysPdf::NoMirror, Double_t rho = 1);
     virtual ~FFRooModelKeys();
 
+    virtual Int_t GetNDim() const { return fNDim; }
+
+    void SetMaxRelError(Double_t err) { fMaxRelErr = err; }
+
+    virtual TString GetFingerprint() const;
+    virtual TString GetBuildSignature(RooAbsReal** vars) const;
+
     virtual void BuildModel(RooAbsReal** vars);
 
     ClassDef(FFRooModelKeys, 0)  // RooFit kernel estimation model class
@@ -0,0 +1,64 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooModelMorph                                                      //
+//                                                                      //
+// Class representing a model morphed between histogram templates at    //
+// grid points of a parameter for RooFit.                               //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooModelMorph
+#define FOOFIT_FFRooModelMorph
+
+#include "FFRooModel.h"
+
+class TTree;
+class FFRooModelHist;
+
+class FFRooModelMorph : public FFRooModel
+{
+
+protected:
+    Int_t fNDim;                    // number of dimensions
+    Int_t fNPoint;                  // number of grid points
+    Double_t* fPoint;               //[fNPoint] parameter values of the grid points
+    FFRooModelHist** fPointModel;   //[fNPoint] template models of the grid points
+    Int_t fInterpolOrder;           // order of interpolation in the observables
+
+    void Init(Int_t nPoint, const Double_t* points);
+
+public:
+    FFRooModelMorph() : FFRooModel(),
+                        fNDim(0), fNPoint(0), fPoint(0), fPointModel(0),
+                        fInterpolOrder(0) { }
+    FFRooModelMorph(const Char_t* name, const Char_t* title, Int_t nPoint,
+                    const Double_t* points, FFRooModelHist** models, Int_t intOrder = 0);
+    FFRooModelMorph(const Char_t* name, const Char_t* title, Int_t nDim, Int_t nPoint,
+                    const Double_t* points, TTree** trees, const Char_t* weightVar = 0,
+                    Int_t intOrder = 0);
+    virtual ~FFRooModelMorph();
+
+    Int_t GetNPoint() const { return fNPoint; }
+    Double_t GetPoint(Int_t i) const { return fPoint[i]; }
+    FFRooModelHist* GetPointModel(Int_t i) const { return fPointModel[i]; }
+
+    void SetInterpolationOrder(Int_t order) { fInterpolOrder = order; MarkDirty(); }
+    void SetTemplateCache(Bool_t use = kTRUE);
+
+    virtual Int_t GetNDim() const { return fNDim; }
+
+    virtual TString GetFingerprint() const;
+    virtual TString GetBuildSignature(RooAbsReal** vars) const;
+
+    virtual void PrepareTemplates(RooAbsReal** vars, FFTemplateFiller& filler);
+    virtual void BuildModel(RooAbsReal** vars);
+
+    ClassDef(FFRooModelMorph, 0)  // RooFit template morphing model class
+};
+
+#endif
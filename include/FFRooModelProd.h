@@ -19,6 +19,9 @@
 class FFRooModelProd : public FFRooModelComp
 {
 
+protected:
+    virtual Int_t GetModelVarOffset(Int_t i) const;
+
 public:
     FFRooModelProd() : FFRooModelComp() { }
     FFRooModelProd(const Char_t* name, const Char_t* title, Int_t n, FFRooModel** list = 0);
@@ -0,0 +1,59 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooMorphPdf                                                        //
+//                                                                      //
+// Histogram template pdf morphed between templates at parameter grid   //
+// points.                                                              //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooMorphPdf
+#define FOOFIT_FFRooMorphPdf
+
+#include "RooRealProxy.h"
+
+#include "FFRooTemplatePdf.h"
+
+class FFRooMorphPdf : public FFRooTemplatePdf
+{
+
+protected:
+    RooRealProxy fPar;                  // morphing parameter
+    Int_t fNPoint;                      // number of grid points
+    Double_t* fPoint;                   //[fNPoint] parameter values of the grid points
+    Int_t fNCoef;                       // number of interpolation coefficients
+    Double_t* fCoef;                    //[fNCoef] interpolation coefficients [segment][power][cell]
+    Int_t fNErr;                        // number of squared errors of grid points
+    Double_t* fPointErr2;               //[fNErr] squared errors of grid points [point][cell]
+    mutable Double_t fGridPar;          //! parameter value of the current grid
+    mutable Bool_t fGridValid;          //! flag for a valid current grid
+    mutable Long64_t fNUpdate;          //! number of grid updates
+
+    void InitMorphing(TH1** hists);
+    virtual void UpdateGrid() const;
+
+public:
+    FFRooMorphPdf() : FFRooTemplatePdf(),
+                      fNPoint(0), fPoint(0), fNCoef(0), fCoef(0), fNErr(0), fPointErr2(0),
+                      fGridPar(0), fGridValid(kFALSE), fNUpdate(0) { }
+    FFRooMorphPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                  RooAbsReal& par, Int_t nPoint, const Double_t* points, TH1** hists,
+                  Int_t intOrder = 0);
+    FFRooMorphPdf(const FFRooMorphPdf& other, const Char_t* name = 0);
+    virtual ~FFRooMorphPdf();
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooMorphPdf(*this, newname); }
+
+    Int_t GetNPoint() const { return fNPoint; }
+    Double_t GetPoint(Int_t i) const { return fPoint[i]; }
+    Long64_t GetNUpdate() const { return fNUpdate; }
+
+    ClassDef(FFRooMorphPdf, 0)  // Histogram template pdf with morphing
+};
+
+#endif
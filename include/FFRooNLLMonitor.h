@@ -0,0 +1,64 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooNLLMonitor                                                      //
+//                                                                      //
+// Wrapper of a minimized function (NLL, chi2) monitoring its           //
+// evaluations.                                                         //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooNLLMonitor
+#define FOOFIT_FFRooNLLMonitor
+
+#include <vector>
+
+#include "RooAbsReal.h"
+#include "RooRealProxy.h"
+
+class RooAbsPdf;
+class RooRealVar;
+class FFRooFitProfile;
+class FFRooFitTrace;
+
+class FFRooNLLMonitor : public RooAbsReal
+{
+
+protected:
+    RooRealProxy fFunc;                                     // monitored function
+    FFRooFitProfile* fProfile;                              //! profile receiving the counters
+    FFRooFitTrace* fTrace;                                  //! trace receiving the calls (0 if disabled)
+    Int_t fTraceFcn;                                        //! index of function in trace
+    std::vector<RooRealVar*> fTracePar;                     //! traced parameters
+    std::vector<Bool_t> fCompIsConv;                        //! FFT convolution flags of components
+    std::vector<std::vector<RooRealVar*> > fCompPar;        //! floating parameters of components
+    mutable std::vector<std::vector<Double_t> > fCompVal;   //! parameter values of last evaluation
+
+    void TrackComponents(RooAbsPdf* model, const RooArgSet* obs);
+    void TraceParameters();
+    void CountComponents() const;
+
+    virtual Double_t evaluate() const;
+
+public:
+    FFRooNLLMonitor() : RooAbsReal(),
+                        fProfile(0), fTrace(0), fTraceFcn(-1) { }
+    FFRooNLLMonitor(const Char_t* name, const Char_t* title, RooAbsReal& func,
+                    RooAbsPdf* model, const RooArgSet* obs, FFRooFitProfile* profile,
+                    FFRooFitTrace* trace = 0);
+    FFRooNLLMonitor(const FFRooNLLMonitor& other, const Char_t* name = 0);
+    virtual ~FFRooNLLMonitor() { }
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooNLLMonitor(*this, newname); }
+
+    RooAbsReal& GetFunction() const { return (RooAbsReal&)fFunc.arg(); }
+
+    ClassDef(FFRooNLLMonitor, 0)  // Monitor of a minimized function
+};
+
+#endif
+
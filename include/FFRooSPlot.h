@@ -14,6 +14,8 @@
 #ifndef FOOFIT_FFRooSPlot
 #define FOOFIT_FFRooSPlot
 
+#include <vector>
+
 #include "FFRooFitTree.h"
 
 namespace RooStats
@@ -21,6 +23,7 @@ namespace RooStats
     class SPlot;
 };
 class RooRealVar;
+class RooArgList;
 class FFRooModel;
 
 class FFRooSPlot : public FFRooFitTree
@@ -30,9 +33,11 @@ protected:
     Int_t fNSpec;                   // number of species
     RooRealVar* fEventID;           // event ID variable
     RooStats::SPlot* fSPlot;        // sPlot object
+    std::vector<Double_t> fSWeight; //! sWeights of solved yields [event][fNSpec]
 
     Bool_t CheckSpecBounds(Int_t spec, const Char_t* loc) const;
     Bool_t CheckEventID();
+    Bool_t SolveSWeights(const RooArgList& yields);
 
 public:
     FFRooSPlot() : FFRooFitTree(),
@@ -0,0 +1,79 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooSparseHistPdf                                                   //
+//                                                                      //
+// N-dimensional histogram pdf storing only the occupied bins.          //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooSparseHistPdf
+#define FOOFIT_FFRooSparseHistPdf
+
+#include <unordered_map>
+
+#include "RooAbsPdf.h"
+#include "RooListProxy.h"
+
+class RooArgList;
+
+class FFRooSparseHistPdf : public RooAbsPdf
+{
+
+protected:
+    RooListProxy fObs;                                  // observables
+    Int_t fNDim;                                        // number of dimensions
+    Int_t* fNBin;                                       //[fNDim] number of bins per dimension
+    Double_t* fMin;                                     //[fNDim] lower bounds
+    Double_t* fMax;                                     //[fNDim] upper bounds
+    Double_t* fBinW;                                    //[fNDim] bin widths
+    Long64_t* fStride;                                  //[fNDim] strides of the global bin index
+    Int_t fInterpolOrder;                               // order of interpolation (0 or 1)
+    std::unordered_map<Long64_t, Double_t> fContent;    //! contents of the occupied bins
+    Double_t fSumW;                                     // sum of all bin contents
+    Double_t fBinVol;                                   // bin volume
+
+    void Init(const Int_t* nBin, const Double_t* min, const Double_t* max);
+    Double_t GetContent(const Int_t* bin) const;
+
+    virtual Double_t evaluate() const;
+
+public:
+    FFRooSparseHistPdf() : RooAbsPdf(),
+                           fNDim(0), fNBin(0), fMin(0), fMax(0), fBinW(0), fStride(0),
+                           fInterpolOrder(0), fSumW(0), fBinVol(0) { }
+    FFRooSparseHistPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                       const Int_t* nBin, const Double_t* min, const Double_t* max,
+                       Int_t intOrder = 0);
+    FFRooSparseHistPdf(const FFRooSparseHistPdf& other, const Char_t* name = 0);
+    virtual ~FFRooSparseHistPdf();
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooSparseHistPdf(*this, newname); }
+
+    Int_t GetNDim() const { return fNDim; }
+    Int_t GetNBins(Int_t i) const { return fNBin[i]; }
+    Double_t GetMin(Int_t i) const { return fMin[i]; }
+    Double_t GetMax(Int_t i) const { return fMax[i]; }
+    Long64_t GetNFilledBins() const { return fContent.size(); }
+    Double_t GetSumOfWeights() const { return fSumW; }
+    Int_t GetInterpolationOrder() const { return fInterpolOrder; }
+    Long64_t GetBinIndex(const Double_t* x) const;
+    Bool_t HasBinning(const Int_t* nBin, const Double_t* min, const Double_t* max) const;
+    Bool_t HasObservables(RooAbsReal** obs) const;
+
+    void Fill(const Double_t* x, Double_t w = 1);
+    void AddBinContent(Long64_t bin, Double_t w);
+    void Reset();
+
+    virtual Int_t getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars,
+                                        const char* rangeName = 0) const;
+    virtual Double_t analyticalIntegral(Int_t code, const char* rangeName = 0) const;
+
+    ClassDef(FFRooSparseHistPdf, 0)  // Sparse N-dimensional histogram pdf
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooTemplatePdf                                                     //
+//                                                                      //
+// Histogram template pdf with lookup tables for event evaluation.      //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooTemplatePdf
+#define FOOFIT_FFRooTemplatePdf
+
+#include <vector>
+
+#include "RooAbsPdf.h"
+#include "RooListProxy.h"
+
+class TH1;
+class RooArgList;
+
+class FFRooTemplatePdf : public RooAbsPdf
+{
+
+protected:
+    RooListProxy fObs;                  // observables
+    Int_t fNDim;                        // number of dimensions
+    Int_t* fNBin;                       //[fNDim] number of bins per dimension
+    Double_t* fMin;                     //[fNDim] lower bounds
+    Double_t* fMax;                     //[fNDim] upper bounds
+    Double_t* fBinW;                    //[fNDim] bin widths
+    Int_t fNCell;                       // number of grid cells
+    Double_t* fGrid;                    //[fNCell] bin contents
+    Double_t* fGridErr2;                //[fNCell] squared bin errors
+    Int_t fInterpolOrder;               // order of interpolation (0, 1 or 3)
+    Int_t fNTap;                        // number of interpolation nodes per dimension
+    Double_t fBinVol;                   // bin volume
+    std::vector<Int_t> fOff;            //! cell offsets of the interpolation stencil
+    Long64_t fNEvent;                   //! number of tabulated events
+    std::vector<Int_t> fEvBase;         //! base cells of the stencils of the events
+    std::vector<Double_t> fEvW;         //! interpolation weights of the events
+    const TObject* fEvOwner;            //! owner of the tabulated events (not owned)
+
+    FFRooTemplatePdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                     Int_t intOrder);
+
+    void Init(const TH1* hist);
+    void InitGrid(const Int_t* nBin, const Double_t* min, const Double_t* max);
+    Bool_t ComputeStencil(const Double_t* x, Int_t* base, Double_t* w) const;
+    Double_t EvaluateStencil(Int_t base, const Double_t* w) const;
+    virtual void UpdateGrid() const { }
+
+    virtual Double_t evaluate() const;
+
+public:
+    FFRooTemplatePdf() : RooAbsPdf(),
+                         fNDim(0), fNBin(0), fMin(0), fMax(0), fBinW(0),
+                         fNCell(0), fGrid(0), fGridErr2(0), fInterpolOrder(0), fNTap(1), fBinVol(0),
+                         fNEvent(0), fEvOwner(0) { }
+    FFRooTemplatePdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                     const TH1* hist, Int_t intOrder = 0);
+    FFRooTemplatePdf(const FFRooTemplatePdf& other, const Char_t* name = 0);
+    virtual ~FFRooTemplatePdf();
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooTemplatePdf(*this, newname); }
+
+    Int_t GetNDim() const { return fNDim; }
+    const RooArgList& GetObservables() const { return fObs; }
+    Int_t GetInterpolationOrder() const { return fInterpolOrder; }
+    Long64_t GetNEvent() const { return fNEvent; }
+    const TObject* GetEventOwner() const { return fEvOwner; }
+    Double_t GetNormalization(const char* rangeName = 0) const;
+    Double_t GetRelError2(const Double_t* x) const;
+
+    Long64_t TabulateEvents(Long64_t n, const Double_t* x, const TObject* owner = 0);
+    void EvaluateEvents(Double_t* out, const char* rangeName = 0) const;
+    void ClearEvents();
+
+    virtual Int_t getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars,
+                                        const char* rangeName = 0) const;
+    virtual Double_t analyticalIntegral(Int_t code, const char* rangeName = 0) const;
+
+    static Bool_t IsSupported(const TH1* hist, Int_t intOrder);
+
+    ClassDef(FFRooTemplatePdf, 0)  // Histogram template pdf with event lookup tables
+};
+
+#endif
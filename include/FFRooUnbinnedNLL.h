@@ -0,0 +1,110 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooUnbinnedNLL                                                     //
+//                                                                      //
+// Native extended negative log-likelihood of a sum of models and       //
+// unbinned data using cached per-event component densities.            //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFRooUnbinnedNLL
+#define FOOFIT_FFRooUnbinnedNLL
+
+#include <vector>
+
+#include "RooAbsReal.h"
+#include "RooListProxy.h"
+#include "RooArgSet.h"
+
+class RooRealVar;
+class RooAbsData;
+class RooArgList;
+class RooDataSet;
+class FFRooModel;
+class FFRooModelSum;
+
+class FFRooUnbinnedNLL : public RooAbsReal
+{
+
+protected:
+    RooListProxy fComp;                                     // component pdfs
+    RooListProxy fCoef;                                     // component yields
+    RooListProxy fConstr;                                   // constraint pdfs
+    FFRooModelSum* fModel;                                  //! model (not owned)
+    Int_t fNComp;                                           // number of components
+    Int_t fNObs;                                            // number of observables
+    RooRealVar** fObs;                                      //[fNObs] observables (elements not owned)
+    RooArgSet fObsSet;                                      // set of observables
+    Long64_t fNEvent;                                       // number of events
+    Double_t* fEvX;                                         //[fNEvent*fNObs] observable values of events
+    Double_t* fEvW;                                         //[fNEvent] event weights
+    Double_t* fEvW2;                                        //[fNEvent] squared event weights
+    Double_t fSumW;                                         // sum of event weights
+    Double_t fSumW2;                                        // sum of squared event weights
+    Double_t* fProb;                                        //! cached densities of components [fNComp*fNEvent]
+    Double_t* fMu;                                          //! event expectations [fNEvent]
+    Bool_t fWeightSq;                                       // flag for using squared weights
+    std::vector<RooArgSet*> fConstrNorm;                    //! normalization sets of constraints
+    std::vector<std::vector<RooRealVar*> > fCompPar;        //! floating parameters of components
+    mutable std::vector<std::vector<Double_t> > fCompVal;   //! parameter values of cached densities
+    mutable std::vector<Bool_t> fCompValid;                 //! flags for valid cached densities
+    std::vector<RooRealVar*> fPar;                          //! all floating parameters
+    mutable std::vector<Double_t> fParVal;                  //! parameter values of cached likelihood value
+    mutable Double_t fLastVal;                              //! cached likelihood value
+    mutable Bool_t fLastValid;                              //! flag for valid cached likelihood value
+    mutable Long64_t fNCompEval;                            //! number of component re-evaluations
+    Int_t fNSolverIter;                                     //! number of iterations of the yield solver
+    Double_t fSolverEDM;                                    //! estimated distance to minimum of the yield solver
+
+    void Init();
+    void LoadEvents(RooDataSet& data);
+    void CollectParameters();
+    Bool_t CollectEvents(const RooArgList& obs, std::vector<Double_t>& x) const;
+    Bool_t TabulateTemplate(Int_t comp) const;
+    Bool_t TabulateComponent(Int_t comp) const;
+    void ComputeDensities(Int_t comp) const;
+    Bool_t ComputeYieldNLL(Int_t nFree, const Int_t* idx, const Double_t* n,
+                           const Double_t* mu0, Double_t* nll) const;
+
+    virtual Double_t evaluate() const;
+
+public:
+    FFRooUnbinnedNLL() : RooAbsReal(),
+                         fModel(0), fNComp(0),
+                         fNObs(0), fObs(0),
+                         fNEvent(0), fEvX(0), fEvW(0), fEvW2(0), fSumW(0), fSumW2(0),
+                         fProb(0), fMu(0), fWeightSq(kFALSE),
+                         fLastVal(0), fLastValid(kFALSE), fNCompEval(0),
+                         fNSolverIter(0), fSolverEDM(0) { }
+    FFRooUnbinnedNLL(const Char_t* name, const Char_t* title, FFRooModelSum* model,
+                     RooDataSet& data, RooRealVar** obs, Int_t nObs,
+                     const RooArgSet& constr);
+    FFRooUnbinnedNLL(const FFRooUnbinnedNLL& other, const Char_t* name = 0);
+    virtual ~FFRooUnbinnedNLL();
+
+    virtual TObject* clone(const Char_t* newname) const { return new FFRooUnbinnedNLL(*this, newname); }
+
+    Long64_t GetNEvent() const { return fNEvent; }
+    Int_t GetNComp() const { return fNComp; }
+    Int_t GetNCompCached() const;
+    Long64_t GetNCompEval() const { return fNCompEval; }
+    Int_t GetNSolverIter() const { return fNSolverIter; }
+    Double_t GetSolverEDM() const { return fSolverEDM; }
+
+    void ApplyWeightSquared(Bool_t flag);
+    Bool_t IsYieldOnly() const;
+    Bool_t SolveYields(Int_t maxIter = 100, Double_t tol = 1e-6);
+    Bool_t ComputeSWeights(const RooArgList& yields, std::vector<Double_t>& sw) const;
+
+    static Bool_t IsApplicable(FFRooModel* model, RooAbsData* data);
+    static Bool_t HasCachedComponent(FFRooModel* model, RooAbsData* data);
+
+    ClassDef(FFRooUnbinnedNLL, 0)  // Native unbinned likelihood with cached densities
+};
+
+#endif
@@ -0,0 +1,70 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFTemplateFiller                                                     //
+//                                                                      //
+// Class for filling template histograms from trees in parallel.        //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#ifndef FOOFIT_FFTemplateFiller
+#define FOOFIT_FFTemplateFiller
+
+#include <vector>
+
+#include "TNamed.h"
+
+class TTree;
+class TH1;
+class FFRooSparseHistPdf;
+
+class FFTemplateFiller : public TNamed
+{
+
+protected:
+
+    class Job
+    {
+    public:
+        TH1* fHist;                 // histogram to fill (not owned)
+        FFRooSparseHistPdf* fSparse;// sparse histogram to fill (not owned)
+        TTree* fTree;               // input tree (not owned)
+        Int_t fNDim;                // number of dimensions
+        std::vector<TString> fVar;  // names of the variables
+        TString fWeight;            // name of the event weight variable
+    };
+
+    std::vector<Job> fJob;          // fill jobs
+
+    void AddJob(TH1* hist, FFRooSparseHistPdf* sparse, TTree* tree, Int_t nDim,
+                const Char_t** vars, const Char_t* weight);
+    Bool_t FillDraw(const Job& job) const;
+
+public:
+    FFTemplateFiller() : TNamed() { }
+    FFTemplateFiller(const Char_t* name, const Char_t* title);
+    virtual ~FFTemplateFiller() { }
+
+    Int_t GetNJob() const { return fJob.size(); }
+
+    void AddJob(TH1* hist, TTree* tree, Int_t nDim, const Char_t** vars,
+                const Char_t* weight = 0)
+    {
+        AddJob(hist, 0, tree, nDim, vars, weight);
+    }
+    void AddJob(FFRooSparseHistPdf* sparse, TTree* tree, Int_t nDim, const Char_t** vars,
+                const Char_t* weight = 0)
+    {
+        AddJob(0, sparse, tree, nDim, vars, weight);
+    }
+    void Clear(Option_t* option = "") { fJob.clear(); }
+    Bool_t Fill(Int_t nThreads = 1);
+
+    ClassDef(FFTemplateFiller, 0)  // Parallel filling of template histograms
+};
+
+#endif
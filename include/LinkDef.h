@@ -24,6 +24,8 @@
 
 #pragma link C++ enum EFFMinimizer;
 #pragma link C++ typedef FFMinimizer_t;
+#pragma link C++ enum EFFBinning;
+#pragma link C++ typedef FFBinning_t;
 
 #pragma link C++ namespace FFFooFit;
 #pragma link C++ class FFRooModel+;
@@ -32,6 +34,7 @@
 #pragma link C++ class FFRooModelGaussBifur+;
 #pragma link C++ class FFRooModelLandau+;
 #pragma link C++ class FFRooModelHist+;
+#pragma link C++ class FFRooModelMorph+;
 #pragma link C++ class FFRooModelPol+;
 #pragma link C++ class FFRooModelChebychev+;
 #pragma link C++ class FFRooModelKeys+;
@@ -45,8 +48,23 @@
 #pragma link C++ class FFRooFitter+;
 #pragma link C++ class FFRooFitterUnbinned+;
 #pragma link C++ class FFRooFitterBinned+;
+#pragma link C++ class FFRooFitterAuto+;
 #pragma link C++ class FFRooFitterSPlot+;
 #pragma link C++ class FFRooFitterSpecies+;
+#pragma link C++ class FFRooFitProfile+;
+#pragma link C++ class FFRooNLLMonitor+;
+#pragma link C++ class FFRooFitTrace+;
+#pragma link C++ class FFRooBinnedNLL+;
+#pragma link C++ class FFColumnStats+;
+#pragma link C++ class FFTemplateFiller+;
+#pragma link C++ class FFRooSparseHistPdf+;
+#pragma link C++ class FFRooGridConvPdf+;
+#pragma link C++ class FFRooConvCache+;
+#pragma link C++ class FFRooTemplatePdf+;
+#pragma link C++ class FFRooMorphPdf+;
+#pragma link C++ class FFRooGridKeysPdf+;
+#pragma link C++ class FFRooIndexedKeysPdf+;
+#pragma link C++ class FFRooUnbinnedNLL+;
 
 #endif
 
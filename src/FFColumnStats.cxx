@@ -0,0 +1,1063 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFColumnStats                                                        //
+//                                                                      //
+// Class calculating statistics of data columns in a single pass.       //
+//                                                                      //
+// The requested columns of a dataset are read in blocks of rows. Each  //
+// block is split among several threads accumulating the weighted       //
+// means and co-moments using Welford's algorithm. The partial results  //
+// are merged pairwise (Chan et al.) for numerical stability.           //
+//                                                                      //
+// In the same pass, the minimum, maximum and the number of NaN values  //
+// of each column are determined and its (positively weighted)          //
+// distribution is sketched by a merging t-digest, which provides       //
+// approximate quantiles and histograms. The distribution is also       //
+// recorded in a coarse histogram sketch with a fixed number of bins,   //
+// whose power-of-two bin width grows with the range of the data. It    //
+// preserves empty regions the t-digest interpolates over (see          //
+// CreateSketchHistogram()). The statistics are cached for the dataset  //
+// or tree they were calculated from (see IsCached()).                  //
+//                                                                      //
+// Columns of trees are read directly from their branches (see          //
+// FFFooFit::ReadTreeColumns()), the files of a chain in parallel (one  //
+// thread per file) if the thread safety of ROOT was enabled by the     //
+// caller (see FFFooFit::SetNCPU()). Columns that are not single-valued //
+// leaves are evaluated as tree formulas.                               //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "TMath.h"
+#include "TFile.h"
+#include "TChain.h"
+#include "TChainElement.h"
+#include "TTree.h"
+#include "TTreeFormula.h"
+#include "TH1.h"
+#include "RooAbsData.h"
+#include "RooArgSet.h"
+#include "RooAbsReal.h"
+
+#include "FFColumnStats.h"
+#include "FFFooFit.h"
+
+ClassImp(FFColumnStats)
+
+// init static class members
+const Int_t FFColumnStats::fgBlockSize = 65536;
+const Int_t FFColumnStats::fgNSketchBin = 4096;
+
+namespace {
+
+//______________________________________________________________________________
+Long64_t FloorShift(Long64_t k, Int_t d)
+{
+    // Return the index of the bin containing the bin 'k' after increasing
+    // the binary exponent of the bin width by 'd', i.e. floor(k / 2^d).
+
+    if (d <= 0)
+        return k;
+    if (d >= 63)
+        return k < 0 ? -1 : 0;
+
+    return k >= 0 ? k >> d : -((-(k + 1)) >> d) - 1;
+}
+
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Digest::Compress()
+{
+    // Merge the buffered values into the centroids. The size of the merged
+    // centroids is limited by the k1 scale function, which keeps the
+    // centroids small in the tails of the distribution.
+
+    if (fBuf.empty())
+        return;
+
+    // collect and sort all centroids and buffered values
+    for (UInt_t i = 0; i < fMean.size(); i++)
+        fBuf.push_back(std::make_pair(fMean[i], fW[i]));
+    std::sort(fBuf.begin(), fBuf.end());
+    Double_t tot = 0;
+    for (UInt_t i = 0; i < fBuf.size(); i++)
+        tot += fBuf[i].second;
+
+    // scale function k1 and its inverse
+    const Double_t norm = fCompression / TMath::TwoPi();
+    auto k = [&](Double_t q) { return norm * TMath::ASin(2*q - 1); };
+    auto qlim = [&](Double_t kv)
+    {
+        return kv >= fCompression / 4 ? 1. : (TMath::Sin(kv / norm) + 1) / 2;
+    };
+
+    // merge greedily
+    fMean.clear();
+    fW.clear();
+    Double_t sumW = 0;
+    Double_t limit = tot * qlim(k(0) + 1);
+    Double_t m = fBuf[0].first;
+    Double_t w = fBuf[0].second;
+    for (UInt_t i = 1; i < fBuf.size(); i++)
+    {
+        if (sumW + w + fBuf[i].second <= limit)
+        {
+            w += fBuf[i].second;
+            m += (fBuf[i].first - m) * fBuf[i].second / w;
+        }
+        else
+        {
+            sumW += w;
+            fMean.push_back(m);
+            fW.push_back(w);
+            limit = tot * qlim(k(sumW / tot) + 1);
+            m = fBuf[i].first;
+            w = fBuf[i].second;
+        }
+    }
+    fMean.push_back(m);
+    fW.push_back(w);
+    fTotW = tot;
+    fBuf.clear();
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Digest::Merge(const Digest& d)
+{
+    // Merge the digest 'd' into this digest.
+
+    for (UInt_t i = 0; i < d.fMean.size(); i++)
+        fBuf.push_back(std::make_pair(d.fMean[i], d.fW[i]));
+    fBuf.insert(fBuf.end(), d.fBuf.begin(), d.fBuf.end());
+    Compress();
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::Digest::Quantile(Double_t q, Double_t min, Double_t max) const
+{
+    // Return the approximate quantile 'q' of the compressed digest by
+    // interpolating between the centroids. 'min' and 'max' are the extreme
+    // values of the sketched distribution.
+
+    const Int_t n = fMean.size();
+    if (!n || fTotW <= 0)
+        return 0;
+    if (q <= 0)
+        return min;
+    if (q >= 1)
+        return max;
+
+    // left tail
+    const Double_t t = q * fTotW;
+    if (t < fW[0] / 2)
+        return min + (fMean[0] - min) * t / (fW[0] / 2);
+
+    // interpolate between centroid centers
+    Double_t c = fW[0] / 2;
+    for (Int_t i = 0; i < n-1; i++)
+    {
+        Double_t dc = (fW[i] + fW[i+1]) / 2;
+        if (t < c + dc)
+            return fMean[i] + (fMean[i+1] - fMean[i]) * (t - c) / dc;
+        c += dc;
+    }
+
+    // right tail
+    Double_t r = fW[n-1] / 2;
+    return fMean[n-1] + (max - fMean[n-1]) * TMath::Min((t - c) / r, 1.);
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::Digest::CDF(Double_t x, Double_t min, Double_t max) const
+{
+    // Return the approximate fraction of the weight below 'x' of the
+    // compressed digest (inverse of Quantile()).
+
+    const Int_t n = fMean.size();
+    if (!n || fTotW <= 0 || x <= min)
+        return 0;
+    if (x >= max)
+        return 1;
+
+    // left tail
+    if (x < fMean[0])
+        return fW[0] / 2 * (x - min) / (fMean[0] - min) / fTotW;
+
+    // interpolate between centroid centers
+    Double_t c = fW[0] / 2;
+    for (Int_t i = 0; i < n-1; i++)
+    {
+        Double_t dc = (fW[i] + fW[i+1]) / 2;
+        if (x < fMean[i+1])
+        {
+            Double_t dm = fMean[i+1] - fMean[i];
+            return (c + (dm > 0 ? dc * (x - fMean[i]) / dm : 0)) / fTotW;
+        }
+        c += dc;
+    }
+
+    // right tail
+    Double_t r = fW[n-1] / 2;
+    return (c + r * (x - fMean[n-1]) / (max - fMean[n-1])) / fTotW;
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Sketch::Add(Double_t x, Double_t w)
+{
+    // Add the value 'x' with weight 'w'. Bin 'k' of the sketch covers the
+    // values [k, k+1) * 2^fExp. The range is moved and the bins are merged
+    // when 'x' is outside of the current range.
+
+    // skip infinite values
+    if (!TMath::Finite(x))
+        return;
+
+    // init range around the first value (bin width of about 1/4096 of it)
+    if (fCont.empty())
+    {
+        fExp = x != 0 ? std::ilogb(x) - 12 : -1000;
+        fLo = fHi = (Long64_t)TMath::Floor(std::ldexp(x, -fExp));
+        fFirst = fLo - fgNSketchBin / 2;
+        fCont.assign(fgNSketchBin, 0);
+    }
+
+    // extend range if needed
+    Double_t k = TMath::Floor(std::ldexp(x, -fExp));
+    if (k < fFirst || k >= fFirst + fgNSketchBin)
+    {
+        Rebin(x, x, fExp);
+        k = TMath::Floor(std::ldexp(x, -fExp));
+    }
+
+    // fill
+    const Long64_t bin = (Long64_t)k;
+    fCont[bin - fFirst] += w;
+    if (bin < fLo) fLo = bin;
+    if (bin > fHi) fHi = bin;
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Sketch::Rebin(Double_t min, Double_t max, Int_t exp)
+{
+    // Increase the binary exponent of the bin width to at least 'exp' and
+    // further until the filled bins and the values 'min' and 'max' fit into
+    // the range of the sketch. Center the range on them and merge the bins.
+
+    // find bin width
+    exp = TMath::Max(exp, fExp);
+    const Double_t lo = TMath::Min(min, std::ldexp((Double_t)fLo, fExp));
+    const Double_t hi = TMath::Max(max, std::ldexp((Double_t)fHi, fExp));
+    while (!(TMath::Floor(std::ldexp(hi, -exp)) - TMath::Floor(std::ldexp(lo, -exp)) < fgNSketchBin))
+        exp++;
+
+    // center range
+    const Long64_t klo = (Long64_t)TMath::Floor(std::ldexp(lo, -exp));
+    const Long64_t khi = (Long64_t)TMath::Floor(std::ldexp(hi, -exp));
+    const Long64_t first = klo - (fgNSketchBin - 1 - (khi - klo)) / 2;
+
+    // merge bins
+    const Int_t d = exp - fExp;
+    std::vector<Double_t> cont(fgNSketchBin, 0);
+    for (Long64_t k = fLo; k <= fHi; k++)
+        if (fCont[k - fFirst] != 0) cont[FloorShift(k, d) - first] += fCont[k - fFirst];
+
+    // update sketch
+    fExp = exp;
+    fFirst = first;
+    fLo = FloorShift(fLo, d);
+    fHi = FloorShift(fHi, d);
+    fCont.swap(cont);
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Sketch::Merge(const Sketch& s)
+{
+    // Merge the sketch 's' into this sketch.
+
+    if (s.fCont.empty())
+        return;
+    if (fCont.empty())
+    {
+        *this = s;
+        return;
+    }
+
+    // adapt range and bin width
+    Rebin(std::ldexp((Double_t)s.fLo, s.fExp), std::ldexp((Double_t)s.fHi, s.fExp), s.fExp);
+
+    // add bins
+    const Int_t d = fExp - s.fExp;
+    for (Long64_t k = s.fLo; k <= s.fHi; k++)
+        if (s.fCont[k - s.fFirst] != 0) fCont[FloorShift(k, d) - fFirst] += s.fCont[k - s.fFirst];
+    fLo = TMath::Min(fLo, FloorShift(s.fLo, d));
+    fHi = TMath::Max(fHi, FloorShift(s.fHi, d));
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Accumulator::Add(const Double_t* x, Double_t w)
+{
+    // Add the row 'x' with weight 'w' (weighted Welford update).
+
+    fCount++;
+    if (w == 0)
+        return;
+    fSumW += w;
+    if (fSumW == 0)
+        return;
+    const Double_t f = w / fSumW;
+
+    // update co-moments using the deviations from the old and new means
+    for (Int_t i = 0; i < fN; i++)
+    {
+        fDelta[i] = x[i] - fMean[i];
+        fMean[i] += fDelta[i] * f;
+    }
+    for (Int_t i = 0; i < fN; i++)
+        for (Int_t j = 0; j <= i; j++)
+            fCoMom[i*fN+j] += w * fDelta[i] * (x[j] - fMean[j]);
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Accumulator::AddRow(const Double_t* x, Double_t w)
+{
+    // Add the row 'x' with weight 'w' to the statistics of the single
+    // columns and, if the row contains no NaN values, to the co-moments.
+
+    // check weight
+    if (TMath::IsNaN(w))
+    {
+        fNNaNW++;
+        return;
+    }
+    if (w == 0)
+        fNZeroW++;
+
+    // single columns
+    Bool_t bad = kFALSE;
+    for (Int_t i = 0; i < fN; i++)
+    {
+        if (TMath::IsNaN(x[i]))
+        {
+            fNNaN[i]++;
+            bad = kTRUE;
+            continue;
+        }
+        fNValid[i]++;
+        if (x[i] < fMin[i]) fMin[i] = x[i];
+        if (x[i] > fMax[i]) fMax[i] = x[i];
+        if (w > 0) fDigest[i].Add(x[i], w);
+        fSketch[i].Add(x[i], w);
+    }
+
+    // co-moments
+    if (!bad)
+        Add(x, w);
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Accumulator::Merge(const Accumulator& a)
+{
+    // Merge the accumulated statistics 'a' (pairwise update of Chan et al.).
+
+    // single columns
+    for (Int_t i = 0; i < fN; i++)
+    {
+        fMin[i] = TMath::Min(fMin[i], a.fMin[i]);
+        fMax[i] = TMath::Max(fMax[i], a.fMax[i]);
+        fNValid[i] += a.fNValid[i];
+        fNNaN[i] += a.fNNaN[i];
+        fDigest[i].Merge(a.fDigest[i]);
+        fSketch[i].Merge(a.fSketch[i]);
+    }
+    fNNaNW += a.fNNaNW;
+    fNZeroW += a.fNZeroW;
+
+    // co-moments
+    fCount += a.fCount;
+    if (a.fSumW == 0)
+        return;
+    if (fSumW == 0)
+    {
+        fSumW = a.fSumW;
+        fMean = a.fMean;
+        fCoMom = a.fCoMom;
+        return;
+    }
+
+    // merge
+    const Double_t sumW = fSumW + a.fSumW;
+    const Double_t f = fSumW * a.fSumW / sumW;
+    for (Int_t i = 0; i < fN; i++)
+        for (Int_t j = 0; j <= i; j++)
+            fCoMom[i*fN+j] += a.fCoMom[i*fN+j] + (a.fMean[i] - fMean[i]) * (a.fMean[j] - fMean[j]) * f;
+    for (Int_t i = 0; i < fN; i++)
+        fMean[i] += (a.fMean[i] - fMean[i]) * a.fSumW / sumW;
+    fSumW = sumW;
+}
+
+//______________________________________________________________________________
+FFColumnStats::FFColumnStats(const Char_t* name, const Char_t* title)
+    : TNamed(name, title)
+{
+    // Constructor.
+
+    // init members
+    fNRow = 0;
+    fNRowSkip = 0;
+    fSource = 0;
+}
+
+//______________________________________________________________________________
+Bool_t FFColumnStats::CheckColumnBounds(Int_t i, const Char_t* loc) const
+{
+    // Check if the column index 'i' is within valid bounds.
+    // Return kTRUE if the index 'i' is valid, otherwise kFALSE.
+    // Use 'loc' to set the location of the error.
+
+    if (i < 0 || i >= GetNColumn())
+    {
+        Error("CheckColumnBounds", "%s: Invalid column index %d (number of columns: %d)",
+              loc, i, GetNColumn());
+        return kFALSE;
+    }
+    else
+    {
+        return kTRUE;
+    }
+}
+
+//______________________________________________________________________________
+const Char_t* FFColumnStats::GetColumnName(Int_t i) const
+{
+    // Return the name of the column with index 'i'.
+
+    if (!CheckColumnBounds(i, "GetColumnName"))
+        return 0;
+
+    return fColName[i].Data();
+}
+
+//______________________________________________________________________________
+Int_t FFColumnStats::GetColumnIndex(const Char_t* name) const
+{
+    // Return the index of the column 'name' or -1 if it was not found.
+
+    for (Int_t i = 0; i < GetNColumn(); i++)
+        if (fColName[i] == name) return i;
+
+    return -1;
+}
+
+//______________________________________________________________________________
+Int_t FFColumnStats::AddColumn(const Char_t* name)
+{
+    // Add the column 'name' (ignored if already added).
+    // Return the index of the column.
+
+    Int_t i = GetColumnIndex(name);
+    if (i != -1)
+        return i;
+
+    fColName.push_back(name);
+    Reset();
+
+    return GetNColumn() - 1;
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Reset()
+{
+    // Reset the accumulated statistics.
+
+    fNRow = 0;
+    fNRowSkip = 0;
+    fAcc = Accumulator(GetNColumn());
+    fSource = 0;
+}
+
+//______________________________________________________________________________
+Bool_t FFColumnStats::IsCached(const RooAbsData* data) const
+{
+    // Check if the statistics were calculated from the dataset 'data'.
+
+    return data && IsCached(data, data->numEntries());
+}
+
+//______________________________________________________________________________
+Bool_t FFColumnStats::IsCached(const TTree* tree) const
+{
+    // Check if the statistics were calculated from the tree 'tree'.
+
+    return tree && IsCached(tree, ((TTree*)tree)->GetEntries());
+}
+
+//______________________________________________________________________________
+void FFColumnStats::AccumulateBlock(const Double_t* x, const Double_t* w, Int_t n,
+                                    std::vector<Accumulator>& acc) const
+{
+    // Accumulate the block of 'n' rows 'x' with weights 'w' using one thread
+    // per accumulator in 'acc'.
+
+    const Int_t nCol = GetNColumn();
+    const Int_t nThreads = acc.size();
+
+    // accumulate the slice of one thread
+    auto work = [&](Int_t t)
+    {
+        Int_t start = (Int_t)((Long64_t)n * t / nThreads);
+        Int_t end = (Int_t)((Long64_t)n * (t + 1) / nThreads);
+        for (Int_t r = start; r < end; r++)
+            acc[t].AddRow(x + r*nCol, w[r]);
+    };
+
+    // run threads
+    if (nThreads == 1 || n < nThreads)
+    {
+        for (Int_t t = 0; t < nThreads; t++)
+            work(t);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        for (Int_t t = 0; t < nThreads; t++)
+            threads.push_back(std::thread(work, t));
+        for (Int_t t = 0; t < nThreads; t++)
+            threads[t].join();
+    }
+}
+
+//______________________________________________________________________________
+void FFColumnStats::MergeResults(std::vector<Accumulator>& acc, Long64_t nRow,
+                                 const TObject* src)
+{
+    // Merge the thread results 'acc' of 'nRow' rows read from the source
+    // 'src'.
+
+    for (UInt_t t = 0; t < acc.size(); t++)
+        fAcc.Merge(acc[t]);
+    for (Int_t i = 0; i < GetNColumn(); i++)
+        fAcc.fDigest[i].Compress();
+    fNRow = nRow;
+    fNRowSkip = nRow - fAcc.fCount;
+    fSource = src;
+}
+
+//______________________________________________________________________________
+Bool_t FFColumnStats::Fill(RooAbsData* data, Int_t nThreads)
+{
+    // Reset and calculate the statistics of all columns of the dataset 'data'
+    // using 'nThreads' threads. Rows containing NaN values are skipped in
+    // the calculation of the co-moments.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // reset
+    Reset();
+
+    // find columns (the row set of the dataset is reused for all rows)
+    const Int_t nCol = GetNColumn();
+    const RooArgSet* vars = data->get();
+    std::vector<RooAbsReal*> col(nCol);
+    for (Int_t i = 0; i < nCol; i++)
+    {
+        col[i] = (RooAbsReal*)vars->find(fColName[i].Data());
+        if (!col[i])
+        {
+            Error("Fill", "Column '%s' not found in dataset '%s'!", fColName[i].Data(), data->GetName());
+            return kFALSE;
+        }
+    }
+
+    // thread accumulators
+    std::vector<Accumulator> acc(TMath::Max(nThreads, 1), Accumulator(nCol));
+
+    // block buffers
+    Double_t* x = new Double_t[fgBlockSize*nCol];
+    Double_t* w = new Double_t[fgBlockSize];
+
+    // loop over blocks
+    const Long64_t nEntries = data->numEntries();
+    for (Long64_t b = 0; b < nEntries; b += fgBlockSize)
+    {
+        // read block
+        const Int_t n = (Int_t)TMath::Min((Long64_t)fgBlockSize, nEntries - b);
+        for (Int_t r = 0; r < n; r++)
+        {
+            data->get(b + r);
+            for (Int_t i = 0; i < nCol; i++)
+                x[r*nCol+i] = col[i]->getVal();
+            w[r] = data->weight();
+        }
+
+        // accumulate block
+        AccumulateBlock(x, w, n, acc);
+    }
+
+    // merge thread results
+    MergeResults(acc, nEntries, data);
+
+    // clean-up
+    delete [] x;
+    delete [] w;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Long64_t FFColumnStats::ReadBranches(TTree* tree, const Char_t* weight,
+                                     std::function<void(const Double_t*, Double_t)> row) const
+{
+    // Read all columns and the optional event weight 'weight' from the
+    // branches of the tree 'tree' and pass each row to 'row' (see
+    // FFFooFit::ReadTreeColumns()).
+    // Return the number of rows read or -1 on error.
+
+    const Int_t nCol = GetNColumn();
+    std::vector<const Char_t*> cols(nCol + 1);
+    for (Int_t i = 0; i < nCol; i++)
+        cols[i] = fColName[i].Data();
+    cols[nCol] = weight;
+
+    return FFFooFit::ReadTreeColumns(tree, nCol + 1, cols.data(),
+                                     [&](const Double_t* x) { row(x, x[nCol]); });
+}
+
+//______________________________________________________________________________
+Long64_t FFColumnStats::FillBranches(TTree* tree, const Char_t* weight,
+                                     std::vector<Accumulator>& acc) const
+{
+    // Accumulate the columns of the tree 'tree' read from its branches
+    // using one thread per accumulator in 'acc'. The files of a chain are
+    // read in parallel if the thread safety of ROOT was enabled, otherwise the rows are read in blocks whose
+    // accumulation is split among the threads.
+    // Return the number of rows read or -1 on error.
+
+    const Int_t nCol = GetNColumn();
+    const Int_t nThreads = acc.size();
+
+    // collect files of chain
+    std::vector<TChainElement*> files;
+    if (tree->InheritsFrom("TChain"))
+    {
+        TObjArray* list = ((TChain*)tree)->GetListOfFiles();
+        for (Int_t i = 0; i < list->GetEntriesFast(); i++)
+            files.push_back((TChainElement*)list->At(i));
+    }
+
+    // read files in parallel (if the thread safety of ROOT was enabled)
+    if (nThreads > 1 && files.size() > 1 && FFFooFit::IsThreadSafe())
+    {
+        std::atomic<Int_t> next(0);
+        std::atomic<Bool_t> ok(kTRUE);
+        std::vector<Long64_t> nRead(nThreads, 0);
+        auto work = [&](Int_t t)
+        {
+            for (Int_t f = next++; f < (Int_t)files.size(); f = next++)
+            {
+                // open file
+                TFile* file = TFile::Open(files[f]->GetTitle());
+                TTree* ftree = 0;
+                if (file && !file->IsZombie())
+                    file->GetObject(files[f]->GetName(), ftree);
+                if (!ftree)
+                {
+                    Error("FillBranches", "Could not read tree '%s' from file '%s'!",
+                          files[f]->GetName(), files[f]->GetTitle());
+                    ok = kFALSE;
+                    delete file;
+                    continue;
+                }
+
+                // accumulate rows
+                Long64_t n = ReadBranches(ftree, weight,
+                                          [&](const Double_t* x, Double_t w) { acc[t].AddRow(x, w); });
+                if (n < 0)
+                    ok = kFALSE;
+                else
+                    nRead[t] += n;
+
+                // clean-up
+                delete file;
+            }
+        };
+        std::vector<std::thread> threads;
+        for (Int_t t = 0; t < nThreads; t++)
+            threads.push_back(std::thread(work, t));
+        for (Int_t t = 0; t < nThreads; t++)
+            threads[t].join();
+
+        // count rows
+        if (!ok)
+            return -1;
+        Long64_t nRow = 0;
+        for (Int_t t = 0; t < nThreads; t++)
+            nRow += nRead[t];
+
+        return nRow;
+    }
+
+    // read rows in blocks
+    Double_t* xb = new Double_t[fgBlockSize*nCol];
+    Double_t* wb = new Double_t[fgBlockSize];
+    Int_t n = 0;
+    Long64_t nRow = ReadBranches(tree, weight, [&](const Double_t* x, Double_t w)
+    {
+        for (Int_t i = 0; i < nCol; i++)
+            xb[n*nCol+i] = x[i];
+        wb[n] = w;
+        if (++n == fgBlockSize)
+        {
+            AccumulateBlock(xb, wb, n, acc);
+            n = 0;
+        }
+    });
+    if (n)
+        AccumulateBlock(xb, wb, n, acc);
+
+    // clean-up
+    delete [] xb;
+    delete [] wb;
+
+    return nRow;
+}
+
+//______________________________________________________________________________
+Long64_t FFColumnStats::FillFormulas(TTree* tree, const Char_t* weight,
+                                     std::vector<Accumulator>& acc) const
+{
+    // Accumulate the columns of the tree 'tree' evaluated as tree formulas
+    // using one thread per accumulator in 'acc'. The rows are read in blocks
+    // whose accumulation is split among the threads.
+    // Return the number of rows read or -1 on error.
+
+    // create formulas
+    const Int_t nCol = GetNColumn();
+    std::vector<TTreeFormula*> col(nCol + 1, (TTreeFormula*)0);
+    Bool_t res = kTRUE;
+    for (Int_t i = 0; i <= nCol; i++)
+    {
+        const Char_t* expr = i < nCol ? fColName[i].Data() : weight;
+        if (!expr || !strcmp(expr, ""))
+            continue;
+        col[i] = new TTreeFormula(TString::Format("%s_f%d", GetName(), i).Data(), expr, tree);
+        if (col[i]->GetNdim() == 0)
+        {
+            Error("FillFormulas", "Column '%s' not found in tree '%s'!", expr, tree->GetName());
+            res = kFALSE;
+        }
+    }
+
+    // block buffers
+    Double_t* x = new Double_t[fgBlockSize*nCol];
+    Double_t* w = new Double_t[fgBlockSize];
+
+    // loop over blocks
+    const Long64_t nEntries = res ? tree->GetEntries() : 0;
+    Int_t treeNumber = -1;
+    for (Long64_t b = 0; b < nEntries; b += fgBlockSize)
+    {
+        // read block
+        const Int_t n = (Int_t)TMath::Min((Long64_t)fgBlockSize, nEntries - b);
+        for (Int_t r = 0; r < n; r++)
+        {
+            // load entry and update formulas when the tree of a chain changes
+            tree->LoadTree(b + r);
+            if (tree->GetTreeNumber() != treeNumber)
+            {
+                treeNumber = tree->GetTreeNumber();
+                for (Int_t i = 0; i <= nCol; i++)
+                    if (col[i]) col[i]->UpdateFormulaLeaves();
+            }
+
+            // evaluate formulas
+            for (Int_t i = 0; i < nCol; i++)
+            {
+                col[i]->GetNdata();
+                x[r*nCol+i] = col[i]->EvalInstance();
+            }
+            if (col[nCol])
+            {
+                col[nCol]->GetNdata();
+                w[r] = col[nCol]->EvalInstance();
+            }
+            else
+            {
+                w[r] = 1;
+            }
+        }
+
+        // accumulate block
+        AccumulateBlock(x, w, n, acc);
+    }
+
+    // clean-up
+    delete [] x;
+    delete [] w;
+    for (Int_t i = 0; i <= nCol; i++)
+        delete col[i];
+
+    return res ? nEntries : -1;
+}
+
+//______________________________________________________________________________
+Bool_t FFColumnStats::Fill(TTree* tree, const Char_t* weight, Int_t nThreads)
+{
+    // Reset and calculate the statistics of all columns of the tree 'tree'
+    // using 'nThreads' threads. The columns and the optional event weight
+    // 'weight' can be tree variables or formulas. If all of them are
+    // single-valued leaves, they are read directly from their branches
+    // (the files of a chain in parallel), otherwise they are evaluated as
+    // tree formulas. Rows containing NaN values are skipped in the
+    // calculation of the co-moments.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // reset
+    Reset();
+
+    // check if all columns are single-valued leaves
+    const Int_t nCol = GetNColumn();
+    Bool_t leaves = kTRUE;
+    for (Int_t i = 0; i <= nCol; i++)
+    {
+        const Char_t* expr = i < nCol ? fColName[i].Data() : weight;
+        if (!expr || !strcmp(expr, ""))
+            continue;
+        if (!FFFooFit::IsTreeLeaf(tree, expr))
+            leaves = kFALSE;
+    }
+
+    // accumulate rows
+    std::vector<Accumulator> acc(TMath::Max(nThreads, 1), Accumulator(nCol));
+    Long64_t nRow = leaves ? FillBranches(tree, weight, acc) : FillFormulas(tree, weight, acc);
+    if (nRow < 0)
+        return kFALSE;
+
+    // merge thread results
+    MergeResults(acc, nRow, tree);
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Long64_t FFColumnStats::GetNValid(Int_t i) const
+{
+    // Return the number of valid (non-NaN) values of the column with index
+    // 'i'.
+
+    if (!CheckColumnBounds(i, "GetNValid"))
+        return 0;
+
+    return fAcc.fNValid[i];
+}
+
+//______________________________________________________________________________
+Long64_t FFColumnStats::GetNNaN(Int_t i) const
+{
+    // Return the number of NaN values of the column with index 'i'.
+
+    if (!CheckColumnBounds(i, "GetNNaN"))
+        return 0;
+
+    return fAcc.fNNaN[i];
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::GetMinimum(Int_t i) const
+{
+    // Return the minimum value of the column with index 'i'.
+
+    if (!CheckColumnBounds(i, "GetMinimum"))
+        return 0;
+
+    return fAcc.fNValid[i] ? fAcc.fMin[i] : 0;
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::GetMaximum(Int_t i) const
+{
+    // Return the maximum value of the column with index 'i'.
+
+    if (!CheckColumnBounds(i, "GetMaximum"))
+        return 0;
+
+    return fAcc.fNValid[i] ? fAcc.fMax[i] : 0;
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::GetMean(Int_t i) const
+{
+    // Return the weighted mean of the column with index 'i'.
+
+    if (!CheckColumnBounds(i, "GetMean"))
+        return 0;
+
+    return fAcc.fMean[i];
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::GetCovariance(Int_t i, Int_t j) const
+{
+    // Return the weighted covariance of the columns with indices 'i' and 'j'.
+
+    if (!CheckColumnBounds(i, "GetCovariance") || !CheckColumnBounds(j, "GetCovariance"))
+        return 0;
+    if (fAcc.fSumW == 0)
+        return 0;
+
+    return i >= j ? fAcc.fCoMom[i*fAcc.fN+j] / fAcc.fSumW : fAcc.fCoMom[j*fAcc.fN+i] / fAcc.fSumW;
+}
+//______________________________________________________________________________
+Double_t FFColumnStats::GetVariance(Int_t i) const
+{
+    // Return the weighted variance of the column with index 'i'.
+
+    return GetCovariance(i, i);
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::GetCorrelation(Int_t i, Int_t j) const
+{
+    // Return the correlation coefficient of the columns with indices 'i'
+    // and 'j'.
+
+    Double_t norm = TMath::Sqrt(GetVariance(i) * GetVariance(j));
+
+    return norm > 0 ? GetCovariance(i, j) / norm : 0;
+}
+
+//______________________________________________________________________________
+TMatrixDSym FFColumnStats::GetCovarianceMatrix() const
+{
+    // Return the weighted covariance matrix of all columns.
+
+    const Int_t n = GetNColumn();
+    TMatrixDSym m(n);
+    for (Int_t i = 0; i < n; i++)
+        for (Int_t j = 0; j < n; j++)
+            m(i, j) = GetCovariance(i, j);
+
+    return m;
+}
+
+//______________________________________________________________________________
+TMatrixDSym FFColumnStats::GetCorrelationMatrix() const
+{
+    // Return the correlation matrix of all columns.
+
+    const Int_t n = GetNColumn();
+    TMatrixDSym m(n);
+    for (Int_t i = 0; i < n; i++)
+        for (Int_t j = 0; j < n; j++)
+            m(i, j) = GetCorrelation(i, j);
+
+    return m;
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::GetQuantile(Int_t i, Double_t q) const
+{
+    // Return the approximate quantile 'q' of the (positively weighted)
+    // distribution of the column with index 'i'.
+
+    if (!CheckColumnBounds(i, "GetQuantile"))
+        return 0;
+
+    return fAcc.fDigest[i].Quantile(q, GetMinimum(i), GetMaximum(i));
+}
+
+//______________________________________________________________________________
+Double_t FFColumnStats::GetCDF(Int_t i, Double_t x) const
+{
+    // Return the approximate fraction of the (positively weighted)
+    // distribution of the column with index 'i' below 'x'.
+
+    if (!CheckColumnBounds(i, "GetCDF"))
+        return 0;
+
+    return fAcc.fDigest[i].CDF(x, GetMinimum(i), GetMaximum(i));
+}
+
+//______________________________________________________________________________
+TH1* FFColumnStats::CreateHistogram(Int_t i, const Char_t* name, Int_t nBins,
+                                    Double_t min, Double_t max) const
+{
+    // Create the histogram 'name' with 'nBins' bins in the range ['min', 'max']
+    // of the (positively weighted) distribution of the column with index 'i'
+    // from its quantile sketch. Return 0 on error.
+
+    if (!CheckColumnBounds(i, "CreateHistogram"))
+        return 0;
+
+    // create histogram
+    TH1* h = new TH1D(name, name, nBins, min, max);
+    const Digest& d = fAcc.fDigest[i];
+    Double_t cdf_low = d.CDF(min, GetMinimum(i), GetMaximum(i));
+    for (Int_t j = 1; j <= nBins; j++)
+    {
+        Double_t cdf_up = d.CDF(h->GetXaxis()->GetBinUpEdge(j), GetMinimum(i), GetMaximum(i));
+        h->SetBinContent(j, (cdf_up - cdf_low) * d.fTotW);
+        cdf_low = cdf_up;
+    }
+
+    return h;
+}
+
+//______________________________________________________________________________
+TH1* FFColumnStats::CreateSketchHistogram(Int_t i, const Char_t* name, Int_t nBins,
+                                          Double_t min, Double_t max) const
+{
+    // Create the histogram 'name' with 'nBins' bins in the range ['min', 'max']
+    // of the (weighted) distribution of the column with index 'i' from its
+    // histogram sketch. The content of each sketch bin is added to the bin
+    // containing its center, i.e. empty regions wider than about two sketch
+    // bins (1/2048 of the data range) remain empty. Return 0 on error.
+
+    if (!CheckColumnBounds(i, "CreateSketchHistogram"))
+        return 0;
+
+    // create histogram
+    TH1* h = new TH1D(name, name, nBins, min, max);
+    const Sketch& s = fAcc.fSketch[i];
+    for (Long64_t k = s.fLo; k <= s.fHi && !s.fCont.empty(); k++)
+    {
+        // skip empty bins and bins outside of the range
+        const Double_t c = s.fCont[k - s.fFirst];
+        const Double_t lo = std::ldexp((Double_t)k, s.fExp);
+        const Double_t up = std::ldexp((Double_t)(k + 1), s.fExp);
+        if (c == 0 || up <= min || lo > max)
+            continue;
+
+        // add content at bin center (moved into the range)
+        Int_t bin = h->GetXaxis()->FindFixBin(TMath::Min(TMath::Max((lo + up) / 2, min), max));
+        h->AddBinContent(TMath::Min(bin, nBins), c);
+    }
+
+    return h;
+}
+
+//______________________________________________________________________________
+void FFColumnStats::Print(Option_t* option) const
+{
+    // Print out the content of this class.
+
+    printf("%sFFColumnStats content:\n", option);
+    printf("%sName                       : %s\n", option, GetName());
+    printf("%sNumber of rows             : %lld\n", option, fNRow);
+    printf("%sNumber of skipped rows     : %lld\n", option, fNRowSkip);
+    printf("%sNumber of NaN weights      : %lld\n", option, fAcc.fNNaNW);
+    printf("%sNumber of zero weights     : %lld\n", option, fAcc.fNZeroW);
+    printf("%sSum of weights             : %e\n", option, fAcc.fSumW);
+    for (Int_t i = 0; i < GetNColumn(); i++)
+        printf("%sColumn %2d '%s': min %e  max %e  mean %e  std. dev. %e  median %e  NaN %lld\n",
+               option, i, fColName[i].Data(), GetMinimum(i), GetMaximum(i),
+               GetMean(i), TMath::Sqrt(GetVariance(i)), GetQuantile(i, 0.5), GetNNaN(i));
+}
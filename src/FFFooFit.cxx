@@ -20,11 +20,26 @@
 #include <unistd.h>
 #endif
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "TChain.h"
+#include "TBranch.h"
+#include "TLeaf.h"
 #include "TSystemFile.h"
 #include "TSystemDirectory.h"
 #include "TSystem.h"
 #include "TError.h"
+#include "TMD5.h"
+#include "TMath.h"
+#include "TROOT.h"
+#include "TVirtualMutex.h"
+#include "RooRealVar.h"
+#include "RooArgList.h"
+#include "RooArgSet.h"
 
 #include "FFFooFit.h"
 
@@ -32,6 +47,89 @@ namespace FFFooFit
 {
     Int_t gUseNCPU = 1;
     Int_t gParStrat = 0;
+    TString gCacheDir = "";
+}
+
+namespace {
+
+// persistent worker threads of FFFooFit::ParallelFor()
+class FFThreadPool
+{
+private:
+    std::vector<std::thread> fThreads;              // worker threads
+    std::mutex fMutex;                              // lock of the task state
+    std::condition_variable fStart;                 // signal of a new task
+    std::condition_variable fDone;                  // signal of a finished task
+    const std::function<void(Int_t)>* fTask;        // current task (not owned)
+    Int_t fNSlice;                                  // number of slices of the task
+    Int_t fNext;                                    // next unprocessed slice
+    Int_t fNPending;                                // number of unfinished slices
+    Long64_t fGen;                                  // task counter
+    Bool_t fStop;                                   // flag for stopping the workers
+
+    void RunSlices(std::unique_lock<std::mutex>& lock)
+    {
+        while (fNext < fNSlice)
+        {
+            Int_t t = fNext++;
+            lock.unlock();
+            (*fTask)(t);
+            lock.lock();
+            if (--fNPending == 0)
+                fDone.notify_all();
+        }
+    }
+
+    void Work()
+    {
+        gInPool = kTRUE;
+        Long64_t gen = 0;
+        std::unique_lock<std::mutex> lock(fMutex);
+        while (kTRUE)
+        {
+            fStart.wait(lock, [&]() { return fStop || fGen != gen; });
+            if (fStop)
+                return;
+            gen = fGen;
+            RunSlices(lock);
+        }
+    }
+
+public:
+    static thread_local Bool_t gInPool;             // flag for threads running a task
+    std::mutex fRunMutex;                           // lock of running tasks (one at a time)
+
+    FFThreadPool() : fTask(0), fNSlice(0), fNext(0), fNPending(0), fGen(0), fStop(kFALSE) { }
+    ~FFThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(fMutex);
+            fStop = kTRUE;
+        }
+        fStart.notify_all();
+        for (UInt_t t = 0; t < fThreads.size(); t++)
+            fThreads[t].join();
+    }
+
+    void Run(Int_t nSlice, const std::function<void(Int_t)>& task)
+    {
+        std::unique_lock<std::mutex> lock(fMutex);
+        while ((Int_t)fThreads.size() < nSlice - 1)
+            fThreads.push_back(std::thread(&FFThreadPool::Work, this));
+        fTask = &task;
+        fNSlice = nSlice;
+        fNext = 0;
+        fNPending = nSlice;
+        fGen++;
+        fStart.notify_all();
+        RunSlices(lock);
+        fDone.wait(lock, [&]() { return fNPending == 0; });
+        fTask = 0;
+    }
+};
+
+thread_local Bool_t FFThreadPool::gInPool = kFALSE;
+
 }
 
 //______________________________________________________________________________
@@ -65,6 +163,29 @@ Int_t FFFooFit::GetNumberOfCPUs()
     #endif
 }
 
+//______________________________________________________________________________
+void FFFooFit::SetNCPU(Int_t n)
+{
+    // Set the number of CPUs to use (gUseNCPU) to 'n'. For more than one
+    // CPU, the thread safety of ROOT is enabled once via
+    // ROOT::EnableThreadSafety(). This enables global locking in ROOT for
+    // the whole process and is required to read the files of chains in
+    // parallel (see FFTemplateFiller and FFColumnStats). Setting gUseNCPU
+    // directly parallelizes computations only.
+
+    gUseNCPU = n;
+    if (n > 1 && !IsThreadSafe())
+        ROOT::EnableThreadSafety();
+}
+
+//______________________________________________________________________________
+Bool_t FFFooFit::IsThreadSafe()
+{
+    // Check if the thread safety of ROOT was enabled (see SetNCPU()).
+
+    return gGlobalMutex != 0;
+}
+
 //______________________________________________________________________________
 Bool_t FFFooFit::LoadFilesToChain(const Char_t* loc, TChain* chain,
                                   const Char_t* wildCard)
@@ -176,6 +297,216 @@ Bool_t FFFooFit::FileExists(const Char_t* f)
         return kFALSE;
 }
 
+//______________________________________________________________________________
+Bool_t FFFooFit::IsTreeLeaf(TTree* tree, const Char_t* name)
+{
+    // Return kTRUE if 'name' is a single-valued leaf of the tree 'tree',
+    // otherwise (e.g. for formulas or arrays) return kFALSE.
+
+    TLeaf* leaf = tree->FindLeaf(name);
+    if (leaf && leaf->GetLen() == 1)
+        return kTRUE;
+    else
+        return kFALSE;
+}
+
+//______________________________________________________________________________
+Long64_t FFFooFit::ReadTreeColumns(TTree* tree, Int_t n, const Char_t** cols,
+                                   std::function<void(const Double_t*)> row)
+{
+    // Read the 'n' single-valued leaves 'cols' of all entries of the tree
+    // 'tree' and pass the values of each entry to 'row'. Columns that are
+    // zero or empty are set to 1 (e.g. for optional weights). The leaves
+    // are looked up once per tree of a chain and only their branches are
+    // read.
+    // Return the number of entries read or -1 on error.
+
+    std::vector<TLeaf*> leaf(n, (TLeaf*)0);
+    std::vector<TBranch*> branch;
+    std::vector<Double_t> x(n, 1.);
+
+    // loop over entries
+    const Long64_t nEntries = tree->GetEntries();
+    Int_t treeNumber = -1;
+    for (Long64_t e = 0; e < nEntries; e++)
+    {
+        // load entry
+        Long64_t local = tree->LoadTree(e);
+        if (local < 0)
+        {
+            Error("FFFooFit::ReadTreeColumns", "Could not load entry %lld of tree '%s'!",
+                  e, tree->GetName());
+            return -1;
+        }
+
+        // look up leaves when the tree of a chain changes
+        if (tree->GetTreeNumber() != treeNumber)
+        {
+            treeNumber = tree->GetTreeNumber();
+            branch.clear();
+            for (Int_t i = 0; i < n; i++)
+            {
+                if (!cols[i] || !strcmp(cols[i], ""))
+                    continue;
+                leaf[i] = tree->GetTree()->FindLeaf(cols[i]);
+                if (!leaf[i])
+                {
+                    Error("FFFooFit::ReadTreeColumns", "Column '%s' not found in tree '%s'!",
+                          cols[i], tree->GetName());
+                    return -1;
+                }
+                if (std::find(branch.begin(), branch.end(), leaf[i]->GetBranch()) == branch.end())
+                    branch.push_back(leaf[i]->GetBranch());
+            }
+        }
+
+        // read branches
+        for (UInt_t i = 0; i < branch.size(); i++)
+            branch[i]->GetEntry(local);
+
+        // pass row
+        for (Int_t i = 0; i < n; i++)
+            if (leaf[i]) x[i] = leaf[i]->GetValue(0);
+        row(x.data());
+    }
+
+    return nEntries;
+}
+
+//______________________________________________________________________________
+Bool_t FFFooFit::SolveCholesky(Int_t n, Double_t* a, Double_t* b)
+{
+    // Solve the linear system a*x = b of the symmetric positive-definite
+    // matrix 'a' [n*n] via Cholesky decomposition. 'a' is overwritten by the
+    // decomposition and 'b' [n] by the solution.
+    // Return kFALSE if the matrix is not positive-definite or ill-conditioned,
+    // otherwise kTRUE.
+
+    // scale of the matrix
+    Double_t maxDiag = 0;
+    for (Int_t i = 0; i < n; i++)
+        maxDiag = TMath::Max(maxDiag, a[i*n+i]);
+    if (!(maxDiag > 0))
+        return kFALSE;
+
+    // decomposition a = L*L^T (L stored in lower triangle)
+    for (Int_t j = 0; j < n; j++)
+    {
+        Double_t d = a[j*n+j];
+        for (Int_t k = 0; k < j; k++)
+            d -= a[j*n+k] * a[j*n+k];
+        if (!(d > 1e-12 * maxDiag))
+            return kFALSE;
+        a[j*n+j] = TMath::Sqrt(d);
+        for (Int_t i = j+1; i < n; i++)
+        {
+            Double_t s = a[i*n+j];
+            for (Int_t k = 0; k < j; k++)
+                s -= a[i*n+k] * a[j*n+k];
+            a[i*n+j] = s / a[j*n+j];
+        }
+    }
+
+    // forward substitution
+    for (Int_t i = 0; i < n; i++)
+    {
+        for (Int_t k = 0; k < i; k++)
+            b[i] -= a[i*n+k] * b[k];
+        b[i] /= a[i*n+i];
+    }
+
+    // backward substitution
+    for (Int_t i = n-1; i >= 0; i--)
+    {
+        for (Int_t k = i+1; k < n; k++)
+            b[i] -= a[k*n+i] * b[k];
+        b[i] /= a[i*n+i];
+    }
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFFooFit::IsYieldOnly(const std::vector<std::vector<RooRealVar*> >& compPar,
+                             const std::vector<RooArgSet*>& constrNorm,
+                             const std::vector<RooRealVar*>& par, const RooArgList& coef)
+{
+    // Check if the yields 'coef' are the only floating parameters 'par' of a
+    // likelihood of a sum of components, i.e. if the components have no
+    // floating parameters 'compPar' and the constraints have no floating
+    // constrained parameters 'constrNorm'.
+
+    // check components
+    for (UInt_t k = 0; k < compPar.size(); k++)
+        if (!compPar[k].empty()) return kFALSE;
+
+    // check constraints
+    for (UInt_t i = 0; i < constrNorm.size(); i++)
+        if (constrNorm[i]->getSize()) return kFALSE;
+
+    // check parameters
+    if (par.empty())
+        return kFALSE;
+    for (UInt_t i = 0; i < par.size(); i++)
+    {
+        Bool_t yield = kFALSE;
+        for (Int_t k = 0; k < coef.getSize(); k++)
+        {
+            if (par[i] == coef.at(k))
+            {
+                yield = kTRUE;
+                break;
+            }
+        }
+        if (!yield)
+            return kFALSE;
+    }
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Int_t FFFooFit::ParallelFor(Long64_t n, Int_t nThreads,
+                            std::function<void(Int_t, Long64_t, Long64_t)> work,
+                            Long64_t minPerThread)
+{
+    // Split the 'n' items into contiguous slices and process them by calling
+    // 'work(t, start, end)' for slice t and the items [start, end) using up
+    // to 'nThreads' threads. At least 'minPerThread' items are assigned to
+    // each thread, i.e. small loops run in the calling thread.
+    // The slices are processed by the calling thread and by persistent
+    // worker threads created on demand. Nested or concurrent calls process
+    // their slices in the calling thread.
+    // Return the number of slices.
+
+    // number of slices
+    Long64_t nMax = minPerThread > 0 ? n / minPerThread : n;
+    Int_t nSlice = (Int_t)TMath::Max(1LL, TMath::Min((Long64_t)TMath::Max(nThreads, 1), nMax));
+
+    // process slice
+    std::function<void(Int_t)> slice = [&](Int_t t)
+    {
+        work(t, n * t / nSlice, n * (t + 1) / nSlice);
+    };
+
+    // run slices in worker threads if available
+    static FFThreadPool pool;
+    if (nSlice > 1 && !FFThreadPool::gInPool && pool.fRunMutex.try_lock())
+    {
+        FFThreadPool::gInPool = kTRUE;
+        pool.Run(nSlice, slice);
+        FFThreadPool::gInPool = kFALSE;
+        pool.fRunMutex.unlock();
+    }
+    else
+    {
+        for (Int_t t = 0; t < nSlice; t++)
+            slice(t);
+    }
+
+    return nSlice;
+}
+
 //______________________________________________________________________________
 Int_t FFFooFit::IndexOf(const Char_t* s1, const Char_t* s2, UInt_t p)
 {
@@ -253,3 +584,58 @@ TString FFFooFit::ExtractDirectory(const Char_t* s)
     return out;
 }
 
+//______________________________________________________________________________
+TString FFFooFit::MD5(const Char_t* s)
+{
+    // Return the MD5 hash of the string 's' as hexadecimal string.
+
+    TMD5 md5;
+    md5.Update((const UChar_t*)s, strlen(s));
+    md5.Final();
+
+    return TString(md5.AsString());
+}
+
+//______________________________________________________________________________
+TString FFFooFit::EscapeJSON(const Char_t* s)
+{
+    // Return the string 's' escaped for use in a JSON string.
+
+    TString out;
+    for (const Char_t* c = s; c && *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out += '\\';
+            out += *c;
+        }
+        else if ((UChar_t)*c < 0x20)
+            out += TString::Format("\\u%04x", (UChar_t)*c);
+        else
+            out += *c;
+    }
+
+    return out;
+}
+
+//______________________________________________________________________________
+TString FFFooFit::GetCacheDirectory()
+{
+    // Return the expanded path of the fit-result cache directory. If
+    // 'gCacheDir' is not set, the environment variable FOOFIT_CACHE_DIR is
+    // used, and '$HOME/.foofit/cache' if neither is set.
+
+    // determine directory
+    TString dir = gCacheDir;
+    if (dir == "")
+    {
+        const Char_t* env = gSystem->Getenv("FOOFIT_CACHE_DIR");
+        if (env)
+            dir = env;
+        else
+            dir = "$HOME/.foofit/cache";
+    }
+
+    return ExpandPath(dir.Data());
+}
+
@@ -0,0 +1,911 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooBinnedNLL                                                       //
+//                                                                      //
+// Native extended Poisson negative log-likelihood of a sum of models   //
+// and binned data.                                                     //
+//                                                                      //
+// The non-empty bins of the data are stored in contiguous arrays       //
+// together with their precomputed volumes. The bin probabilities of    //
+// each component are cached and only recomputed if a parameter of the  //
+// component changed, i.e. a change of the yields only requires the     //
+// recalculation of the bin expectations. Empty bins only contribute    //
+// via the total expected number of events and are skipped.             //
+//                                                                      //
+// Components providing a cumulative distribution function (see         //
+// FFRooModel::HasCDF()), either directly (1-dim. fits) or for all      //
+// factors of a product of models, are integrated exactly over the      //
+// bins using one CDF evaluation per bin edge. All other components     //
+// are evaluated at the bin centers.                                    //
+//                                                                      //
+// Optionally, the statistical uncertainties of histogram templates     //
+// (see FFRooTemplatePdf) are included via the Barlow-Beeston-lite      //
+// method: the expectation of each bin is scaled by a nuisance factor   //
+// constrained by a Gaussian of the relative template uncertainty of    //
+// the bin. The factors are profiled analytically per bin, which        //
+// requires all bins of the data, including the empty ones.             //
+//                                                                      //
+// If only yields are floating (see IsYieldOnly()), the likelihood can  //
+// be minimized directly via SolveYields() using Newton iterations with //
+// the analytical gradient.                                             //
+//                                                                      //
+// NOTE: the likelihood is evaluated in the calling process only, i.e.  //
+// FFFooFit::gUseNCPU is ignored.                                       //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "TMath.h"
+#include "RooRealVar.h"
+#include "RooAbsPdf.h"
+#include "RooDataHist.h"
+
+#include "FFRooBinnedNLL.h"
+#include "FFRooModelSum.h"
+#include "FFRooModelProd.h"
+#include "FFRooTemplatePdf.h"
+#include "FFFooFit.h"
+
+ClassImp(FFRooBinnedNLL)
+
+//______________________________________________________________________________
+FFRooBinnedNLL::FFRooBinnedNLL(const Char_t* name, const Char_t* title, FFRooModelSum* model,
+                               RooDataHist& data, RooRealVar** obs, Int_t nObs,
+                               const RooArgSet& constr, Bool_t bbLite)
+    : RooAbsReal(name, title),
+      fComp("comp", "Component pdfs", this),
+      fCoef("coef", "Component yields", this),
+      fConstr("constr", "Constraint pdfs", this)
+{
+    // Constructor using the sum of models 'model', the binned data 'data',
+    // the 'nObs' observables 'obs' and the constraint pdfs 'constr'.
+    // If 'bbLite' is kTRUE, the statistical uncertainties of the histogram
+    // templates are included via the Barlow-Beeston-lite method.
+
+    // init members
+    fModel = model;
+    fNObs = nObs;
+    fObs = new RooRealVar*[fNObs];
+    for (Int_t i = 0; i < fNObs; i++)
+    {
+        fObs[i] = obs[i];
+        fObsSet.add(*obs[i]);
+    }
+    fWeightSq = kFALSE;
+    fBBLite = bbLite;
+
+    // register components, yields and constraints
+    for (Int_t i = 0; i < fModel->GetNModel(); i++)
+    {
+        fComp.add(*fModel->GetModel(i)->GetPdf());
+        fCoef.add(*fModel->GetPar(i));
+    }
+    fConstr.add(constr);
+
+    // load the non-empty bins
+    LoadBins(data);
+
+    // init caches
+    Init();
+}
+
+//______________________________________________________________________________
+FFRooBinnedNLL::FFRooBinnedNLL(const FFRooBinnedNLL& other, const Char_t* name)
+    : RooAbsReal(other, name),
+      fComp("comp", this, other.fComp),
+      fCoef("coef", this, other.fCoef),
+      fConstr("constr", this, other.fConstr)
+{
+    // Copy constructor.
+
+    // init members
+    fModel = other.fModel;
+    fNObs = other.fNObs;
+    fObs = new RooRealVar*[fNObs];
+    for (Int_t i = 0; i < fNObs; i++)
+    {
+        fObs[i] = other.fObs[i];
+        fObsSet.add(*other.fObs[i]);
+    }
+    fNBin = other.fNBin;
+    fBinX = new Double_t[fNBin*fNObs];
+    fBinVol = new Double_t[fNBin];
+    fBinW = new Double_t[fNBin];
+    fBinW2 = new Double_t[fNBin];
+    for (Int_t i = 0; i < fNBin*fNObs; i++)
+        fBinX[i] = other.fBinX[i];
+    fBinIdx = new Int_t[fNBin*fNObs];
+    for (Int_t i = 0; i < fNBin*fNObs; i++)
+        fBinIdx[i] = other.fBinIdx[i];
+    for (Int_t i = 0; i < fNBin; i++)
+    {
+        fBinVol[i] = other.fBinVol[i];
+        fBinW[i] = other.fBinW[i];
+        fBinW2[i] = other.fBinW2[i];
+    }
+    fSumW = other.fSumW;
+    fSumW2 = other.fSumW2;
+    fNEdge = new Int_t[fNObs];
+    fEdge = new Double_t*[fNObs];
+    for (Int_t i = 0; i < fNObs; i++)
+    {
+        fNEdge[i] = other.fNEdge[i];
+        fEdge[i] = new Double_t[fNEdge[i]];
+        for (Int_t j = 0; j < fNEdge[i]; j++)
+            fEdge[i][j] = other.fEdge[i][j];
+    }
+    fWeightSq = other.fWeightSq;
+    fBBLite = other.fBBLite;
+
+    // init caches
+    Init();
+}
+
+//______________________________________________________________________________
+FFRooBinnedNLL::~FFRooBinnedNLL()
+{
+    // Destructor.
+
+    if (fObs)
+        delete [] fObs;
+    if (fBinX)
+        delete [] fBinX;
+    if (fBinVol)
+        delete [] fBinVol;
+    if (fBinW)
+        delete [] fBinW;
+    if (fBinW2)
+        delete [] fBinW2;
+    if (fBinIdx)
+        delete [] fBinIdx;
+    for (Int_t i = 0; i < fNObs; i++)
+    {
+        if (fEdge)
+            delete [] fEdge[i];
+        if (fInt)
+            delete [] fInt[i];
+    }
+    if (fNEdge)
+        delete [] fNEdge;
+    if (fEdge)
+        delete [] fEdge;
+    if (fInt)
+        delete [] fInt;
+    if (fProb)
+        delete [] fProb;
+    if (fMu)
+        delete [] fMu;
+    if (fRelErr2)
+        delete [] fRelErr2;
+    if (fBeta)
+        delete [] fBeta;
+    if (fSig2)
+        delete [] fSig2;
+    for (UInt_t i = 0; i < fConstrNorm.size(); i++)
+        delete fConstrNorm[i];
+}
+
+//______________________________________________________________________________
+Bool_t FFRooBinnedNLL::IsApplicable(FFRooModel* model, RooAbsData* data)
+{
+    // Check if the native binned likelihood can be used for the model 'model'
+    // and the data 'data'.
+
+    // check data
+    if (!data || !data->InheritsFrom("RooDataHist"))
+        return kFALSE;
+
+    // check model
+    if (!model || !model->InheritsFrom("FFRooModelSum") || !model->GetPdf())
+        return kFALSE;
+
+    // check sub-models
+    FFRooModelSum* sum = (FFRooModelSum*)model;
+    for (Int_t i = 0; i < sum->GetNModel(); i++)
+        if (!sum->GetModel(i) || !sum->GetModel(i)->GetPdf()) return kFALSE;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+void FFRooBinnedNLL::LoadBins(RooDataHist& data)
+{
+    // Copy the centers, volumes and contents of all non-empty bins (all bins
+    // if Barlow-Beeston-lite is used) of the data 'data' into contiguous
+    // arrays.
+
+    // count non-empty bins
+    const Int_t nEntries = data.numEntries();
+    fNBin = 0;
+    for (Int_t i = 0; i < nEntries; i++)
+    {
+        data.get(i);
+        if (fBBLite || data.weight() != 0)
+            fNBin++;
+    }
+
+    // create arrays
+    fBinX = new Double_t[fNBin*fNObs];
+    fBinIdx = new Int_t[fNBin*fNObs];
+    fBinVol = new Double_t[fNBin];
+    fBinW = new Double_t[fNBin];
+    fBinW2 = new Double_t[fNBin];
+
+    // copy bin edges of the data binning
+    const RooArgSet* dataVars = data.get();
+    fNEdge = new Int_t[fNObs];
+    fEdge = new Double_t*[fNObs];
+    for (Int_t j = 0; j < fNObs; j++)
+    {
+        RooAbsArg* x = dataVars->find(fObs[j]->GetName());
+        if (x && x->InheritsFrom("RooRealVar"))
+        {
+            const RooAbsBinning& binning = ((RooRealVar*)x)->getBinning();
+            fNEdge[j] = binning.numBoundaries();
+            fEdge[j] = new Double_t[fNEdge[j]];
+            for (Int_t k = 0; k < fNEdge[j]; k++)
+                fEdge[j][k] = binning.array()[k];
+        }
+        else
+        {
+            fNEdge[j] = 0;
+            fEdge[j] = 0;
+        }
+    }
+
+    // copy bins
+    Int_t b = 0;
+    fSumW = 0;
+    fSumW2 = 0;
+    for (Int_t i = 0; i < nEntries; i++)
+    {
+        // skip empty bins
+        const RooArgSet* row = data.get(i);
+        Double_t w = data.weight();
+        if (!fBBLite && w == 0)
+            continue;
+
+        // bin center and bin indices
+        for (Int_t j = 0; j < fNObs; j++)
+        {
+            RooAbsReal* x = (RooAbsReal*)row->find(fObs[j]->GetName());
+            fBinX[b*fNObs+j] = x ? x->getVal() : 0;
+            fBinIdx[b*fNObs+j] = fNEdge[j] ? ((RooRealVar*)x)->getBinning().binNumber(fBinX[b*fNObs+j]) : 0;
+        }
+
+        // bin volume and content
+        fBinVol[b] = data.binVolume();
+        fBinW[b] = w;
+        fBinW2[b] = data.weightSquared();
+        fSumW += fBinW[b];
+        fSumW2 += fBinW2[b];
+        b++;
+    }
+}
+
+//______________________________________________________________________________
+void FFRooBinnedNLL::Init()
+{
+    // Create the caches of the bin probabilities and expectations and
+    // collect the parameters.
+
+    fNComp = fComp.getSize();
+    fProb = new Double_t[fNComp*fNBin];
+    fMu = new Double_t[fNBin];
+    fInt = new Double_t*[fNObs];
+    for (Int_t j = 0; j < fNObs; j++)
+        fInt[j] = fNEdge[j] ? new Double_t[fNEdge[j]-1] : 0;
+
+    // check which components can be integrated using CDFs
+    // (0: bin centers, 1: 1-dim. model, 2: product of 1-dim. models)
+    fCompCDF.assign(fNComp, 0);
+    Bool_t edges = kTRUE;
+    for (Int_t j = 0; j < fNObs; j++)
+        if (fNEdge[j] < 2) edges = kFALSE;
+    for (Int_t k = 0; k < fNComp && edges; k++)
+    {
+        FFRooModel* m = fModel->GetModel(k);
+        if (fNObs == 1 && m->HasCDF())
+        {
+            fCompCDF[k] = 1;
+        }
+        else if (m->InheritsFrom("FFRooModelProd") && ((FFRooModelProd*)m)->GetNModel() == fNObs)
+        {
+            Bool_t all = kTRUE;
+            for (Int_t j = 0; j < fNObs; j++)
+                if (!((FFRooModelProd*)m)->GetModel(j)->HasCDF()) all = kFALSE;
+            if (all)
+                fCompCDF[k] = 2;
+        }
+    }
+    fLastVal = 0;
+    fLastValid = kFALSE;
+    fNCompEval = 0;
+    fNSolverIter = 0;
+    fSolverEDM = 0;
+    CollectParameters();
+
+    // Barlow-Beeston-lite caches
+    fRelErr2 = 0;
+    fBeta = 0;
+    fSig2 = 0;
+    if (fBBLite)
+    {
+        fRelErr2 = new Double_t[fNComp*fNBin];
+        fBeta = new Double_t[fNBin];
+        fSig2 = new Double_t[fNBin];
+        LoadTemplateErrors();
+    }
+}
+
+//______________________________________________________________________________
+void FFRooBinnedNLL::CollectParameters()
+{
+    // Collect the floating parameters of the components, of the constraints
+    // and of the full likelihood.
+
+    // floating parameters of components
+    fCompPar.clear();
+    fCompVal.clear();
+    fCompValid.clear();
+    for (Int_t i = 0; i < fNComp; i++)
+    {
+        std::vector<RooRealVar*> par;
+        RooArgSet* params = fComp.at(i)->getParameters(fObsSet);
+        TIterator* iter = params->createIterator();
+        while (RooAbsArg* p = (RooAbsArg*)iter->Next())
+            if (p->InheritsFrom("RooRealVar") && !p->isConstant()) par.push_back((RooRealVar*)p);
+        delete iter;
+        delete params;
+        fCompPar.push_back(par);
+        fCompVal.push_back(std::vector<Double_t>(par.size(), 0));
+        fCompValid.push_back(kFALSE);
+    }
+
+    // normalization sets of constraints (floating constrained parameters)
+    for (UInt_t i = 0; i < fConstrNorm.size(); i++)
+        delete fConstrNorm[i];
+    fConstrNorm.clear();
+    for (Int_t i = 0; i < fConstr.getSize(); i++)
+    {
+        RooArgSet* norm = new RooArgSet();
+        RooArgSet* vars = fConstr.at(i)->getVariables();
+        TIterator* iter = vars->createIterator();
+        while (RooAbsArg* p = (RooAbsArg*)iter->Next())
+            if (!p->isConstant()) norm->add(*p);
+        delete iter;
+        delete vars;
+        fConstrNorm.push_back(norm);
+    }
+
+    // floating parameters of the likelihood
+    fPar.clear();
+    RooArgSet* params = getParameters(fObsSet);
+    TIterator* iter = params->createIterator();
+    while (RooAbsArg* p = (RooAbsArg*)iter->Next())
+        if (p->InheritsFrom("RooRealVar") && !p->isConstant()) fPar.push_back((RooRealVar*)p);
+    delete iter;
+    delete params;
+    fParVal.assign(fPar.size(), 0);
+}
+
+//______________________________________________________________________________
+Int_t FFRooBinnedNLL::GetNCompCDF() const
+{
+    // Return the number of components integrated exactly using CDFs.
+
+    Int_t n = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+        if (fCompCDF[k]) n++;
+
+    return n;
+}
+
+//______________________________________________________________________________
+Int_t FFRooBinnedNLL::GetNCompBBLite() const
+{
+    // Return the number of components whose template uncertainties are
+    // included via Barlow-Beeston-lite.
+
+    if (!fBBLite)
+        return 0;
+
+    Int_t n = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        const Double_t* err2 = fRelErr2 + k*fNBin;
+        for (Int_t i = 0; i < fNBin; i++)
+        {
+            if (err2[i] > 0)
+            {
+                n++;
+                break;
+            }
+        }
+    }
+
+    return n;
+}
+
+//______________________________________________________________________________
+void FFRooBinnedNLL::LoadTemplateErrors()
+{
+    // Load the squared relative statistical errors of the histogram template
+    // components (see FFRooTemplatePdf) at the bin centers. Other components
+    // are considered to have no uncertainty.
+
+    for (Int_t i = 0; i < fNComp*fNBin; i++)
+        fRelErr2[i] = 0;
+
+    // loop over components
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        // check type of component
+        if (!fComp.at(k)->InheritsFrom("FFRooTemplatePdf"))
+            continue;
+        FFRooTemplatePdf* pdf = (FFRooTemplatePdf*)fComp.at(k);
+
+        // map observables of the template
+        const Int_t nDim = pdf->GetNDim();
+        Int_t map[3];
+        Bool_t mapped = nDim > 0;
+        for (Int_t d = 0; d < nDim; d++)
+        {
+            map[d] = -1;
+            for (Int_t j = 0; j < fNObs; j++)
+                if (!strcmp(pdf->GetObservables().at(d)->GetName(), fObs[j]->GetName())) map[d] = j;
+            if (map[d] == -1)
+                mapped = kFALSE;
+        }
+        if (!mapped)
+            continue;
+
+        // relative errors at the bin centers
+        Double_t* err2 = fRelErr2 + k*fNBin;
+        for (Int_t i = 0; i < fNBin; i++)
+        {
+            Double_t x[3];
+            for (Int_t d = 0; d < nDim; d++)
+                x[d] = fBinX[i*fNObs+map[d]];
+            err2[i] = pdf->GetRelError2(x);
+        }
+    }
+}
+
+//______________________________________________________________________________
+Bool_t FFRooBinnedNLL::IntegrateComponent(Int_t comp) const
+{
+    // Compute the probabilities of all non-empty bins for the component
+    // 'comp' by integrating the (factorized) model over the bins using the
+    // cumulative distribution functions.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // integrate all observables
+    FFRooModel* m = fModel->GetModel(comp);
+    for (Int_t j = 0; j < fNObs; j++)
+    {
+        FFRooModel* mj = fCompCDF[comp] == 2 ? ((FFRooModelProd*)m)->GetModel(j) : m;
+        if (!mj->IntegrateBins(fNEdge[j]-1, fEdge[j], fObs[j]->getMin(), fObs[j]->getMax(), fInt[j]))
+            return kFALSE;
+    }
+
+    // combine bin integrals
+    Double_t* prob = fProb + comp*fNBin;
+    for (Int_t i = 0; i < fNBin; i++)
+    {
+        Double_t p = 1;
+        for (Int_t j = 0; j < fNObs; j++)
+            p *= fInt[j][fBinIdx[i*fNObs+j]];
+        prob[i] = p;
+    }
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+void FFRooBinnedNLL::ComputeProbabilities(Int_t comp) const
+{
+    // Compute the probabilities of all non-empty bins for the component
+    // 'comp' exactly using CDFs if possible, otherwise using the normalized
+    // pdf at the bin centers.
+    // NOTE: the values of the observables may be modified.
+
+    fNCompEval++;
+
+    // exact bin integrals
+    if (fCompCDF[comp] && IntegrateComponent(comp))
+        return;
+
+    // bin centers
+    RooAbsReal* pdf = (RooAbsReal*)fComp.at(comp);
+    Double_t* prob = fProb + comp*fNBin;
+    for (Int_t i = 0; i < fNBin; i++)
+    {
+        for (Int_t j = 0; j < fNObs; j++)
+            fObs[j]->setVal(fBinX[i*fNObs+j]);
+        prob[i] = pdf->getVal(&fObsSet) * fBinVol[i];
+    }
+}
+
+//______________________________________________________________________________
+void FFRooBinnedNLL::ApplyWeightSquared(Bool_t flag)
+{
+    // Use the squared weights of the bin contents if 'flag' is kTRUE (used to
+    // correct the covariance matrix of weighted fits).
+
+    if (flag != fWeightSq)
+    {
+        fWeightSq = flag;
+        fLastValid = kFALSE;
+        setValueDirty();
+    }
+}
+
+//______________________________________________________________________________
+Double_t FFRooBinnedNLL::evaluate() const
+{
+    // Evaluate the negative log-likelihood.
+
+    // return cached value if no parameter changed
+    Bool_t changed = !fLastValid;
+    for (UInt_t i = 0; i < fPar.size(); i++)
+    {
+        Double_t v = fPar[i]->getVal();
+        if (v != fParVal[i])
+        {
+            fParVal[i] = v;
+            changed = kTRUE;
+        }
+    }
+    if (!changed)
+        return fLastVal;
+
+    // update the bin probabilities of the components with changed parameters
+    Double_t* obsVal = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        // check parameters
+        Bool_t compChanged = !fCompValid[k];
+        for (UInt_t j = 0; j < fCompPar[k].size(); j++)
+        {
+            Double_t v = fCompPar[k][j]->getVal();
+            if (v != fCompVal[k][j])
+            {
+                fCompVal[k][j] = v;
+                compChanged = kTRUE;
+            }
+        }
+        if (!compChanged)
+            continue;
+
+        // backup observable values
+        if (!obsVal)
+        {
+            obsVal = new Double_t[fNObs];
+            for (Int_t j = 0; j < fNObs; j++)
+                obsVal[j] = fObs[j]->getVal();
+        }
+
+        // compute bin probabilities
+        ComputeProbabilities(k);
+        fCompValid[k] = kTRUE;
+    }
+
+    // restore observable values
+    if (obsVal)
+    {
+        for (Int_t j = 0; j < fNObs; j++)
+            fObs[j]->setVal(obsVal[j]);
+        delete [] obsVal;
+    }
+
+    // calculate the bin expectations
+    Double_t nExp = 0;
+    for (Int_t i = 0; i < fNBin; i++)
+        fMu[i] = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        const Double_t n = ((RooAbsReal*)fCoef.at(k))->getVal();
+        const Double_t* prob = fProb + k*fNBin;
+        for (Int_t i = 0; i < fNBin; i++)
+            fMu[i] += n * prob[i];
+        nExp += n;
+    }
+
+    // extended Poisson likelihood
+    // (non-positive expectations are floored to yield a large but finite value)
+    Double_t nll = 0;
+    if (fBBLite)
+    {
+        // expectations scaled by the profiled Barlow-Beeston-lite factors
+        nll = ComputeBBLite();
+        if (!fWeightSq)
+        {
+            nll += nExp;
+            for (Int_t i = 0; i < fNBin; i++)
+            {
+                const Double_t m = fBeta[i] * fMu[i];
+                nll += m - fMu[i] - fBinW[i] * TMath::Log(m > 0 ? m : 1e-300);
+            }
+        }
+        else
+        {
+            // squared weights (extended term scaled by the global ratio of the
+            // sums of squared weights and weights, as in RooFit)
+            Double_t sumM = 0;
+            for (Int_t i = 0; i < fNBin; i++)
+            {
+                const Double_t m = fBeta[i] * fMu[i];
+                sumM += m;
+                nll -= fBinW2[i] * TMath::Log(m > 0 ? m : 1e-300);
+            }
+            nll += fSumW != 0 ? fSumW2 / fSumW * sumM : sumM;
+        }
+    }
+    else if (!fWeightSq)
+    {
+        nll = nExp;
+        for (Int_t i = 0; i < fNBin; i++)
+            nll -= fBinW[i] * TMath::Log(fMu[i] > 0 ? fMu[i] : 1e-300);
+    }
+    else
+    {
+        // squared weights (extended term scaled by the global ratio of the
+        // sums of squared weights and weights, as in RooFit)
+        nll = fSumW != 0 ? fSumW2 / fSumW * nExp : nExp;
+        for (Int_t i = 0; i < fNBin; i++)
+            nll -= fBinW2[i] * TMath::Log(fMu[i] > 0 ? fMu[i] : 1e-300);
+    }
+
+    // constraints
+    for (Int_t i = 0; i < fConstr.getSize(); i++)
+        nll -= TMath::Log(((RooAbsReal*)fConstr.at(i))->getVal(fConstrNorm[i]));
+
+    // cache value
+    fLastVal = nll;
+    fLastValid = kTRUE;
+
+    return nll;
+}
+
+//______________________________________________________________________________
+Double_t FFRooBinnedNLL::ComputeBBLite() const
+{
+    // Calculate the squared relative template uncertainties and the
+    // Barlow-Beeston-lite scale factors of all bins for the current bin
+    // expectations. The factors maximizing the likelihood are obtained
+    // analytically as the positive root of the quadratic equation
+    // beta^2 + (mu*sigma^2 - 1)*beta - n*sigma^2 = 0.
+    // Return the sum of the Gaussian penalty terms of the factors.
+
+    // squared uncertainties of the bin expectations
+    for (Int_t i = 0; i < fNBin; i++)
+        fSig2[i] = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        const Double_t n = ((RooAbsReal*)fCoef.at(k))->getVal();
+        const Double_t* prob = fProb + k*fNBin;
+        const Double_t* err2 = fRelErr2 + k*fNBin;
+        for (Int_t i = 0; i < fNBin; i++)
+        {
+            const Double_t t = n * prob[i];
+            fSig2[i] += t * t * err2[i];
+        }
+    }
+
+    // profile scale factors
+    Double_t pen = 0;
+    for (Int_t i = 0; i < fNBin; i++)
+    {
+        const Double_t mu = fMu[i];
+        if (!(mu > 0) || fSig2[i] == 0)
+        {
+            fBeta[i] = 1;
+            fSig2[i] = 0;
+            continue;
+        }
+        fSig2[i] /= mu * mu;
+        const Double_t b = 1 - mu * fSig2[i];
+        const Double_t disc = b * b + 4 * fBinW[i] * fSig2[i];
+        fBeta[i] = disc > 0 ? 0.5 * (b + TMath::Sqrt(disc)) : TMath::Max(0., 0.5 * b);
+        pen += (fBeta[i] - 1) * (fBeta[i] - 1) / (2 * fSig2[i]);
+    }
+
+    return pen;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooBinnedNLL::IsYieldOnly() const
+{
+    // Check if the yields are the only floating parameters of the likelihood,
+    // i.e. if all component shapes are fixed and no floating parameter is
+    // constrained (see FFFooFit::IsYieldOnly()).
+
+    return FFFooFit::IsYieldOnly(fCompPar, fConstrNorm, fPar, fCoef);
+}
+
+//______________________________________________________________________________
+void FFRooBinnedNLL::ComputeYieldDerivatives(Int_t nFree, const Int_t* idx, const Double_t* n,
+                                             Double_t* g, Double_t* h) const
+{
+    // Calculate the gradient 'g' [nFree] of the likelihood with respect to
+    // the 'nFree' floating yields 'n' of the components with indices 'idx'
+    // and the Hessian 'h' [nFree*nFree] of the Poisson terms using the bin
+    // expectations (and Barlow-Beeston-lite factors) of the last evaluation.
+    // The Barlow-Beeston-lite factors are profiled, i.e. they only enter the
+    // gradient via the dependence of the template uncertainties on the
+    // yields.
+
+    // per-bin coefficients
+    std::vector<Double_t> a(fNBin, 0);
+    std::vector<Double_t> b(fNBin, 0);
+    std::vector<Double_t> c(fNBin, 0);
+    for (Int_t i = 0; i < fNBin; i++)
+    {
+        const Double_t mu = fMu[i];
+        if (!(mu > 0))
+            continue;
+        const Double_t beta = fBBLite ? fBeta[i] : 1;
+        a[i] = beta - 1 - fBinW[i] / mu;
+        b[i] = fBinW[i] / (mu * mu);
+        if (fBBLite && fSig2[i] > 0)
+            c[i] = -(beta - 1) * (beta - 1) / (2 * fSig2[i] * fSig2[i]);
+    }
+
+    // gradient and Hessian
+    for (Int_t k = 0; k < nFree; k++)
+    {
+        const Double_t* pk = fProb + idx[k]*fNBin;
+        Double_t s = 1;
+        for (Int_t i = 0; i < fNBin; i++)
+            s += a[i] * pk[i];
+        if (fBBLite)
+        {
+            const Double_t* rk = fRelErr2 + idx[k]*fNBin;
+            for (Int_t i = 0; i < fNBin; i++)
+            {
+                if (c[i] == 0)
+                    continue;
+                s += c[i] * (2 * n[k] * pk[i] * pk[i] * rk[i] / (fMu[i] * fMu[i]) -
+                             2 * fSig2[i] * pk[i] / fMu[i]);
+            }
+        }
+        g[k] = s;
+        for (Int_t l = 0; l <= k; l++)
+        {
+            const Double_t* pl = fProb + idx[l]*fNBin;
+            Double_t t = 0;
+            for (Int_t i = 0; i < fNBin; i++)
+                t += b[i] * pk[i] * pl[i];
+            h[k*nFree+l] = t;
+            h[l*nFree+k] = t;
+        }
+    }
+}
+
+//______________________________________________________________________________
+Bool_t FFRooBinnedNLL::SolveYields(Int_t maxIter, Double_t tol)
+{
+    // Minimize the likelihood with respect to the floating yields if they
+    // are the only floating parameters (see IsYieldOnly()) using Newton
+    // steps until the estimated distance to the minimum is below 'tol' or
+    // 'maxIter' iterations were performed. The yields are kept within their
+    // limits: yields at a limit with the gradient pointing outwards are held
+    // fixed and the Newton steps and the estimated distance to the minimum
+    // use the remaining yields only (projected gradient).
+    // The yields are set to the solution on success. If the Hessian is
+    // ill-conditioned or no convergence was reached, the yields are left
+    // unchanged and kFALSE is returned.
+
+    fNSolverIter = 0;
+    fSolverEDM = 0;
+
+    // check parameters
+    if (!IsYieldOnly() || fWeightSq)
+        return kFALSE;
+
+    // collect floating yields
+    Int_t idx[fNComp];
+    Int_t nFree = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+        if (!fCoef.at(k)->isConstant()) idx[nFree++] = k;
+    if (!nFree)
+        return kFALSE;
+
+    // start values and limits
+    Double_t n[nFree];
+    Double_t nMin[nFree];
+    Double_t nMax[nFree];
+    Double_t nStart[nFree];
+    RooRealVar* var[nFree];
+    for (Int_t k = 0; k < nFree; k++)
+    {
+        var[k] = (RooRealVar*)fCoef.at(idx[k]);
+        nStart[k] = var[k]->getVal();
+        nMin[k] = var[k]->getMin();
+        nMax[k] = var[k]->getMax();
+        n[k] = nStart[k];
+    }
+
+    // Newton iterations
+    Double_t g[nFree];
+    Double_t h[nFree*nFree];
+    Double_t d[nFree];
+    Int_t inact[nFree];
+    Double_t hr[nFree*nFree];
+    Double_t dr[nFree];
+    Bool_t converged = kFALSE;
+    Double_t nll = getVal();
+    for (fNSolverIter = 0; fNSolverIter < maxIter; fNSolverIter++)
+    {
+        // yields not held at a limit (the gradient points outwards at active limits)
+        ComputeYieldDerivatives(nFree, idx, n, g, h);
+        Int_t nInact = 0;
+        for (Int_t k = 0; k < nFree; k++)
+        {
+            Bool_t active = (n[k] <= nMin[k] && g[k] > 0) || (n[k] >= nMax[k] && g[k] < 0);
+            if (!active)
+                inact[nInact++] = k;
+        }
+
+        // Newton step of the yields not held at a limit
+        for (Int_t k = 0; k < nInact; k++)
+        {
+            dr[k] = -g[inact[k]];
+            for (Int_t l = 0; l < nInact; l++)
+                hr[k*nInact+l] = h[inact[k]*nFree+inact[l]];
+        }
+        if (nInact && !FFFooFit::SolveCholesky(nInact, hr, dr))
+            break;
+        for (Int_t k = 0; k < nFree; k++)
+            d[k] = 0;
+        for (Int_t k = 0; k < nInact; k++)
+            d[inact[k]] = dr[k];
+
+        // estimated distance to minimum (projected gradient)
+        fSolverEDM = 0;
+        for (Int_t k = 0; k < nFree; k++)
+            fSolverEDM -= 0.5 * g[k] * d[k];
+        if (fSolverEDM < tol)
+        {
+            converged = kTRUE;
+            break;
+        }
+
+        // line search within the limits
+        Bool_t accepted = kFALSE;
+        Double_t alpha = 1;
+        for (Int_t j = 0; j < 30; j++, alpha *= 0.5)
+        {
+            for (Int_t k = 0; k < nFree; k++)
+                var[k]->setVal(TMath::Max(nMin[k], TMath::Min(n[k] + alpha*d[k], nMax[k])));
+            Double_t nllTrial = getVal();
+            if (nllTrial <= nll)
+            {
+                for (Int_t k = 0; k < nFree; k++)
+                    n[k] = var[k]->getVal();
+                nll = nllTrial;
+                accepted = kTRUE;
+                break;
+            }
+        }
+
+        // no further decrease possible without reaching the minimum
+        if (!accepted)
+            break;
+    }
+
+    // restore start values on failure
+    if (!converged)
+    {
+        for (Int_t k = 0; k < nFree; k++)
+            var[k]->setVal(nStart[k]);
+        return kFALSE;
+    }
+
+    return kTRUE;
+}
@@ -0,0 +1,188 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooConvCache                                                       //
+//                                                                      //
+// Manager of shared FFT plans and convolution cache binnings.          //
+//                                                                      //
+// FFT plans (including their aligned input and output buffers) are     //
+// created once per transform type, size and thread and shared by all   //
+// users in this thread, e.g. all FFRooGridConvPdf instances. Plans are //
+// thus never used concurrently, and their creation and deletion (not   //
+// thread-safe in FFTW) is serialized. The plans of a thread are        //
+// deleted when the thread exits. Transform sizes should be rounded up  //
+// via GetGoodSize() to sizes that are efficient and can be shared.     //
+//                                                                      //
+// The number of bins of the "cache" binning used by RooFFTConvPdf can  //
+// be set per model or derived automatically from the binning of the    //
+// convolution variable and the range of the Gaussian sigma. Since the  //
+// cache binning belongs to the variable, the finest binning requested  //
+// by the models sharing a variable is used unless a model sets its     //
+// number of bins explicitly. The automatic binning usually has fewer   //
+// bins than the fixed 10000 bins used before by FFRooModelLandau.      //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TMath.h"
+#include "TVirtualFFT.h"
+#include "RooRealVar.h"
+
+#include "FFRooConvCache.h"
+
+ClassImp(FFRooConvCache)
+
+// init static class members
+std::mutex FFRooConvCache::fgMutex;
+std::atomic<Long64_t> FFRooConvCache::fgNRequest(0);
+Int_t FFRooConvCache::fgOversampling = 4;
+Int_t FFRooConvCache::fgMaxBins = 10000;
+
+namespace {
+
+// FFT plans of a thread (deleted when the thread exits)
+class FFPlanMap : public std::map<std::string, TVirtualFFT*>
+{
+public:
+    std::mutex* fMutex;
+
+    FFPlanMap() : fMutex(0) { }
+    ~FFPlanMap() { Clear(); }
+    void Clear()
+    {
+        if (empty())
+            return;
+        std::lock_guard<std::mutex> lock(*fMutex);
+        for (auto it = begin(); it != end(); ++it)
+            delete it->second;
+        clear();
+    }
+};
+
+thread_local FFPlanMap gPlan;
+
+}
+
+//______________________________________________________________________________
+TVirtualFFT* FFRooConvCache::GetPlan(Int_t nDim, const Int_t* n, const Char_t* opt)
+{
+    // Return the FFT plan of dimension 'nDim' with the sizes 'n' and the
+    // TVirtualFFT options 'opt' (e.g. "R2C ES") shared within the calling
+    // thread. The plan is created on the first request of the thread and
+    // owned by this class.
+    // Return 0 if the plan could not be created.
+
+    // plan key
+    std::string key = opt;
+    std::vector<Int_t> size(nDim);
+    for (Int_t i = 0; i < nDim; i++)
+    {
+        key += TString::Format(":%d", n[i]).Data();
+        size[i] = n[i];
+    }
+
+    // look for existing plan
+    fgNRequest++;
+    auto it = gPlan.find(key);
+    if (it != gPlan.end())
+        return it->second;
+
+    // create new plan (serialized)
+    std::lock_guard<std::mutex> lock(fgMutex);
+    gPlan.fMutex = &fgMutex;
+    TVirtualFFT* fft = TVirtualFFT::FFT(nDim, size.data(), TString::Format("%s K", opt).Data());
+    if (fft)
+        gPlan[key] = fft;
+
+    return fft;
+}
+
+//______________________________________________________________________________
+Int_t FFRooConvCache::GetNPlans()
+{
+    // Return the number of FFT plans of the calling thread.
+
+    return gPlan.size();
+}
+
+//______________________________________________________________________________
+void FFRooConvCache::ClearPlans()
+{
+    // Delete all FFT plans of the calling thread.
+
+    gPlan.Clear();
+}
+
+//______________________________________________________________________________
+Int_t FFRooConvCache::GetGoodSize(Int_t n)
+{
+    // Return the smallest transform size not less than 'n' having only the
+    // prime factors 2, 3 and 5.
+
+    for (Int_t m = TMath::Max(n, 1); ; m++)
+    {
+        Int_t r = m;
+        while (r % 2 == 0) r /= 2;
+        while (r % 3 == 0) r /= 3;
+        while (r % 5 == 0) r /= 5;
+        if (r == 1)
+            return m;
+    }
+}
+
+//______________________________________________________________________________
+Int_t FFRooConvCache::GetCacheBins(const RooRealVar* var, const RooAbsReal* sigma, Int_t nBins)
+{
+    // Return the number of cache bins for the convolution in the variable
+    // 'var' with a Gaussian having the sigma 'sigma'. If 'nBins' is larger
+    // than 0, it is returned. Otherwise the cache bin width is set to the
+    // bin width of the variable divided by the oversampling factor, or to
+    // half the smallest possible sigma if smaller.
+
+    // user setting
+    if (nBins > 0)
+        return nBins;
+
+    // cache bin width from variable binning
+    Double_t range = var->getMax() - var->getMin();
+    Double_t w = range / var->numBins() / fgOversampling;
+
+    // resolve the narrowest Gaussian
+    Double_t sMin = TMath::Abs(sigma->getVal());
+    if (sigma->InheritsFrom("RooRealVar"))
+        sMin = TMath::Max(((RooRealVar*)sigma)->getMin(), 0.);
+    if (sMin > 0)
+        w = TMath::Min(w, sMin / 2);
+
+    // number of bins
+    Double_t n = TMath::Ceil(range / w);
+    n = TMath::Max(n, (Double_t)var->numBins());
+    if (fgMaxBins > 0)
+        n = TMath::Min(n, (Double_t)fgMaxBins);
+
+    return GetGoodSize((Int_t)n);
+}
+
+//______________________________________________________________________________
+Int_t FFRooConvCache::SetCacheBinning(RooRealVar* var, const RooAbsReal* sigma, Int_t nBins)
+{
+    // Set the "cache" binning of the variable 'var' used for the convolution
+    // with a Gaussian having the sigma 'sigma' (see GetCacheBins()). For an
+    // automatic binning ('nBins' = 0), an existing finer cache binning of the
+    // variable is kept. An explicit number of bins is always set.
+    // Return the number of cache bins of the variable.
+
+    Int_t n = GetCacheBins(var, sigma, nBins);
+    if (nBins <= 0 && var->hasBinning("cache") && var->getBinning("cache").numBins() >= n)
+        return var->getBinning("cache").numBins();
+    var->setBins(n, "cache");
+
+    return n;
+}
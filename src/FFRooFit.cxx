@@ -11,21 +11,41 @@
 //////////////////////////////////////////////////////////////////////////
 
 
+#include <vector>
+
 #include "RooRealVar.h"
 #include "RooAbsData.h"
 #include "RooAbsPdf.h"
 #include "RooPlot.h"
 #include "RooDataHist.h"
+#include "RooDataSet.h"
 #include "RooFitResult.h"
-#include "RooChi2Var.h"
+#include "RooMinimizer.h"
+#include "RooNLLVar.h"
+#include "RooMultiVarGaussian.h"
+#include "RooBinning.h"
 #include "TCanvas.h"
 #include "TLegend.h"
 #include "TH2.h"
 #include "TMath.h"
+#include "TMatrixDSym.h"
+#include "TVectorD.h"
+#include "TFile.h"
+#include "TSystem.h"
+#include "TSystemDirectory.h"
+#include "TSystemFile.h"
 
 #include "FFRooFit.h"
 #include "FFFooFit.h"
 #include "FFRooModel.h"
+#include "FFRooModelGauss.h"
+#include "FFRooModelSum.h"
+#include "FFRooBinnedNLL.h"
+#include "FFRooUnbinnedNLL.h"
+#include "FFRooFitProfile.h"
+#include "FFRooFitTrace.h"
+#include "FFRooNLLMonitor.h"
+#include "FFColumnStats.h"
 
 ClassImp(FFRooFit)
 
@@ -42,14 +62,24 @@ FFRooFit::FFRooFit(Int_t nVar, const Char_t* name, const Char_t* title)
     // init members
     fNVar = nVar;
     fVar = new RooRealVar*[fNVar];
+    fBinType = new FFBinning_t[fNVar];
+    fBinPar = new Double_t[fNVar];
+    fBinNUni = new Int_t[fNVar];
     for (Int_t i = 0; i < fNVar; i++)
+    {
         fVar[i] = 0;
+        fBinType[i] = kBinningUniform;
+        fBinPar[i] = 0;
+        fBinNUni[i] = 0;
+    }
     fNVarAux = 0;
     fVarAux = 0;
     fNVarCtrl = 0;
     fVarCtrl = 0;
     fNConstr = 0;
     fConstr = 0;
+    fConstrGauss = 0;
+    fConstrGaussSig = "";
     fData = 0;
     fModel = 0;
     fResult = 0;
@@ -58,6 +88,12 @@ FFRooFit::FFRooFit(Int_t nVar, const Char_t* name, const Char_t* title)
     fMinimizerPreFit = kMinuit2_Migrad;
     fRangeMin = 0;
     fRangeMax = 0;
+    fProfile = new FFRooFitProfile(TString::Format("%s_Profile", GetName()).Data(),
+                                   TString::Format("Profile of %s", GetTitle()).Data());
+    fTrace = 0;
+    fTraceFile = "";
+    fStats = new FFColumnStats(TString::Format("%s_Stats", GetName()).Data(),
+                               TString::Format("Column statistics of %s", GetTitle()).Data());
 }
 
 //______________________________________________________________________________
@@ -71,6 +107,12 @@ FFRooFit::~FFRooFit()
             if (fVar[i]) delete fVar[i];
         delete [] fVar;
     }
+    if (fBinType)
+        delete [] fBinType;
+    if (fBinPar)
+        delete [] fBinPar;
+    if (fBinNUni)
+        delete [] fBinNUni;
     if (fVarAux)
         delete [] fVarAux;
     if (fVarCtrl)
@@ -81,10 +123,18 @@ FFRooFit::~FFRooFit()
     }
     if (fConstr)
         delete [] fConstr;
+    if (fConstrGauss)
+        delete fConstrGauss;
     if (fData)
         delete fData;
     if (fResult)
         delete fResult;
+    if (fProfile)
+        delete fProfile;
+    if (fTrace)
+        delete fTrace;
+    if (fStats)
+        delete fStats;
 }
 
 //______________________________________________________________________________
@@ -114,9 +164,65 @@ void FFRooFit::SetVariable(Int_t i, const Char_t* name, const Char_t* title,
         fVar[i] = new RooRealVar(name, title, min, max);
         if (nbins)
             fVar[i]->setBins(nbins);
+        fBinNUni[i] = fVar[i]->numBins();
+    }
+}
+
+//______________________________________________________________________________
+FFRooFit::FFBinning_t FFRooFit::GetBinningType(Int_t i) const
+{
+    // Return the binning type of the fit variable with index 'i'.
+
+    // check variable index
+    if (CheckVarBounds(i, "GetBinningType()"))
+        return fBinType[i];
+    else
+        return kBinningUniform;
+}
+
+//______________________________________________________________________________
+void FFRooFit::SetAdaptiveBinning(Int_t i, FFBinning_t type, Double_t par)
+{
+    // Set the binning type of the fit variable with index 'i' to 'type'.
+    // The binning is determined from the data when loading the data and used
+    // in all binned fits (binned likelihood and chi2 fits, chi2 pre-fits).
+    //
+    // kBinningUniform    : uniform bins as set via SetVariable()
+    // kBinningQuantile   : 'par' bins of equal population (the number of bins
+    //                      set via SetVariable() if 'par' is zero)
+    // kBinningMinContent : the uniform bins set via SetVariable() are merged
+    //                      until each bin has at least a content of 'par'
+    //
+    // The number of uniform bins is recorded when the variable is set (or
+    // here if not known yet) and not read back from the current binning of
+    // the variable, which is replaced by the adaptive binning.
+
+    // check variable index
+    if (CheckVarBounds(i, "SetAdaptiveBinning()"))
+    {
+        fBinType[i] = type;
+        fBinPar[i] = par;
+        if (!fBinNUni[i] && fVar[i])
+            fBinNUni[i] = fVar[i]->numBins();
     }
 }
 
+//______________________________________________________________________________
+void FFRooFit::SetModel(FFRooModel* model)
+{
+    // Set the fit model to 'model'.
+
+    // delete combined constraints depending on the parameters of the old model
+    if (model != fModel && fConstrGauss)
+    {
+        delete fConstrGauss;
+        fConstrGauss = 0;
+        fConstrGaussSig = "";
+    }
+
+    fModel = model;
+}
+
 //______________________________________________________________________________
 void FFRooFit::AddAuxVariable(RooRealVar* aux_var)
 {
@@ -172,7 +278,12 @@ void FFRooFit::AddControlVariable(const Char_t* name, const Char_t* title)
 //______________________________________________________________________________
 void FFRooFit::AddConstraint(FFRooModel* c)
 {
-    // Add the model pdf 'c' as fit constraint.
+    // Add the model pdf 'c' as fit constraint. Constraints that were
+    // already added are ignored.
+
+    // check if constraint was already added
+    for (Int_t i = 0; i < fNConstr; i++)
+        if (fConstr[i] == c) return;
 
     // backup old array
     FFRooModel** old = fConstr;
@@ -229,6 +340,153 @@ Bool_t FFRooFit::CheckVariables() const
     return kTRUE;
 }
 
+//______________________________________________________________________________
+Bool_t FFRooFit::HasAdaptiveBinning() const
+{
+    // Return kTRUE if any fit variable uses adaptive binning.
+
+    for (Int_t i = 0; i < fNVar; i++)
+        if (fBinType[i] != kBinningUniform) return kTRUE;
+
+    return kFALSE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFit::ApplyAdaptiveBinning(RooAbsData* data)
+{
+    // Determine the adaptive binnings of the fit variables (see
+    // SetAdaptiveBinning()) from the data 'data' and set them as default
+    // binnings of the variables. The (weighted) distributions of all
+    // variables are sketched in fine histograms in a single pass over the
+    // data.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // check for adaptive binning
+    if (!HasAdaptiveBinning())
+        return kTRUE;
+
+    // create sketch histograms
+    Int_t* nFine = new Int_t[fNVar];
+    Double_t** fine = new Double_t*[fNVar];
+    for (Int_t i = 0; i < fNVar; i++)
+    {
+        if (fBinType[i] == kBinningQuantile)
+        {
+            Int_t nBins = fBinPar[i] > 0 ? (Int_t)fBinPar[i] : fBinNUni[i];
+            nFine[i] = TMath::Max(100*nBins, 10000);
+        }
+        else if (fBinType[i] == kBinningMinContent)
+        {
+            nFine[i] = fBinNUni[i];
+        }
+        else
+        {
+            nFine[i] = 0;
+        }
+        fine[i] = new Double_t[nFine[i]];
+        for (Int_t j = 0; j < nFine[i]; j++)
+            fine[i][j] = 0;
+    }
+
+    // fill sketch histograms in a single pass
+    const Int_t nEntries = data->numEntries();
+    for (Int_t i = 0; i < nEntries; i++)
+    {
+        const RooArgSet* row = data->get(i);
+        Double_t w = data->weight();
+        for (Int_t j = 0; j < fNVar; j++)
+        {
+            if (!nFine[j])
+                continue;
+            Double_t min = fVar[j]->getMin();
+            Double_t max = fVar[j]->getMax();
+            Double_t x = row->getRealValue(fVar[j]->GetName(), min - 1);
+            if (x < min || x >= max)
+                continue;
+            fine[j][TMath::Min((Int_t)((x - min) / (max - min) * nFine[j]), nFine[j]-1)] += w;
+        }
+    }
+
+    // determine bin edges
+    Bool_t res = kTRUE;
+    for (Int_t i = 0; i < fNVar; i++)
+    {
+        if (!nFine[i])
+            continue;
+
+        // total content
+        Double_t min = fVar[i]->getMin();
+        Double_t max = fVar[i]->getMax();
+        Double_t width = (max - min) / nFine[i];
+        Double_t tot = 0;
+        for (Int_t j = 0; j < nFine[i]; j++)
+            tot += fine[i][j];
+        if (tot <= 0)
+        {
+            Error("ApplyAdaptiveBinning", "No data found in the range of variable '%s'!", fVar[i]->GetName());
+            res = kFALSE;
+            continue;
+        }
+
+        // collect edges
+        std::vector<Double_t> edges;
+        edges.push_back(min);
+        if (fBinType[i] == kBinningQuantile)
+        {
+            // equal population (interpolated within fine bins)
+            Int_t nBins = fBinPar[i] > 0 ? (Int_t)fBinPar[i] : fBinNUni[i];
+            Double_t target = tot / nBins;
+            Double_t sum = 0;
+            Int_t k = 1;
+            for (Int_t j = 0; j < nFine[i] && k < nBins; j++)
+            {
+                while (k < nBins && fine[i][j] > 0 && sum + fine[i][j] >= k*target)
+                {
+                    Double_t e = min + width * (j + (k*target - sum) / fine[i][j]);
+                    if (e > edges.back() && e < max)
+                        edges.push_back(e);
+                    k++;
+                }
+                sum += fine[i][j];
+            }
+        }
+        else
+        {
+            // merge until minimum content is reached
+            Double_t sum = 0;
+            for (Int_t j = 0; j < nFine[i]-1; j++)
+            {
+                sum += fine[i][j];
+                if (sum >= fBinPar[i])
+                {
+                    edges.push_back(min + width * (j + 1));
+                    sum = 0;
+                }
+            }
+
+            // merge a last bin below the minimum content with the previous bin
+            if (sum + fine[i][nFine[i]-1] < fBinPar[i] && edges.size() > 1)
+                edges.pop_back();
+        }
+        edges.push_back(max);
+
+        // set binning
+        RooBinning binning(edges.size()-1, &edges[0]);
+        fVar[i]->setBinning(binning);
+        Info("ApplyAdaptiveBinning", "Variable '%s': %d %s bins",
+             fVar[i]->GetName(), (Int_t)edges.size()-1,
+             fBinType[i] == kBinningQuantile ? "equal-population" : "minimum-content");
+    }
+
+    // clean-up
+    for (Int_t i = 0; i < fNVar; i++)
+        delete [] fine[i];
+    delete [] fine;
+    delete [] nFine;
+
+    return res;
+}
+
 //______________________________________________________________________________
 Bool_t FFRooFit::CheckFitResult(RooFitResult* res, FFMinimizer_t minimizer,
                                 Bool_t verbose) const
@@ -369,6 +627,534 @@ RooCmdArg FFRooFit::CreateMinimizerArg(FFMinimizer_t min)
     }
 }
 
+//______________________________________________________________________________
+void FFRooFit::CollectConstraints(RooArgSet& set)
+{
+    // Collect the pdfs of all fit constraints, i.e. the constraints added
+    // to the model and the external constraints, without duplicates into
+    // 'set'. All Gaussian constraints with fixed mean and sigma are combined
+    // into a single multivariate Gaussian pdf (constraints on the same
+    // parameter are merged), which is only recreated if the constrained
+    // parameters or the constraint values change.
+
+    // collect constraints of the model and external constraints
+    TList constrList;
+    fModel->FindAllConstraints(&constrList);
+    for (Int_t i = 0; i < fNConstr; i++)
+        if (!constrList.FindObject(fConstr[i])) constrList.Add(fConstr[i]);
+
+    // collect Gaussian constraints
+    std::vector<RooAbsReal*> gVar;
+    std::vector<Double_t> gWMean;
+    std::vector<Double_t> gWeight;
+    std::vector<Int_t> gN;
+    std::vector<FFRooModel*> gConstr;
+    TIter next(&constrList);
+    while (FFRooModel* c = (FFRooModel*)next())
+    {
+        // check constraint pdf
+        if (!c->GetPdf())
+        {
+            Warning("CollectConstraints", "Ignoring constraint %s (pdf was not built)", c->GetName());
+            continue;
+        }
+
+        // non-Gaussian constraints
+        if (!c->InheritsFrom("FFRooModelGauss") || !((FFRooModelGauss*)c)->GetVariable() ||
+            !c->IsParConstant(0) || !c->IsParConstant(1) || c->GetParameter(1) <= 0)
+        {
+            Info("Fit", "Using fit constraint %s", c->GetName());
+            set.add(*c->GetPdf());
+            continue;
+        }
+
+        // merge Gaussian constraints on the same parameter (inverse-variance weighting)
+        RooAbsReal* var = ((FFRooModelGauss*)c)->GetVariable();
+        Double_t w = 1. / (c->GetParameter(1) * c->GetParameter(1));
+        UInt_t j = 0;
+        while (j < gVar.size() && gVar[j] != var)
+            j++;
+        if (j == gVar.size())
+        {
+            gVar.push_back(var);
+            gWMean.push_back(0);
+            gWeight.push_back(0);
+            gN.push_back(0);
+            gConstr.push_back(c);
+        }
+        gWMean[j] += w * c->GetParameter(0);
+        gWeight[j] += w;
+        gN[j]++;
+        Info("Fit", "Using fit constraint %s", c->GetName());
+    }
+
+    // single Gaussian constraint
+    const Int_t nG = gVar.size();
+    if (nG == 1 && gN[0] == 1)
+    {
+        set.add(*gConstr[0]->GetPdf());
+        return;
+    }
+    else if (nG == 0)
+        return;
+
+    // signature of combined Gaussian constraint
+    TString sig;
+    for (Int_t i = 0; i < nG; i++)
+        sig += TString::Format("%p:%.12g:%.12g;", gVar[i], gWMean[i], gWeight[i]);
+
+    // create combined Gaussian constraint
+    if (!fConstrGauss || sig != fConstrGaussSig)
+    {
+        RooArgList xList;
+        TVectorD mu(nG);
+        TMatrixDSym cov(nG);
+        for (Int_t i = 0; i < nG; i++)
+        {
+            xList.add(*gVar[i]);
+            mu(i) = gWMean[i] / gWeight[i];
+            for (Int_t j = 0; j < nG; j++)
+                cov(i, j) = i == j ? 1. / gWeight[i] : 0;
+        }
+        if (fConstrGauss)
+            delete fConstrGauss;
+        fConstrGauss = new RooMultiVarGaussian(TString::Format("%s_Constr_Gauss", GetName()).Data(),
+                                               TString::Format("Combined Gaussian constraints of %s", GetTitle()).Data(),
+                                               xList, mu, cov);
+        fConstrGaussSig = sig;
+    }
+
+    // user info
+    Info("Fit", "Combined %d Gaussian fit constraint(s) into %s", nG, fConstrGauss->GetName());
+
+    set.add(*fConstrGauss);
+}
+
+//______________________________________________________________________________
+void FFRooFit::EnableTrace(const Char_t* file)
+{
+    // Enable the recording of a trace of the next fits (see FFRooFitTrace).
+    // If 'file' is not empty, the trace is written to this file after each
+    // fit, either as ROOT trees (file ending with '.root') or as Chrome
+    // trace-event JSON (all other files).
+
+    // create trace
+    if (!fTrace)
+        fTrace = new FFRooFitTrace(TString::Format("%s_Trace", GetName()).Data(),
+                                   TString::Format("Trace of %s", GetTitle()).Data());
+
+    // set output file
+    fTraceFile = file;
+}
+
+//______________________________________________________________________________
+void FFRooFit::DisableTrace()
+{
+    // Disable the recording of the fit trace.
+
+    if (fTrace)
+    {
+        delete fTrace;
+        fTrace = 0;
+    }
+    fTraceFile = "";
+}
+
+//______________________________________________________________________________
+void FFRooFit::StartPhase(Int_t phase)
+{
+    // Start the timer of the fit phase 'phase' (see FFRooFitProfile::EFFPhase).
+    // A running phase is stopped before.
+
+    // trace span
+    if (fTrace)
+    {
+        if (fProfile->GetPhase() >= 0)
+            fTrace->StopSpan();
+        fTrace->StartSpan(FFRooFitProfile::GetPhaseName(phase));
+    }
+
+    fProfile->StartPhase((FFRooFitProfile::EFFPhase)phase);
+}
+
+//______________________________________________________________________________
+void FFRooFit::StopPhase()
+{
+    // Stop the timer of the running fit phase.
+
+    // trace span
+    if (fTrace && fProfile->GetPhase() >= 0)
+        fTrace->StopSpan();
+
+    fProfile->StopPhase();
+}
+
+//______________________________________________________________________________
+RooFitResult* FFRooFit::Minimize(RooAbsReal* fcn, FFMinimizer_t min,
+                                 Bool_t sumW2Error, Bool_t verbose)
+{
+    // Minimize the function 'fcn' using the minimizer 'min', calculate the
+    // covariance matrix using Hesse and return the fit result.
+    // If 'sumW2Error' is kTRUE, correct the covariance matrix for weighted
+    // data. If 'verbose' is kFALSE, all minimizer output is suppressed.
+    // The Migrad and Hesse phases are only timed outside of chi2 pre-fits.
+    // NOTE: the returned fit result has to be destroyed by the caller.
+
+    // check if phases should be timed
+    Bool_t timePhases = fProfile->GetPhase() != FFRooFitProfile::kChi2PreFit;
+
+    // wrap the function to monitor its evaluations
+    FFRooNLLMonitor mon(TString::Format("%s_Monitor", fcn->GetName()).Data(), fcn->GetTitle(),
+                        *fcn, fModel->GetPdf(), fData->get(), fProfile, fTrace);
+
+    // configure minimizer
+    RooMinimizer m(mon);
+    m.optimizeConst(2);
+    if (verbose)
+    {
+        m.setPrintEvalErrors(1);
+    }
+    else
+    {
+        m.setPrintEvalErrors(-1);
+        m.setPrintLevel(-1);
+        m.setVerbose(kFALSE);
+    }
+
+    // minimize
+    if (timePhases)
+        StartPhase(FFRooFitProfile::kMigrad);
+    RooCmdArg minArg = CreateMinimizerArg(min);
+    m.minimize(minArg.getString(0), minArg.getString(1));
+
+    // calculate covariance matrix
+    if (timePhases)
+        StartPhase(FFRooFitProfile::kHesse);
+    m.hesse();
+
+    // correct covariance matrix of weighted fits
+    if (sumW2Error)
+    {
+        // collect likelihood components
+        RooArgSet* comps = fcn->getComponents();
+        TIterator* iter = comps->createIterator();
+
+        // calculate covariance matrix with squared weights
+        RooFitResult* rw = m.save();
+        while (RooAbsArg* c = (RooAbsArg*)iter->Next())
+        {
+            if (c->InheritsFrom("RooNLLVar")) ((RooNLLVar*)c)->applyWeightSquared(kTRUE);
+            else if (c->InheritsFrom("FFRooBinnedNLL")) ((FFRooBinnedNLL*)c)->ApplyWeightSquared(kTRUE);
+            else if (c->InheritsFrom("FFRooUnbinnedNLL")) ((FFRooUnbinnedNLL*)c)->ApplyWeightSquared(kTRUE);
+        }
+        m.hesse();
+        RooFitResult* rw2 = m.save();
+        iter->Reset();
+        while (RooAbsArg* c = (RooAbsArg*)iter->Next())
+        {
+            if (c->InheritsFrom("RooNLLVar")) ((RooNLLVar*)c)->applyWeightSquared(kFALSE);
+            else if (c->InheritsFrom("FFRooBinnedNLL")) ((FFRooBinnedNLL*)c)->ApplyWeightSquared(kFALSE);
+            else if (c->InheritsFrom("FFRooUnbinnedNLL")) ((FFRooUnbinnedNLL*)c)->ApplyWeightSquared(kFALSE);
+        }
+
+        // apply correction matrix V C^-1 V
+        const TMatrixDSym& matV = rw->covarianceMatrix();
+        TMatrixDSym matC = rw2->covarianceMatrix();
+        Double_t det = 0;
+        matC.Invert(&det);
+        if (det == 0)
+        {
+            Error("Minimize", "Covariance matrix with squared weights is singular - "
+                              "no sum-of-weights-squared correction applied!");
+        }
+        else
+        {
+            matC.Similarity(matV);
+            m.applyCovarianceMatrix(matC);
+        }
+
+        // clean-up
+        delete rw;
+        delete rw2;
+        delete iter;
+        delete comps;
+    }
+
+    // stop timing
+    if (timePhases)
+        StopPhase();
+
+    return m.save(TString::Format("fitresult_%s", fcn->GetName()).Data(),
+                  TString::Format("Result of fit of %s", fcn->GetTitle()).Data());
+}
+
+//______________________________________________________________________________
+TString FFRooFit::GetModelFingerprint() const
+{
+    // Return a string identifying the structure of the fit model including
+    // the external constraints.
+
+    // check model
+    if (!fModel)
+        return "";
+
+    // model (including its constraints)
+    TString fp = fModel->GetFingerprint();
+
+    // external constraints not part of the model
+    TList modelConstr;
+    fModel->FindAllConstraints(&modelConstr);
+    for (Int_t i = 0; i < fNConstr; i++)
+    {
+        if (!modelConstr.FindObject(fConstr[i]))
+            fp += TString::Format("{%s}", fConstr[i]->GetFingerprint().Data());
+    }
+
+    return fp;
+}
+
+//______________________________________________________________________________
+TString FFRooFit::GetDataFingerprint()
+{
+    // Return a string identifying the fit data, i.e. the dataset type, the
+    // number of entries, the sum of weights, the variable binnings, the
+    // weighted means and variances of the fit variables, and the fit
+    // range. The moments are taken from the column statistics of the data
+    // (see UpdateColumnStats()), which are calculated anyway before the fit.
+
+    // check data
+    if (!fData || !UpdateColumnStats())
+        return "";
+
+    // dataset
+    TString fp = TString::Format("%s:%d:%.12g", fData->ClassName(),
+                                 fData->numEntries(), fData->sumEntries());
+
+    // fit variables
+    for (Int_t i = 0; i < fNVar; i++)
+    {
+        fp += TString::Format(";%s[%.12g,%.12g,%d]:%.10g:%.10g", fVar[i]->GetName(),
+                              fVar[i]->getMin(), fVar[i]->getMax(), fVar[i]->numBins(),
+                              fStats->GetMean(i), fStats->GetVariance(i));
+    }
+
+    // fit range
+    fp += TString::Format(";range[%.12g,%.12g]", fRangeMin, fRangeMax);
+
+    return fp;
+}
+
+//______________________________________________________________________________
+TString FFRooFit::GetCacheFile(const Char_t* modelKey, const Char_t* dataKey) const
+{
+    // Return the path of the fit-result cache file for the model key
+    // 'modelKey' and the data key 'dataKey'.
+
+    return TString::Format("%s/%s_%s.root", FFFooFit::GetCacheDirectory().Data(),
+                           modelKey, dataKey);
+}
+
+//______________________________________________________________________________
+FFRooFit::EFFCacheMatch FFRooFit::LoadCachedResult()
+{
+    // Look for a cached fit result of the current model and data in the
+    // fit-result cache (see FFFooFit::GetCacheDirectory()). If the model and
+    // the data match exactly, or if only the model matches (compatible fit),
+    // set the floating parameters and their errors to the cached values.
+    // Return the type of match found.
+
+    // calculate keys
+    TString modelFP = GetModelFingerprint();
+    TString dataFP = GetDataFingerprint();
+    TString modelKey = FFFooFit::MD5(modelFP.Data());
+    TString dataKey = FFFooFit::MD5(dataFP.Data());
+
+    // look for exact match
+    EFFCacheMatch match = kCacheNone;
+    TString file = GetCacheFile(modelKey.Data(), dataKey.Data());
+    if (FFFooFit::FileExists(file.Data()))
+    {
+        match = kCacheExact;
+    }
+    else
+    {
+        // look for the most recent cached fit of the same model
+        TSystemDirectory dir("cachedir", FFFooFit::GetCacheDirectory().Data());
+        TList* list = dir.GetListOfFiles();
+        if (list)
+        {
+            Long_t mtime = 0;
+            TIter next(list);
+            while (TSystemFile* f = (TSystemFile*)next())
+            {
+                TString str(f->GetName());
+                if (str.BeginsWith(modelKey + "_") && str.EndsWith(".root"))
+                {
+                    TString path = TString::Format("%s/%s", FFFooFit::GetCacheDirectory().Data(), f->GetName());
+                    FileStat_t stat;
+                    if (!gSystem->GetPathInfo(path.Data(), stat) && stat.fMtime >= mtime)
+                    {
+                        mtime = stat.fMtime;
+                        file = path;
+                        match = kCacheCompatible;
+                    }
+                }
+            }
+            delete list;
+        }
+    }
+
+    // no cached fit result found
+    if (match == kCacheNone)
+    {
+        Info("LoadCachedResult", "No cached fit result found");
+        return kCacheNone;
+    }
+
+    // open the cache file
+    TFile* f = TFile::Open(file.Data());
+    if (!f || f->IsZombie())
+    {
+        Warning("LoadCachedResult", "Could not open cache file '%s'!", file.Data());
+        if (f) delete f;
+        return kCacheNone;
+    }
+
+    // read fit result and check model fingerprint against hash collisions
+    RooFitResult* res = (RooFitResult*)f->Get("fitresult");
+    TNamed* fp = (TNamed*)f->Get("fingerprint");
+    if (!res || !fp || modelFP != fp->GetName())
+    {
+        Warning("LoadCachedResult", "Invalid cache file '%s'!", file.Data());
+        if (res) delete res;
+        if (fp) delete fp;
+        delete f;
+        return kCacheNone;
+    }
+    if (match == kCacheExact && dataFP != fp->GetTitle())
+        match = kCacheCompatible;
+
+    // set floating parameters to cached values
+    RooArgSet* params = fModel->GetPdf()->getParameters(*fData);
+    const RooArgList& cached = res->floatParsFinal();
+    Int_t nSet = 0;
+    for (Int_t i = 0; i < cached.getSize(); i++)
+    {
+        RooRealVar* c = (RooRealVar*)cached.at(i);
+        RooRealVar* p = (RooRealVar*)params->find(c->GetName());
+        if (p && !p->isConstant())
+        {
+            p->setVal(TMath::Min(TMath::Max(c->getVal(), p->getMin()), p->getMax()));
+            p->setError(c->getError());
+            nSet++;
+        }
+    }
+
+    // user info
+    Info("LoadCachedResult", "Found %s cached fit result in '%s'",
+         match == kCacheExact ? "exact" : "compatible", file.Data());
+    Info("LoadCachedResult", "Warm start of %d parameter(s) at cached minimum (NLL = %e)",
+         nSet, res->minNll());
+
+    // clean-up
+    delete params;
+    delete res;
+    delete fp;
+    delete f;
+
+    return match;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFit::SaveCachedResult()
+{
+    // Save the result of the last fit to the fit-result cache.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // check fit result
+    if (!fResult)
+        return kFALSE;
+
+    // calculate keys
+    TString modelFP = GetModelFingerprint();
+    TString dataFP = GetDataFingerprint();
+    TString dir = FFFooFit::GetCacheDirectory();
+    TString file = GetCacheFile(FFFooFit::MD5(modelFP.Data()).Data(),
+                                FFFooFit::MD5(dataFP.Data()).Data());
+
+    // create cache directory
+    if (!FFFooFit::FileExists(dir.Data()) && gSystem->mkdir(dir.Data(), kTRUE))
+    {
+        Warning("SaveCachedResult", "Could not create cache directory '%s'!", dir.Data());
+        return kFALSE;
+    }
+
+    // write to temporary file
+    TString tmp = TString::Format("%s.%d.tmp", file.Data(), gSystem->GetPid());
+    TFile* f = new TFile(tmp.Data(), "RECREATE");
+    if (!f || f->IsZombie())
+    {
+        Warning("SaveCachedResult", "Could not create cache file '%s'!", tmp.Data());
+        if (f) delete f;
+        return kFALSE;
+    }
+    TNamed fp(modelFP.Data(), dataFP.Data());
+    fp.Write("fingerprint");
+    fResult->Write("fitresult");
+    delete f;
+
+    // move to final location (atomic w.r.t. concurrent fits)
+    if (gSystem->Rename(tmp.Data(), file.Data()))
+    {
+        Warning("SaveCachedResult", "Could not write cache file '%s'!", file.Data());
+        gSystem->Unlink(tmp.Data());
+        return kFALSE;
+    }
+
+    // user info
+    Info("SaveCachedResult", "Fit result cached in '%s'", file.Data());
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFit::UpdateColumnStats()
+{
+    // Calculate the statistics of the fit variables and of the auxiliary
+    // and control variables contained in the dataset in a single pass over
+    // the data. Cached statistics of the current dataset are reused.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // check data
+    if (!fData)
+    {
+        Error("UpdateColumnStats", "No data found!");
+        return kFALSE;
+    }
+
+    // check for cached statistics
+    Bool_t cached = fStats && fStats->IsCached(fData);
+    for (Int_t i = 0; i < fNVar && cached; i++)
+        if (fStats->GetColumnIndex(fVar[i]->GetName()) != i) cached = kFALSE;
+    for (Int_t i = 0; i < fNVarAux && cached; i++)
+        if (fData->get()->find(fVarAux[i]->GetName()) &&
+            fStats->GetColumnIndex(fVarAux[i]->GetName()) == -1) cached = kFALSE;
+    if (cached)
+        return kTRUE;
+
+    // set columns (fit variables first)
+    delete fStats;
+    fStats = new FFColumnStats(TString::Format("%s_Stats", GetName()).Data(),
+                               TString::Format("Column statistics of %s", GetTitle()).Data());
+    for (Int_t i = 0; i < fNVar; i++)
+        fStats->AddColumn(fVar[i]->GetName());
+    for (Int_t i = 0; i < fNVarAux; i++)
+        if (fData->get()->find(fVarAux[i]->GetName())) fStats->AddColumn(fVarAux[i]->GetName());
+
+    // calculate statistics
+    return fStats->Fill(fData, FFFooFit::gUseNCPU);
+}
+
 //______________________________________________________________________________
 Bool_t FFRooFit::PrepareFit()
 {
@@ -378,6 +1164,17 @@ Bool_t FFRooFit::PrepareFit()
     Char_t ws[256];
     Int_t maxLen;
 
+    //
+    // calculate the statistics of fit, auxiliary and control variables
+    // (single pass over the data, reused if cached)
+    //
+
+    if (!UpdateColumnStats())
+    {
+        Error("PrepareFit", "Could not calculate the statistics of the data columns!");
+        return kFALSE;
+    }
+
     //
     // adjust range of fit variables
     //
@@ -387,7 +1184,8 @@ Bool_t FFRooFit::PrepareFit()
     for (Int_t i = 0; i < fNVar; i++)
     {
         // get range of data set
-        fData->getRange(*fVar[i], min, max);
+        min = fStats->GetMinimum(i);
+        max = fStats->GetMaximum(i);
 
         // round to next integer
         min = TMath::Floor(min);
@@ -437,7 +1235,7 @@ Bool_t FFRooFit::PrepareFit()
                     printf("    Fit variable '%s'\n", fVar[i]->GetTitle());
 
                 // calculate correlation
-                Double_t corr = fData->correlation(*fVar[i], *fVar[j]);
+                Double_t corr = fStats->GetCorrelation(i, j);
 
                 // format and print
                 Int_t l = 0;
@@ -480,7 +1278,7 @@ Bool_t FFRooFit::PrepareFit()
             for (Int_t j = 0; j < fNVarCtrl; j++)
             {
                 // calculate correlation
-                Double_t corr = fData->correlation(*fVar[i], *fVarCtrl[j]);
+                Double_t corr = fStats->GetCorrelation(i, fStats->GetColumnIndex(fVarCtrl[j]->GetName()));
 
                 // format and print
                 Int_t l = 0;
@@ -551,19 +1349,16 @@ Bool_t FFRooFit::Chi2PreFit()
     Info("Chi2PreFit", "Performing %d binned chi2 pre-fit(s) to find "
                        "optimal %d fit parameters", fNChi2PreFit, nPar);
 
-    // configure fit
-    RooLinkedList fitArgs;
-    fitArgs.Add(new RooCmdArg(RooFit::Extended()));
-    fitArgs.Add(new RooCmdArg(RooFit::Save()));
-    fitArgs.Add(new RooCmdArg(RooFit::Verbose(kFALSE)));
-    fitArgs.Add(new RooCmdArg(RooFit::PrintLevel(-1)));
-    fitArgs.Add(new RooCmdArg(RooFit::Warnings(kFALSE)));
-    fitArgs.Add(new RooCmdArg(RooFit::PrintEvalErrors(-1)));
-    fitArgs.Add(new RooCmdArg(CreateMinimizerArg(fMinimizerPreFit)));
+    // configure chi2
+    RooLinkedList chi2Args;
+    chi2Args.Add(new RooCmdArg(RooFit::Extended()));
     if (FFFooFit::gUseNCPU > 1)
-        fitArgs.Add(new RooCmdArg(RooFit::NumCPU(FFFooFit::gUseNCPU, FFFooFit::gParStrat)));
+        chi2Args.Add(new RooCmdArg(RooFit::NumCPU(FFFooFit::gUseNCPU, FFFooFit::gParStrat)));
     if (fRangeMin != 0 || fRangeMax != 0)
-        fitArgs.Add(new RooCmdArg(RooFit::Range(fRangeMin, fRangeMax)));
+        chi2Args.Add(new RooCmdArg(RooFit::Range(fRangeMin, fRangeMax)));
+
+    // create the chi2 function
+    RooAbsReal* chi2 = fModel->GetPdf()->createChi2(*dataBinned, chi2Args);
 
     // perform a number of chi2 fits with random initial parameter values
     Int_t nFailed = 0;
@@ -579,7 +1374,11 @@ Bool_t FFRooFit::Chi2PreFit()
         }
 
         // perform chi2 fit
-        RooFitResult* fit_res = fModel->GetPdf()->chi2FitTo(*dataBinned, fitArgs);
+        if (fTrace)
+            fTrace->StartSpan(TString::Format("Chi2PreFit %d", i+1).Data());
+        RooFitResult* fit_res = Minimize(chi2, fMinimizerPreFit, kFALSE, kFALSE);
+        if (fTrace)
+            fTrace->StopSpan();
 
         // check fit result and repeat fit if it failed
         Bool_t fit_res_ok = CheckFitResult(fit_res, fMinimizerPreFit, kFALSE);
@@ -591,12 +1390,12 @@ Bool_t FFRooFit::Chi2PreFit()
             continue;
         }
 
-        // calculate chi2
-        RooChi2Var chi2("prefit-chi2", "prefit-chi2", *fModel->GetPdf(), *dataBinned, RooFit::Extended());
+        // get chi2
+        Double_t chi2Val = chi2->getVal();
 
         // print fit result
         printf("\n");
-        printf("  Chi2 pre-fit %d    chi2 = %e\n\n", i+1, chi2.getVal());
+        printf("  Chi2 pre-fit %d    chi2 = %e\n\n", i+1, chi2Val);
         printf("  PARAMETER                          VALUE          ERROR\n");
         printf("  --------------------------------------------------------------\n");
         iter->Reset();
@@ -605,9 +1404,9 @@ Bool_t FFRooFit::Chi2PreFit()
         printf("\n");
 
         // save best fit
-        if (i == 0 || chi2.getVal() < bestChi2)
+        if (i == 0 || chi2Val < bestChi2)
         {
-            bestChi2 = chi2.getVal();
+            bestChi2 = chi2Val;
             bestFit = i;
             Int_t n = 0;
             iter->Reset();
@@ -636,7 +1435,8 @@ Bool_t FFRooFit::Chi2PreFit()
     Info("Chi2PreFit", "End of binned chi2 pre-fit(s)");
 
     // clean-up
-    fitArgs.Delete();
+    delete chi2;
+    chi2Args.Delete();
     delete iter;
     delete params;
     delete dataBinned;
@@ -652,14 +1452,71 @@ Bool_t FFRooFit::Fit(const Char_t* opt)
     // Options to be set via 'opt':
     // 'bchi2'      : perform a binned chi2 fit
     // 'nosumw2err' : set SumW2Error(kFALSE) for weighted fits
+    // 'roonll'     : use the RooFit likelihood instead of the native binned
+    //                likelihood (see FFRooBinnedNLL) for binned fits and the
+    //                native unbinned likelihood (see FFRooUnbinnedNLL) for
+    //                unbinned fits
+    // 'bblite'     : include the statistical uncertainties of histogram
+    //                templates via Barlow-Beeston-lite in the native binned
+    //                likelihood (see FFRooBinnedNLL)
+    // 'nosolve'    : do not solve yield-only native likelihoods directly
+    //                before the minimization (see
+    //                FFRooBinnedNLL::SolveYields() and
+    //                FFRooUnbinnedNLL::SolveYields())
+    // 'profile'    : print the fit profile (timings and counters) after the fit
+    // 'cache'      : warm start from a cached fit result of the same model
+    //                (skipping the chi2 pre-fits) and cache the result
+    //                (see FFFooFit::GetCacheDirectory())
+    //
+    // The timings and counters of the fit can be accessed via GetProfile().
+    // If enabled via EnableTrace(), the trace of the fit can be accessed via
+    // GetTrace().
     //
     // Return kTRUE on success, otherwise kFALSE.
 
+    // start profiling
+    fProfile->Reset();
+    fProfile->Start();
+    if (fTrace)
+    {
+        fTrace->Reset();
+        fTrace->StartSpan("Fit");
+    }
+
+    // perform the fit
+    Bool_t res = PerformFit(opt);
+
+    // stop profiling
+    fProfile->Stop();
+    if (FFFooFit::IndexOf(opt, "profile") != -1)
+        fProfile->Print();
+
+    // stop tracing
+    if (fTrace)
+    {
+        fTrace->StopAllSpans();
+        if (fTraceFile != "")
+        {
+            if (fTrace->Save(fTraceFile.Data()))
+                Info("Fit", "Fit trace written to '%s'", fTraceFile.Data());
+        }
+    }
+
+    return res;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFit::PerformFit(const Char_t* opt)
+{
+    // Perform all steps of the fit (see Fit() for the options 'opt').
+    // Return kTRUE on success, otherwise kFALSE.
+
     // check fit variables
     if (!CheckVariables())
         return kFALSE;
 
     // try to load the data
+    StartPhase(FFRooFitProfile::kLoadData);
     if (!LoadData())
     {
         Error("Fit", "An error occurred during data loading!");
@@ -687,6 +1544,7 @@ Bool_t FFRooFit::Fit(const Char_t* opt)
     }
 
     // do various things before fitting
+    StartPhase(FFRooFitProfile::kPrepareFit);
     if (!PrepareFit())
     {
         Error("Fit", "An error occurred while preparing the fit routine!");
@@ -701,21 +1559,34 @@ Bool_t FFRooFit::Fit(const Char_t* opt)
     }
 
     // build the model
+    StartPhase(FFRooFitProfile::kBuildModel);
     Info("Fit", "Building the model pdf");
-    fModel->BuildModel(fVar, fNVar);
+    if (!fModel->BuildModel(fVar, fNVar))
+        Info("Fit", "Model pdf unchanged since last build - reusing it");
+    StopPhase();
 
     // user info
     Info("Fit", "Fitting using %d CPU(s) (Parallelization strategy: %d)",
          FFFooFit::gUseNCPU, FFFooFit::gParStrat);
 
-    // perform chi2 pre-fits
-    if (fNChi2PreFit > 0)
+    // look for a cached fit result
+    Bool_t useCache = FFFooFit::IndexOf(opt, "cache") != -1;
+    EFFCacheMatch cacheMatch = useCache ? LoadCachedResult() : kCacheNone;
+
+    // perform chi2 pre-fits (not needed when starting from the result of the same data)
+    if (fNChi2PreFit > 0 && cacheMatch == kCacheExact)
+    {
+        Info("Fit", "Skipping chi2 pre-fit(s) - warm start from exactly matching cached fit result");
+    }
+    else if (fNChi2PreFit > 0)
     {
+        StartPhase(FFRooFitProfile::kChi2PreFit);
         if (!Chi2PreFit())
         {
             Error("Fit", "An error occurred in the chi2 pre-fit routine!");
             return kFALSE;
         }
+        StopPhase();
     }
 
     // delete old fit result
@@ -738,69 +1609,118 @@ Bool_t FFRooFit::Fit(const Char_t* opt)
                                                   varSet,
                                                   *fData);
 
-        // configure fit
-        RooLinkedList fitArgs;
-        fitArgs.Add(new RooCmdArg(RooFit::Extended()));
-        fitArgs.Add(new RooCmdArg(RooFit::Save()));
-        fitArgs.Add(new RooCmdArg(RooFit::PrintEvalErrors(1)));
-        fitArgs.Add(new RooCmdArg(CreateMinimizerArg(fMinimizer)));
+        // configure chi2
+        RooLinkedList chi2Args;
+        chi2Args.Add(new RooCmdArg(RooFit::Extended()));
         if (FFFooFit::gUseNCPU > 1)
-            fitArgs.Add(new RooCmdArg(RooFit::NumCPU(FFFooFit::gUseNCPU, FFFooFit::gParStrat)));
+            chi2Args.Add(new RooCmdArg(RooFit::NumCPU(FFFooFit::gUseNCPU, FFFooFit::gParStrat)));
         if (fRangeMin != 0 || fRangeMax != 0)
-            fitArgs.Add(new RooCmdArg(RooFit::Range(fRangeMin, fRangeMax)));
+            chi2Args.Add(new RooCmdArg(RooFit::Range(fRangeMin, fRangeMax)));
 
         // perform binned chi2 fit
-        fResult = fModel->GetPdf()->chi2FitTo(*dataBinned, fitArgs);
+        RooAbsReal* chi2 = fModel->GetPdf()->createChi2(*dataBinned, chi2Args);
+        fResult = Minimize(chi2, fMinimizer);
 
         // clean-up
-        fitArgs.Delete();
+        delete chi2;
+        chi2Args.Delete();
         delete dataBinned;
     }
     else
     {
         Info("Fit", "Performing maximum likelihood fit");
 
-        // look for additional constraints in the model
-        TList* constrList = new TList();
-        fModel->FindAllConstraints(constrList);
-        TIter next(constrList);
-        while (FFRooModel* c = (FFRooModel*)next())
-            AddConstraint(c);
-        delete constrList;
-
-        // create argument set of constraints
+        // collect the constraints of the model and the external constraints
         RooArgSet constrSet;
-        for (Int_t i = 0; i < fNConstr; i++)
-        {
-            Info("Fit", "Using fit constraint %s", fConstr[i]->GetName());
-            constrSet.add(*fConstr[i]->GetPdf());
-        }
-
-        // configure fit
-        RooLinkedList fitArgs;
-        fitArgs.Add(new RooCmdArg(RooFit::Extended()));
-        fitArgs.Add(new RooCmdArg(RooFit::Save()));
-        fitArgs.Add(new RooCmdArg(RooFit::PrintEvalErrors(1)));
-        fitArgs.Add(new RooCmdArg(CreateMinimizerArg(fMinimizer)));
-        if (fNConstr)
-            fitArgs.Add(new RooCmdArg(RooFit::ExternalConstraints(constrSet)));
+        CollectConstraints(constrSet);
+
+        // check if the native binned or unbinned likelihood can be used
+        Bool_t nativeNLL = FFFooFit::IndexOf(opt, "roonll") == -1 &&
+                           fRangeMin == 0 && fRangeMax == 0;
+        Bool_t binnedNLL = nativeNLL && FFRooBinnedNLL::IsApplicable(fModel, fData);
+        Bool_t unbinnedNLL = nativeNLL && FFRooUnbinnedNLL::IsApplicable(fModel, fData) &&
+                             FFRooUnbinnedNLL::HasCachedComponent(fModel, fData);
+
+        // configure likelihood
+        RooLinkedList nllArgs;
+        nllArgs.Add(new RooCmdArg(RooFit::Extended()));
+        if (constrSet.getSize())
+            nllArgs.Add(new RooCmdArg(RooFit::ExternalConstraints(constrSet)));
         if (FFFooFit::gUseNCPU > 1)
-            fitArgs.Add(new RooCmdArg(RooFit::NumCPU(FFFooFit::gUseNCPU, FFFooFit::gParStrat)));
-        if (fData->isWeighted())
-        {
-            if (FFFooFit::IndexOf(opt, "nosumw2err") != -1)
-                fitArgs.Add(new RooCmdArg(RooFit::SumW2Error(kFALSE)));
-            else
-                fitArgs.Add(new RooCmdArg(RooFit::SumW2Error(kTRUE)));
-        }
+            nllArgs.Add(new RooCmdArg(RooFit::NumCPU(FFFooFit::gUseNCPU, FFFooFit::gParStrat)));
         if (fRangeMin != 0 || fRangeMax != 0)
-            fitArgs.Add(new RooCmdArg(RooFit::Range(fRangeMin, fRangeMax)));
+            nllArgs.Add(new RooCmdArg(RooFit::Range(fRangeMin, fRangeMax)));
+
+        // correct errors of weighted fits
+        Bool_t sumW2Error = fData->isWeighted() && FFFooFit::IndexOf(opt, "nosumw2err") == -1;
 
         // perform maximum likelihood fit
-        fResult = fModel->GetPdf()->fitTo(*fData, fitArgs);
+        RooAbsReal* nll;
+        if (binnedNLL)
+        {
+            Info("Fit", "Using native binned Poisson likelihood");
+            nll = new FFRooBinnedNLL(TString::Format("nll_%s", fModel->GetName()).Data(),
+                                     TString::Format("Binned likelihood of %s", fModel->GetTitle()).Data(),
+                                     (FFRooModelSum*)fModel, *((RooDataHist*)fData), fVar, fNVar, constrSet,
+                                     FFFooFit::IndexOf(opt, "bblite") != -1);
+            FFRooBinnedNLL* bnll = (FFRooBinnedNLL*)nll;
+            if (bnll->IsBBLite())
+            {
+                Info("Fit", "Number of bins: %d", bnll->GetNBin());
+                Info("Fit", "Components with Barlow-Beeston-lite template uncertainties: %d/%d",
+                     bnll->GetNCompBBLite(), bnll->GetNComp());
+            }
+            else
+            {
+                Info("Fit", "Number of non-empty bins: %d", bnll->GetNBin());
+            }
+            Info("Fit", "Components integrated exactly over bins: %d/%d",
+                 bnll->GetNCompCDF(), bnll->GetNComp());
+            if (FFFooFit::gUseNCPU > 1)
+                Info("Fit", "Native likelihood is evaluated using 1 CPU");
+
+            // solve yield-only likelihood directly (minimizer starts at the solution)
+            if (FFFooFit::IndexOf(opt, "nosolve") == -1 && bnll->IsYieldOnly())
+            {
+                if (bnll->SolveYields())
+                    Info("Fit", "Yields solved after %d Newton iterations (EDM: %e)",
+                         bnll->GetNSolverIter(), bnll->GetSolverEDM());
+                else
+                    Warning("Fit", "Yield solver failed (ill-conditioned templates) - using the minimizer only");
+            }
+        }
+        else if (unbinnedNLL)
+        {
+            Info("Fit", "Using native unbinned likelihood");
+            nll = new FFRooUnbinnedNLL(TString::Format("nll_%s", fModel->GetName()).Data(),
+                                       TString::Format("Unbinned likelihood of %s", fModel->GetTitle()).Data(),
+                                       (FFRooModelSum*)fModel, *((RooDataSet*)fData), fVar, fNVar, constrSet);
+            Info("Fit", "Number of events: %lld", ((FFRooUnbinnedNLL*)nll)->GetNEvent());
+            Info("Fit", "Components with cached event densities: %d/%d",
+                 ((FFRooUnbinnedNLL*)nll)->GetNCompCached(), ((FFRooUnbinnedNLL*)nll)->GetNComp());
+            if (FFFooFit::gUseNCPU > 1)
+                Info("Fit", "Native likelihood is evaluated using 1 CPU");
+
+            // solve yield-only likelihood directly (minimizer starts at the solution)
+            FFRooUnbinnedNLL* unll = (FFRooUnbinnedNLL*)nll;
+            if (FFFooFit::IndexOf(opt, "nosolve") == -1 && unll->IsYieldOnly())
+            {
+                if (unll->SolveYields())
+                    Info("Fit", "Yields solved after %d Newton iterations (EDM: %e)",
+                         unll->GetNSolverIter(), unll->GetSolverEDM());
+                else
+                    Warning("Fit", "Yield solver failed (ill-conditioned densities) - using the minimizer only");
+            }
+        }
+        else
+        {
+            nll = fModel->GetPdf()->createNLL(*fData, nllArgs);
+        }
+        fResult = Minimize(nll, fMinimizer, sumW2Error);
 
         // clean-up
-        fitArgs.Delete();
+        delete nll;
+        nllArgs.Delete();
     }
 
     // show fit result
@@ -810,12 +1730,18 @@ Bool_t FFRooFit::Fit(const Char_t* opt)
     if (!CheckFitResult(fResult, fMinimizer))
         return kFALSE;
 
+    // cache fit result
+    if (useCache)
+        SaveCachedResult();
+
     // do various things after fitting
+    StartPhase(FFRooFitProfile::kPostFit);
     if (!PostFit())
     {
         Error("Fit", "An error occurred during the post-fit routine!");
         return kFALSE;
     }
+    StopPhase();
 
     return kTRUE;
 }
@@ -886,7 +1812,8 @@ RooPlot* FFRooFit::PlotDataAndModel(Int_t var, const Char_t* opt)
 
             // check if pdf has to contain the variable exclusively - if yes, skip component
             Bool_t drawVarExcl = kTRUE;
-            if (comp->InheritsFrom("RooHistPdf") || comp->InheritsFrom("RooNDKeysPdf"))
+            if (comp->InheritsFrom("RooHistPdf") || comp->InheritsFrom("FFRooTemplatePdf") ||
+                comp->InheritsFrom("RooNDKeysPdf") || comp->InheritsFrom("FFRooIndexedKeysPdf"))
                 drawVarExcl = kFALSE;
             if (!ContainsVariable(comp, var, drawVarExcl))
                 continue;
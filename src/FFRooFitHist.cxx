@@ -49,6 +49,10 @@ Bool_t FFRooFitHist::LoadData()
         return kFALSE;
     }
 
+    // adaptive binning is not supported
+    if (HasAdaptiveBinning())
+        Warning("LoadData", "Adaptive binning is not supported for histogram data - using histogram binning");
+
     // create argument set of variables and auxiliary variables
     RooArgSet varSet;
     for (Int_t i = 0; i < fNVar; i++)
@@ -0,0 +1,209 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooFitProfile                                                      //
+//                                                                      //
+// Class collecting phase timings and evaluation counters of a fit.     //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <chrono>
+#include <fstream>
+
+#include "FFRooFitProfile.h"
+#include "FFFooFit.h"
+
+ClassImp(FFRooFitProfile)
+
+// init static class members
+const Char_t* FFRooFitProfile::fgPhaseName[FFRooFitProfile::kNPhase] =
+    { "LoadData", "PrepareFit", "BuildModel", "Chi2PreFit", "Migrad", "Hesse", "PostFit" };
+const Char_t* FFRooFitProfile::fgCounterName[FFRooFitProfile::kNCounter] =
+    { "NLLEval", "NormIntegralEst", "FFTConvolEst", "CacheHitEst" };
+
+//______________________________________________________________________________
+FFRooFitProfile::FFRooFitProfile(const Char_t* name, const Char_t* title)
+    : TNamed(name, title)
+{
+    // Constructor.
+
+    // init members
+    Reset();
+}
+
+//______________________________________________________________________________
+Double_t FFRooFitProfile::Now()
+{
+    // Return the time of a monotonic high-resolution clock in seconds.
+
+    return std::chrono::duration<Double_t>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//______________________________________________________________________________
+const Char_t* FFRooFitProfile::GetPhaseName(Int_t p)
+{
+    // Return the name of the phase 'p'.
+
+    if (p >= 0 && p < kNPhase)
+        return fgPhaseName[p];
+    else
+        return "None";
+}
+
+//______________________________________________________________________________
+const Char_t* FFRooFitProfile::GetCounterName(Int_t c)
+{
+    // Return the name of the counter 'c'.
+
+    if (c >= 0 && c < kNCounter)
+        return fgCounterName[c];
+    else
+        return "None";
+}
+
+//______________________________________________________________________________
+Double_t FFRooFitProfile::GetTotalTime() const
+{
+    // Return the total wall time in seconds including a running total timer.
+
+    if (fTotalStart >= 0)
+        return fTotalTime + Now() - fTotalStart;
+    else
+        return fTotalTime;
+}
+
+//______________________________________________________________________________
+void FFRooFitProfile::Reset()
+{
+    // Reset all timers and counters.
+
+    for (Int_t i = 0; i < kNPhase; i++)
+    {
+        fPhaseTime[i] = 0;
+        fPhaseCalls[i] = 0;
+    }
+    for (Int_t i = 0; i < kNCounter; i++)
+        fCounter[i] = 0;
+    fPhase = -1;
+    fPhaseStart = 0;
+    fTotalTime = 0;
+    fTotalStart = -1;
+}
+
+//______________________________________________________________________________
+void FFRooFitProfile::Start()
+{
+    // Start the total timer.
+
+    if (fTotalStart < 0)
+        fTotalStart = Now();
+}
+
+//______________________________________________________________________________
+void FFRooFitProfile::Stop()
+{
+    // Stop the running phase and the total timer.
+
+    StopPhase();
+    if (fTotalStart >= 0)
+    {
+        fTotalTime += Now() - fTotalStart;
+        fTotalStart = -1;
+    }
+}
+
+//______________________________________________________________________________
+void FFRooFitProfile::StartPhase(EFFPhase p)
+{
+    // Start the timer of the phase 'p'. A running phase is stopped before.
+
+    StopPhase();
+    fPhase = p;
+    fPhaseCalls[p]++;
+    fPhaseStart = Now();
+}
+
+//______________________________________________________________________________
+void FFRooFitProfile::StopPhase()
+{
+    // Stop the timer of the running phase.
+
+    if (fPhase >= 0)
+    {
+        fPhaseTime[fPhase] += Now() - fPhaseStart;
+        fPhase = -1;
+    }
+}
+
+//______________________________________________________________________________
+TString FFRooFitProfile::GetSummary() const
+{
+    // Return a machine-readable summary (JSON) of all timers and counters.
+
+    TString out = TString::Format("{\"name\": \"%s\", \"total_time\": %.6e, \"phases\": {",
+                                  FFFooFit::EscapeJSON(GetName()).Data(), GetTotalTime());
+    for (Int_t i = 0; i < kNPhase; i++)
+    {
+        out += TString::Format("\"%s\": {\"time\": %.6e, \"calls\": %d}",
+                               fgPhaseName[i], fPhaseTime[i], fPhaseCalls[i]);
+        if (i != kNPhase-1)
+            out += ", ";
+    }
+    out += "}, \"counters\": {";
+    for (Int_t i = 0; i < kNCounter; i++)
+    {
+        out += TString::Format("\"%s\": %lld", fgCounterName[i], fCounter[i]);
+        if (i != kNCounter-1)
+            out += ", ";
+    }
+    out += "}}";
+
+    return out;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFitProfile::WriteSummary(const Char_t* file) const
+{
+    // Write the machine-readable summary to the file 'file'.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // open file
+    std::ofstream out(file);
+    if (!out.good())
+    {
+        Error("WriteSummary", "Could not open file '%s'!", file);
+        return kFALSE;
+    }
+
+    // write summary
+    out << GetSummary().Data() << std::endl;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+void FFRooFitProfile::Print(Option_t* option) const
+{
+    // Print out the content of this class.
+
+    Double_t total = GetTotalTime();
+
+    printf("%sFFRooFitProfile content:\n", option);
+    printf("%sName                       : %s\n", option, GetName());
+    printf("%sTotal time                 : %.3f s\n", option, total);
+    printf("%sPhases\n", option);
+    for (Int_t i = 0; i < kNPhase; i++)
+    {
+        printf("%s  %-12s: %12.3f s  %6.2f %%  (%d call(s))\n",
+               option, fgPhaseName[i], fPhaseTime[i],
+               total > 0 ? 100.*fPhaseTime[i]/total : 0., fPhaseCalls[i]);
+    }
+    printf("%sCounters\n", option);
+    for (Int_t i = 0; i < kNCounter; i++)
+        printf("%s  %-16s: %12lld\n", option, fgCounterName[i], fCounter[i]);
+}
+
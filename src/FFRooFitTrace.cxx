@@ -0,0 +1,330 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooFitTrace                                                        //
+//                                                                      //
+// Class recording a trace of a fit (spans and minimized function       //
+// calls) exportable as Chrome trace-event JSON or ROOT tree.           //
+//                                                                      //
+// The JSON output can be loaded into chrome://tracing or Perfetto      //
+// (https://ui.perfetto.dev).                                           //
+//                                                                      //
+// NOTE: when fitting with several CPUs (FFFooFit::gUseNCPU), RooFit    //
+// evaluates the likelihood in forked worker processes. Only the master //
+// process is traced, i.e. the recorded call durations include the time //
+// waiting for the workers.                                             //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <fstream>
+#include <thread>
+#include <functional>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TMath.h"
+#include "TSystem.h"
+
+#include "FFRooFitTrace.h"
+#include "FFRooFitProfile.h"
+#include "FFFooFit.h"
+
+ClassImp(FFRooFitTrace)
+
+//______________________________________________________________________________
+FFRooFitTrace::FFRooFitTrace(const Char_t* name, const Char_t* title)
+    : TNamed(name, title)
+{
+    // Constructor.
+
+    // init members
+    Reset();
+}
+
+//______________________________________________________________________________
+ULong64_t FFRooFitTrace::GetThreadID()
+{
+    // Return an identifier of the calling thread.
+
+    return std::hash<std::thread::id>()(std::this_thread::get_id());
+}
+
+//______________________________________________________________________________
+TString FFRooFitTrace::FormatNumber(Double_t v)
+{
+    // Format the number 'v' for JSON output (non-finite numbers as null).
+
+    if (TMath::Finite(v))
+        return TString::Format("%.10g", v);
+    else
+        return "null";
+}
+
+//______________________________________________________________________________
+void FFRooFitTrace::Reset()
+{
+    // Clear all recorded spans and calls and restart the trace clock.
+
+    fStart = FFRooFitProfile::Now();
+    fPid = gSystem->GetPid();
+    fSpanOpen.clear();
+    fSpanName.clear();
+    fSpanThread.clear();
+    fSpanStart.clear();
+    fSpanEnd.clear();
+    fFcnName.clear();
+    fFcnPar.clear();
+    fCallFcn.clear();
+    fCallPhase.clear();
+    fCallThread.clear();
+    fCallStart.clear();
+    fCallDur.clear();
+    fCallVal.clear();
+    fCallPar.clear();
+}
+
+//______________________________________________________________________________
+void FFRooFitTrace::StartSpan(const Char_t* name)
+{
+    // Start the span 'name'. Spans started before are not stopped, i.e.
+    // spans can be nested.
+
+    fSpanOpen.push_back(fSpanName.size());
+    fSpanName.push_back(name);
+    fSpanThread.push_back(GetThreadID());
+    fSpanStart.push_back(FFRooFitProfile::Now() - fStart);
+    fSpanEnd.push_back(-1);
+}
+
+//______________________________________________________________________________
+void FFRooFitTrace::StopSpan()
+{
+    // Stop the innermost running span.
+
+    if (!fSpanOpen.empty())
+    {
+        fSpanEnd[fSpanOpen.back()] = FFRooFitProfile::Now() - fStart;
+        fSpanOpen.pop_back();
+    }
+}
+
+//______________________________________________________________________________
+void FFRooFitTrace::StopAllSpans()
+{
+    // Stop all running spans.
+
+    while (!fSpanOpen.empty())
+        StopSpan();
+}
+
+//______________________________________________________________________________
+Int_t FFRooFitTrace::AddFunction(const Char_t* name, const std::vector<TString>& parNames)
+{
+    // Register the traced function 'name' having the parameters 'parNames'.
+    // Return the index of the function to be used in AddCall().
+
+    fFcnName.push_back(name);
+    fFcnPar.push_back(parNames);
+
+    return fFcnName.size() - 1;
+}
+
+//______________________________________________________________________________
+void FFRooFitTrace::AddCall(Int_t fcn, Int_t phase, Double_t start, Double_t dur,
+                            Double_t val, const std::vector<Double_t>& par)
+{
+    // Record a call of the function with index 'fcn' in the fit phase 'phase'
+    // (see FFRooFitProfile::EFFPhase) starting at the time 'start' (see
+    // FFRooFitProfile::Now()), taking 'dur' seconds and yielding the value 'val'
+    // for the parameter values 'par'.
+
+    fCallFcn.push_back(fcn);
+    fCallPhase.push_back(phase);
+    fCallThread.push_back(GetThreadID());
+    fCallStart.push_back(start - fStart);
+    fCallDur.push_back(dur);
+    fCallVal.push_back(val);
+    fCallPar.push_back(par);
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFitTrace::WriteJSON(const Char_t* file) const
+{
+    // Write the trace in the Chrome trace-event JSON format to the file 'file'.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // open file
+    std::ofstream out(file);
+    if (!out.good())
+    {
+        Error("WriteJSON", "Could not open file '%s'!", file);
+        return kFALSE;
+    }
+
+    // header and process name
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    out << TString::Format("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": 0, "
+                           "\"args\": {\"name\": \"%s\"}}", fPid, FFFooFit::EscapeJSON(GetName()).Data()).Data();
+
+    // spans
+    for (UInt_t i = 0; i < fSpanName.size(); i++)
+    {
+        Double_t end = fSpanEnd[i] >= 0 ? fSpanEnd[i] : fSpanStart[i];
+        out << TString::Format(",\n{\"name\": \"%s\", \"cat\": \"span\", \"ph\": \"X\", "
+                               "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %llu}",
+                               FFFooFit::EscapeJSON(fSpanName[i]).Data(), 1e6*fSpanStart[i], 1e6*(end - fSpanStart[i]),
+                               fPid, fSpanThread[i]).Data();
+    }
+
+    // function calls
+    for (UInt_t i = 0; i < fCallFcn.size(); i++)
+    {
+        const std::vector<TString>& parNames = fFcnPar[fCallFcn[i]];
+
+        // call
+        out << TString::Format(",\n{\"name\": \"%s\", \"cat\": \"call\", \"ph\": \"X\", "
+                               "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %llu, "
+                               "\"args\": {\"phase\": \"%s\", \"value\": %s",
+                               FFFooFit::EscapeJSON(fFcnName[fCallFcn[i]]).Data(), 1e6*fCallStart[i], 1e6*fCallDur[i],
+                               fPid, fCallThread[i], FFRooFitProfile::GetPhaseName(fCallPhase[i]),
+                               FormatNumber(fCallVal[i]).Data()).Data();
+        for (UInt_t j = 0; j < fCallPar[i].size() && j < parNames.size(); j++)
+            out << TString::Format(", \"%s\": %s", FFFooFit::EscapeJSON(parNames[j]).Data(),
+                                   FormatNumber(fCallPar[i][j]).Data()).Data();
+        out << "}}";
+
+        // function value as counter track
+        if (TMath::Finite(fCallVal[i]))
+        {
+            out << TString::Format(",\n{\"name\": \"%s value\", \"ph\": \"C\", \"ts\": %.3f, "
+                                   "\"pid\": %d, \"args\": {\"value\": %s}}",
+                                   FFFooFit::EscapeJSON(fFcnName[fCallFcn[i]]).Data(), 1e6*fCallStart[i],
+                                   fPid, FormatNumber(fCallVal[i]).Data()).Data();
+        }
+    }
+
+    // footer
+    out << "\n]}" << std::endl;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFitTrace::WriteTree(const Char_t* file) const
+{
+    // Write the trace as ROOT trees (one for the calls, one for the spans) to
+    // the file 'file'. The parameter names of the traced functions are
+    // stored in the titles of the named objects 'fcn_i'.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // open file
+    TFile* f = new TFile(file, "RECREATE");
+    if (!f || f->IsZombie())
+    {
+        Error("WriteTree", "Could not open file '%s'!", file);
+        if (f) delete f;
+        return kFALSE;
+    }
+
+    // determine maximum number of parameters
+    Int_t maxPar = 1;
+    for (UInt_t i = 0; i < fFcnPar.size(); i++)
+        maxPar = TMath::Max(maxPar, (Int_t)fFcnPar[i].size());
+
+    // write traced functions
+    for (UInt_t i = 0; i < fFcnName.size(); i++)
+    {
+        TString parList;
+        for (UInt_t j = 0; j < fFcnPar[i].size(); j++)
+        {
+            parList += fFcnPar[i][j];
+            if (j != fFcnPar[i].size()-1)
+                parList += ":";
+        }
+        TNamed fcn(fFcnName[i].Data(), parList.Data());
+        fcn.Write(TString::Format("fcn_%d", i).Data());
+    }
+
+    // calls
+    Int_t fcn, phase, npar;
+    ULong64_t thread;
+    Double_t start, dur, val;
+    Double_t* par = new Double_t[maxPar];
+    TTree* calls = new TTree("calls", "Minimized function calls");
+    calls->Branch("fcn", &fcn, "fcn/I");
+    calls->Branch("phase", &phase, "phase/I");
+    calls->Branch("thread", &thread, "thread/l");
+    calls->Branch("start", &start, "start/D");
+    calls->Branch("dur", &dur, "dur/D");
+    calls->Branch("val", &val, "val/D");
+    calls->Branch("npar", &npar, "npar/I");
+    calls->Branch("par", par, "par[npar]/D");
+    for (UInt_t i = 0; i < fCallFcn.size(); i++)
+    {
+        fcn = fCallFcn[i];
+        phase = fCallPhase[i];
+        thread = fCallThread[i];
+        start = fCallStart[i];
+        dur = fCallDur[i];
+        val = fCallVal[i];
+        npar = TMath::Min((Int_t)fCallPar[i].size(), maxPar);
+        for (Int_t j = 0; j < npar; j++)
+            par[j] = fCallPar[i][j];
+        calls->Fill();
+    }
+    calls->Write();
+
+    // spans
+    Char_t name[256];
+    TTree* spans = new TTree("spans", "Fit spans");
+    spans->Branch("name", name, "name/C");
+    spans->Branch("thread", &thread, "thread/l");
+    spans->Branch("start", &start, "start/D");
+    spans->Branch("dur", &dur, "dur/D");
+    for (UInt_t i = 0; i < fSpanName.size(); i++)
+    {
+        snprintf(name, sizeof(name), "%s", fSpanName[i].Data());
+        thread = fSpanThread[i];
+        start = fSpanStart[i];
+        dur = fSpanEnd[i] >= 0 ? fSpanEnd[i] - fSpanStart[i] : 0;
+        spans->Fill();
+    }
+    spans->Write();
+
+    // clean-up
+    delete f;
+    delete [] par;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFitTrace::Save(const Char_t* file) const
+{
+    // Write the trace to the file 'file'. Files ending with '.root' are
+    // written as ROOT trees, all others as Chrome trace-event JSON.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    TString f(file);
+    if (f.EndsWith(".root"))
+        return WriteTree(file);
+    else
+        return WriteJSON(file);
+}
+
+//______________________________________________________________________________
+void FFRooFitTrace::Print(Option_t* option) const
+{
+    // Print out the content of this class.
+
+    printf("%sFFRooFitTrace content:\n", option);
+    printf("%sName                       : %s\n", option, GetName());
+    printf("%sNumber of spans            : %d\n", option, GetNSpans());
+    printf("%sNumber of functions        : %d\n", option, GetNFunctions());
+    printf("%sNumber of calls            : %lld\n", option, GetNCalls());
+}
+
@@ -18,6 +18,7 @@
 #include "TMath.h"
 
 #include "FFRooFitTree.h"
+#include "FFColumnStats.h"
 
 ClassImp(FFRooFitTree)
 
@@ -130,9 +131,22 @@ Bool_t FFRooFitTree::LoadData()
     Info("LoadData", "Entries in data tree      : %.9e", (Double_t)fTree->GetEntries());
     Info("LoadData", "Entries in RooFit dataset : %.9e", (Double_t)nEntries);
 
-    // check data by looping over all data points
+    // calculate the statistics of the data columns (single pass, reused
+    // in PrepareFit())
+    if (!UpdateColumnStats())
+    {
+        Error("LoadData", "Could not calculate the statistics of the data columns!");
+        return kFALSE;
+    }
+
+    // check the statistics for NaN values and zero weights
+    Bool_t checkRows = fStats->GetNNaNWeight() || fStats->GetNZeroWeight();
+    for (Int_t j = 0; j < fNVar; j++)
+        if (fStats->GetNNaN(j)) checkRows = kTRUE;
+
+    // locate invalid data by looping over all data points
     Bool_t badData = kFALSE;
-    for (Int_t i = 0; i < nEntries; i++)
+    for (Int_t i = 0; checkRows && i < nEntries; i++)
     {
         // get entry
         const RooArgSet* set = fData->get(i);
@@ -195,6 +209,13 @@ Bool_t FFRooFitTree::LoadData()
         return kFALSE;
     }
 
+    // determine adaptive binnings
+    if (!ApplyAdaptiveBinning(fData))
+    {
+        Error("LoadData", "Could not determine the adaptive binning!");
+        return kFALSE;
+    }
+
     // convert to binned data set if requested
     if (fIsBinnedFit)
     {
@@ -19,6 +19,7 @@
 
 #include "FFRooFitter.h"
 #include "FFRooModelHist.h"
+#include "FFRooModelMorph.h"
 #include "FFRooModelSum.h"
 #include "FFRooModelKeys.h"
 #include "FFRooModelGauss.h"
@@ -30,6 +31,7 @@
 #include "FFRooFitterSpecies.h"
 #include "FFFooFit.h"
 #include "FFRooFitTree.h"
+#include "FFColumnStats.h"
 
 ClassImp(FFRooFitter)
 
@@ -47,6 +49,10 @@ FFRooFitter::FFRooFitter(const Char_t* name, const Char_t* title)
     fModel = 0;
     fNSpec = 0;
     fSpec = 0;
+    fAutoRangeTailLow = 0.005;
+    fAutoRangeTailHigh = 0;
+    fTemplateCache = kFALSE;
+    fKeysMaxRelErr = 0;
 }
 
 //______________________________________________________________________________
@@ -70,6 +76,8 @@ FFRooFitter::~FFRooFitter()
             if (fSpec[i]) delete fSpec[i];
         delete [] fSpec;
     }
+    for (FFColumnStats* s : fTreeStats)
+        delete s;
 }
 
 //______________________________________________________________________________
@@ -224,6 +232,38 @@ RooRealVar* FFRooFitter::GetVariable(Int_t i) const
     }
 }
 
+//______________________________________________________________________________
+FFRooFitProfile* FFRooFitter::GetProfile() const
+{
+    // Wrapper for FFRooFit::GetProfile().
+
+    if (fFitter)
+    {
+        return fFitter->GetProfile();
+    }
+    else
+    {
+        Error("GetProfile", "Fitter not created yet!");
+        return 0;
+    }
+}
+
+//______________________________________________________________________________
+FFRooFitTrace* FFRooFitter::GetTrace() const
+{
+    // Wrapper for FFRooFit::GetTrace().
+
+    if (fFitter)
+    {
+        return fFitter->GetTrace();
+    }
+    else
+    {
+        Error("GetTrace", "Fitter not created yet!");
+        return 0;
+    }
+}
+
 //______________________________________________________________________________
 TString FFRooFitter::BuildModelName(const Char_t* name)
 {
@@ -378,6 +418,7 @@ Bool_t FFRooFitter::AddSpeciesHistPdf(const Char_t* name, const Char_t* title, c
     // to the list of species to be fit using a histogram pdf.
     // If 'gaussConvol' is kTRUE, the pdf will be convoluted with a Gaussian.
     // The order of the histogram interpolation can be specified via 'intOrder'.
+    // The filled histogram is cached if enabled via SetTemplateCache().
     // Return kTRUE if the species was added, otherwise return kFALSE.
 
     // load chain
@@ -386,10 +427,11 @@ Bool_t FFRooFitter::AddSpeciesHistPdf(const Char_t* name, const Char_t* title, c
         return kFALSE;
 
     // create the model
-    FFRooModel* model = new FFRooModelHist(BuildModelName(name).Data(),
-                                           title, fFitter->GetNVariable(), chain,
-                                           fWeightVar == "" ? 0 : fWeightVar.Data(),
-                                           gaussConvol, intOrder);
+    FFRooModelHist* model = new FFRooModelHist(BuildModelName(name).Data(),
+                                               title, fFitter->GetNVariable(), chain,
+                                               fWeightVar == "" ? 0 : fWeightVar.Data(),
+                                               gaussConvol, intOrder);
+    model->SetTemplateCache(fTemplateCache);
 
     return AddSpeciesModel(name, title, "histogram", model);
 }
@@ -402,6 +444,7 @@ Bool_t FFRooFitter::AddSpeciesHistPdf(const Char_t* name, const Char_t* title, c
     // to the list of species to be fit using a histogram pdf.
     // Use the parameters 'convolPar' as Gaussian convolution parameters.
     // The order of the histogram interpolation can be specified via 'intOrder'.
+    // The filled histogram is cached if enabled via SetTemplateCache().
     // Return kTRUE if the species was added, otherwise return kFALSE.
 
     // load chain
@@ -410,11 +453,12 @@ Bool_t FFRooFitter::AddSpeciesHistPdf(const Char_t* name, const Char_t* title, c
         return kFALSE;
 
     // create the model
-    FFRooModel* model = new FFRooModelHist(BuildModelName(name).Data(),
-                                           title, fFitter->GetNVariable(), chain,
-                                           convolPar,
-                                           fWeightVar == "" ? 0 : fWeightVar.Data(),
-                                           intOrder);
+    FFRooModelHist* model = new FFRooModelHist(BuildModelName(name).Data(),
+                                               title, fFitter->GetNVariable(), chain,
+                                               convolPar,
+                                               fWeightVar == "" ? 0 : fWeightVar.Data(),
+                                               intOrder);
+    model->SetTemplateCache(fTemplateCache);
 
     return AddSpeciesModel(name, title, "histogram", model);
 }
@@ -436,6 +480,49 @@ Bool_t FFRooFitter::AddSpeciesHistPdf(const Char_t* name, const Char_t* title, T
     return AddSpeciesModel(name, title, "histogram", model);
 }
 
+//______________________________________________________________________________
+Bool_t FFRooFitter::AddSpeciesHistMorphPdf(const Char_t* name, const Char_t* title, Int_t nPoint,
+                                           const Double_t* points, const Char_t** treeLoc,
+                                           Int_t intOrder)
+{
+    // Add the species with name 'name' and title 'title' to the list of species
+    // to be fit using a histogram pdf morphed between the templates filled from
+    // the 'nPoint' tree locations 'treeLoc' at the grid points 'points' (in
+    // increasing order) of a floating morphing parameter.
+    // The order of the histogram interpolation can be specified via 'intOrder'.
+    // The filled histograms are cached if enabled via SetTemplateCache().
+    // Return kTRUE if the species was added, otherwise return kFALSE.
+
+    // check grid points
+    if (nPoint < 2)
+    {
+        Error("AddSpeciesHistMorphPdf", "At least two grid points are needed for morphing!");
+        return kFALSE;
+    }
+
+    // load chains
+    TTree* chains[nPoint];
+    for (Int_t i = 0; i < nPoint; i++)
+    {
+        chains[i] = LoadChainSpecies(name, treeLoc[i]);
+        if (!chains[i])
+        {
+            for (Int_t j = 0; j < i; j++)
+                delete chains[j];
+            return kFALSE;
+        }
+    }
+
+    // create the model
+    FFRooModelMorph* model = new FFRooModelMorph(BuildModelName(name).Data(), title,
+                                                 fFitter->GetNVariable(), nPoint, points, chains,
+                                                 fWeightVar == "" ? 0 : fWeightVar.Data(),
+                                                 intOrder);
+    model->SetTemplateCache(fTemplateCache);
+
+    return AddSpeciesModel(name, title, "histogram morphing", model);
+}
+
 //______________________________________________________________________________
 Bool_t FFRooFitter::AddSpeciesKeysPdf(const Char_t* name, const Char_t* title, const Char_t* treeLoc,
                                       const Char_t* opt, Double_t rho, Int_t nSigma, Bool_t rotate)
@@ -443,6 +530,11 @@ Bool_t FFRooFitter::AddSpeciesKeysPdf(const Char_t* name, const Char_t* title, c
     // Add the species with name 'name', title 'title' and tree location 'treeLoc'
     // to the list of species to be fit using a kernel estimation pdf.
     // See RooNDKeysPdf for meaning of parameters 'opt', 'rho', 'nSigma' and 'rotate'.
+    // By default, the kernel estimation is tabulated on a grid via FFT (see
+    // FFRooGridKeysPdf, up to 3 dimensions). If 'opt' contains 'i', the
+    // kernels are evaluated using a spatial index (see FFRooIndexedKeysPdf)
+    // with distant kernels subsampled according to SetKeysMaxRelError(). If
+    // 'opt' contains 'n', RooNDKeysPdf is used (rotated kernels).
     // Return kTRUE if the species was added, otherwise return kFALSE.
 
     // load chain
@@ -451,9 +543,10 @@ Bool_t FFRooFitter::AddSpeciesKeysPdf(const Char_t* name, const Char_t* title, c
         return kFALSE;
 
     // create the model
-    FFRooModel* model = new FFRooModelKeys(BuildModelName(name).Data(),
-                                           title, fFitter->GetNVariable(), chain,
-                                           opt, rho, nSigma, rotate);
+    FFRooModelKeys* model = new FFRooModelKeys(BuildModelName(name).Data(),
+                                               title, fFitter->GetNVariable(), chain,
+                                               opt, rho, nSigma, rotate);
+    model->SetMaxRelError(fKeysMaxRelErr);
 
     return AddSpeciesModel(name, title, "keys", model);
 }
@@ -498,12 +591,13 @@ void FFRooFitter::SetVariableAutoRange(Int_t i, const Char_t* name, const Char_t
                                        Int_t nbins)
 {
     // Wrapper for FFRooFit::SetVariable() which automatically determines the
-    // range of the variable 'i'.
-
-    //
-    // look for minimum and maximum variable value in tree
-    // (TTree::GetMinimum() is crashing)
-    //
+    // range of the variable 'i'. The range is set to the quantiles of the
+    // (weighted) distribution of the variable in the unbinned input data
+    // excluding the tail fractions set via SetAutoRangeTails() (default:
+    // lower 0.5%, no upper tail). Without upper tail fraction, the maximum
+    // is set to the last filled bin before the first empty bin above the
+    // peak of the distribution. The input data of each variable is read
+    // only once in a single pass and its statistics are cached.
 
     // check if unbinned data is present
     if (!fTree)
@@ -512,73 +606,62 @@ void FFRooFitter::SetVariableAutoRange(Int_t i, const Char_t* name, const Char_t
         return;
     }
 
-    // try to find the leaf
-    TLeaf* leaf = fTree->FindLeaf(name);
-    if (!leaf)
+    // find cached statistics of the variable
+    FFColumnStats* stats = 0;
+    for (FFColumnStats* s : fTreeStats)
     {
-        Error("Error", "Variable '%s' not found in data tree!", name);
-        return;
+        if (s->GetColumnIndex(name) == 0)
+        {
+            stats = s;
+            break;
+        }
     }
-
-    // do not read other branches
-    fTree->SetBranchStatus("*", 0);
-    fTree->SetBranchStatus(name, 1);
-
-    // loop over events
-    Double_t min = 1e30;
-    Double_t max = 1e-30;
-    for (Long64_t i = 0; i < fTree->GetEntries(); i++)
+    if (!stats)
     {
-        // read entry
-        fTree->GetEntry(i);
-
-        // update leaf
-        leaf = fTree->FindLeaf(name);
-
-        // get minimum/maximum
-        min = TMath::Min(min, leaf->GetValue(0));
-        max = TMath::Max(max, leaf->GetValue(0));
+        stats = new FFColumnStats(TString::Format("%s_TreeStats_%s", GetName(), name).Data(),
+                                  TString::Format("Input data statistics of %s", GetTitle()).Data());
+        stats->AddColumn(name);
+        fTreeStats.push_back(stats);
     }
 
-    // reset branch addresses
-    fTree->ResetBranchAddresses();
-    fTree->SetBranchStatus("*", 1);
-
-    // create histogram of data
-    TH1* h = new TH1F("h_det_range", "h_det_range", nbins, min, max);
-    fTree->Draw(TString::Format("%s>>h_det_range", name).Data(), fWeightVar == "" ? 0 : fWeightVar.Data());
-
-    // get bin with maximum
-    Int_t maxBin = h->GetMaximumBin();
-
-    // determine minimum
-    for (Int_t i = maxBin-1; i > 1; i--)
+    // calculate statistics of the variable if needed
+    if (!stats->IsCached(fTree))
     {
-        // calculate integrals
-        Double_t int_low = h->Integral(1, i);
-        Double_t int_tot = h->Integral(1, h->GetNbinsX());
-
-        // leave if ratio is below threshold
-        if (int_low/int_tot < 0.005)
+        if (!stats->Fill(fTree, fWeightVar.Data(), FFFooFit::gUseNCPU))
         {
-            min = h->GetBinCenter(i);
-            break;
+            Error("SetVariableAutoRange", "Variable '%s' not found in data tree!", name);
+            stats->Reset();
+            return;
         }
     }
 
-    // determine maximum
-    for (Int_t i = maxBin+1; i <= h->GetNbinsX(); i++)
+    // determine range
+    if (!stats->GetNValid(0))
     {
-        if (h->GetBinContent(i) == 0)
+        Error("SetVariableAutoRange", "No valid values of variable '%s' found in data tree!", name);
+        return;
+    }
+    Double_t min = stats->GetQuantile(0, fAutoRangeTailLow);
+    Double_t max = stats->GetQuantile(0, 1 - fAutoRangeTailHigh);
+
+    // without upper tail fraction, use the last filled bin before the first
+    // empty bin above the peak of the distribution as maximum (excludes
+    // isolated outliers, the quantile sketch would interpolate over gaps)
+    if (fAutoRangeTailHigh == 0 && nbins > 0 && stats->GetMaximum(0) > stats->GetMinimum(0))
+    {
+        TH1* h = stats->CreateSketchHistogram(0, "h_det_range", nbins,
+                                              stats->GetMinimum(0), stats->GetMaximum(0));
+        for (Int_t j = h->GetMaximumBin()+1; j <= h->GetNbinsX(); j++)
         {
-            max = h->GetBinCenter(i-1);
-            break;
+            if (h->GetBinContent(j) == 0)
+            {
+                max = h->GetBinCenter(j-1);
+                break;
+            }
         }
+        delete h;
     }
 
-    // clean-up
-    delete h;
-
     // round values
     min = TMath::Ceil(min);
     max = TMath::Floor(max);
@@ -587,6 +670,37 @@ void FFRooFitter::SetVariableAutoRange(Int_t i, const Char_t* name, const Char_t
     fFitter->SetVariable(i, name, title, min, max, nbins);
 }
 
+//______________________________________________________________________________
+void FFRooFitter::SetAutoRangeTails(Double_t low, Double_t high)
+{
+    // Set the fractions of the lower and upper tails of the data
+    // distributions that are excluded from the ranges determined by
+    // SetVariableAutoRange() to 'low' and 'high', respectively. If 'high'
+    // is 0 (default), the upper limit is determined from the first empty
+    // bin above the peak of the distribution instead.
+
+    // check fractions
+    if (low < 0 || high < 0 || low + high >= 1)
+    {
+        Error("SetAutoRangeTails", "Invalid tail fractions %e and %e!", low, high);
+        return;
+    }
+
+    fAutoRangeTailLow = low;
+    fAutoRangeTailHigh = high;
+}
+
+//______________________________________________________________________________
+void FFRooFitter::SetAdaptiveBinning(Int_t i, FFRooFit::FFBinning_t type, Double_t par)
+{
+    // Wrapper for FFRooFit::SetAdaptiveBinning().
+
+    if (fFitter)
+        fFitter->SetAdaptiveBinning(i, type, par);
+    else
+        Error("SetAdaptiveBinning", "Fitter not created yet!");
+}
+
 //______________________________________________________________________________
 void FFRooFitter::AddAuxVariable(RooRealVar* aux_var)
 {
@@ -653,6 +767,28 @@ void FFRooFitter::SetMinimizerPreFit(FFRooFit::FFMinimizer_t min)
         Error("SetMinimizerPreFit", "Fitter not created yet!");
 }
 
+//______________________________________________________________________________
+void FFRooFitter::EnableTrace(const Char_t* file)
+{
+    // Wrapper for FFRooFit::EnableTrace().
+
+    if (fFitter)
+        fFitter->EnableTrace(file);
+    else
+        Error("EnableTrace", "Fitter not created yet!");
+}
+
+//______________________________________________________________________________
+void FFRooFitter::DisableTrace()
+{
+    // Wrapper for FFRooFit::DisableTrace().
+
+    if (fFitter)
+        fFitter->DisableTrace();
+    else
+        Error("DisableTrace", "Fitter not created yet!");
+}
+
 //______________________________________________________________________________
 void FFRooFitter::SetFitRange(Double_t min, Double_t max)
 {
@@ -750,8 +886,15 @@ Bool_t FFRooFitter::BuildModel()
 
     if (fFitter)
     {
-        // create total model
-        fModel = new FFRooModelSum("total_model", "total model", fNSpec);
+        // create total model (reuse the one of previous fits if possible)
+        if (fModel && ((FFRooModelSum*)fModel)->GetNModel() != fNSpec)
+        {
+            fFitter->SetModel(0);
+            delete fModel;
+            fModel = 0;
+        }
+        if (!fModel)
+            fModel = new FFRooModelSum("total_model", "total model", fNSpec);
 
         // configure models of all species
         for (Int_t i = 0; i < fNSpec; i++)
@@ -763,7 +906,9 @@ Bool_t FFRooFitter::BuildModel()
             fModel->SetParName(i, TString::Format("Yield_%s", fSpec[i]->GetName()));
             fModel->SetParTitle(i, TString::Format("Yield of species '%s'", fSpec[i]->GetTitle()));
 
-            // configure yield parameter
+            // configure yield parameter (release fixing of previous fits)
+            if (fModel->GetPar(i)->InheritsFrom("RooRealVar"))
+                ((RooRealVar*)fModel->GetPar(i))->setConstant(kFALSE);
             fModel->SetParameter(i,
                                  fSpec[i]->GetYieldInit(),
                                  fSpec[i]->GetYieldMin(),
@@ -774,6 +919,8 @@ Bool_t FFRooFitter::BuildModel()
                 fModel->AddParConstrGauss(i,
                                           fSpec[i]->GetYieldConstrGMean(),
                                           fSpec[i]->GetYieldConstrGSigma());
+            else
+                fModel->RemoveParConstr(i);
         }
 
         // set total model
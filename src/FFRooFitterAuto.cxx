@@ -0,0 +1,203 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooFitterAuto                                                      //
+//                                                                      //
+// Class for fitting multiple species to data choosing automatically    //
+// between an unbinned and a binned fit.                                //
+//                                                                      //
+// Before each fit, the cost of one likelihood evaluation is estimated  //
+// for the unbinned (events x components) and the binned fit (bins x    //
+// components) and the cheaper representation is used. If the           //
+// resolution of a fit variable is set via SetVariableResolution(),     //
+// its binning is derived from the resolution (see                      //
+// SetBinsPerResolution()) for the duration of the fit, otherwise the   //
+// binning set via SetVariable() is used. The binnings of the variables //
+// are restored after the fit.                                          //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <vector>
+
+#include "TMath.h"
+#include "RooRealVar.h"
+#include "RooAbsBinning.h"
+
+#include "FFRooFitterAuto.h"
+#include "FFRooFitTree.h"
+
+ClassImp(FFRooFitterAuto)
+
+//______________________________________________________________________________
+FFRooFitterAuto::FFRooFitterAuto(TTree* tree, Int_t nVar,
+                                 const Char_t* name, const Char_t* title,
+                                 const Char_t* weightVar)
+    : FFRooFitterUnbinned(tree, nVar, name, title, weightVar)
+{
+    // Constructor.
+
+    // init members
+    Init(nVar);
+}
+
+//______________________________________________________________________________
+FFRooFitterAuto::FFRooFitterAuto(const Char_t* treeName, const Char_t* treeLoc, Int_t nVar,
+                                 const Char_t* name, const Char_t* title,
+                                 const Char_t* weightVar)
+    : FFRooFitterUnbinned(treeName, treeLoc, nVar, name, title, weightVar)
+{
+    // Constructor.
+
+    // init members
+    Init(nVar);
+}
+
+//______________________________________________________________________________
+FFRooFitterAuto::~FFRooFitterAuto()
+{
+    // Destructor.
+
+    if (fVarRes)
+        delete [] fVarRes;
+}
+
+//______________________________________________________________________________
+void FFRooFitterAuto::Init(Int_t nVar)
+{
+    // Init the members for 'nVar' fit variables.
+
+    fNVar = nVar;
+    fVarRes = new Double_t[fNVar];
+    for (Int_t i = 0; i < fNVar; i++)
+        fVarRes[i] = 0;
+    fBinsPerRes = 2;
+    fIsBinnedFit = kFALSE;
+    fSpeedup = 1;
+}
+
+//______________________________________________________________________________
+Double_t FFRooFitterAuto::GetVariableResolution(Int_t i) const
+{
+    // Return the resolution of the fit variable with index 'i'.
+
+    // check variable index
+    if (i < 0 || i >= fNVar)
+    {
+        Error("GetVariableResolution", "Invalid variable index %d (number of variables: %d)", i, fNVar);
+        return 0;
+    }
+
+    return fVarRes[i];
+}
+
+//______________________________________________________________________________
+void FFRooFitterAuto::SetVariableResolution(Int_t i, Double_t res)
+{
+    // Set the resolution of the fit variable with index 'i' to 'res'. A
+    // resolution of zero disables the automatic binning of this variable.
+
+    // check variable index
+    if (i < 0 || i >= fNVar)
+    {
+        Error("SetVariableResolution", "Invalid variable index %d (number of variables: %d)", i, fNVar);
+        return;
+    }
+
+    fVarRes[i] = res;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFitterAuto::ChooseFitType()
+{
+    // Estimate the cost of a likelihood evaluation of the unbinned and the
+    // binned fit and configure the fitter to use the cheaper one.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // check tree
+    if (!fTree)
+    {
+        Error("ChooseFitType", "No unbinned input data (tree) was specified!");
+        return kFALSE;
+    }
+
+    // count events
+    Double_t nEvents = fTree->GetEntries();
+    for (UInt_t i = 0; i < fTreeAdd.size(); i++)
+        nEvents += fTreeAdd[i]->GetEntries();
+
+    // count bins (binning derived from resolution if set)
+    Double_t nBins = 1;
+    for (Int_t i = 0; i < fNVar; i++)
+    {
+        RooRealVar* var = GetVariable(i);
+        if (!var)
+            return kFALSE;
+        if (fVarRes[i] > 0 && fBinsPerRes > 0)
+        {
+            Int_t n = TMath::Max(1, (Int_t)TMath::Ceil((var->getMax() - var->getMin()) / fVarRes[i] * fBinsPerRes));
+            var->setBins(n);
+            Info("ChooseFitType", "Binning of variable '%s' from resolution %e: %d bins",
+                 var->GetName(), fVarRes[i], n);
+        }
+        nBins *= var->numBins();
+    }
+
+    // estimate costs of likelihood evaluations
+    Int_t nComp = TMath::Max(fNSpec, 1);
+    Double_t costUnbinned = nEvents * nComp;
+    Double_t costBinned = nBins * nComp;
+
+    // choose cheaper fit
+    fIsBinnedFit = costBinned < costUnbinned;
+    fSpeedup = fIsBinnedFit ? costUnbinned / costBinned : 1;
+    ((FFRooFitTree*)fFitter)->SetBinnedFit(fIsBinnedFit);
+
+    // user info
+    Info("ChooseFitType", "Cost estimate unbinned fit : %.3e (%.0f events x %d components)",
+         costUnbinned, nEvents, nComp);
+    Info("ChooseFitType", "Cost estimate binned fit   : %.3e (%.0f bins x %d components)",
+         costBinned, nBins, nComp);
+    if (fIsBinnedFit)
+        Info("ChooseFitType", "Using binned fit (estimated speedup: %.1f)", fSpeedup);
+    else
+        Info("ChooseFitType", "Using unbinned fit (binned fit would be %.1f times slower)",
+             costBinned / costUnbinned);
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooFitterAuto::Fit(const Char_t* opt)
+{
+    // Choose between unbinned and binned fit and perform the fit
+    // (see FFRooFitter::Fit()). The binnings of the fit variables are
+    // restored after the fit.
+
+    // save binnings of the fit variables
+    std::vector<RooAbsBinning*> binning(fNVar, (RooAbsBinning*)0);
+    for (Int_t i = 0; i < fNVar; i++)
+        if (GetVariable(i)) binning[i] = GetVariable(i)->getBinning().clone();
+
+    // choose fit type and perform the fit
+    Bool_t res = kFALSE;
+    if (ChooseFitType())
+        res = FFRooFitter::Fit(opt);
+    else
+        Error("Fit", "An error occurred while choosing the fit type!");
+
+    // restore binnings
+    for (Int_t i = 0; i < fNVar; i++)
+    {
+        if (binning[i])
+        {
+            GetVariable(i)->setBinning(*binning[i]);
+            delete binning[i];
+        }
+    }
+
+    return res;
+}
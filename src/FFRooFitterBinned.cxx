@@ -8,6 +8,12 @@
 //                                                                      //
 // Class for fitting multiple species to binned data.                   //
 //                                                                      //
+// The fit uses the native binned likelihood (see FFRooBinnedNLL). If   //
+// all species are histogram templates, the fit is linear in the yields //
+// and the yields are solved directly via Newton iterations. The        //
+// statistical uncertainties of the templates can be included via the   //
+// Barlow-Beeston-lite method using the fit option 'bblite'.            //
+//                                                                      //
 //////////////////////////////////////////////////////////////////////////
 
 
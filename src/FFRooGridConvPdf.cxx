@@ -0,0 +1,544 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooGridConvPdf                                                     //
+//                                                                      //
+// Histogram pdf convolved with Gaussians in all dimensions via FFT.    //
+//                                                                      //
+// The intrinsic shape is given by the bin contents of a 1-, 2- or      //
+// 3-dimensional histogram with fixed bin sizes. It is convolved with a //
+// separable Gaussian resolution having the mean and sigma parameters   //
+// 'mean[i]' and 'sigma[i]' in dimension i, i.e. the observed value is  //
+// the intrinsic value plus a Gaussian offset.                          //
+//                                                                      //
+// The grid is zero-padded to cover the Gaussian kernels within the     //
+// ranges of the parameters and is transformed only once. When the      //
+// parameters change, the transform is multiplied with the transforms   //
+// of the 1-dimensional bin-integrated Gaussian kernels and transformed //
+// back. The convolved grid is cached and recomputed only if a mean or  //
+// sigma parameter changed; only the kernels of the dimensions with     //
+// changed parameters are transformed again. The FFT plans are shared   //
+// with other instances via FFRooConvCache.                             //
+//                                                                      //
+// With interpolation order 1, the convolved grid is interpolated       //
+// multi-linearly between the neighbouring bin centers. Integrals over  //
+// any subset of the observables are calculated analytically.           //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "TMath.h"
+#include "TH1.h"
+#include "TVirtualFFT.h"
+#include "RooArgList.h"
+#include "RooArgSet.h"
+#include "RooRealVar.h"
+
+#include "FFRooGridConvPdf.h"
+#include "FFRooConvCache.h"
+
+ClassImp(FFRooGridConvPdf)
+
+//______________________________________________________________________________
+FFRooGridConvPdf::FFRooGridConvPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                                   const RooArgList& mean, const RooArgList& sigma, const TH1* hist,
+                                   Int_t intOrder)
+    : RooAbsPdf(name, title),
+      fObs("obs", "Observables", this),
+      fMean("mean", "Gaussian means", this),
+      fSigma("sigma", "Gaussian sigmas", this)
+{
+    // Constructor using the observables 'obs', the Gaussian parameters 'mean'
+    // and 'sigma' of each dimension, and the intrinsic shape given by the
+    // histogram 'hist'. Values are interpolated if 'intOrder' is 1.
+
+    // init members
+    fObs.add(obs);
+    fMean.add(mean);
+    fSigma.add(sigma);
+    fNDim = obs.getSize();
+    fInterpolOrder = intOrder;
+    fNConv = 0;
+    if (fInterpolOrder < 0 || fInterpolOrder > 1)
+    {
+        Warning("FFRooGridConvPdf", "Unsupported interpolation order %d - using linear interpolation",
+                fInterpolOrder);
+        fInterpolOrder = 1;
+    }
+
+    // check dimensions
+    if (fNDim < 1 || fNDim > 3 || hist->GetDimension() != fNDim ||
+        mean.getSize() != fNDim || sigma.getSize() != fNDim)
+    {
+        Error("FFRooGridConvPdf", "Inconsistent dimensions of observables, parameters and histogram!");
+        fNDim = 0;
+    }
+
+    // grid from histogram
+    Int_t nbin[3] = { 0, 0, 0 };
+    Double_t min[3] = { 0, 0, 0 };
+    Double_t max[3] = { 0, 0, 0 };
+    const TAxis* haxes[3] = { hist->GetXaxis(), hist->GetYaxis(), hist->GetZaxis() };
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        nbin[i] = haxes[i]->GetNbins();
+        min[i] = haxes[i]->GetXmin();
+        max[i] = haxes[i]->GetXmax();
+    }
+    Init(nbin, min, max);
+    for (Int_t c = 0; c < fNCell; c++)
+    {
+        Int_t bin[3] = { 0, 0, 0 };
+        Int_t r = c;
+        for (Int_t i = fNDim-1; i >= 0; i--)
+        {
+            bin[i] = r % fNBin[i] + 1;
+            r /= fNBin[i];
+        }
+        fGrid[c] = hist->GetBinContent(hist->GetBin(bin[0], bin[1], bin[2]));
+    }
+
+    // padding covering the Gaussian kernels within the parameter ranges
+    // (avoids the wrap-around of the circular convolution)
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        RooAbsReal* m = (RooAbsReal*)fMean.at(i);
+        RooAbsReal* s = (RooAbsReal*)fSigma.at(i);
+        Double_t mMax = TMath::Abs(m->getVal());
+        Double_t sMax = TMath::Abs(s->getVal());
+        if (m->InheritsFrom("RooRealVar"))
+            mMax = TMath::Max(TMath::Abs(((RooRealVar*)m)->getMin()), TMath::Abs(((RooRealVar*)m)->getMax()));
+        if (s->InheritsFrom("RooRealVar"))
+            sMax = TMath::Max(TMath::Abs(((RooRealVar*)s)->getMin()), TMath::Abs(((RooRealVar*)s)->getMax()));
+        Double_t half = TMath::Min((mMax + 5*sMax) / fBinW[i] + 1, 2.*fNBin[i]);
+        fNPad[i] = FFRooConvCache::GetGoodSize(fNBin[i] + 2*(Int_t)TMath::Ceil(half));
+    }
+}
+
+//______________________________________________________________________________
+FFRooGridConvPdf::FFRooGridConvPdf(const FFRooGridConvPdf& other, const Char_t* name)
+    : RooAbsPdf(other, name),
+      fObs("obs", this, other.fObs),
+      fMean("mean", this, other.fMean),
+      fSigma("sigma", this, other.fSigma)
+{
+    // Copy constructor.
+
+    // init members
+    fNDim = other.fNDim;
+    fInterpolOrder = other.fInterpolOrder;
+    fNConv = 0;
+    Init(other.fNBin, other.fMin, other.fMax);
+    for (Int_t i = 0; i < fNDim; i++)
+        fNPad[i] = other.fNPad[i];
+    for (Int_t c = 0; c < fNCell; c++)
+        fGrid[c] = other.fGrid[c];
+    fFwdRe = other.fFwdRe;
+    fFwdIm = other.fFwdIm;
+}
+
+//______________________________________________________________________________
+FFRooGridConvPdf::~FFRooGridConvPdf()
+{
+    // Destructor.
+
+    if (fNBin)
+        delete [] fNBin;
+    if (fMin)
+        delete [] fMin;
+    if (fMax)
+        delete [] fMax;
+    if (fBinW)
+        delete [] fBinW;
+    if (fNPad)
+        delete [] fNPad;
+    if (fGrid)
+        delete [] fGrid;
+}
+
+//______________________________________________________________________________
+void FFRooGridConvPdf::Init(const Int_t* nBin, const Double_t* min, const Double_t* max)
+{
+    // Init the grid having 'nBin' bins in the ranges ['min','max'] in each
+    // dimension.
+
+    fNBin = new Int_t[fNDim];
+    fMin = new Double_t[fNDim];
+    fMax = new Double_t[fNDim];
+    fBinW = new Double_t[fNDim];
+    fNPad = new Int_t[fNDim];
+    fNCell = fNDim ? 1 : 0;
+    fBinVol = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        fNBin[i] = TMath::Max(nBin[i], 1);
+        fMin[i] = min[i];
+        fMax[i] = max[i];
+        fBinW[i] = (fMax[i] - fMin[i]) / fNBin[i];
+        fNPad[i] = fNBin[i];
+        fNCell *= fNBin[i];
+        fBinVol *= fBinW[i];
+    }
+    fGrid = new Double_t[fNCell];
+    fConvMean.assign(fNDim, 0);
+    fConvSigma.assign(fNDim, 0);
+    fKerRe.assign(fNDim, std::vector<Double_t>());
+    fKerIm.assign(fNDim, std::vector<Double_t>());
+}
+
+//______________________________________________________________________________
+void FFRooGridConvPdf::UpdateConvolution() const
+{
+    // Update the convolved grid if a Gaussian parameter changed. If an FFT
+    // cannot be created, the convolved grid is set to zero (see CheckFFT()).
+
+    // check parameters
+    Bool_t update = fConv.empty();
+    Bool_t changed[fNDim];
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        Double_t m = ((RooAbsReal*)fMean.at(i))->getVal();
+        Double_t s = ((RooAbsReal*)fSigma.at(i))->getVal();
+        changed[i] = fKerRe[i].empty() || m != fConvMean[i] || s != fConvSigma[i];
+        if (changed[i])
+        {
+            fConvMean[i] = m;
+            fConvSigma[i] = s;
+            update = kTRUE;
+        }
+    }
+    if (!update)
+        return;
+
+    // sizes of the padded grid and of its transform
+    Int_t nPad[fNDim];
+    Int_t nTot = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        nPad[i] = fNPad[i];
+        nTot *= fNPad[i];
+    }
+    const Int_t nLast = fNPad[fNDim-1] / 2 + 1;
+    const Int_t nCplx = nTot / fNPad[fNDim-1] * nLast;
+
+    // index of a grid cell in the padded grid
+    auto padIndex = [&](Int_t c) -> Int_t
+    {
+        Int_t bin[fNDim];
+        for (Int_t i = fNDim-1; i >= 0; i--)
+        {
+            bin[i] = c % fNBin[i];
+            c /= fNBin[i];
+        }
+        Int_t p = 0;
+        for (Int_t i = 0; i < fNDim; i++)
+            p = p * fNPad[i] + bin[i];
+        return p;
+    };
+
+    // transform the padded intrinsic grid (only once)
+    if (fFwdRe.empty())
+    {
+        std::vector<Double_t> pad(nTot, 0);
+        for (Int_t c = 0; c < fNCell; c++)
+            pad[padIndex(c)] = fGrid[c];
+        TVirtualFFT* fft = FFRooConvCache::GetPlan(fNDim, nPad, "R2C ES");
+        if (!fft)
+        {
+            Error("UpdateConvolution", "Could not create the forward FFT of the grid!");
+            fConv.assign(fNCell, 0);
+            return;
+        }
+        fft->SetPoints(pad.data());
+        fft->Transform();
+        fFwdRe.assign(nTot, 0);
+        fFwdIm.assign(nTot, 0);
+        fft->GetPointsComplex(fFwdRe.data(), fFwdIm.data());
+    }
+
+    // transforms of the bin-integrated 1-dimensional Gaussian kernels
+    // (only for changed parameters)
+    std::vector<std::vector<Double_t> >& kRe = fKerRe;
+    std::vector<std::vector<Double_t> >& kIm = fKerIm;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (!changed[i])
+            continue;
+
+        // kernel in units of bins (negative offsets wrapped around)
+        Int_t n = fNPad[i];
+        std::vector<Double_t> k(n, 0);
+        const Double_t m = fConvMean[i] / fBinW[i];
+        const Double_t s = TMath::Abs(fConvSigma[i]) / fBinW[i];
+        if (s > 0)
+        {
+            for (Int_t j = 0; j < n; j++)
+            {
+                Double_t o = j <= n/2 ? j : j - n;
+                k[j] = 0.5 * (TMath::Erf((o + 0.5 - m) / (TMath::Sqrt2() * s)) -
+                              TMath::Erf((o - 0.5 - m) / (TMath::Sqrt2() * s)));
+            }
+        }
+        else
+        {
+            k[(TMath::Nint(m) % n + n) % n] = 1;
+        }
+
+        // transform kernel
+        TVirtualFFT* fft = FFRooConvCache::GetPlan(1, &n, "R2C ES");
+        if (!fft)
+        {
+            Error("UpdateConvolution", "Could not create the FFT of the kernel in dimension %d!", i);
+            kRe[i].clear();
+            fConv.assign(fNCell, 0);
+            return;
+        }
+        fft->SetPoints(k.data());
+        fft->Transform();
+        kRe[i].assign(n, 0);
+        kIm[i].assign(n, 0);
+        fft->GetPointsComplex(kRe[i].data(), kIm[i].data());
+        for (Int_t j = n/2 + 1; j < n; j++)
+        {
+            kRe[i][j] = kRe[i][n-j];
+            kIm[i][j] = -kIm[i][n-j];
+        }
+    }
+
+    // multiply transforms
+    std::vector<Double_t> re(nCplx);
+    std::vector<Double_t> im(nCplx);
+    for (Int_t c = 0; c < nCplx; c++)
+    {
+        Double_t pr = 1;
+        Double_t pi = 0;
+        Int_t r = c;
+        for (Int_t i = fNDim-1; i >= 0; i--)
+        {
+            Int_t len = i == fNDim-1 ? nLast : fNPad[i];
+            Int_t j = r % len;
+            r /= len;
+            Double_t t = pr * kRe[i][j] - pi * kIm[i][j];
+            pi = pr * kIm[i][j] + pi * kRe[i][j];
+            pr = t;
+        }
+        re[c] = fFwdRe[c] * pr - fFwdIm[c] * pi;
+        im[c] = fFwdRe[c] * pi + fFwdIm[c] * pr;
+    }
+
+    // transform back
+    TVirtualFFT* fft = FFRooConvCache::GetPlan(fNDim, nPad, "C2R ES");
+    if (!fft)
+    {
+        Error("UpdateConvolution", "Could not create the backward FFT of the grid!");
+        fConv.assign(fNCell, 0);
+        return;
+    }
+    fft->SetPointsComplex(re.data(), im.data());
+    fft->Transform();
+    std::vector<Double_t> out(nTot);
+    fft->GetPoints(out.data());
+
+    // extract convolved grid (normalization of the backward transform)
+    fConv.resize(fNCell);
+    for (Int_t c = 0; c < fNCell; c++)
+        fConv[c] = TMath::Max(out[padIndex(c)] / nTot, 0.);
+    fNConv++;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooGridConvPdf::CheckFFT() const
+{
+    // Check if all FFTs needed for the convolution can be created.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // check grid
+    if (!fNCell)
+        return kFALSE;
+
+    // forward and backward transforms of the padded grid
+    Int_t nPad[fNDim];
+    for (Int_t i = 0; i < fNDim; i++)
+        nPad[i] = fNPad[i];
+    if (!FFRooConvCache::GetPlan(fNDim, nPad, "R2C ES") ||
+        !FFRooConvCache::GetPlan(fNDim, nPad, "C2R ES"))
+        return kFALSE;
+
+    // transforms of the kernels
+    for (Int_t i = 0; i < fNDim; i++)
+        if (!FFRooConvCache::GetPlan(1, &nPad[i], "R2C ES")) return kFALSE;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Double_t FFRooGridConvPdf::GetConvContent(const Int_t* bin) const
+{
+    // Return the content of the convolved grid in the bin with the bin
+    // indices 'bin'.
+
+    Int_t c = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+        c = c * fNBin[i] + bin[i];
+
+    return fConv[c];
+}
+
+//______________________________________________________________________________
+Double_t FFRooGridConvPdf::evaluate() const
+{
+    // Calculate the value of the pdf.
+
+    // check grid
+    if (!fNCell)
+        return 0;
+
+    // update the convolution
+    UpdateConvolution();
+
+    // nearest bins and interpolation fractions
+    Int_t lo[fNDim];
+    Double_t f[fNDim];
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        Double_t x = ((RooAbsReal*)fObs.at(i))->getVal();
+        if (!(x >= fMin[i] && x < fMax[i]))
+            return 0;
+
+        if (fInterpolOrder == 0)
+        {
+            lo[i] = TMath::Min((Int_t)((x - fMin[i]) / fBinW[i]), fNBin[i]-1);
+            f[i] = 0;
+        }
+        else
+        {
+            // position relative to the bin centers (constant beyond the
+            // outermost bin centers)
+            Double_t u = (x - fMin[i]) / fBinW[i] - 0.5;
+            lo[i] = (Int_t)TMath::Floor(u);
+            f[i] = u - lo[i];
+            if (lo[i] < 0)
+            {
+                lo[i] = 0;
+                f[i] = 0;
+            }
+            else if (lo[i] >= fNBin[i]-1)
+            {
+                lo[i] = fNBin[i]-1;
+                f[i] = 0;
+            }
+        }
+    }
+
+    // sum contributions of neighbouring bins
+    Double_t sum = 0;
+    Int_t bin[fNDim];
+    const Int_t nCorner = fInterpolOrder == 0 ? 1 : 1 << fNDim;
+    for (Int_t c = 0; c < nCorner; c++)
+    {
+        Double_t w = 1;
+        for (Int_t i = 0; i < fNDim && w > 0; i++)
+        {
+            Bool_t up = (c >> i) & 1;
+            w *= up ? f[i] : 1 - f[i];
+            bin[i] = lo[i] + up;
+        }
+        if (w > 0)
+            sum += w * GetConvContent(bin);
+    }
+
+    return sum / fBinVol;
+}
+
+//______________________________________________________________________________
+Int_t FFRooGridConvPdf::getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars,
+                                              const char* rangeName) const
+{
+    // Advertise the analytical integration over any subset of the
+    // observables. The integration code is 1 + bit mask of the integrated
+    // observables.
+
+    Int_t mask = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (allVars.find(*fObs.at(i)))
+        {
+            mask |= 1 << i;
+            analVars.add(*fObs.at(i));
+        }
+    }
+
+    return mask ? mask + 1 : 0;
+}
+
+//______________________________________________________________________________
+Double_t FFRooGridConvPdf::analyticalIntegral(Int_t code, const char* rangeName) const
+{
+    // Calculate the integral over the observables selected by 'code' (see
+    // getAnalyticalIntegral()) in the range 'rangeName'. The other
+    // observables are fixed to the bins of their current values.
+
+    // check grid
+    if (!fNCell)
+        return 0;
+
+    // update the convolution
+    UpdateConvolution();
+
+    // integration ranges and bins of the fixed observables
+    const Int_t mask = code - 1;
+    Double_t lo[fNDim];
+    Double_t hi[fNDim];
+    Int_t fix[fNDim];
+    Double_t norm = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (mask & (1 << i))
+        {
+            RooRealVar* var = (RooRealVar*)fObs.at(i);
+            lo[i] = TMath::Max(var->getMin(rangeName), fMin[i]);
+            hi[i] = TMath::Min(var->getMax(rangeName), fMax[i]);
+            if (hi[i] <= lo[i])
+                return 0;
+        }
+        else
+        {
+            Double_t x = ((RooAbsReal*)fObs.at(i))->getVal();
+            if (!(x >= fMin[i] && x < fMax[i]))
+                return 0;
+            fix[i] = TMath::Min((Int_t)((x - fMin[i]) / fBinW[i]), fNBin[i]-1);
+            norm *= fBinW[i];
+        }
+    }
+
+    // sum overlaps of bins with integration ranges
+    Double_t sum = 0;
+    for (Int_t c = 0; c < fNCell; c++)
+    {
+        if (fConv[c] == 0)
+            continue;
+        Double_t frac = 1;
+        Int_t r = c;
+        for (Int_t i = fNDim-1; i >= 0 && frac > 0; i--)
+        {
+            Int_t b = r % fNBin[i];
+            r /= fNBin[i];
+            if (mask & (1 << i))
+            {
+                Double_t blo = fMin[i] + b * fBinW[i];
+                Double_t overlap = TMath::Min(hi[i], blo + fBinW[i]) - TMath::Max(lo[i], blo);
+                frac *= overlap > 0 ? overlap / fBinW[i] : 0;
+            }
+            else if (b != fix[i])
+            {
+                frac = 0;
+            }
+        }
+        sum += frac * fConv[c];
+    }
+
+    return sum / norm;
+}
@@ -0,0 +1,584 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooGridKeysPdf                                                     //
+//                                                                      //
+// Kernel estimation pdf tabulated on a grid via FFT.                   //
+//                                                                      //
+// The events of a dataset are binned onto a fine grid covering the     //
+// ranges of the 1, 2 or 3 observables (linear binning, i.e. each event //
+// is shared between the neighbouring grid nodes). The grid is zero-    //
+// padded by the kernel range and convolved with separable Gaussian     //
+// kernels via FFT, which costs O(G log G) for G grid nodes instead of  //
+// O(N) kernel sums per evaluation for N events. The tabulated density  //
+// is evaluated by interpolation of the grid of the underlying          //
+// FFRooTemplatePdf, i.e. in constant time.                             //
+//                                                                      //
+// The bandwidths follow the rule of thumb of RooNDKeysPdf, using the   //
+// effective number of events of weighted data. With option 'a', the    //
+// adaptive kernel widths are scaled by (f/g)^-1/2 (Abramson), where f  //
+// is the fixed-width pilot estimate at the event and g the geometric   //
+// mean of f. The adaptive scales are quantized into logarithmically    //
+// spaced classes, each of which is binned separately; the transforms   //
+// of all classes are summed so only one backward transform is needed.  //
+// With option 'm', the density is mirrored at the range boundaries.    //
+// Kernels are truncated at 'nSigma' times the kernel width and are not //
+// rotated along the principal axes of the data.                        //
+//                                                                      //
+// The loops over the events (moments, binning, pilot estimate) and the //
+// products of the transforms are split among FFFooFit::gUseNCPU        //
+// threads. Partial sums are accumulated in chunks of fixed size and    //
+// each thread bins the events into its own slab of the grid, i.e. the  //
+// result does not depend on the number of threads.                     //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "TMath.h"
+#include "TVirtualFFT.h"
+#include "RooArgList.h"
+#include "RooRealVar.h"
+#include "RooDataSet.h"
+
+#include "FFRooGridKeysPdf.h"
+#include "FFRooConvCache.h"
+#include "FFFooFit.h"
+
+ClassImp(FFRooGridKeysPdf)
+
+//______________________________________________________________________________
+FFRooGridKeysPdf::FFRooGridKeysPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                                   RooDataSet& data, const Char_t* opt, Double_t rho,
+                                   Int_t nSigma, Int_t nBin, Int_t intOrder)
+    : FFRooTemplatePdf(name, title, obs, intOrder)
+{
+    // Constructor using the observables 'obs' and the events of the dataset
+    // 'data'. The options 'opt' ('a': adaptive, 'm': mirror), the bandwidth
+    // scaling 'rho' and the kernel range 'nSigma' follow RooNDKeysPdf.
+    // The grid has 'nBin' bins per dimension (default if 0). Values are
+    // interpolated on the grid using the order 'intOrder'
+    // (see FFRooTemplatePdf).
+
+    // init members
+    fOpt = opt;
+    fOpt.ToLower();
+    fRho = rho;
+    fNSigma = nSigma > 0 ? nSigma : 1;
+    fBandwidth[0] = fBandwidth[1] = fBandwidth[2] = 0;
+    fNKernel = 0;
+    fSumW = 0;
+    fValid = kFALSE;
+
+    // check dimensions
+    if (!fNDim)
+        return;
+
+    // copy events
+    const Long64_t n = data.numEntries();
+    std::vector<Double_t> x(n*fNDim);
+    std::vector<Double_t> w(n);
+    for (Long64_t i = 0; i < n; i++)
+    {
+        const RooArgSet* row = data.get(i);
+        for (Int_t j = 0; j < fNDim; j++)
+        {
+            RooAbsReal* v = (RooAbsReal*)row->find(fObs.at(j)->GetName());
+            x[i*fNDim+j] = v ? v->getVal() : 0;
+        }
+        w[i] = data.weight();
+    }
+
+    // tabulate the density
+    fValid = BuildGrid(n, x.data(), w.data(), nBin > 0 ? nBin : GetDefaultBins(fNDim));
+}
+
+//______________________________________________________________________________
+FFRooGridKeysPdf::FFRooGridKeysPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                                   Long64_t n, const Double_t* x, const Double_t* w,
+                                   const Char_t* opt, Double_t rho, Int_t nSigma, Int_t nBin,
+                                   Int_t intOrder)
+    : FFRooTemplatePdf(name, title, obs, intOrder)
+{
+    // Constructor using the observables 'obs' and the 'n' events having the
+    // observable values 'x' [n*nDim] and the weights 'w' [n] (unweighted if
+    // 'w' is 0). See the constructor above for the other parameters.
+
+    // init members
+    fOpt = opt;
+    fOpt.ToLower();
+    fRho = rho;
+    fNSigma = nSigma > 0 ? nSigma : 1;
+    fBandwidth[0] = fBandwidth[1] = fBandwidth[2] = 0;
+    fNKernel = 0;
+    fSumW = 0;
+    fValid = kFALSE;
+
+    // tabulate the density
+    if (fNDim)
+        fValid = BuildGrid(n, x, w, nBin > 0 ? nBin : GetDefaultBins(fNDim));
+}
+
+//______________________________________________________________________________
+FFRooGridKeysPdf::FFRooGridKeysPdf(const FFRooGridKeysPdf& other, const Char_t* name)
+    : FFRooTemplatePdf(other, name)
+{
+    // Copy constructor.
+
+    // init members
+    fOpt = other.fOpt;
+    fRho = other.fRho;
+    fNSigma = other.fNSigma;
+    for (Int_t i = 0; i < 3; i++)
+        fBandwidth[i] = other.fBandwidth[i];
+    fNKernel = other.fNKernel;
+    fSumW = other.fSumW;
+    fValid = other.fValid;
+}
+
+//______________________________________________________________________________
+Int_t FFRooGridKeysPdf::GetDefaultBins(Int_t nDim)
+{
+    // Return the default number of grid bins per dimension for 'nDim'
+    // dimensions.
+
+    switch (nDim)
+    {
+        case 1: return 1024;
+        case 2: return 256;
+        default: return 64;
+    }
+}
+
+//______________________________________________________________________________
+Bool_t FFRooGridKeysPdf::TransformKernels(Double_t scale, const Int_t* nPad, const Int_t* pad,
+                                          std::vector<Double_t>* kRe, std::vector<Double_t>* kIm) const
+{
+    // Calculate the transforms 'kRe' and 'kIm' of the 1-dimensional Gaussian
+    // kernels having the global bandwidths scaled by 'scale' for the padded
+    // grid sizes 'nPad'. The kernels are truncated at 'pad' bins.
+    // Return kFALSE if an FFT could not be created, otherwise kTRUE.
+
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        // kernel in units of bins (negative offsets wrapped around)
+        Int_t n = nPad[i];
+        std::vector<Double_t> k(n, 0);
+        const Double_t s = scale * fBandwidth[i] / fBinW[i];
+        if (s > 1e-3)
+        {
+            Double_t sum = 0;
+            for (Int_t j = 0; j < n; j++)
+            {
+                Double_t o = j <= n/2 ? j : j - n;
+                if (TMath::Abs(o) > pad[i])
+                    continue;
+                k[j] = TMath::Exp(-0.5 * o * o / (s * s));
+                sum += k[j];
+            }
+            for (Int_t j = 0; j < n; j++)
+                k[j] /= sum;
+        }
+        else
+        {
+            k[0] = 1;
+        }
+
+        // transform kernel
+        TVirtualFFT* fft = FFRooConvCache::GetPlan(1, &n, "R2C ES");
+        if (!fft)
+        {
+            Error("TransformKernels", "Could not create FFT!");
+            return kFALSE;
+        }
+        fft->SetPoints(k.data());
+        fft->Transform();
+        kRe[i].assign(n, 0);
+        kIm[i].assign(n, 0);
+        fft->GetPointsComplex(kRe[i].data(), kIm[i].data());
+        for (Int_t j = n/2 + 1; j < n; j++)
+        {
+            kRe[i][j] = kRe[i][n-j];
+            kIm[i][j] = -kIm[i][n-j];
+        }
+    }
+
+    return kTRUE;
+}
+
+
+//______________________________________________________________________________
+Bool_t FFRooGridKeysPdf::BuildGrid(Long64_t nEntries, const Double_t* x, const Double_t* w, Int_t nBin)
+{
+    // Tabulate the kernel estimation of the 'nEntries' events having the
+    // observable values 'x' and the weights 'w' (unweighted if 0) on a grid
+    // having 'nBin' bins per dimension.
+    // Return kFALSE if no events were found or an FFT could not be created,
+    // otherwise kTRUE.
+
+    // adaptive kernel classes
+    const Bool_t adaptive = fOpt.Contains("a");
+    const Bool_t mirror = fOpt.Contains("m");
+    const Double_t maxScale = adaptive ? 8 : 1;
+    const Int_t nClass = adaptive ? 25 : 1;
+    const Double_t logStep = adaptive ? 2 * TMath::Log(maxScale) / (nClass - 1) : 1;
+
+    // threads and size of the chunks of the partial sums (fixed to make the
+    // reductions independent of the number of threads)
+    const Int_t nThreads = FFFooFit::gUseNCPU;
+    const Long64_t chunk = 16384;
+
+    // init the grid covering the observable ranges
+    Int_t nb[3];
+    Double_t min[3];
+    Double_t max[3];
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        RooRealVar* v = (RooRealVar*)fObs.at(i);
+        nb[i] = nBin;
+        min[i] = v->getMin();
+        max[i] = v->getMax();
+    }
+    InitGrid(nb, min, max);
+
+    // select events within the ranges
+    std::vector<Long64_t> sel;
+    sel.reserve(nEntries);
+    for (Long64_t e = 0; e < nEntries; e++)
+    {
+        Bool_t inRange = !w || w[e] != 0;
+        for (Int_t j = 0; j < fNDim && inRange; j++)
+        {
+            Double_t v = x[e*fNDim+j];
+            if (!(v >= fMin[j] && v <= fMax[j]))
+                inRange = kFALSE;
+        }
+        if (inRange)
+            sel.push_back(e);
+    }
+    const Long64_t nEvent = sel.size();
+    auto evX = [&](Long64_t n, Int_t i) -> Double_t { return x[sel[n]*fNDim+i]; };
+    auto evW = [&](Long64_t n) -> Double_t { return w ? w[sel[n]] : 1.; };
+
+    // moments (partial sums per chunk: sum(w), sum(w^2), sum(w*x), sum(w*x^2))
+    const Long64_t nChunk = (nEvent + chunk - 1) / chunk;
+    const Int_t nMom = 2 + 2*fNDim;
+    std::vector<Double_t> mom(nChunk*nMom, 0);
+    FFFooFit::ParallelFor(nChunk, nThreads, [&](Int_t, Long64_t start, Long64_t end)
+    {
+        for (Long64_t c = start; c < end; c++)
+        {
+            Double_t* m = &mom[c*nMom];
+            for (Long64_t n = c*chunk; n < TMath::Min((c+1)*chunk, nEvent); n++)
+            {
+                Double_t wn = evW(n);
+                m[0] += wn;
+                m[1] += wn * wn;
+                for (Int_t i = 0; i < fNDim; i++)
+                {
+                    m[2+i] += wn * evX(n, i);
+                    m[2+fNDim+i] += wn * evX(n, i) * evX(n, i);
+                }
+            }
+        }
+    }, 1);
+    std::vector<Double_t> sum(nMom, 0);
+    for (Long64_t c = 0; c < nChunk; c++)
+        for (Int_t k = 0; k < nMom; k++)
+            sum[k] += mom[c*nMom+k];
+    fSumW = sum[0];
+
+    // check events
+    if (!nEvent || fSumW <= 0)
+    {
+        Error("BuildGrid", "No events with positive sum of weights found in the ranges of the observables!");
+        return kFALSE;
+    }
+
+    // global bandwidths (rule of thumb using the effective number of events)
+    const Double_t nEff = fSumW * fSumW / sum[1];
+    const Double_t f = TMath::Power(4. / (fNDim + 2.), 1. / (fNDim + 4.)) *
+                       TMath::Power(nEff, -1. / (fNDim + 4.));
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        Double_t mean = sum[2+i] / fSumW;
+        Double_t sigma = TMath::Sqrt(TMath::Max(sum[2+fNDim+i] / fSumW - mean * mean, 0.));
+        fBandwidth[i] = fRho * sigma * f;
+        if (fBandwidth[i] <= 0)
+            fBandwidth[i] = fBinW[i];
+    }
+
+    // padded grid (covering the largest kernels)
+    Int_t pad[3];
+    Int_t nPad[3];
+    Int_t stride[3];
+    Int_t nTot = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        pad[i] = (Int_t)TMath::Ceil(fNSigma * maxScale * fBandwidth[i] / fBinW[i]);
+        pad[i] = TMath::Max(1, TMath::Min(pad[i], fNBin[i]));
+        nPad[i] = FFRooConvCache::GetGoodSize(fNBin[i] + 2*pad[i]);
+        nTot *= nPad[i];
+    }
+    for (Int_t i = fNDim-1; i >= 0; i--)
+        stride[i] = i == fNDim-1 ? 1 : stride[i+1] * nPad[i+1];
+    const Int_t nLast = nPad[fNDim-1] / 2 + 1;
+    const Int_t nCplx = nTot / nPad[fNDim-1] * nLast;
+    const Int_t nNode = 1 << fNDim;
+
+    // linear binning of the events: base nodes and fractions
+    std::vector<Int_t> evBase(nEvent);
+    std::vector<Int_t> evK0(nEvent);
+    std::vector<Double_t> evFrac(nEvent*fNDim);
+    FFFooFit::ParallelFor(nEvent, nThreads, [&](Int_t, Long64_t start, Long64_t end)
+    {
+        for (Long64_t n = start; n < end; n++)
+        {
+            Int_t base = 0;
+            for (Int_t i = 0; i < fNDim; i++)
+            {
+                Double_t u = (evX(n, i) - fMin[i]) / fBinW[i] - 0.5 + pad[i];
+                Int_t k = TMath::Min((Int_t)TMath::Floor(u), pad[i] + fNBin[i] - 1);
+                evFrac[n*fNDim+i] = u - k;
+                base += k * stride[i];
+                if (i == 0)
+                    evK0[n] = k;
+            }
+            evBase[n] = base;
+        }
+    });
+
+    // weights of the grid nodes of an event
+    auto nodeWeight = [&](Long64_t n, Int_t node, Int_t& idx) -> Double_t
+    {
+        Double_t wn = 1;
+        idx = evBase[n];
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            Double_t fr = evFrac[n*fNDim+i];
+            if (node & (1 << i))
+            {
+                wn *= fr;
+                idx += stride[i];
+            }
+            else
+            {
+                wn *= 1 - fr;
+            }
+        }
+        return wn;
+    };
+
+    // sort the events by kernel class and base node in the first dimension
+    std::vector<Int_t> evClass(nEvent, 0);
+    std::vector<Long64_t> order(nEvent);
+    std::vector<Long64_t> first(nClass*nPad[0]+1, 0);
+    auto sortEvents = [&]()
+    {
+        first.assign(nClass*nPad[0]+1, 0);
+        for (Long64_t n = 0; n < nEvent; n++)
+            first[evClass[n]*nPad[0]+evK0[n]+1]++;
+        for (Int_t k = 0; k < nClass*nPad[0]; k++)
+            first[k+1] += first[k];
+        std::vector<Long64_t> pos(first.begin(), first.end() - 1);
+        for (Long64_t n = 0; n < nEvent; n++)
+            order[pos[evClass[n]*nPad[0]+evK0[n]]++] = n;
+    };
+
+    // bin the events of a kernel class (each thread fills a slab of the grid
+    // in the first dimension, i.e. the sums do not depend on the threads)
+    std::vector<Double_t> binned(nTot);
+    auto binEvents = [&](Int_t k)
+    {
+        binned.assign(nTot, 0);
+        FFFooFit::ParallelFor(nPad[0], nThreads, [&](Int_t, Long64_t start, Long64_t end)
+        {
+            Long64_t e0 = first[k*nPad[0]+TMath::Max(start-1, 0LL)];
+            Long64_t e1 = first[k*nPad[0]+end];
+            for (Long64_t e = e0; e < e1; e++)
+            {
+                const Long64_t n = order[e];
+                for (Int_t node = 0; node < nNode; node++)
+                {
+                    Int_t k0 = evK0[n] + (node & 1);
+                    if (k0 < start || k0 >= end)
+                        continue;
+                    Int_t idx;
+                    Double_t wn = nodeWeight(n, node, idx);
+                    binned[idx] += evW(n) * wn;
+                }
+            }
+        }, 1);
+    };
+
+    // FFT plans
+    TVirtualFFT* fwd = FFRooConvCache::GetPlan(fNDim, nPad, "R2C ES");
+    TVirtualFFT* bwd = FFRooConvCache::GetPlan(fNDim, nPad, "C2R ES");
+    if (!fwd || !bwd)
+    {
+        Error("BuildGrid", "Could not create FFT!");
+        return kFALSE;
+    }
+
+    // convolve the binned events of one kernel class and add the transform
+    std::vector<Double_t> re(nTot);
+    std::vector<Double_t> im(nTot);
+    std::vector<Double_t> accRe(nCplx, 0);
+    std::vector<Double_t> accIm(nCplx, 0);
+    std::vector<Double_t> kRe[3];
+    std::vector<Double_t> kIm[3];
+    auto addClass = [&](Double_t scale) -> Bool_t
+    {
+        if (!TransformKernels(scale, nPad, pad, kRe, kIm))
+            return kFALSE;
+        fwd->SetPoints(binned.data());
+        fwd->Transform();
+        fwd->GetPointsComplex(re.data(), im.data());
+        FFFooFit::ParallelFor(nCplx, nThreads, [&](Int_t, Long64_t start, Long64_t end)
+        {
+            for (Long64_t c = start; c < end; c++)
+            {
+                Double_t pr = 1;
+                Double_t pi = 0;
+                Long64_t r = c;
+                for (Int_t i = fNDim-1; i >= 0; i--)
+                {
+                    Int_t len = i == fNDim-1 ? nLast : nPad[i];
+                    Int_t j = r % len;
+                    r /= len;
+                    Double_t t = pr * kRe[i][j] - pi * kIm[i][j];
+                    pi = pr * kIm[i][j] + pi * kRe[i][j];
+                    pr = t;
+                }
+                accRe[c] += re[c] * pr - im[c] * pi;
+                accIm[c] += re[c] * pi + im[c] * pr;
+            }
+        });
+        fNKernel++;
+        return kTRUE;
+    };
+
+    // transform back the sum of all classes
+    std::vector<Double_t> out(nTot);
+    auto transformBack = [&]()
+    {
+        bwd->SetPointsComplex(accRe.data(), accIm.data());
+        bwd->Transform();
+        bwd->GetPoints(out.data());
+        for (Int_t p = 0; p < nTot; p++)
+            out[p] /= nTot;
+    };
+
+    // fixed-width estimate
+    sortEvents();
+    binEvents(0);
+    if (!addClass(1))
+        return kFALSE;
+    transformBack();
+
+    // adaptive estimate
+    if (adaptive)
+    {
+        // pilot density at the events
+        Double_t maxOut = 0;
+        for (Int_t p = 0; p < nTot; p++)
+            maxOut = TMath::Max(maxOut, out[p]);
+        std::vector<Double_t> logF(nEvent);
+        std::vector<Double_t> part(2*nChunk, 0);
+        FFFooFit::ParallelFor(nChunk, nThreads, [&](Int_t, Long64_t start, Long64_t end)
+        {
+            for (Long64_t c = start; c < end; c++)
+            {
+                for (Long64_t n = c*chunk; n < TMath::Min((c+1)*chunk, nEvent); n++)
+                {
+                    Double_t fp = 0;
+                    for (Int_t node = 0; node < nNode; node++)
+                    {
+                        Int_t idx;
+                        Double_t wn = nodeWeight(n, node, idx);
+                        fp += wn * out[idx];
+                    }
+                    logF[n] = TMath::Log(TMath::Max(fp, 1e-10 * maxOut));
+                    part[2*c] += TMath::Abs(evW(n)) * logF[n];
+                    part[2*c+1] += TMath::Abs(evW(n));
+                }
+            }
+        }, 1);
+        Double_t sumLogF = 0;
+        Double_t sumAbsW = 0;
+        for (Long64_t c = 0; c < nChunk; c++)
+        {
+            sumLogF += part[2*c];
+            sumAbsW += part[2*c+1];
+        }
+        const Double_t logG = sumLogF / sumAbsW;
+
+        // kernel classes of the events
+        for (Long64_t n = 0; n < nEvent; n++)
+        {
+            Double_t logScale = TMath::Max(-TMath::Log(maxScale),
+                                           TMath::Min(0.5 * (logG - logF[n]), TMath::Log(maxScale)));
+            evClass[n] = TMath::Nint((logScale + TMath::Log(maxScale)) / logStep);
+        }
+        sortEvents();
+
+        // bin and convolve the events of each class
+        accRe.assign(nCplx, 0);
+        accIm.assign(nCplx, 0);
+        fNKernel = 0;
+        for (Int_t k = 0; k < nClass; k++)
+        {
+            if (first[(k+1)*nPad[0]] == first[k*nPad[0]])
+                continue;
+            binEvents(k);
+            if (!addClass(TMath::Exp(k * logStep - TMath::Log(maxScale))))
+                return kFALSE;
+        }
+        transformBack();
+    }
+
+    // mirror the density outside of the ranges at the boundaries
+    if (mirror)
+    {
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            const Int_t lo = pad[i];
+            const Int_t hi = pad[i] + fNBin[i];
+            for (Int_t p = 0; p < nTot; p++)
+            {
+                Int_t k = (p / stride[i]) % nPad[i];
+                Int_t m = -1;
+                if (k < lo)
+                    m = 2*lo - 1 - k;
+                else if (k >= hi)
+                    m = 2*hi - 1 - k;
+                else
+                    continue;
+                if (m >= lo && m < hi)
+                    out[p + (m - k) * stride[i]] += out[p];
+                out[p] = 0;
+            }
+        }
+    }
+
+    // extract the normalized density of the grid cells
+    for (Int_t c = 0; c < fNCell; c++)
+    {
+        Int_t r = c;
+        Int_t p = 0;
+        for (Int_t i = fNDim-1; i >= 0; i--)
+        {
+            p += (r % fNBin[i] + pad[i]) * stride[i];
+            r /= fNBin[i];
+        }
+        fGrid[c] = TMath::Max(out[p], 0.) / (fSumW * fBinVol);
+    }
+
+    // user info
+    Info("BuildGrid", "Tabulated kernel estimation of %lld events on %d cells using %d kernel class(es)",
+         nEvent, fNCell, fNKernel);
+
+    return kTRUE;
+}
@@ -0,0 +1,802 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooIndexedKeysPdf                                                  //
+//                                                                      //
+// N-dimensional kernel estimation pdf with truncated kernels evaluated //
+// via a spatial index.                                                 //
+//                                                                      //
+// Each event of a dataset of 1 to 3 observables is represented by a    //
+// separable Gaussian kernel truncated at 'nSigma' kernel widths in     //
+// each dimension. The bandwidths follow the rule of thumb of           //
+// RooNDKeysPdf (using the effective number of events of weighted       //
+// data). With option 'a', the kernel widths are scaled by (f/g)^-1/2   //
+// (Abramson), where f is the fixed-width pilot estimate at the event   //
+// and g the geometric mean of f. With option 'm', events close to the  //
+// range boundaries are mirrored. Kernels are not rotated along the     //
+// principal axes of the data.                                          //
+//                                                                      //
+// The kernels are grouped into classes of similar widths and sorted    //
+// into a uniform grid of cells per class with a cell width equal to    //
+// the largest kernel range of the class (enlarged if needed to limit   //
+// the grid to 262144 cells per class). The value at a point is thus    //
+// calculated from the kernels in the 3^N cells around the point of     //
+// each class only, instead of from all events.                         //
+//                                                                      //
+// If a maximum relative error is set, cells whose nearest point is     //
+// farther than one kernel width from the point are subsampled: only a  //
+// run of consecutive kernels of such a cell (stored in a fixed random  //
+// order) is summed and scaled, with their number chosen such that the  //
+// estimated standard deviation of the sum of all subsampled cells      //
+// stays below the maximum relative error times the exact contribution  //
+// of the near cells. The start of the run is derived from a hash of    //
+// the cell and of the point, i.e. the subsampling error varies between //
+// points and averages out over events, while the value at a given      //
+// point is deterministic.                                              //
+//                                                                      //
+// Integrals over any subset of the observables are calculated          //
+// analytically. EvaluateEvents() evaluates a batch of events using     //
+// FFFooFit::gUseNCPU threads.                                          //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <cstring>
+
+#include "TMath.h"
+#include "TRandom3.h"
+#include "RooArgList.h"
+#include "RooArgSet.h"
+#include "RooRealVar.h"
+#include "RooDataSet.h"
+
+#include "FFRooIndexedKeysPdf.h"
+#include "FFFooFit.h"
+
+ClassImp(FFRooIndexedKeysPdf)
+
+namespace {
+
+//______________________________________________________________________________
+ULong64_t Mix(ULong64_t z)
+{
+    // Return the hash of 'z' (finalizer of splitmix64).
+
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+}
+
+//______________________________________________________________________________
+FFRooIndexedKeysPdf::FFRooIndexedKeysPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                                         RooDataSet& data, const Char_t* opt, Double_t rho,
+                                         Int_t nSigma, Double_t maxRelErr)
+    : RooAbsPdf(name, title),
+      fObs("obs", "Observables", this)
+{
+    // Constructor using the observables 'obs' and the events of the dataset
+    // 'data'. The options 'opt' ('a': adaptive, 'm': mirror), the bandwidth
+    // scaling 'rho' and the kernel range 'nSigma' follow RooNDKeysPdf.
+    // Distant cells are subsampled if the maximum relative error 'maxRelErr'
+    // is larger than 0.
+
+    // init members
+    fObs.add(obs);
+    Init(opt, rho, nSigma, maxRelErr);
+    if (!fNDim)
+        return;
+
+    // copy events
+    const Long64_t n = data.numEntries();
+    std::vector<Double_t> x(n*fNDim);
+    std::vector<Double_t> w(n);
+    for (Long64_t i = 0; i < n; i++)
+    {
+        const RooArgSet* row = data.get(i);
+        for (Int_t j = 0; j < fNDim; j++)
+        {
+            RooAbsReal* v = (RooAbsReal*)row->find(fObs.at(j)->GetName());
+            x[i*fNDim+j] = v ? v->getVal() : 0;
+        }
+        w[i] = data.weight();
+    }
+
+    // build the kernels and the index
+    fValid = Build(n, x.data(), w.data());
+}
+
+//______________________________________________________________________________
+FFRooIndexedKeysPdf::FFRooIndexedKeysPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                                         Long64_t n, const Double_t* x, const Double_t* w,
+                                         const Char_t* opt, Double_t rho, Int_t nSigma,
+                                         Double_t maxRelErr)
+    : RooAbsPdf(name, title),
+      fObs("obs", "Observables", this)
+{
+    // Constructor using the observables 'obs' and the 'n' events having the
+    // observable values 'x' [n*nDim] and the weights 'w' [n] (unweighted if
+    // 'w' is 0). See the constructor above for the other parameters.
+
+    // init members
+    fObs.add(obs);
+    Init(opt, rho, nSigma, maxRelErr);
+
+    // build the kernels and the index
+    if (fNDim)
+        fValid = Build(n, x, w);
+}
+
+//______________________________________________________________________________
+FFRooIndexedKeysPdf::FFRooIndexedKeysPdf(const FFRooIndexedKeysPdf& other, const Char_t* name)
+    : RooAbsPdf(other, name),
+      fObs("obs", this, other.fObs)
+{
+    // Copy constructor.
+
+    // init members
+    fNDim = other.fNDim;
+    fOpt = other.fOpt;
+    fRho = other.fRho;
+    fNSigma = other.fNSigma;
+    fMaxRelErr = other.fMaxRelErr;
+    for (Int_t i = 0; i < 3; i++)
+    {
+        fMin[i] = other.fMin[i];
+        fMax[i] = other.fMax[i];
+        fBandwidth[i] = other.fBandwidth[i];
+    }
+    fSumW = other.fSumW;
+    fNKernel = other.fNKernel;
+    fKerX = other.fKerX;
+    fKerInvH = other.fKerInvH;
+    fKerW = other.fKerW;
+    fNClass = other.fNClass;
+    fClassMax = other.fClassMax;
+    fCellN = other.fCellN;
+    fCellW = other.fCellW;
+    fCellMin = other.fCellMin;
+    fCellOff = other.fCellOff;
+    fCellStart = other.fCellStart;
+    fCellMaxW = other.fCellMaxW;
+    fIntegral = other.fIntegral;
+    fValid = other.fValid;
+}
+
+//______________________________________________________________________________
+void FFRooIndexedKeysPdf::Init(const Char_t* opt, Double_t rho, Int_t nSigma, Double_t maxRelErr)
+{
+    // Init the members using the options 'opt', the bandwidth scaling 'rho',
+    // the kernel range 'nSigma' and the maximum relative error 'maxRelErr'.
+
+    fNDim = fObs.getSize();
+    fOpt = opt;
+    fOpt.ToLower();
+    fRho = rho;
+    fNSigma = nSigma > 0 ? nSigma : 1;
+    fMaxRelErr = maxRelErr > 0 ? maxRelErr : 0;
+    for (Int_t i = 0; i < 3; i++)
+    {
+        fMin[i] = 0;
+        fMax[i] = 0;
+        fBandwidth[i] = 0;
+    }
+    fSumW = 0;
+    fNKernel = 0;
+    fNClass = 0;
+    fIntegral = 0;
+    fValid = kFALSE;
+
+    // check dimensions
+    if (fNDim < 1 || fNDim > 3)
+    {
+        Error("FFRooIndexedKeysPdf", "Unsupported number of dimensions (%d)!", fNDim);
+        fNDim = 0;
+    }
+}
+
+//______________________________________________________________________________
+Bool_t FFRooIndexedKeysPdf::Build(Long64_t nEntries, const Double_t* x, const Double_t* w)
+{
+    // Build the kernels and the index of the 'nEntries' events having the
+    // observable values 'x' and the weights 'w' (unweighted if 0).
+    // Return kFALSE if no events were found, otherwise kTRUE.
+
+    // adaptive kernel classes
+    const Bool_t adaptive = fOpt.Contains("a");
+    const Double_t maxScale = 8;
+    const Int_t nClass = fgNClass;
+
+    // observable ranges
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        RooRealVar* v = (RooRealVar*)fObs.at(i);
+        fMin[i] = v->getMin();
+        fMax[i] = v->getMax();
+    }
+
+    // select events within the ranges and calculate moments
+    std::vector<Double_t> ex;
+    std::vector<Double_t> ew;
+    ex.reserve(nEntries*fNDim);
+    ew.reserve(nEntries);
+    Double_t sumW2 = 0;
+    Double_t sumX[3] = { 0, 0, 0 };
+    Double_t sumXX[3] = { 0, 0, 0 };
+    for (Long64_t e = 0; e < nEntries; e++)
+    {
+        Double_t we = w ? w[e] : 1.;
+        Bool_t inRange = we != 0;
+        for (Int_t i = 0; i < fNDim && inRange; i++)
+        {
+            Double_t v = x[e*fNDim+i];
+            if (!(v >= fMin[i] && v <= fMax[i]))
+                inRange = kFALSE;
+        }
+        if (!inRange)
+            continue;
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            Double_t v = x[e*fNDim+i];
+            ex.push_back(v);
+            sumX[i] += we * v;
+            sumXX[i] += we * v * v;
+        }
+        ew.push_back(we);
+        fSumW += we;
+        sumW2 += we * we;
+    }
+    const Long64_t nEvent = ew.size();
+
+    // check events
+    if (!nEvent || fSumW <= 0)
+    {
+        Error("Build", "No events with positive sum of weights found in the ranges of the observables!");
+        return kFALSE;
+    }
+
+    // global bandwidths (rule of thumb using the effective number of events)
+    const Double_t nEff = fSumW * fSumW / sumW2;
+    const Double_t f = TMath::Power(4. / (fNDim + 2.), 1. / (fNDim + 4.)) *
+                       TMath::Power(nEff, -1. / (fNDim + 4.));
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        Double_t mean = sumX[i] / fSumW;
+        Double_t sigma = TMath::Sqrt(TMath::Max(sumXX[i] / fSumW - mean * mean, 0.));
+        fBandwidth[i] = fRho * sigma * f;
+        if (fBandwidth[i] <= 0)
+            fBandwidth[i] = 1e-3 * (fMax[i] - fMin[i]);
+    }
+
+    // fixed-width kernels
+    std::vector<Double_t> scale(nEvent, 1.);
+    BuildIndex(nEvent, ex.data(), ew.data(), scale.data(), 1);
+
+    // adaptive kernels
+    if (adaptive)
+    {
+        // pilot density at the events (exact)
+        const Double_t maxRelErr = fMaxRelErr;
+        fMaxRelErr = 0;
+        std::vector<Double_t> pilot(nEvent);
+        FFFooFit::ParallelFor(nEvent, FFFooFit::gUseNCPU, [&](Int_t, Long64_t start, Long64_t end)
+        {
+            for (Long64_t n = start; n < end; n++)
+                pilot[n] = Evaluate(&ex[n*fNDim]);
+        });
+        fMaxRelErr = maxRelErr;
+
+        // geometric mean of the pilot density
+        Double_t maxPilot = 0;
+        for (Long64_t n = 0; n < nEvent; n++)
+            maxPilot = TMath::Max(maxPilot, pilot[n]);
+        if (maxPilot <= 0)
+        {
+            Error("Build", "Non-positive pilot density, using fixed kernel widths!");
+            fIntegral = ComputeIntegral((1 << fNDim) - 1, fMin, fMax, 0);
+            return kTRUE;
+        }
+        Double_t sumLogF = 0;
+        Double_t sumAbsW = 0;
+        for (Long64_t n = 0; n < nEvent; n++)
+        {
+            pilot[n] = TMath::Log(TMath::Max(pilot[n], 1e-10 * maxPilot));
+            sumLogF += TMath::Abs(ew[n]) * pilot[n];
+            sumAbsW += TMath::Abs(ew[n]);
+        }
+        const Double_t logG = sumLogF / sumAbsW;
+
+        // kernel scales
+        for (Long64_t n = 0; n < nEvent; n++)
+            scale[n] = TMath::Exp(TMath::Max(-TMath::Log(maxScale),
+                                             TMath::Min(0.5 * (logG - pilot[n]), TMath::Log(maxScale))));
+        BuildIndex(nEvent, ex.data(), ew.data(), scale.data(), nClass);
+    }
+
+    // integral over the full ranges
+    fIntegral = ComputeIntegral((1 << fNDim) - 1, fMin, fMax, 0);
+
+    // user info
+    Info("Build", "Indexed %lld kernels of %lld events in %lld cells of %d class(es)",
+         fNKernel, nEvent, fCellOff.back(), fNClass);
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+void FFRooIndexedKeysPdf::BuildIndex(Long64_t nEvent, const Double_t* x, const Double_t* w,
+                                     const Double_t* scale, Int_t nClass)
+{
+    // Create the kernels of the 'nEvent' events having the observable values
+    // 'x', the weights 'w' and the kernel width scales 'scale', and sort
+    // them into the cells of 'nClass' logarithmically spaced kernel width
+    // classes (covering the scales 1/8 to 8 if larger than 1). 'nClass'
+    // must not exceed fgNClass (size of the far cell buffers of Evaluate()).
+
+    // kernel width classes
+    const Double_t logMax = TMath::Log(8.);
+    const Double_t logStep = 2 * logMax / nClass;
+    auto classOf = [&](Double_t s) -> Int_t
+    {
+        if (nClass == 1)
+            return 0;
+        Int_t c = (Int_t)TMath::Floor((TMath::Log(s) + logMax) / logStep);
+        return TMath::Max(0, TMath::Min(c, nClass-1));
+    };
+    fNClass = nClass;
+    fClassMax.assign(nClass, 0);
+    for (Long64_t n = 0; n < nEvent; n++)
+    {
+        Int_t c = classOf(scale[n]);
+        fClassMax[c] = TMath::Max(fClassMax[c], scale[n]);
+    }
+
+    // kernels (including mirrored events)
+    const Bool_t mirror = fOpt.Contains("m");
+    const Double_t norm = 1. / (TMath::Sqrt(2 * TMath::Pi()) * TMath::Erf(fNSigma / TMath::Sqrt2()));
+    Int_t nComb = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+        nComb *= 3;
+    std::vector<Double_t> kx;
+    std::vector<Double_t> kh;
+    std::vector<Double_t> kw;
+    std::vector<Int_t> kc;
+    kx.reserve(nEvent*fNDim);
+    kh.reserve(nEvent*fNDim);
+    kw.reserve(nEvent);
+    kc.reserve(nEvent);
+    for (Long64_t n = 0; n < nEvent; n++)
+    {
+        // kernel widths and normalization
+        Double_t invH[3];
+        Double_t wn = w[n];
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            invH[i] = 1. / (scale[n] * fBandwidth[i]);
+            wn *= norm * invH[i];
+        }
+
+        // loop over mirror combinations (0: none, 1: lower, 2: upper boundary)
+        for (Int_t m = 0; m < (mirror ? nComb : 1); m++)
+        {
+            Double_t xm[3];
+            Bool_t valid = kTRUE;
+            for (Int_t i = 0, r = m; i < fNDim && valid; i++, r /= 3)
+            {
+                const Double_t v = x[n*fNDim+i];
+                const Double_t reach = fNSigma / invH[i];
+                if (r % 3 == 0)
+                    xm[i] = v;
+                else if (r % 3 == 1 && v - fMin[i] < reach)
+                    xm[i] = 2 * fMin[i] - v;
+                else if (r % 3 == 2 && fMax[i] - v < reach)
+                    xm[i] = 2 * fMax[i] - v;
+                else
+                    valid = kFALSE;
+            }
+            if (!valid)
+                continue;
+            for (Int_t i = 0; i < fNDim; i++)
+            {
+                kx.push_back(xm[i]);
+                kh.push_back(invH[i]);
+            }
+            kw.push_back(wn);
+            kc.push_back(classOf(scale[n]));
+        }
+    }
+    fNKernel = kw.size();
+
+    // cell grids of the classes (cells as wide as the largest kernel range
+    // plus one cell for mirrored kernels on each side, enlarged uniformly
+    // if the total number of cells of a class exceeds the maximum)
+    const Double_t maxCells = 262144;
+    fCellN.assign(nClass*fNDim, 0);
+    fCellW.assign(nClass*fNDim, 0);
+    fCellMin.assign(nClass*fNDim, 0);
+    fCellOff.assign(nClass+1, 0);
+    for (Int_t c = 0; c < nClass; c++)
+    {
+        Double_t cw[3];
+        Double_t n[3];
+        Double_t nCell = 1;
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            cw[i] = fNSigma * TMath::Max(fClassMax[c], 1e-3) * fBandwidth[i];
+            n[i] = TMath::Max(TMath::Ceil((fMax[i] - fMin[i]) / cw[i]), 1.);
+            nCell *= n[i] + 2;
+        }
+        while (nCell > maxCells)
+        {
+            const Double_t f = TMath::Max(TMath::Power(nCell / maxCells, 1. / fNDim), 1.01);
+            nCell = 1;
+            for (Int_t i = 0; i < fNDim; i++)
+            {
+                cw[i] *= f;
+                n[i] = TMath::Max(TMath::Ceil((fMax[i] - fMin[i]) / cw[i]), 1.);
+                nCell *= n[i] + 2;
+            }
+        }
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            fCellN[c*fNDim+i] = (Int_t)n[i] + 2;
+            fCellW[c*fNDim+i] = cw[i];
+            fCellMin[c*fNDim+i] = fMin[i] - cw[i];
+        }
+        fCellOff[c+1] = fCellOff[c] + (fClassMax[c] > 0 ? (Long64_t)nCell : 0);
+    }
+
+    // global cell of a kernel
+    auto cellOf = [&](Long64_t k) -> Long64_t
+    {
+        const Int_t c = kc[k];
+        Long64_t cell = 0;
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            const Int_t n = fCellN[c*fNDim+i];
+            Int_t q = (Int_t)TMath::Floor((kx[k*fNDim+i] - fCellMin[c*fNDim+i]) / fCellW[c*fNDim+i]);
+            cell = cell * n + TMath::Max(0, TMath::Min(q, n-1));
+        }
+        return fCellOff[c] + cell;
+    };
+
+    // fixed random order of the kernels (used for subsampling)
+    std::vector<Long64_t> perm(fNKernel);
+    for (Long64_t k = 0; k < fNKernel; k++)
+        perm[k] = k;
+    TRandom3 rnd(4357);
+    for (Long64_t k = fNKernel-1; k > 0; k--)
+        std::swap(perm[k], perm[(Long64_t)(rnd.Rndm() * (k + 1)) % (k + 1)]);
+
+    // sort kernels into the cells
+    const Long64_t nCellTot = fCellOff.back();
+    std::vector<Long64_t> cellOfKer(fNKernel);
+    fCellStart.assign(nCellTot+1, 0);
+    for (Long64_t k = 0; k < fNKernel; k++)
+    {
+        cellOfKer[k] = cellOf(k);
+        fCellStart[cellOfKer[k]+1]++;
+    }
+    for (Long64_t c = 0; c < nCellTot; c++)
+        fCellStart[c+1] += fCellStart[c];
+    std::vector<Long64_t> pos(fCellStart.begin(), fCellStart.end() - 1);
+    fKerX.resize(fNKernel*fNDim);
+    fKerInvH.resize(fNKernel*fNDim);
+    fKerW.resize(fNKernel);
+    fCellMaxW.assign(nCellTot, 0);
+    for (Long64_t p = 0; p < fNKernel; p++)
+    {
+        const Long64_t k = perm[p];
+        const Long64_t cell = cellOfKer[k];
+        const Long64_t d = pos[cell]++;
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            fKerX[d*fNDim+i] = kx[k*fNDim+i];
+            fKerInvH[d*fNDim+i] = kh[k*fNDim+i];
+        }
+        fKerW[d] = kw[k];
+        fCellMaxW[cell] = TMath::Max(fCellMaxW[cell], TMath::Abs(kw[k]));
+    }
+}
+
+//______________________________________________________________________________
+Double_t FFRooIndexedKeysPdf::Evaluate(const Double_t* x) const
+{
+    // Return the (unnormalized) value of the pdf at the point 'x'.
+
+    // check kernels
+    if (!fNKernel)
+        return 0;
+
+    // hash of the point (start of the subsampled kernels of far cells)
+    ULong64_t seed = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        ULong64_t b;
+        memcpy(&b, &x[i], sizeof(b));
+        seed = Mix(seed ^ b);
+    }
+
+    // sum of the kernels ['start', 'end')
+    const Double_t nSigma = fNSigma;
+    auto sumKernels = [&](Long64_t start, Long64_t end) -> Double_t
+    {
+        Double_t sum = 0;
+        for (Long64_t k = start; k < end; k++)
+        {
+            const Double_t* kx = &fKerX[k*fNDim];
+            const Double_t* kh = &fKerInvH[k*fNDim];
+            Double_t u2 = 0;
+            Bool_t inside = kTRUE;
+            for (Int_t i = 0; i < fNDim; i++)
+            {
+                Double_t u = (x[i] - kx[i]) * kh[i];
+                if (!(TMath::Abs(u) < nSigma))
+                {
+                    inside = kFALSE;
+                    break;
+                }
+                u2 += u * u;
+            }
+            if (inside)
+                sum += fKerW[k] * TMath::Exp(-0.5 * u2);
+        }
+        return sum;
+    };
+
+    // sum of 'm' consecutive kernels of a cell (wrapped around, starting at
+    // a kernel chosen by the hash of the cell and of the point if m < n)
+    auto sumCell = [&](Long64_t cell, Long64_t m) -> Double_t
+    {
+        const Long64_t start = fCellStart[cell];
+        const Long64_t n = fCellStart[cell+1] - start;
+        if (m >= n)
+            return sumKernels(start, start + n);
+        const Long64_t first = (Long64_t)(Mix(seed ^ (ULong64_t)cell) % (ULong64_t)n);
+        const Long64_t nWrap = TMath::Max(first + m - n, 0LL);
+        return sumKernels(start + first, start + first + m - nWrap) + sumKernels(start, start + nWrap);
+    };
+
+    // loop over the cells around the point of each class
+    Double_t sumNear = 0;
+    Int_t nFar = 0;
+    Long64_t farCell[fgNClass*27];
+    Double_t farMax[fgNClass*27];
+    Int_t nComb = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+        nComb *= 3;
+    for (Int_t c = 0; c < fNClass; c++)
+    {
+        // skip empty classes
+        if (fCellOff[c+1] == fCellOff[c])
+            continue;
+
+        // cell of the point
+        const Int_t* cn = &fCellN[c*fNDim];
+        const Double_t* cw = &fCellW[c*fNDim];
+        const Double_t* cmin = &fCellMin[c*fNDim];
+        Int_t q[3];
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            Double_t qi = TMath::Floor((x[i] - cmin[i]) / cw[i]);
+            q[i] = (Int_t)TMath::Max(-2., TMath::Min(qi, (Double_t)cn[i] + 1));
+        }
+
+        // loop over neighbouring cells
+        for (Int_t m = 0; m < nComb; m++)
+        {
+            Long64_t cell = 0;
+            Double_t d2 = 0;
+            Bool_t valid = kTRUE;
+            for (Int_t i = 0, r = m; i < fNDim && valid; i++, r /= 3)
+            {
+                const Int_t j = q[i] + r % 3 - 1;
+                if (j < 0 || j >= cn[i])
+                {
+                    valid = kFALSE;
+                    break;
+                }
+                cell = cell * cn[i] + j;
+
+                // distance to the cell in units of the largest kernel width
+                const Double_t lo = cmin[i] + j * cw[i];
+                const Double_t dist = TMath::Max(0., TMath::Max(lo - x[i], x[i] - lo - cw[i]));
+                const Double_t u = dist / (fClassMax[c] * fBandwidth[i]);
+                if (u >= nSigma)
+                    valid = kFALSE;
+                d2 += u * u;
+            }
+            if (!valid)
+                continue;
+            cell += fCellOff[c];
+            if (fCellStart[cell+1] == fCellStart[cell])
+                continue;
+
+            // sum near cells exactly, collect far cells
+            if (fMaxRelErr > 0 && d2 >= 1)
+            {
+                farCell[nFar] = cell;
+                farMax[nFar] = fCellMaxW[cell] * TMath::Exp(-0.5 * d2);
+                nFar++;
+            }
+            else
+            {
+                sumNear += sumCell(cell, fCellStart[cell+1] - fCellStart[cell]);
+            }
+        }
+    }
+
+    // sum far cells (subsampled if the near cells contribute)
+    Double_t sumFar = 0;
+    const Double_t tol2 = fMaxRelErr * fMaxRelErr * sumNear * sumNear;
+    for (Int_t f = 0; f < nFar; f++)
+    {
+        const Long64_t n = fCellStart[farCell[f]+1] - fCellStart[farCell[f]];
+        Long64_t m = n;
+        if (tol2 > 0)
+        {
+            Double_t req = nFar * (Double_t)n * n * farMax[f] * farMax[f] / tol2;
+            m = req < n ? TMath::Max((Long64_t)TMath::Ceil(req), 1LL) : n;
+        }
+        sumFar += sumCell(farCell[f], m) * n / m;
+    }
+
+    return (sumNear + sumFar) / fSumW;
+}
+
+//______________________________________________________________________________
+void FFRooIndexedKeysPdf::EvaluateEvents(Long64_t n, const Double_t* x, Double_t* out,
+                                         const char* rangeName) const
+{
+    // Evaluate the pdf normalized in the range 'rangeName' of the observables
+    // for the 'n' events having the observable values 'x' [n*fNDim] and store
+    // the values in 'out' [n].
+
+    // normalization
+    Double_t norm = analyticalIntegral(1 << fNDim, rangeName);
+    norm = norm > 0 ? 1. / norm : 0;
+
+    // evaluate events (slices in parallel)
+    FFFooFit::ParallelFor(n, FFFooFit::gUseNCPU, [&](Int_t, Long64_t start, Long64_t end)
+    {
+        for (Long64_t e = start; e < end; e++)
+        {
+            Bool_t inRange = kTRUE;
+            for (Int_t i = 0; i < fNDim; i++)
+                if (!(x[e*fNDim+i] >= fMin[i] && x[e*fNDim+i] <= fMax[i])) inRange = kFALSE;
+            out[e] = inRange ? TMath::Max(Evaluate(x + e*fNDim), 0.) * norm : 0;
+        }
+    }, 256);
+}
+
+//______________________________________________________________________________
+Double_t FFRooIndexedKeysPdf::evaluate() const
+{
+    // Calculate the value of the pdf.
+
+    // current point
+    Double_t x[3];
+    for (Int_t i = 0; i < fNDim; i++)
+        x[i] = ((RooAbsReal*)fObs.at(i))->getVal();
+
+    return TMath::Max(Evaluate(x), 0.);
+}
+
+//______________________________________________________________________________
+Double_t FFRooIndexedKeysPdf::ComputeIntegral(Int_t mask, const Double_t* lo, const Double_t* hi,
+                                              const Double_t* x) const
+{
+    // Calculate the integral over the observables in the bit mask 'mask' in
+    // the ranges ['lo[i]', 'hi[i]']. The other observables are fixed to the
+    // values 'x[i]'.
+
+    // partial sums per chunk of fixed size (independent of the threads)
+    const Long64_t chunk = 16384;
+    const Long64_t nChunk = (fNKernel + chunk - 1) / chunk;
+    const Double_t nSigma = fNSigma;
+    const Double_t sqrt2Pi = TMath::Sqrt(2 * TMath::Pi());
+    std::vector<Double_t> part(nChunk, 0);
+    FFFooFit::ParallelFor(nChunk, FFFooFit::gUseNCPU, [&](Int_t, Long64_t start, Long64_t end)
+    {
+        for (Long64_t c = start; c < end; c++)
+        {
+            for (Long64_t k = c*chunk; k < TMath::Min((c+1)*chunk, fNKernel); k++)
+            {
+                Double_t v = fKerW[k];
+                for (Int_t i = 0; i < fNDim && v != 0; i++)
+                {
+                    const Double_t kx = fKerX[k*fNDim+i];
+                    const Double_t kh = fKerInvH[k*fNDim+i];
+                    if (mask & (1 << i))
+                    {
+                        // integral of the truncated kernel (the weight contains its
+                        // value at the center)
+                        Double_t ulo = TMath::Max((lo[i] - kx) * kh, -nSigma);
+                        Double_t uhi = TMath::Min((hi[i] - kx) * kh, nSigma);
+                        v *= uhi > ulo ? 0.5 * sqrt2Pi / kh *
+                                         (TMath::Erf(uhi / TMath::Sqrt2()) - TMath::Erf(ulo / TMath::Sqrt2())) : 0;
+                    }
+                    else
+                    {
+                        Double_t u = (x[i] - kx) * kh;
+                        v *= TMath::Abs(u) < nSigma ? TMath::Exp(-0.5 * u * u) : 0;
+                    }
+                }
+                part[c] += v;
+            }
+        }
+    }, 1);
+
+    // sum chunks
+    Double_t sum = 0;
+    for (Long64_t c = 0; c < nChunk; c++)
+        sum += part[c];
+
+    return sum / fSumW;
+}
+
+//______________________________________________________________________________
+Int_t FFRooIndexedKeysPdf::getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars,
+                                                 const char* rangeName) const
+{
+    // Advertise the analytical integration over any subset of the
+    // observables. The integration code is 1 + bit mask of the integrated
+    // observables.
+
+    Int_t mask = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (allVars.find(*fObs.at(i)))
+        {
+            mask |= 1 << i;
+            analVars.add(*fObs.at(i));
+        }
+    }
+
+    return mask ? mask + 1 : 0;
+}
+
+//______________________________________________________________________________
+Double_t FFRooIndexedKeysPdf::analyticalIntegral(Int_t code, const char* rangeName) const
+{
+    // Calculate the integral over the observables selected by 'code' (see
+    // getAnalyticalIntegral()) in the range 'rangeName'. The other
+    // observables are fixed to their current values.
+
+    // check kernels
+    if (!fNKernel)
+        return 0;
+
+    // cached integral over the full ranges
+    const Int_t mask = code - 1;
+    if (mask == (1 << fNDim) - 1 && (!rangeName || !strcmp(rangeName, "")))
+        return fIntegral;
+
+    // integration ranges and values of the fixed observables
+    Double_t lo[3];
+    Double_t hi[3];
+    Double_t x[3];
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        RooRealVar* var = (RooRealVar*)fObs.at(i);
+        if (mask & (1 << i))
+        {
+            lo[i] = TMath::Max(var->getMin(rangeName), fMin[i]);
+            hi[i] = TMath::Min(var->getMax(rangeName), fMax[i]);
+            if (hi[i] <= lo[i])
+                return 0;
+        }
+        else
+        {
+            x[i] = var->getVal();
+        }
+    }
+
+    return ComputeIntegral(mask, lo, hi, x);
+}
@@ -13,10 +13,13 @@
 
 #include "RooAbsPdf.h"
 #include "RooRealVar.h"
+#include "TMath.h"
 
 #include "FFRooModel.h"
 #include "FFRooModelComp.h"
 #include "FFRooModelGauss.h"
+#include "FFTemplateFiller.h"
+#include "FFFooFit.h"
 
 ClassImp(FFRooModel)
 
@@ -41,8 +44,11 @@ FFRooModel::FFRooModel(const Char_t* name, const Char_t* title, Int_t nPar)
     fNConstr = 0;
     fConstr = 0;
     fIsConvol = kFALSE;
+    fConvCacheBins = 0;
     fPdfIntr = 0;
     fPdfConv = 0;
+    fBuildSig = "";
+    fIsDirty = kTRUE;
 }
 
 //______________________________________________________________________________
@@ -108,6 +114,7 @@ void FFRooModel::AddParameter(Int_t i, const Char_t* name, const Char_t* title)
             delete fPar[i];
         fPar[i] = new RooRealVar(name, title, -RooNumber::infinity(), RooNumber::infinity());
         fParIsOwned[i] = kTRUE;
+        MarkDirty();
     }
 }
 
@@ -128,6 +135,7 @@ void FFRooModel::AddVarTrans(RooAbsReal* varTrans)
     // add new element
     fVarTrans[fNVarTrans] = varTrans;
     fNVarTrans++;
+    MarkDirty();
 
     // destroy old list
     if (old)
@@ -246,6 +254,7 @@ void FFRooModel::SetParameter(Int_t i, RooAbsReal* par)
     // set external parameter
     fPar[i] = par;
     fParIsOwned[i] = kFALSE;
+    MarkDirty();
 }
 
 //______________________________________________________________________________
@@ -369,12 +378,25 @@ void FFRooModel::FixParameter(Int_t i, Double_t v)
 void FFRooModel::AddParConstrGauss(Int_t i, Double_t mean, Double_t sigma)
 {
     // Add a Gaussian fit constraint to the parameter with index 'i' using
-    // the 'mean' and 'sigma' values.
+    // the 'mean' and 'sigma' values. An existing Gaussian constraint on this
+    // parameter is updated instead of adding a second one.
 
     // check parameter index
     if (!CheckParBounds(i, "AddParConstrGauss()"))
         return;
 
+    // update existing constraint
+    for (Int_t j = 0; j < fNConstr; j++)
+    {
+        if (fConstr[j]->InheritsFrom("FFRooModelGauss") &&
+            ((FFRooModelGauss*)fConstr[j])->GetVariable() == fPar[i])
+        {
+            fConstr[j]->FixParameter(0, mean);
+            fConstr[j]->FixParameter(1, sigma);
+            return;
+        }
+    }
+
     // create constraint model
     FFRooModelGauss* c = new FFRooModelGauss(TString::Format("Gauss_Constr_Par_%s",
                                                              fPar[i]->GetName()).Data(),
@@ -392,6 +414,28 @@ void FFRooModel::AddParConstrGauss(Int_t i, Double_t mean, Double_t sigma)
     AddConstraint(c);
 }
 
+//______________________________________________________________________________
+void FFRooModel::RemoveParConstr(Int_t i)
+{
+    // Remove all Gaussian fit constraints on the parameter with index 'i'.
+
+    // check parameter index
+    if (!CheckParBounds(i, "RemoveParConstr()"))
+        return;
+
+    // loop over constraints
+    Int_t n = 0;
+    for (Int_t j = 0; j < fNConstr; j++)
+    {
+        if (fConstr[j]->InheritsFrom("FFRooModelGauss") &&
+            ((FFRooModelGauss*)fConstr[j])->GetVariable() == fPar[i])
+            delete fConstr[j];
+        else
+            fConstr[n++] = fConstr[j];
+    }
+    fNConstr = n;
+}
+
 //______________________________________________________________________________
 void FFRooModel::FindAllConstraints(TList* list)
 {
@@ -414,10 +458,121 @@ void FFRooModel::FindAllConstraints(TList* list)
 }
 
 //______________________________________________________________________________
-void FFRooModel::BuildModel(RooRealVar** vars, Int_t nVars)
+TString FFRooModel::GetFingerprint() const
+{
+    // Return a string identifying the structure of this model, i.e. the
+    // model class, the parameter names, bounds and fixed values, and the
+    // constraints. Initial values of floating parameters are not included.
+
+    // model
+    TString fp = TString::Format("%s:%s(", ClassName(), GetName());
+
+    // parameters
+    for (Int_t i = 0; i < fNPar; i++)
+    {
+        if (!fPar[i])
+            fp += "0";
+        else if (fPar[i]->InheritsFrom("RooRealVar"))
+        {
+            RooRealVar* p = (RooRealVar*)fPar[i];
+            fp += TString::Format("%s[%.12g,%.12g]", p->GetName(), p->getMin(), p->getMax());
+            if (p->isConstant())
+                fp += TString::Format("=%.12g", p->getVal());
+        }
+        else
+            fp += TString::Format("%s:%s", fPar[i]->ClassName(), fPar[i]->GetName());
+        if (i != fNPar-1)
+            fp += ",";
+    }
+    fp += TString::Format(";conv=%d;trans=%d)", fIsConvol, fNVarTrans);
+
+    // constraints
+    for (Int_t i = 0; i < fNConstr; i++)
+        fp += TString::Format("{%s}", fConstr[i]->GetFingerprint().Data());
+
+    return fp;
+}
+
+//______________________________________________________________________________
+TString FFRooModel::GetBuildSignature(RooAbsReal** vars) const
+{
+    // Return a string identifying all inputs of BuildModel() when using the
+    // variables 'vars', i.e. the variables and their ranges and binnings,
+    // and the parameter objects. If the signature did not change since the
+    // last build, the model pdf does not have to be rebuilt.
+
+    TString sig;
+
+    // variables
+    for (Int_t i = 0; i < GetNDim(); i++)
+    {
+        sig += TString::Format("%p:%s", vars[i], vars[i]->GetName());
+        if (vars[i]->InheritsFrom("RooRealVar"))
+        {
+            RooRealVar* v = (RooRealVar*)vars[i];
+            sig += TString::Format("[%.12g,%.12g,%d]", v->getMin(), v->getMax(), v->numBins());
+        }
+        sig += ";";
+    }
+
+    // parameters
+    for (Int_t i = 0; i < fNPar; i++)
+        sig += TString::Format("%p,", fPar[i]);
+
+    // variable transformations
+    for (Int_t i = 0; i < fNVarTrans; i++)
+        sig += TString::Format("%p,", fVarTrans[i]);
+
+    // convolution cache binning
+    if (fIsConvol)
+        sig += TString::Format("conv:%d;", fConvCacheBins);
+
+    return sig;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooModel::NeedsBuild(RooAbsReal** vars) const
 {
-    // Build the model using the 'nVars' variables 'vars'.
-    // (Wrapper method).
+    // Return kTRUE if the model needs to be (re)built using the variables
+    // 'vars' (see Build()), otherwise kFALSE.
+
+    return !fPdf || fIsDirty || GetBuildSignature(vars) != fBuildSig;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooModel::Build(RooAbsReal** vars)
+{
+    // Build the model using the variables 'vars' if the model pdf does not
+    // exist yet, the model was marked dirty via MarkDirty(), or if any input
+    // changed since the last build (see GetBuildSignature()). Otherwise the
+    // existing model pdf and its caches are kept.
+    // Return kTRUE if the model was rebuilt, otherwise kFALSE.
+
+    // check if a rebuild is needed
+    TString sig = GetBuildSignature(vars);
+    if (fPdf && !fIsDirty && sig == fBuildSig)
+        return kFALSE;
+
+    // fill the templates of this model and all sub-models in one pass
+    FFTemplateFiller filler(TString::Format("%s_Filler", GetName()).Data(), "Template filler");
+    PrepareTemplates(vars, filler);
+    if (filler.GetNJob())
+        filler.Fill(FFFooFit::gUseNCPU);
+
+    // build the model
+    BuildModel(vars);
+    fBuildSig = sig;
+    fIsDirty = kFALSE;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooModel::BuildModel(RooRealVar** vars, Int_t nVars)
+{
+    // Build the model using the 'nVars' variables 'vars' if any input changed
+    // since the last build (wrapper method, see Build()).
+    // Return kTRUE if the model was rebuilt, otherwise kFALSE.
 
     // convert pointers
     RooAbsReal* vars_c[nVars];
@@ -425,7 +580,70 @@ void FFRooModel::BuildModel(RooRealVar** vars, Int_t nVars)
         vars_c[i] = (RooAbsReal*) vars[i];
 
     // call main method
-    BuildModel(vars_c);
+    return Build(vars_c);
+}
+
+//______________________________________________________________________________
+void FFRooModel::EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                             Double_t min, Double_t max) const
+{
+    // Evaluate the (unnormalized) cumulative distribution function of the
+    // model pdf at the 'n' points 'x' of the variable having the range
+    // ['min','max'] and store the values in 'cdf' using the current values of
+    // the parameters. Constant offsets and factors are irrelevant.
+    // To be implemented by analytic models (see HasCDF()).
+
+    Error("EvaluateCDF", "No cumulative distribution function available for model %s!", GetName());
+    for (Int_t i = 0; i < n; i++)
+        cdf[i] = 0;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooModel::IntegrateBins(Int_t nBins, const Double_t* edges,
+                                 Double_t min, Double_t max, Double_t* integral) const
+{
+    // Calculate the integrals of the model pdf normalized in the variable range
+    // ['min','max'] in the 'nBins' bins having the edges 'edges' (nBins+1
+    // elements) using the cumulative distribution function (see EvaluateCDF()).
+    // If the bins cover the full range, only nBins+1 evaluations are needed.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // check for cumulative distribution function
+    if (!HasCDF())
+        return kFALSE;
+
+    // check if range bounds need to be evaluated separately
+    Bool_t fullRange = edges[0] == min && edges[nBins] == max;
+    Int_t n = fullRange ? nBins+1 : nBins+3;
+
+    // evaluation points (edges clamped to the range, range bounds)
+    Double_t* x = new Double_t[n];
+    Double_t* cdf = new Double_t[n];
+    for (Int_t i = 0; i <= nBins; i++)
+        x[i] = TMath::Min(TMath::Max(edges[i], min), max);
+    if (!fullRange)
+    {
+        x[nBins+1] = min;
+        x[nBins+2] = max;
+    }
+
+    // evaluate cumulative distribution function
+    EvaluateCDF(n, x, cdf, min, max);
+
+    // calculate normalized bin integrals
+    Double_t norm = fullRange ? cdf[nBins] - cdf[0] : cdf[nBins+2] - cdf[nBins+1];
+    Bool_t res = norm > 0 && TMath::Finite(norm);
+    if (res)
+    {
+        for (Int_t i = 0; i < nBins; i++)
+            integral[i] = (cdf[i+1] - cdf[i]) / norm;
+    }
+
+    // clean-up
+    delete [] x;
+    delete [] cdf;
+
+    return res;
 }
 
 //______________________________________________________________________________
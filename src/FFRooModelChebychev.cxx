@@ -13,6 +13,7 @@
 
 
 #include "RooChebychev.h"
+#include "TMath.h"
 
 #include "FFRooModelChebychev.h"
 
@@ -47,3 +48,46 @@ void FFRooModelChebychev::BuildModel(RooAbsReal** vars)
     fPdf = new RooChebychev(GetName(), GetTitle(), *vars[0], coeffList);
 }
 
+//______________________________________________________________________________
+void FFRooModelChebychev::EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                                      Double_t min, Double_t max) const
+{
+    // Evaluate the cumulative distribution function at the 'n' points 'x'
+    // (see FFRooModel::EvaluateCDF()). The polynomials are defined on the
+    // variable range ['min','max'] mapped to [-1,1], the common factor
+    // (max-min)/2 is omitted.
+
+    // coefficients (order 0 is fixed to 1)
+    Double_t* c = new Double_t[fNPar+1];
+    c[0] = 1;
+    for (Int_t i = 0; i < fNPar; i++)
+        c[i+1] = GetParameter(i);
+
+    // Chebychev polynomials up to order fNPar+1
+    Double_t* t = new Double_t[fNPar+2];
+
+    // loop over points
+    for (Int_t i = 0; i < n; i++)
+    {
+        // map to [-1,1]
+        Double_t u = (2*x[i] - (max + min)) / (max - min);
+
+        // polynomials
+        t[0] = 1;
+        t[1] = u;
+        for (Int_t k = 2; k <= fNPar+1; k++)
+            t[k] = 2*u*t[k-1] - t[k-2];
+
+        // integrals of the polynomials
+        Double_t v = c[0] * t[1];
+        if (fNPar >= 1)
+            v += c[1] * 0.5 * u * u;
+        for (Int_t k = 2; k <= fNPar; k++)
+            v += c[k] * 0.5 * (t[k+1] / (k + 1) - t[k-1] / (k - 1));
+        cdf[i] = v;
+    }
+
+    // clean-up
+    delete [] c;
+    delete [] t;
+}
@@ -12,6 +12,7 @@
 
 
 #include "RooRealVar.h"
+#include "TMath.h"
 
 #include "FFRooModelComp.h"
 
@@ -60,6 +61,7 @@ void FFRooModelComp::SetModelList(FFRooModel** list)
         // set model pointer
         fModelList[i] = list[i];
     }
+    MarkDirty();
 }
 
 //______________________________________________________________________________
@@ -68,8 +70,78 @@ void FFRooModelComp::SetModel(Int_t i, FFRooModel* model)
     // Set the pointer to the model with index 'i' to 'model'.
 
     // check model index
-    if (CheckModelBounds(i, "SetModel()"))
+    if (CheckModelBounds(i, "SetModel()") && fModelList[i] != model)
+    {
         fModelList[i] = model;
+        MarkDirty();
+    }
+}
+
+//______________________________________________________________________________
+Int_t FFRooModelComp::GetNDim() const
+{
+    // Return the number of variables used by this model, i.e. the maximum
+    // number of variables used by the sub-models taking into account the
+    // variable offsets of the sub-models.
+
+    Int_t n = 0;
+    for (Int_t i = 0; i < fNModel; i++)
+    {
+        if (fModelList[i])
+            n = TMath::Max(n, GetModelVarOffset(i) + fModelList[i]->GetNDim());
+    }
+
+    return n;
+}
+
+//______________________________________________________________________________
+TString FFRooModelComp::GetBuildSignature(RooAbsReal** vars) const
+{
+    // Return a string identifying all inputs of BuildModel() when using the
+    // variables 'vars' including the build signatures and states of all
+    // sub-models.
+
+    // this model
+    TString sig = FFRooModel::GetBuildSignature(vars);
+
+    // sub-models
+    for (Int_t i = 0; i < fNModel; i++)
+    {
+        if (fModelList[i])
+        {
+            sig += TString::Format("[%p:%p:%d:%s]", fModelList[i], fModelList[i]->GetPdf(),
+                                   fModelList[i]->IsDirty(),
+                                   fModelList[i]->GetBuildSignature(vars + GetModelVarOffset(i)).Data());
+        }
+        else
+        {
+            sig += "[0]";
+        }
+    }
+
+    return sig;
+}
+
+//______________________________________________________________________________
+TString FFRooModelComp::GetFingerprint() const
+{
+    // Return a string identifying the structure of this model including
+    // all sub-models.
+
+    // this model
+    TString fp = FFRooModel::GetFingerprint();
+
+    // sub-models
+    fp += "[";
+    for (Int_t i = 0; i < fNModel; i++)
+    {
+        fp += fModelList[i] ? fModelList[i]->GetFingerprint() : TString("0");
+        if (i != fNModel-1)
+            fp += ",";
+    }
+    fp += "]";
+
+    return fp;
 }
 
 //______________________________________________________________________________
@@ -92,3 +164,16 @@ Bool_t FFRooModelComp::CheckModelBounds(Int_t mod, const Char_t* loc) const
     }
 }
 
+//______________________________________________________________________________
+void FFRooModelComp::PrepareTemplates(RooAbsReal** vars, FFTemplateFiller& filler)
+{
+    // Register the template histograms of all sub-models needing a rebuild
+    // using the variables 'vars' in the template filler 'filler'.
+
+    for (Int_t i = 0; i < fNModel; i++)
+    {
+        if (fModelList[i] && fModelList[i]->NeedsBuild(vars + GetModelVarOffset(i)))
+            fModelList[i]->PrepareTemplates(vars + GetModelVarOffset(i), filler);
+    }
+}
+
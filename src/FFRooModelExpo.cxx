@@ -11,7 +11,10 @@
 //////////////////////////////////////////////////////////////////////////
 
 
+#include <cmath>
+
 #include "RooExponential.h"
+#include "TMath.h"
 
 #include "FFRooModelExpo.h"
 
@@ -39,3 +42,31 @@ void FFRooModelExpo::BuildModel(RooAbsReal** vars)
     fPdf = new RooExponential(GetName(), GetTitle(), *vars[0], *fPar[0]);
 }
 
+//______________________________________________________________________________
+void FFRooModelExpo::EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                                 Double_t min, Double_t max) const
+{
+    // Evaluate the cumulative distribution function at the 'n' points 'x'
+    // (see FFRooModel::EvaluateCDF()). The function is evaluated relative to
+    // the point of the largest exponent to avoid overflows, and via expm1()
+    // to keep the differences accurate for small slopes.
+
+    const Double_t c = GetParameter(0);
+
+    // find the point of the largest exponent
+    Double_t ref = x[0];
+    for (Int_t i = 1; i < n; i++)
+        if (c * x[i] > c * ref) ref = x[i];
+
+    // flat distribution
+    if (c == 0)
+    {
+        for (Int_t i = 0; i < n; i++)
+            cdf[i] = x[i] - ref;
+        return;
+    }
+
+    // evaluate
+    for (Int_t i = 0; i < n; i++)
+        cdf[i] = std::expm1(c * (x[i] - ref)) / c;
+}
@@ -12,6 +12,7 @@
 
 
 #include "RooGaussian.h"
+#include "TMath.h"
 
 #include "FFRooModelGauss.h"
 
@@ -23,6 +24,9 @@ FFRooModelGauss::FFRooModelGauss(const Char_t* name, const Char_t* title)
 {
     // Constructor.
 
+    // init members
+    fVar = 0;
+
     // add the mean parameter
     TString tmp = TString::Format("%s_Mean", GetName());
     AddParameter(0, tmp.Data(), tmp.Data());
@@ -41,5 +45,18 @@ void FFRooModelGauss::BuildModel(RooAbsReal** vars)
     if (fPdf)
         delete fPdf;
     fPdf = new RooGaussian(GetName(), GetTitle(), *vars[0], *fPar[0], *fPar[1]);
+    fVar = vars[0];
 }
 
+//______________________________________________________________________________
+void FFRooModelGauss::EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                                  Double_t min, Double_t max) const
+{
+    // Evaluate the cumulative distribution function at the 'n' points 'x'
+    // (see FFRooModel::EvaluateCDF()).
+
+    const Double_t mean = GetParameter(0);
+    const Double_t f = 1. / (TMath::Sqrt2() * TMath::Abs(GetParameter(1)));
+    for (Int_t i = 0; i < n; i++)
+        cdf[i] = 0.5 * TMath::Erf((x[i] - mean) * f);
+}
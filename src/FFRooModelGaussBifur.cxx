@@ -12,6 +12,7 @@
 
 
 #include "RooBifurGauss.h"
+#include "TMath.h"
 
 #include "FFRooModelGaussBifur.h"
 
@@ -47,3 +48,21 @@ void FFRooModelGaussBifur::BuildModel(RooAbsReal** vars)
     fPdf = new RooBifurGauss(GetName(), GetTitle(), *vars[0], *fPar[0], *fPar[1], *fPar[2]);
 }
 
+//______________________________________________________________________________
+void FFRooModelGaussBifur::EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                                       Double_t min, Double_t max) const
+{
+    // Evaluate the cumulative distribution function at the 'n' points 'x'
+    // (see FFRooModel::EvaluateCDF()). The common factor sqrt(pi/2) of both
+    // halves is omitted.
+
+    const Double_t mean = GetParameter(0);
+    const Double_t sigmaL = TMath::Abs(GetParameter(1));
+    const Double_t sigmaR = TMath::Abs(GetParameter(2));
+    for (Int_t i = 0; i < n; i++)
+    {
+        Double_t d = x[i] - mean;
+        Double_t s = d < 0 ? sigmaL : sigmaR;
+        cdf[i] = s * TMath::Erf(d / (TMath::Sqrt2() * s));
+    }
+}
@@ -11,16 +11,26 @@
 //////////////////////////////////////////////////////////////////////////
 
 
+#include <vector>
+
 #include "TH2.h"
 #include "TH3.h"
+#include "TFile.h"
 #include "TTree.h"
+#include "TChain.h"
+#include "TSystem.h"
 #include "RooRealVar.h"
+#include "RooAbsBinning.h"
+#include "RooArgList.h"
 #include "RooDataHist.h"
 #include "RooHistPdf.h"
-#include "RooGaussModel.h"
-#include "RooFFTConvPdf.h"
 
 #include "FFRooModelHist.h"
+#include "FFTemplateFiller.h"
+#include "FFRooSparseHistPdf.h"
+#include "FFRooGridConvPdf.h"
+#include "FFRooTemplatePdf.h"
+#include "FFFooFit.h"
 
 ClassImp(FFRooModelHist)
 
@@ -38,6 +48,11 @@ FFRooModelHist::FFRooModelHist(const Char_t* name, const Char_t* title, TH1* his
     fWeightVar = "";
     fInterpolOrder = intOrder;
     fDataHist = 0;
+    fHistNew = kFALSE;
+    fSparse = kFALSE;
+    fSparseHist = 0;
+    fUseCache = kFALSE;
+    fHistCached = kFALSE;
     fIsConvol = gaussConvol;
     if (fIsConvol)
         AddGaussConvolPars();
@@ -59,6 +74,11 @@ FFRooModelHist::FFRooModelHist(const Char_t* name, const Char_t* title, Int_t nD
     if (weightVar)
         fWeightVar = weightVar;
     fDataHist = 0;
+    fHistNew = kFALSE;
+    fSparse = kFALSE;
+    fSparseHist = 0;
+    fUseCache = kFALSE;
+    fHistCached = kFALSE;
     fIsConvol = gaussConvol;
     if (fIsConvol)
         AddGaussConvolPars();
@@ -80,6 +100,11 @@ FFRooModelHist::FFRooModelHist(const Char_t* name, const Char_t* title, Int_t nD
     if (weightVar)
         fWeightVar = weightVar;
     fDataHist = 0;
+    fHistNew = kFALSE;
+    fSparse = kFALSE;
+    fSparseHist = 0;
+    fUseCache = kFALSE;
+    fHistCached = kFALSE;
     fIsConvol = kTRUE;
 
     // set Gaussian convolution parameters
@@ -98,6 +123,59 @@ FFRooModelHist::~FFRooModelHist()
         delete fTree;
     if (fDataHist)
         delete fDataHist;
+    if (fSparseHist)
+        delete fSparseHist;
+}
+
+//______________________________________________________________________________
+TString FFRooModelHist::GetFingerprint() const
+{
+    // Return a string identifying the structure of this model including
+    // the source of the histogram.
+
+    // this model
+    TString fp = FFRooModel::GetFingerprint();
+
+    // histogram source
+    if (fTree)
+        fp += TString::Format("<tree:%s;%lld;%s;dim=%d;int=%d;sparse=%d>", fTree->GetName(),
+                              fTree->GetEntries(), fWeightVar.Data(), fNDim, fInterpolOrder, IsSparse());
+    else if (fHist)
+        fp += TString::Format("<hist:%s;%d;%.12g;dim=%d;int=%d>", fHist->GetName(),
+                              fHist->GetNcells(), fHist->GetSumOfWeights(), fNDim, fInterpolOrder);
+
+    return fp;
+}
+
+//______________________________________________________________________________
+TString FFRooModelHist::GetBuildSignature(RooAbsReal** vars) const
+{
+    // Return a string identifying all inputs of BuildModel() when using the
+    // variables 'vars' including the histogram source, the interpolation
+    // order and the ranges of the convolution parameters.
+
+    // this model
+    TString sig = FFRooModel::GetBuildSignature(vars);
+
+    // histogram source
+    if (fTree)
+        sig += TString::Format("tree:%p:%lld:%s;", fTree, fTree->GetEntries(), fWeightVar.Data());
+    else
+        sig += TString::Format("hist:%p;", fHist);
+    sig += TString::Format("int:%d;sparse:%d;", fInterpolOrder, IsSparse());
+
+    // ranges of convolution parameters (histogram binning)
+    if (fIsConvol)
+    {
+        for (Int_t i = 0; i < fNPar; i++)
+        {
+            if (fPar[i]->InheritsFrom("RooRealVar"))
+                sig += TString::Format("[%.12g,%.12g]", ((RooRealVar*)fPar[i])->getMin(),
+                                       ((RooRealVar*)fPar[i])->getMax());
+        }
+    }
+
+    return sig;
 }
 
 //______________________________________________________________________________
@@ -154,6 +232,389 @@ void FFRooModelHist::AddGaussConvolPars()
     }
 }
 
+//______________________________________________________________________________
+TString FFRooModelHist::GetTemplateName(RooAbsReal** vars) const
+{
+    // Return the name of the histogram of the unbinned input data using the
+    // variables 'vars'.
+
+    TString name = "hist";
+    for (Int_t i = 0; i < fNDim; i++)
+        name += TString::Format("_%s", vars[i]->GetName());
+    name += TString::Format("_%s", GetName());
+
+    return name;
+}
+
+//______________________________________________________________________________
+TString FFRooModelHist::GetTemplateFingerprint(RooAbsReal** vars, const Int_t* nBin,
+                                               const Double_t* min, const Double_t* max) const
+{
+    // Return a string identifying the histogram of the unbinned input data
+    // using the variables 'vars' and the binning 'nBin', 'min' and 'max',
+    // i.e. the input files with their modification times and sizes, the
+    // tree and weight variable names, the variable names and the binning.
+    // Return an empty string if the input files cannot be identified
+    // (e.g. remote files or trees in memory).
+
+    // input files
+    std::vector<TString> files;
+    if (fTree->InheritsFrom("TChain"))
+    {
+        TObjArray* list = ((TChain*)fTree)->GetListOfFiles();
+        for (Int_t i = 0; i < list->GetEntriesFast(); i++)
+            files.push_back(list->At(i)->GetTitle());
+    }
+    else if (fTree->GetCurrentFile())
+    {
+        files.push_back(fTree->GetCurrentFile()->GetName());
+    }
+    if (files.empty())
+        return "";
+
+    // file names, modification times and sizes
+    TString fp = TString::Format("tree:%s;", fTree->GetName());
+    for (UInt_t i = 0; i < files.size(); i++)
+    {
+        FileStat_t stat;
+        if (gSystem->GetPathInfo(files[i].Data(), stat))
+            return "";
+        fp += TString::Format("%s:%ld:%lld;", files[i].Data(), stat.fMtime, stat.fSize);
+    }
+
+    // weight, variables and binning
+    fp += TString::Format("weight:%s;", fWeightVar.Data());
+    for (Int_t i = 0; i < fNDim; i++)
+        fp += TString::Format("%s[%d,%.12g,%.12g];", vars[i]->GetName(), nBin[i], min[i], max[i]);
+
+    return fp;
+}
+
+//______________________________________________________________________________
+TString FFRooModelHist::GetTemplateCacheFile(const Char_t* fp) const
+{
+    // Return the path of the template cache file for the fingerprint 'fp'.
+
+    return TString::Format("%s/template_%s.root", FFFooFit::GetCacheDirectory().Data(),
+                           FFFooFit::MD5(fp).Data());
+}
+
+//______________________________________________________________________________
+Bool_t FFRooModelHist::LoadCachedTemplate(RooAbsReal** vars, const Char_t* fp)
+{
+    // Load the histogram of the unbinned input data using the variables
+    // 'vars' with the fingerprint 'fp' and the derived RooFit histogram from
+    // the template cache (see FFFooFit::GetCacheDirectory()).
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // check cache file
+    TString file = GetTemplateCacheFile(fp);
+    if (!FFFooFit::FileExists(file.Data()))
+        return kFALSE;
+
+    // open the cache file
+    TFile* f = TFile::Open(file.Data());
+    if (!f || f->IsZombie())
+    {
+        Warning("LoadCachedTemplate", "Could not open cache file '%s'!", file.Data());
+        if (f) delete f;
+        return kFALSE;
+    }
+
+    // read histogram and check fingerprint against hash collisions
+    TH1* hist = 0;
+    RooDataHist* dataHist = 0;
+    TNamed* fpc = 0;
+    f->GetObject("template", hist);
+    f->GetObject("datahist", dataHist);
+    f->GetObject("fingerprint", fpc);
+    if (!hist || !fpc || fpc->GetTitle() != TString(fp) || hist->GetDimension() != fNDim)
+    {
+        Warning("LoadCachedTemplate", "Invalid cache file '%s'!", file.Data());
+        if (dataHist) delete dataHist;
+        delete f;
+        return kFALSE;
+    }
+
+    // take ownership
+    hist->SetDirectory(0);
+    hist->SetName(GetTemplateName(vars).Data());
+    fHist = hist;
+    if (fDataHist)
+        delete fDataHist;
+    fDataHist = dataHist;
+    fHistCached = kTRUE;
+
+    // user info
+    Info("LoadCachedTemplate", "Loaded histogram '%s' from template cache '%s'",
+         fHist->GetName(), file.Data());
+
+    // clean-up
+    delete fpc;
+    delete f;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooModelHist::SaveCachedTemplate(RooAbsReal** vars)
+{
+    // Save the histogram of the unbinned input data using the variables
+    // 'vars' and the derived RooFit histogram to the template cache.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // calculate fingerprint
+    Int_t nbin[3] = { 0, 0, 0 };
+    Double_t min[3] = { 0, 0, 0 };
+    Double_t max[3] = { 0, 0, 0 };
+    TAxis* haxes[3] = { fHist->GetXaxis(), fHist->GetYaxis(), fHist->GetZaxis() };
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        nbin[i] = haxes[i]->GetNbins();
+        min[i] = haxes[i]->GetXmin();
+        max[i] = haxes[i]->GetXmax();
+    }
+    TString fp = GetTemplateFingerprint(vars, nbin, min, max);
+    if (fp == "")
+        return kFALSE;
+    TString dir = FFFooFit::GetCacheDirectory();
+    TString file = GetTemplateCacheFile(fp.Data());
+
+    // create cache directory
+    if (!FFFooFit::FileExists(dir.Data()) && gSystem->mkdir(dir.Data(), kTRUE))
+    {
+        Warning("SaveCachedTemplate", "Could not create cache directory '%s'!", dir.Data());
+        return kFALSE;
+    }
+
+    // write to temporary file
+    TString tmp = TString::Format("%s.%d.tmp", file.Data(), gSystem->GetPid());
+    TFile* f = new TFile(tmp.Data(), "RECREATE");
+    if (!f || f->IsZombie())
+    {
+        Warning("SaveCachedTemplate", "Could not create cache file '%s'!", tmp.Data());
+        if (f) delete f;
+        return kFALSE;
+    }
+    TNamed fpc("fingerprint", fp.Data());
+    fpc.Write("fingerprint");
+    fHist->Write("template");
+    if (fDataHist)
+        fDataHist->Write("datahist");
+    delete f;
+
+    // move to final location (atomic w.r.t. concurrent fits)
+    if (gSystem->Rename(tmp.Data(), file.Data()))
+    {
+        Warning("SaveCachedTemplate", "Could not write cache file '%s'!", file.Data());
+        gSystem->Unlink(tmp.Data());
+        return kFALSE;
+    }
+
+    // user info
+    Info("SaveCachedTemplate", "Histogram '%s' cached in '%s'", fHist->GetName(), file.Data());
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+void FFRooModelHist::PrepareTemplates(RooAbsReal** vars, FFTemplateFiller& filler)
+{
+    // Create the histogram of the unbinned input data using the variables
+    // 'vars' and register its filling in the template filler 'filler'.
+    // The histogram of a previous build is reused if its binning did not
+    // change. If enabled via SetTemplateCache(), the histogram is loaded
+    // from the template cache (see FFFooFit::GetCacheDirectory()) instead
+    // of being filled if the input files did not change, and newly filled
+    // histograms are saved to the cache in BuildModel().
+
+    // check unbinned input data
+    if (!fTree)
+        return;
+
+    // sparse N-dimensional histogram
+    if (IsSparse())
+    {
+        PrepareSparseTemplate(vars, filler);
+        return;
+    }
+
+    // check dimension
+    if (fNDim < 1 || fNDim > 3)
+    {
+        Error("PrepareTemplates", "Cannot convert unbinned input data of dimension %d!", fNDim);
+        return;
+    }
+
+    // check if variables can be down-casted
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (!vars[i]->InheritsFrom("RooRealVar"))
+            return;
+    }
+    for (Int_t i = 0; i < fNPar; i++)
+    {
+        if (!fPar[i]->InheritsFrom("RooRealVar"))
+            return;
+    }
+
+    // calculate the binning
+    Int_t nbin[3] = { 0, 0, 0 };
+    Double_t min[3] = { 0, 0, 0 };
+    Double_t max[3] = { 0, 0, 0 };
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (fIsConvol)
+            DetermineHistoBinning((RooRealVar*)vars[i], (RooRealVar*)fPar[2*i], nbin+i, min+i, max+i);
+        else
+            DetermineHistoBinning((RooRealVar*)vars[i], 0, nbin+i, min+i, max+i);
+    }
+
+    // check if the histogram of a previous build can be reused
+    if (fHist)
+    {
+        Bool_t reuse = GetTemplateName(vars) == fHist->GetName();
+        TAxis* haxes[3] = { fHist->GetXaxis(), fHist->GetYaxis(), fHist->GetZaxis() };
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            if (haxes[i]->GetNbins() != nbin[i] ||
+                haxes[i]->GetXmin() != min[i] ||
+                haxes[i]->GetXmax() != max[i])
+                reuse = kFALSE;
+        }
+        if (reuse)
+        {
+            if (!fHistNew)
+                Info("PrepareTemplates", "Reusing histogram '%s'", fHist->GetName());
+            return;
+        }
+        else
+        {
+            delete fHist;
+            fHist = 0;
+            fHistCached = kFALSE;
+        }
+    }
+
+    // load the histogram from the template cache
+    if (fUseCache)
+    {
+        TString fp = GetTemplateFingerprint(vars, nbin, min, max);
+        if (fp != "" && LoadCachedTemplate(vars, fp.Data()))
+        {
+            fHistNew = kTRUE;
+            return;
+        }
+    }
+
+    // create the histogram
+    if (fNDim == 1)
+    {
+        fHist = new TH1F(GetTemplateName(vars).Data(),
+                         TString::Format("Histogram variable '%s' of species '%s'",
+                         vars[0]->GetTitle(), GetTitle()).Data(),
+                         nbin[0], min[0], max[0]);
+    }
+    else if (fNDim == 2)
+    {
+        fHist = new TH2F(GetTemplateName(vars).Data(),
+                         TString::Format("Histogram variables '%s' and '%s' of species '%s'",
+                         vars[0]->GetTitle(), vars[1]->GetTitle(), GetTitle()).Data(),
+                         nbin[0], min[0], max[0],
+                         nbin[1], min[1], max[1]);
+    }
+    else
+    {
+        fHist = new TH3F(GetTemplateName(vars).Data(),
+                         TString::Format("Histogram variables '%s', '%s' and '%s' of species '%s'",
+                         vars[0]->GetTitle(), vars[1]->GetTitle(), vars[2]->GetTitle(), GetTitle()).Data(),
+                         nbin[0], min[0], max[0],
+                         nbin[1], min[1], max[1],
+                         nbin[2], min[2], max[2]);
+    }
+
+    // register the filling of the histogram
+    const Char_t* names[3];
+    for (Int_t i = 0; i < fNDim; i++)
+        names[i] = vars[i]->GetName();
+    filler.AddJob(fHist, fTree, fNDim, names, fWeightVar.Data());
+    fHistNew = kTRUE;
+}
+
+//______________________________________________________________________________
+void FFRooModelHist::PrepareSparseTemplate(RooAbsReal** vars, FFTemplateFiller& filler)
+{
+    // Create the sparse histogram of the unbinned input data using the
+    // variables 'vars' and register its filling in the template filler
+    // 'filler'. The sparse histogram of a previous build is reused if its
+    // binning did not change.
+
+    // check convolution
+    if (fIsConvol)
+    {
+        Error("PrepareTemplates", "Convolution of sparse histograms is not supported!");
+        return;
+    }
+
+    // check if variables can be down-casted
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (!vars[i]->InheritsFrom("RooRealVar"))
+            return;
+    }
+
+    // calculate the binning
+    Int_t nbin[fNDim];
+    Double_t min[fNDim];
+    Double_t max[fNDim];
+    for (Int_t i = 0; i < fNDim; i++)
+        DetermineHistoBinning((RooRealVar*)vars[i], 0, nbin+i, min+i, max+i);
+
+    // check if the histogram of a previous build can be reused
+    if (fSparseHist)
+    {
+        if (fSparseHist->HasObservables(vars) && fSparseHist->HasBinning(nbin, min, max) &&
+            fSparseHist->GetInterpolationOrder() == fInterpolOrder)
+        {
+            if (!fHistNew)
+                Info("PrepareTemplates", "Reusing sparse histogram '%s'", fSparseHist->GetName());
+            return;
+        }
+        else
+        {
+            delete fSparseHist;
+            fSparseHist = 0;
+        }
+    }
+
+    // create the sparse histogram
+    RooArgList obs;
+    TString name = "shist";
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        obs.add(*vars[i]);
+        name += TString::Format("_%s", vars[i]->GetName());
+    }
+    name += TString::Format("_%s", GetName());
+    fSparseHist = new FFRooSparseHistPdf(name.Data(),
+                                         TString::Format("Sparse histogram of species '%s'", GetTitle()).Data(),
+                                         obs, nbin, min, max, fInterpolOrder);
+
+    // register the filling of the histogram
+    const Char_t* names[fNDim];
+    for (Int_t i = 0; i < fNDim; i++)
+        names[i] = vars[i]->GetName();
+    filler.AddJob(fSparseHist, fTree, fNDim, names, fWeightVar.Data());
+    fHistNew = kTRUE;
+
+    // user info
+    Long64_t nCell = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+        nCell *= nbin[i];
+    Info("PrepareTemplates", "Using sparse histogram '%s' with %lld bins in %d dimensions",
+         fSparseHist->GetName(), nCell, fNDim);
+}
+
 //______________________________________________________________________________
 void FFRooModelHist::BuildModel(RooAbsReal** vars)
 {
@@ -184,158 +645,76 @@ void FFRooModelHist::BuildModel(RooAbsReal** vars)
         }
     }
 
-    // create binned input data
-    if (!fHist && fTree)
+    // fill binned input data from unbinned input data if needed
+    Bool_t saveCache = kFALSE;
+    if (fTree)
     {
-        // check dimension
-        if (fNDim == 1)
-        {
-            // calculate the binning
-            Int_t nbin_0 = 0;
-            Double_t min_0 = 0, max_0 = 0;
-            if (fIsConvol)
-                DetermineHistoBinning((RooRealVar*)vars[0], (RooRealVar*)fPar[0], &nbin_0, &min_0, &max_0);
-            else
-                DetermineHistoBinning((RooRealVar*)vars[0], 0, &nbin_0, &min_0, &max_0);
-
-            // create the histogram
-            fHist = new TH1F(TString::Format("hist_%s_%s",
-                                             vars[0]->GetName(),
-                                             GetName()).Data(),
-                             TString::Format("Histogram variable '%s' of species '%s'",
-                             vars[0]->GetTitle(), GetTitle()).Data(),
-                             nbin_0, min_0, max_0);
-
-            // fill the histogram
-            fTree->Draw(TString::Format("%s>>hist_%s_%s",
-                                        vars[0]->GetName(),
-                                        vars[0]->GetName(),
-                                        GetName()).Data(),
-                        fWeightVar.Data());
-        }
-        else if (fNDim == 2)
-        {
-            // calculate the binning
-            Int_t nbin_0 = 0;
-            Int_t nbin_1 = 0;
-            Double_t min_0 = 0, max_0 = 0;
-            Double_t min_1 = 0, max_1 = 0;
-            if (fIsConvol)
-            {
-                DetermineHistoBinning((RooRealVar*)vars[0], (RooRealVar*)fPar[0], &nbin_0, &min_0, &max_0);
-                DetermineHistoBinning((RooRealVar*)vars[1], (RooRealVar*)fPar[2], &nbin_1, &min_1, &max_1);
-            }
-            else
-            {
-                DetermineHistoBinning((RooRealVar*)vars[0], 0, &nbin_0, &min_0, &max_0);
-                DetermineHistoBinning((RooRealVar*)vars[1], 0, &nbin_1, &min_1, &max_1);
-            }
-
-            // create the histogram
-            fHist = new TH2F(TString::Format("hist_%s_%s_%s",
-                                             vars[0]->GetName(),
-                                             vars[1]->GetName(),
-                                             GetName()).Data(),
-                             TString::Format("Histogram variables '%s' and '%s' of species '%s'",
-                             vars[0]->GetTitle(), vars[1]->GetTitle(), GetTitle()).Data(),
-                             nbin_0, min_0, max_0,
-                             nbin_1, min_1, max_1);
-
-            // fill the histogram
-            fTree->Draw(TString::Format("%s:%s>>hist_%s_%s_%s",
-                                        vars[1]->GetName(),
-                                        vars[0]->GetName(),
-                                        vars[0]->GetName(),
-                                        vars[1]->GetName(),
-                                        GetName()).Data(),
-                        fWeightVar.Data());
-        }
-        else if (fNDim == 3)
-        {
-            // calculate the binning
-            Int_t nbin_0 = 0;
-            Int_t nbin_1 = 0;
-            Int_t nbin_2 = 0;
-            Double_t min_0 = 0, max_0 = 0;
-            Double_t min_1 = 0, max_1 = 0;
-            Double_t min_2 = 0, max_2 = 0;
-            if (fIsConvol)
-            {
-                DetermineHistoBinning((RooRealVar*)vars[0], (RooRealVar*)fPar[0], &nbin_0, &min_0, &max_0);
-                DetermineHistoBinning((RooRealVar*)vars[1], (RooRealVar*)fPar[2], &nbin_1, &min_1, &max_1);
-                DetermineHistoBinning((RooRealVar*)vars[2], (RooRealVar*)fPar[4], &nbin_2, &min_2, &max_2);
-            }
-            else
-            {
-                DetermineHistoBinning((RooRealVar*)vars[0], 0, &nbin_0, &min_0, &max_0);
-                DetermineHistoBinning((RooRealVar*)vars[1], 0, &nbin_1, &min_1, &max_1);
-                DetermineHistoBinning((RooRealVar*)vars[2], 0, &nbin_2, &min_2, &max_2);
-            }
-
-            // create the histogram
-            fHist = new TH3F(TString::Format("hist_%s_%s_%s_%s",
-                                             vars[0]->GetName(),
-                                             vars[1]->GetName(),
-                                             vars[2]->GetName(),
-                                             GetName()).Data(),
-                             TString::Format("Histogram variables '%s', '%s' and '%s' of species '%s'",
-                             vars[0]->GetTitle(), vars[1]->GetTitle(), vars[2]->GetTitle(), GetTitle()).Data(),
-                             nbin_0, min_0, max_0,
-                             nbin_1, min_1, max_1,
-                             nbin_2, min_2, max_2);
-
-            // fill the histogram
-            fTree->Draw(TString::Format("%s:%s:%s>>hist_%s_%s_%s_%s",
-                                        vars[2]->GetName(),
-                                        vars[1]->GetName(),
-                                        vars[0]->GetName(),
-                                        vars[0]->GetName(),
-                                        vars[1]->GetName(),
-                                        vars[2]->GetName(),
-                                        GetName()).Data(),
-                        fWeightVar.Data());
-        }
+        FFTemplateFiller filler(TString::Format("%s_Filler", GetName()).Data(), "Template filler");
+        PrepareTemplates(vars, filler);
+        if (filler.GetNJob() && !filler.Fill(FFFooFit::gUseNCPU))
+            Error("BuildModel", "An error occurred while filling the histogram of '%s'!", GetName());
         else
+            saveCache = fUseCache && fHistNew && !fHistCached && !IsSparse();
+        fHistNew = kFALSE;
+    }
+
+    // use sparse histogram
+    if (IsSparse())
+    {
+        if (!fSparseHist)
         {
-            Error("BuildModel", "Cannot convert unbinned input data of dimension %d!", fNDim);
+            Error("BuildModel", "No sparse histogram found!");
             return;
         }
+        if (fPdf)
+            delete fPdf;
+        fPdf = new FFRooSparseHistPdf(*fSparseHist, GetName());
+        return;
     }
 
-    // backup binning of variables
-    Int_t vbins[fNDim];
-    Double_t vmin[fNDim];
-    Double_t vmax[fNDim];
-    for (Int_t i = 0; i < fNDim; i++)
+    // check binned input data
+    if (!fHist)
     {
-        vbins[i] = ((RooRealVar*)vars[i])->getBinning().numBins();
-        vmin[i] = ((RooRealVar*)vars[i])->getBinning().lowBound();
-        vmax[i] = ((RooRealVar*)vars[i])->getBinning().highBound();
+        Error("BuildModel", "No binned input data found!");
+        return;
     }
 
-    // extend variables to range of histogram
-    TAxis* haxes[3] = { fHist->GetXaxis(), fHist->GetYaxis(), fHist->GetZaxis() };
-    for (Int_t i = 0; i < fNDim; i++)
+    // create RooFit histogram (unless loaded from the template cache)
+    if (!fHistCached || !fDataHist)
     {
-        ((RooRealVar*)vars[i])->setBins(haxes[i]->GetNbins());
-        ((RooRealVar*)vars[i])->setMin(haxes[i]->GetXmin());
-        ((RooRealVar*)vars[i])->setMax(haxes[i]->GetXmax());
-    }
+        // backup binning of variables (including adaptive binnings, see
+        // FFRooFit::ApplyAdaptiveBinning())
+        std::vector<RooAbsBinning*> vbinning(fNDim);
+        for (Int_t i = 0; i < fNDim; i++)
+            vbinning[i] = ((RooRealVar*)vars[i])->getBinning().clone();
+
+        // extend variables to range of histogram
+        TAxis* haxes[3] = { fHist->GetXaxis(), fHist->GetYaxis(), fHist->GetZaxis() };
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            ((RooRealVar*)vars[i])->setBins(haxes[i]->GetNbins());
+            ((RooRealVar*)vars[i])->setMin(haxes[i]->GetXmin());
+            ((RooRealVar*)vars[i])->setMax(haxes[i]->GetXmax());
+        }
 
-    // create RooFit histogram
-    if (fDataHist) delete fDataHist;
-    fDataHist = new RooDataHist(TString::Format("%s_RooFit", fHist->GetName()),
-                                TString::Format("%s (RooFit)", fHist->GetTitle()),
-                                varSet, RooFit::Import(*fHist));
+        // create RooFit histogram
+        if (fDataHist) delete fDataHist;
+        fDataHist = new RooDataHist(TString::Format("%s_RooFit", fHist->GetName()),
+                                    TString::Format("%s (RooFit)", fHist->GetTitle()),
+                                    varSet, RooFit::Import(*fHist));
 
-    // restore binning of variables
-    for (Int_t i = 0; i < fNDim; i++)
-    {
-        ((RooRealVar*)vars[i])->setBins(vbins[i]);
-        ((RooRealVar*)vars[i])->setMin(vmin[i]);
-        ((RooRealVar*)vars[i])->setMax(vmax[i]);
+        // restore binning of variables
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            ((RooRealVar*)vars[i])->setBinning(*vbinning[i]);
+            delete vbinning[i];
+        }
     }
 
+    // save newly filled histogram to the template cache
+    if (saveCache)
+        SaveCachedTemplate(vars);
+
     // create the model pdf
     if (fPdf)
         delete fPdf;
@@ -346,19 +725,53 @@ void FFRooModelHist::BuildModel(RooAbsReal** vars)
             delete fPdfIntr;
         if (fPdfConv)
             delete fPdfConv;
+        fPdfIntr = 0;
+        fPdfConv = 0;
 
-        // create pdfs
-        TString tmp;
-        tmp = TString::Format("%s_Conv_Intr", GetName());
-        fPdfIntr = new RooHistPdf(tmp.Data(), tmp.Data(), varSet, *fDataHist, fInterpolOrder);
-        tmp = TString::Format("%s_Conv_Gauss", GetName());
-        fPdfConv = new RooGaussModel(tmp.Data(), tmp.Data(), *((RooRealVar*)vars[0]), *fPar[0], *fPar[1]);
-        ((RooRealVar*)vars[0])->setBins(10000, "cache");
-        fPdf = new RooFFTConvPdf(GetName(), GetTitle(), *((RooRealVar*)vars[0]), *fPdfIntr, *fPdfConv);
+        // check binning (fixed bin sizes required by the convolution grid)
+        TAxis* haxes[3] = { fHist->GetXaxis(), fHist->GetYaxis(), fHist->GetZaxis() };
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            if (haxes[i]->IsVariableBinSize())
+            {
+                Error("BuildModel", "Convolution of '%s' with variable bin sizes is not supported!", GetName());
+                fPdf = 0;
+                return;
+            }
+        }
+
+        // create pdf (Gaussian convolution in all dimensions)
+        RooArgList obs;
+        RooArgList mean;
+        RooArgList sigma;
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            obs.add(*vars[i]);
+            mean.add(*fPar[2*i]);
+            sigma.add(*fPar[2*i+1]);
+        }
+        FFRooGridConvPdf* pdf = new FFRooGridConvPdf(GetName(), GetTitle(), obs, mean, sigma,
+                                                     fHist, fInterpolOrder);
+        if (!pdf->CheckFFT())
+        {
+            Error("BuildModel", "Could not create the FFTs of the convolution of '%s'!", GetName());
+            delete pdf;
+            fPdf = 0;
+            return;
+        }
+        fPdf = pdf;
+    }
+    else if (FFRooTemplatePdf::IsSupported(fHist, fInterpolOrder))
+    {
+        // create pdf (template with event lookup tables)
+        RooArgList obs;
+        for (Int_t i = 0; i < fNDim; i++)
+            obs.add(*vars[i]);
+        fPdf = new FFRooTemplatePdf(GetName(), GetTitle(), obs, fHist, fInterpolOrder);
     }
     else
     {
-        // create pdf
+        // create pdf (variable bin sizes or interpolation order 2 or larger than 3)
         fPdf = new RooHistPdf(GetName(), GetTitle(), varSet, *fDataHist, fInterpolOrder);
     }
 }
@@ -6,18 +6,37 @@
 //                                                                      //
 // FFRooModelKeys                                                       //
 //                                                                      //
-// Class representing a model for RooFit using the n-dimensional kernel //
-// estimation pdf of RooNDKeysPdf.                                      //
+// Class representing a model for RooFit using an n-dimensional kernel  //
+// estimation pdf.                                                      //
+//                                                                      //
+// By default (or with option 'g'), the kernel estimation is tabulated  //
+// on a grid via FFT using FFRooGridKeysPdf, which is much faster to    //
+// build and to evaluate for large event samples. The events are then   //
+// read directly from the tree without a RooFit dataset and the         //
+// tabulation uses FFFooFit::gUseNCPU threads.                          //
+//                                                                      //
+// With option 'i', the events are indexed in space using               //
+// FFRooIndexedKeysPdf, which evaluates truncated kernels close to the  //
+// point only and supports large N-dim. event samples without binning.  //
+//                                                                      //
+// Both are limited to 3 dimensions and do not rotate the kernels. The  //
+// serial RooNDKeysPdf is used for more dimensions or with option 'n'.  //
+// The 1-dim. model with shift parameter uses RooKeysPdf.               //
 //                                                                      //
 //////////////////////////////////////////////////////////////////////////
 
 
+#include <vector>
+
 #include "TTree.h"
 #include "RooDataSet.h"
 #include "RooNDKeysPdf.h"
 #include "RooRealVar.h"
 
 #include "FFRooModelKeys.h"
+#include "FFRooGridKeysPdf.h"
+#include "FFRooIndexedKeysPdf.h"
+#include "FFFooFit.h"
 
 ClassImp(FFRooModelKeys)
 
@@ -26,19 +45,46 @@ FFRooModelKeys::FFRooModelKeys(const Char_t* name, const Char_t* title, Int_t nD
                                const Char_t* opt, Double_t rho, Int_t nSigma, Bool_t rotate)
     : FFRooModel(name, title, 0)
 {
-    // Constructor for 'nDim'-dim. pdf using RooNDKeysPdf.
+    // Constructor for 'nDim'-dim. kernel estimation pdf.
     // See RooNDKeysPdf for meaning of parameters.
+    // FFRooGridKeysPdf is used by default, FFRooIndexedKeysPdf if 'opt'
+    // contains 'i' ('rotate' is ignored in these cases). Both support up
+    // to 3 dimensions, RooNDKeysPdf is used for more or if 'opt' contains
+    // 'n'.
 
     // init members
-    fType = kRooNDKeys;
+    fOpt = opt;
+    if (fOpt.Contains("g"))
+        fType = kGridKeys;
+    else if (fOpt.Contains("i"))
+        fType = kIndexedKeys;
+    else if (fOpt.Contains("n") || nDim > 3)
+        fType = kRooNDKeys;
+    else
+        fType = kGridKeys;
+    fOpt.ReplaceAll("n", "");
     fNDim = nDim;
     fTree = tree;
     fDataSet = 0;
-    fOpt = opt;
     fRho = rho;
     fNSigma = nSigma;
     fRotate = rotate;
     fMirror = RooKeysPdf::NoMirror;
+    fMaxRelErr = 0;
+
+    // fall back to RooNDKeysPdf for more than 3 dimensions
+    if (fType != kRooNDKeys && fNDim > 3)
+    {
+        Warning("FFRooModelKeys", "Using RooNDKeysPdf for %d dimensions instead of %s", fNDim,
+                fType == kGridKeys ? "FFRooGridKeysPdf" : "FFRooIndexedKeysPdf");
+        fType = kRooNDKeys;
+        fOpt.ReplaceAll("g", "");
+        fOpt.ReplaceAll("i", "");
+    }
+
+    // user info
+    if (fType == kGridKeys && fNDim > 1 && rotate)
+        Info("FFRooModelKeys", "Kernels of '%s' are not rotated (use option 'n' for RooNDKeysPdf)", GetName());
 }
 
 //______________________________________________________________________________
@@ -58,6 +104,7 @@ FFRooModelKeys::FFRooModelKeys(const Char_t* name, const Char_t* title, TTree* t
     fNSigma = 0;
     fRotate = kFALSE;
     fMirror = mirror;
+    fMaxRelErr = 0;
 
     // add shift parameters
     if (addShiftPar)
@@ -78,6 +125,44 @@ FFRooModelKeys::~FFRooModelKeys()
         delete fDataSet;
 }
 
+//______________________________________________________________________________
+TString FFRooModelKeys::GetFingerprint() const
+{
+    // Return a string identifying the structure of this model including
+    // the event tree and the kernel estimation settings.
+
+    // this model
+    TString fp = FFRooModel::GetFingerprint();
+
+    // event tree and settings
+    fp += TString::Format("<tree:%s;%lld;type=%d;dim=%d;opt=%s;rho=%.12g;nsig=%d;rot=%d;mir=%d;err=%.12g>",
+                          fTree ? fTree->GetName() : "", fTree ? fTree->GetEntries() : 0,
+                          fType, fNDim, fOpt.Data(), fRho, fNSigma, fRotate, fMirror, fMaxRelErr);
+
+    return fp;
+}
+
+//______________________________________________________________________________
+TString FFRooModelKeys::GetBuildSignature(RooAbsReal** vars) const
+{
+    // Return a string identifying all inputs of BuildModel() when using the
+    // variables 'vars' including the event tree and the ranges of the shift
+    // parameter.
+
+    // this model
+    TString sig = FFRooModel::GetBuildSignature(vars);
+
+    // event tree
+    sig += TString::Format("tree:%p:%lld;", fTree, fTree ? fTree->GetEntries() : 0);
+
+    // range of shift parameter (dataset range)
+    if (fNPar && fPar[0]->InheritsFrom("RooRealVar"))
+        sig += TString::Format("[%.12g,%.12g]", ((RooRealVar*)fPar[0])->getMin(),
+                               ((RooRealVar*)fPar[0])->getMax());
+
+    return sig;
+}
+
 //______________________________________________________________________________
 void FFRooModelKeys::BuildModel(RooAbsReal** vars)
 {
@@ -95,6 +180,14 @@ void FFRooModelKeys::BuildModel(RooAbsReal** vars)
     // create RooFit dataset
     if (fDataSet)
         delete fDataSet;
+    fDataSet = 0;
+
+    // grid or indexed kernel estimation using the events read directly from the tree
+    if (fType == kGridKeys || fType == kIndexedKeys)
+    {
+        BuildTreeModel(vars, varList);
+        return;
+    }
 
     // extend range if shift parameter is present
     if (fNPar)
@@ -159,3 +252,57 @@ void FFRooModelKeys::BuildModel(RooAbsReal** vars)
     }
 }
 
+//______________________________________________________________________________
+void FFRooModelKeys::BuildTreeModel(RooAbsReal** vars, const RooArgList& varList)
+{
+    // Build the model tabulated on a grid (see FFRooGridKeysPdf) or using
+    // indexed kernels (see FFRooIndexedKeysPdf) using the variables 'vars'
+    // (also contained in the list 'varList'). The events are read directly
+    // from the tree without creating a RooFit dataset.
+
+    // read events
+    std::vector<const Char_t*> cols(fNDim);
+    for (Int_t i = 0; i < fNDim; i++)
+        cols[i] = vars[i]->GetName();
+    std::vector<Double_t> x;
+    x.reserve(fTree->GetEntries()*fNDim);
+    Long64_t n = FFFooFit::ReadTreeColumns(fTree, fNDim, cols.data(),
+                                           [&](const Double_t* row) { x.insert(x.end(), row, row + fNDim); });
+
+    // create the model pdf
+    if (fPdf)
+        delete fPdf;
+    if (n < 0)
+    {
+        fPdf = 0;
+        Error("BuildTreeModel", "Could not read the events of the tree '%s'!", fTree->GetName());
+        return;
+    }
+    Info("BuildTreeModel", "Entries in data tree      : %.9e", (Double_t)n);
+    if (fType == kIndexedKeys)
+    {
+        FFRooIndexedKeysPdf* pdf = new FFRooIndexedKeysPdf(GetName(), GetTitle(), varList, n, x.data(), 0,
+                                                           fOpt.Data(), fRho, fNSigma, fMaxRelErr);
+        if (!pdf->IsValid())
+        {
+            Error("BuildTreeModel", "Could not build the indexed kernel estimation of '%s'!", GetName());
+            delete pdf;
+            fPdf = 0;
+            return;
+        }
+        fPdf = pdf;
+    }
+    else
+    {
+        FFRooGridKeysPdf* pdf = new FFRooGridKeysPdf(GetName(), GetTitle(), varList, n, x.data(), 0,
+                                                     fOpt.Data(), fRho, fNSigma);
+        if (!pdf->IsValid())
+        {
+            Error("BuildTreeModel", "Could not tabulate the kernel estimation of '%s'!", GetName());
+            delete pdf;
+            fPdf = 0;
+            return;
+        }
+        fPdf = pdf;
+    }
+}
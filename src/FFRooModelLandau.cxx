@@ -16,6 +16,7 @@
 #include "FFRooModelLandau.h"
 #include "RooGaussModel.h"
 #include "RooFFTConvPdf.h"
+#include "FFRooConvCache.h"
 
 ClassImp(FFRooModelLandau)
 
@@ -69,7 +70,7 @@ void FFRooModelLandau::BuildModel(RooAbsReal** vars)
         fPdfIntr = new RooLandau(tmp.Data(), tmp.Data(), *vars[0], *fPar[0], *fPar[1]);
         tmp = TString::Format("%s_Conv_Gauss", GetName());
         fPdfConv = new RooGaussModel(tmp.Data(), tmp.Data(), *((RooRealVar*)vars[0]), *fPar[2], *fPar[3]);
-        ((RooRealVar*)vars[0])->setBins(10000, "cache");
+        FFRooConvCache::SetCacheBinning((RooRealVar*)vars[0], fPar[3], fConvCacheBins);
         fPdf = new RooFFTConvPdf(GetName(), GetTitle(), *((RooRealVar*)vars[0]), *fPdfIntr, *fPdfConv);
     }
     else
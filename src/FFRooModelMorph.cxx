@@ -0,0 +1,227 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooModelMorph                                                      //
+//                                                                      //
+// Class representing a model morphed between histogram templates at    //
+// grid points of a parameter for RooFit.                               //
+//                                                                      //
+// The templates of the grid points are handled by FFRooModelHist       //
+// models (filled from trees in one pass with all other templates and   //
+// cached if enabled). The shape is interpolated between the templates  //
+// as a function of the floating morphing parameter (parameter 0) using //
+// FFRooMorphPdf, e.g. to fit a shape systematic instead of scanning    //
+// over discrete templates.                                             //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "TH1.h"
+#include "TTree.h"
+#include "RooRealVar.h"
+#include "RooArgList.h"
+
+#include "FFRooModelMorph.h"
+#include "FFRooModelHist.h"
+#include "FFRooMorphPdf.h"
+
+ClassImp(FFRooModelMorph)
+
+//______________________________________________________________________________
+FFRooModelMorph::FFRooModelMorph(const Char_t* name, const Char_t* title, Int_t nPoint,
+                                 const Double_t* points, FFRooModelHist** models, Int_t intOrder)
+    : FFRooModel(name, title, 1)
+{
+    // Constructor using the 'nPoint' histogram models 'models' at the grid
+    // points 'points' (in increasing order) of the morphing parameter.
+    // The order of the histogram interpolation in the observables can be
+    // specified via 'intOrder'.
+    // NOTE: the models are owned by this class.
+
+    // init members
+    fNDim = models[0]->GetNDim();
+    fInterpolOrder = intOrder;
+    fPointModel = new FFRooModelHist*[nPoint];
+    for (Int_t i = 0; i < nPoint; i++)
+        fPointModel[i] = models[i];
+    Init(nPoint, points);
+}
+
+//______________________________________________________________________________
+FFRooModelMorph::FFRooModelMorph(const Char_t* name, const Char_t* title, Int_t nDim, Int_t nPoint,
+                                 const Double_t* points, TTree** trees, const Char_t* weightVar,
+                                 Int_t intOrder)
+    : FFRooModel(name, title, 1)
+{
+    // Constructor using the 'nPoint' trees 'trees' of 'nDim' dimensions at
+    // the grid points 'points' (in increasing order) of the morphing
+    // parameter. If 'weightVar' is non-zero, the templates are filled using
+    // the event weights of this tree variable. The order of the histogram
+    // interpolation in the observables can be specified via 'intOrder'.
+    // NOTE: the trees are owned by this class.
+
+    // init members
+    fNDim = nDim;
+    fInterpolOrder = intOrder;
+    fPointModel = new FFRooModelHist*[nPoint];
+    for (Int_t i = 0; i < nPoint; i++)
+    {
+        TString tmp = TString::Format("%s_Point_%d", GetName(), i);
+        fPointModel[i] = new FFRooModelHist(tmp.Data(), tmp.Data(), nDim, trees[i], weightVar,
+                                            kFALSE, intOrder);
+    }
+    Init(nPoint, points);
+}
+
+//______________________________________________________________________________
+FFRooModelMorph::~FFRooModelMorph()
+{
+    // Destructor.
+
+    if (fPoint)
+        delete [] fPoint;
+    if (fPointModel)
+    {
+        for (Int_t i = 0; i < fNPoint; i++)
+            delete fPointModel[i];
+        delete [] fPointModel;
+    }
+}
+
+//______________________________________________________________________________
+void FFRooModelMorph::Init(Int_t nPoint, const Double_t* points)
+{
+    // Init the 'nPoint' grid points 'points' and the morphing parameter.
+
+    // grid points
+    fNPoint = nPoint;
+    fPoint = new Double_t[fNPoint];
+    for (Int_t i = 0; i < fNPoint; i++)
+        fPoint[i] = points[i];
+
+    // add the morphing parameter (nominal value 0 if within the grid)
+    TString tmp = TString::Format("%s_Morph", GetName());
+    AddParameter(0, tmp.Data(), tmp.Data());
+    if (fNPoint > 1)
+    {
+        const Double_t min = fPoint[0];
+        const Double_t max = fPoint[fNPoint-1];
+        SetParameter(0, min <= 0 && max >= 0 ? 0 : 0.5 * (min + max), min, max);
+    }
+    else if (fNPoint == 1)
+    {
+        FixParameter(0, fPoint[0]);
+    }
+}
+
+//______________________________________________________________________________
+void FFRooModelMorph::SetTemplateCache(Bool_t use)
+{
+    // Enable or disable the template cache of all grid point models.
+
+    for (Int_t i = 0; i < fNPoint; i++)
+        fPointModel[i]->SetTemplateCache(use);
+}
+
+//______________________________________________________________________________
+TString FFRooModelMorph::GetFingerprint() const
+{
+    // Return a string identifying the structure of this model including
+    // the grid points and their models.
+
+    // this model
+    TString fp = FFRooModel::GetFingerprint();
+
+    // grid points
+    fp += TString::Format("<morph:int=%d", fInterpolOrder);
+    for (Int_t i = 0; i < fNPoint; i++)
+        fp += TString::Format(";%.12g=%s", fPoint[i], fPointModel[i]->GetFingerprint().Data());
+    fp += ">";
+
+    return fp;
+}
+
+//______________________________________________________________________________
+TString FFRooModelMorph::GetBuildSignature(RooAbsReal** vars) const
+{
+    // Return a string identifying all inputs of BuildModel() when using the
+    // variables 'vars' including the build signatures and states of all
+    // grid point models.
+
+    // this model
+    TString sig = FFRooModel::GetBuildSignature(vars);
+
+    // grid point models
+    sig += TString::Format("int:%d;", fInterpolOrder);
+    for (Int_t i = 0; i < fNPoint; i++)
+    {
+        sig += TString::Format("[%p:%p:%d:%s]", fPointModel[i], fPointModel[i]->GetPdf(),
+                               fPointModel[i]->IsDirty(),
+                               fPointModel[i]->GetBuildSignature(vars).Data());
+    }
+
+    return sig;
+}
+
+//______________________________________________________________________________
+void FFRooModelMorph::PrepareTemplates(RooAbsReal** vars, FFTemplateFiller& filler)
+{
+    // Register the template histograms of all grid point models needing a
+    // rebuild using the variables 'vars' in the template filler 'filler'.
+
+    for (Int_t i = 0; i < fNPoint; i++)
+    {
+        if (fPointModel[i]->NeedsBuild(vars))
+            fPointModel[i]->PrepareTemplates(vars, filler);
+    }
+}
+
+//______________________________________________________________________________
+void FFRooModelMorph::BuildModel(RooAbsReal** vars)
+{
+    // Build the model using the variables 'vars'.
+
+    // check grid points
+    if (!fNPoint)
+    {
+        Error("BuildModel", "No grid points found!");
+        return;
+    }
+
+    // check if the morphing parameter can be down-casted
+    if (!fPar[0]->InheritsFrom("RooAbsReal"))
+    {
+        Error("BuildModel", "Morphing parameter '%s' is not of type RooAbsReal!", fPar[0]->GetName());
+        return;
+    }
+
+    // build the templates of the grid points
+    TH1* hists[fNPoint];
+    for (Int_t i = 0; i < fNPoint; i++)
+    {
+        if (fPointModel[i]->IsSparse())
+        {
+            Error("BuildModel", "Morphing of sparse histograms is not supported!");
+            return;
+        }
+        fPointModel[i]->Build(vars);
+        hists[i] = fPointModel[i]->GetHistogram();
+        if (!hists[i])
+        {
+            Error("BuildModel", "No histogram found for grid point %g!", fPoint[i]);
+            return;
+        }
+    }
+
+    // create the model pdf
+    RooArgList obs;
+    for (Int_t i = 0; i < fNDim; i++)
+        obs.add(*vars[i]);
+    if (fPdf)
+        delete fPdf;
+    fPdf = new FFRooMorphPdf(GetName(), GetTitle(), obs, *fPar[0], fNPoint, fPoint, hists,
+                             fInterpolOrder);
+}
@@ -13,6 +13,7 @@
 
 
 #include "RooPolynomial.h"
+#include "TMath.h"
 
 #include "FFRooModelPol.h"
 
@@ -48,3 +49,27 @@ void FFRooModelPol::BuildModel(RooAbsReal** vars)
     fPdf = new RooPolynomial(GetName(), GetTitle(), *vars[0], coeffList, 0);
 }
 
+//______________________________________________________________________________
+void FFRooModelPol::EvaluateCDF(Int_t n, const Double_t* x, Double_t* cdf,
+                                Double_t min, Double_t max) const
+{
+    // Evaluate the cumulative distribution function at the 'n' points 'x'
+    // (see FFRooModel::EvaluateCDF()).
+
+    // coefficients of the antiderivative
+    Double_t* a = new Double_t[fNPar];
+    for (Int_t i = 0; i < fNPar; i++)
+        a[i] = GetParameter(i) / (i + 1);
+
+    // evaluate using Horner's method
+    for (Int_t i = 0; i < n; i++)
+    {
+        Double_t v = 0;
+        for (Int_t j = fNPar-1; j >= 0; j--)
+            v = v * x[i] + a[j];
+        cdf[i] = v * x[i];
+    }
+
+    // clean-up
+    delete [] a;
+}
@@ -25,6 +25,15 @@ FFRooModelProd::FFRooModelProd(const Char_t* name, const Char_t* title, Int_t n,
 
 }
 
+//______________________________________________________________________________
+Int_t FFRooModelProd::GetModelVarOffset(Int_t i) const
+{
+    // Return the index of the first variable of the sub-model 'i'.
+    // The sub-model 'i' uses the variables starting at index 'i'.
+
+    return i;
+}
+
 //______________________________________________________________________________
 void FFRooModelProd::BuildModel(RooAbsReal** vars)
 {
@@ -44,8 +53,8 @@ void FFRooModelProd::BuildModel(RooAbsReal** vars)
     RooArgList modelList;
     for (Int_t i = 0; i < fNModel; i++)
     {
-        // build model and set fit variables
-        fModelList[i]->BuildModel(vars+i);
+        // build model (if needed) and set fit variables
+        fModelList[i]->Build(vars + GetModelVarOffset(i));
 
         // add model pdf to argument list
         modelList.add(*fModelList[i]->GetPdf());
@@ -31,6 +31,15 @@ FFRooModelSum::FFRooModelSum(const Char_t* name, const Char_t* title, Int_t n, F
     }
 }
 
+//______________________________________________________________________________
+Int_t FFRooModelSum::GetModelVarOffset(Int_t i) const
+{
+    // Return the index of the first variable of the sub-model 'i'.
+    // All sub-models use the same variables.
+
+    return 0;
+}
+
 //______________________________________________________________________________
 void FFRooModelSum::BuildModel(RooAbsReal** vars)
 {
@@ -51,8 +60,8 @@ void FFRooModelSum::BuildModel(RooAbsReal** vars)
     RooArgList coeffList;
     for (Int_t i = 0; i < fNModel; i++)
     {
-        // build model and set fit variables
-        fModelList[i]->BuildModel(vars);
+        // build model (if needed) and set fit variables
+        fModelList[i]->Build(vars + GetModelVarOffset(i));
 
         // add model pdf to argument list
         modelList.add(*fModelList[i]->GetPdf());
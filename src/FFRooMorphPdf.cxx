@@ -0,0 +1,295 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooMorphPdf                                                        //
+//                                                                      //
+// Histogram template pdf morphed between templates at parameter grid   //
+// points.                                                              //
+//                                                                      //
+// The templates at the grid points of the morphing parameter (e.g. an  //
+// energy-scale variation) are normalized and the content of each bin   //
+// is interpolated as a function of the parameter using a natural       //
+// cubic spline through the grid points (linear for two points). The    //
+// spline coefficients of all bins are precomputed and stored per       //
+// segment in contiguous arrays, i.e. a change of the parameter only    //
+// requires the evaluation of one cubic polynomial per bin. Negative    //
+// interpolated contents are set to zero. Outside of the grid points,   //
+// the parameter is clamped to the first or last point.                 //
+//                                                                      //
+// The morphed bin contents replace the grid of the underlying          //
+// FFRooTemplatePdf, which provides the evaluation, the event lookup    //
+// tables and the integration. The squared bin errors are interpolated  //
+// linearly between the grid points.                                    //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <vector>
+
+#include "TMath.h"
+#include "TH1.h"
+#include "RooArgList.h"
+
+#include "FFRooMorphPdf.h"
+
+ClassImp(FFRooMorphPdf)
+
+//______________________________________________________________________________
+FFRooMorphPdf::FFRooMorphPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                             RooAbsReal& par, Int_t nPoint, const Double_t* points, TH1** hists,
+                             Int_t intOrder)
+    : FFRooTemplatePdf(name, title, obs, hists[0], intOrder),
+      fPar("par", "Morphing parameter", this, par)
+{
+    // Constructor using the observables 'obs', the morphing parameter 'par'
+    // and the 'nPoint' histograms 'hists' corresponding to the parameter
+    // values 'points' (in increasing order). All histograms must have the
+    // same binning. Values are interpolated in the observables using the
+    // order 'intOrder' (see FFRooTemplatePdf).
+
+    // init members
+    fNPoint = nPoint;
+    fPoint = new Double_t[fNPoint];
+    for (Int_t i = 0; i < fNPoint; i++)
+        fPoint[i] = points[i];
+    fNCoef = 0;
+    fCoef = 0;
+    fNErr = 0;
+    fPointErr2 = 0;
+    fGridPar = 0;
+    fGridValid = kFALSE;
+    fNUpdate = 0;
+
+    // check grid points
+    for (Int_t i = 1; i < fNPoint; i++)
+    {
+        if (!(fPoint[i] > fPoint[i-1]))
+        {
+            Error("FFRooMorphPdf", "Grid points have to be in increasing order!");
+            fNPoint = 0;
+            return;
+        }
+    }
+
+    // check binning of histograms
+    for (Int_t i = 0; i < fNPoint; i++)
+    {
+        const TAxis* haxes[3] = { hists[i]->GetXaxis(), hists[i]->GetYaxis(), hists[i]->GetZaxis() };
+        Bool_t same = hists[i]->GetDimension() == fNDim;
+        for (Int_t j = 0; j < fNDim && same; j++)
+        {
+            if (haxes[j]->GetNbins() != fNBin[j] || haxes[j]->GetXmin() != fMin[j] ||
+                haxes[j]->GetXmax() != fMax[j])
+                same = kFALSE;
+        }
+        if (!same)
+        {
+            Error("FFRooMorphPdf", "Binning of histogram '%s' differs from the first histogram!",
+                  hists[i]->GetName());
+            fNPoint = 0;
+            return;
+        }
+    }
+
+    // precompute interpolation coefficients
+    InitMorphing(hists);
+}
+
+//______________________________________________________________________________
+FFRooMorphPdf::FFRooMorphPdf(const FFRooMorphPdf& other, const Char_t* name)
+    : FFRooTemplatePdf(other, name),
+      fPar("par", this, other.fPar)
+{
+    // Copy constructor.
+
+    // init members
+    fNPoint = other.fNPoint;
+    fPoint = new Double_t[fNPoint];
+    for (Int_t i = 0; i < fNPoint; i++)
+        fPoint[i] = other.fPoint[i];
+    fNCoef = other.fNCoef;
+    fCoef = new Double_t[fNCoef];
+    for (Int_t i = 0; i < fNCoef; i++)
+        fCoef[i] = other.fCoef[i];
+    fNErr = other.fNErr;
+    fPointErr2 = new Double_t[fNErr];
+    for (Int_t i = 0; i < fNErr; i++)
+        fPointErr2[i] = other.fPointErr2[i];
+    fGridPar = 0;
+    fGridValid = kFALSE;
+    fNUpdate = 0;
+}
+
+//______________________________________________________________________________
+FFRooMorphPdf::~FFRooMorphPdf()
+{
+    // Destructor.
+
+    if (fPoint)
+        delete [] fPoint;
+    if (fCoef)
+        delete [] fCoef;
+    if (fPointErr2)
+        delete [] fPointErr2;
+}
+
+//______________________________________________________________________________
+void FFRooMorphPdf::InitMorphing(TH1** hists)
+{
+    // Normalize the histograms 'hists' of the grid points and precompute the
+    // coefficients of the natural cubic splines interpolating the bin
+    // contents between the grid points.
+
+    // check grid
+    if (!fNCell || !fNPoint)
+        return;
+
+    // normalized bin contents and squared errors of the grid points
+    std::vector<std::vector<Double_t> > y(fNPoint, std::vector<Double_t>(fNCell));
+    fNErr = fNPoint*fNCell;
+    fPointErr2 = new Double_t[fNErr];
+    for (Int_t i = 0; i < fNPoint; i++)
+    {
+        // copy bins (last dimension running fastest)
+        Double_t sum = 0;
+        for (Int_t c = 0; c < fNCell; c++)
+        {
+            Int_t bin[3] = { 0, 0, 0 };
+            Int_t r = c;
+            for (Int_t j = fNDim-1; j >= 0; j--)
+            {
+                bin[j] = r % fNBin[j] + 1;
+                r /= fNBin[j];
+            }
+            Int_t b = hists[i]->GetBin(bin[0], bin[1], bin[2]);
+            Double_t err = hists[i]->GetBinError(b);
+            y[i][c] = hists[i]->GetBinContent(b);
+            fPointErr2[i*fNCell+c] = err * err;
+            sum += y[i][c];
+        }
+
+        // normalize
+        if (sum <= 0)
+        {
+            Warning("InitMorphing", "Histogram '%s' of grid point %g is empty!",
+                    hists[i]->GetName(), fPoint[i]);
+            continue;
+        }
+        for (Int_t c = 0; c < fNCell; c++)
+        {
+            y[i][c] /= sum;
+            fPointErr2[i*fNCell+c] /= sum * sum;
+        }
+    }
+
+    // second derivatives of the natural splines (tridiagonal system solved
+    // for all bins at once, the matrix only depends on the grid points)
+    std::vector<std::vector<Double_t> > m(fNPoint, std::vector<Double_t>(fNCell, 0));
+    if (fNPoint > 2)
+    {
+        std::vector<Double_t> diag(fNPoint, 0);
+        for (Int_t i = 1; i < fNPoint-1; i++)
+        {
+            const Double_t h0 = fPoint[i] - fPoint[i-1];
+            const Double_t h1 = fPoint[i+1] - fPoint[i];
+            diag[i] = 2 * (h0 + h1);
+            for (Int_t c = 0; c < fNCell; c++)
+                m[i][c] = 6 * ((y[i+1][c] - y[i][c]) / h1 - (y[i][c] - y[i-1][c]) / h0);
+        }
+
+        // forward elimination
+        for (Int_t i = 2; i < fNPoint-1; i++)
+        {
+            const Double_t w = (fPoint[i] - fPoint[i-1]) / diag[i-1];
+            diag[i] -= w * (fPoint[i] - fPoint[i-1]);
+            for (Int_t c = 0; c < fNCell; c++)
+                m[i][c] -= w * m[i-1][c];
+        }
+
+        // back substitution
+        for (Int_t i = fNPoint-2; i >= 1; i--)
+        {
+            const Double_t h1 = fPoint[i+1] - fPoint[i];
+            for (Int_t c = 0; c < fNCell; c++)
+                m[i][c] = (m[i][c] - (i < fNPoint-2 ? h1 * m[i+1][c] : 0)) / diag[i];
+        }
+    }
+
+    // polynomial coefficients per segment
+    const Int_t nSeg = fNPoint > 1 ? fNPoint-1 : 1;
+    fNCoef = 4*nSeg*fNCell;
+    fCoef = new Double_t[fNCoef];
+    for (Int_t i = 0; i < nSeg; i++)
+    {
+        Double_t* a = fCoef + (4*i)*fNCell;
+        Double_t* b = a + fNCell;
+        Double_t* c2 = b + fNCell;
+        Double_t* d = c2 + fNCell;
+        if (fNPoint == 1)
+        {
+            for (Int_t c = 0; c < fNCell; c++)
+            {
+                a[c] = y[0][c];
+                b[c] = c2[c] = d[c] = 0;
+            }
+            continue;
+        }
+        const Double_t h = fPoint[i+1] - fPoint[i];
+        for (Int_t c = 0; c < fNCell; c++)
+        {
+            a[c] = y[i][c];
+            b[c] = (y[i+1][c] - y[i][c]) / h - h * (2 * m[i][c] + m[i+1][c]) / 6;
+            c2[c] = m[i][c] / 2;
+            d[c] = (m[i+1][c] - m[i][c]) / (6 * h);
+        }
+    }
+}
+
+//______________________________________________________________________________
+void FFRooMorphPdf::UpdateGrid() const
+{
+    // Update the bin contents and errors of the template grid for the current
+    // value of the morphing parameter.
+
+    // check grid
+    if (!fNCoef)
+        return;
+
+    // check parameter value
+    const Double_t x = TMath::Max(fPoint[0], TMath::Min((Double_t)fPar, fPoint[fNPoint-1]));
+    if (fGridValid && x == fGridPar)
+        return;
+
+    // find segment
+    const Int_t nSeg = fNPoint > 1 ? fNPoint-1 : 1;
+    Int_t s = 0;
+    while (s < nSeg-1 && x >= fPoint[s+1])
+        s++;
+    const Double_t t = x - fPoint[s];
+
+    // evaluate the polynomials of all bins
+    const Double_t* a = fCoef + (4*s)*fNCell;
+    const Double_t* b = a + fNCell;
+    const Double_t* c2 = b + fNCell;
+    const Double_t* d = c2 + fNCell;
+    for (Int_t c = 0; c < fNCell; c++)
+    {
+        const Double_t v = a[c] + t * (b[c] + t * (c2[c] + t * d[c]));
+        fGrid[c] = v > 0 ? v : 0;
+    }
+
+    // interpolate the squared errors linearly
+    const Double_t* e0 = fPointErr2 + s*fNCell;
+    const Double_t* e1 = fNPoint > 1 ? e0 + fNCell : e0;
+    const Double_t u = fNPoint > 1 ? t / (fPoint[s+1] - fPoint[s]) : 0;
+    for (Int_t c = 0; c < fNCell; c++)
+        fGridErr2[c] = (1 - u) * e0[c] + u * e1[c];
+
+    // save parameter value
+    fGridPar = x;
+    fGridValid = kTRUE;
+    fNUpdate++;
+}
@@ -0,0 +1,205 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooNLLMonitor                                                      //
+//                                                                      //
+// Wrapper of a minimized function (NLL, chi2) monitoring its           //
+// evaluations.                                                         //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "RooAbsPdf.h"
+#include "RooRealVar.h"
+#include "RooArgSet.h"
+
+#include "FFRooNLLMonitor.h"
+#include "FFRooFitProfile.h"
+#include "FFRooFitTrace.h"
+
+ClassImp(FFRooNLLMonitor)
+
+//______________________________________________________________________________
+FFRooNLLMonitor::FFRooNLLMonitor(const Char_t* name, const Char_t* title, RooAbsReal& func,
+                                 RooAbsPdf* model, const RooArgSet* obs, FFRooFitProfile* profile,
+                                 FFRooFitTrace* trace)
+    : RooAbsReal(name, title),
+      fFunc("func", "Monitored function", this, func)
+{
+    // Constructor monitoring the function 'func' of the model 'model' with
+    // observables 'obs'. The evaluation counters are added to 'profile'.
+    // If 'trace' is non-zero, all calls are recorded in this trace.
+
+    // init members
+    fProfile = profile;
+    fTrace = trace;
+    fTraceFcn = -1;
+
+    // track components of the model
+    if (model)
+        TrackComponents(model, obs);
+
+    // register function in trace
+    if (fTrace)
+        TraceParameters();
+}
+
+//______________________________________________________________________________
+FFRooNLLMonitor::FFRooNLLMonitor(const FFRooNLLMonitor& other, const Char_t* name)
+    : RooAbsReal(other, name),
+      fFunc("func", this, other.fFunc)
+{
+    // Copy constructor.
+
+    // init members
+    fProfile = other.fProfile;
+    fTrace = other.fTrace;
+    fTraceFcn = other.fTraceFcn;
+    fTracePar = other.fTracePar;
+    fCompIsConv = other.fCompIsConv;
+    fCompPar = other.fCompPar;
+    fCompVal = other.fCompVal;
+}
+
+//______________________________________________________________________________
+void FFRooNLLMonitor::TrackComponents(RooAbsPdf* model, const RooArgSet* obs)
+{
+    // Register all pdf components of the model 'model' having floating
+    // parameters (w.r.t. the observables 'obs') for the evaluation counters.
+
+    // loop over model components
+    RooArgSet* comps = model->getComponents();
+    TIterator* iter = comps->createIterator();
+    while (RooAbsArg* comp = (RooAbsArg*)iter->Next())
+    {
+        // only pdfs are normalized
+        if (!comp->InheritsFrom("RooAbsPdf"))
+            continue;
+
+        // collect floating parameters
+        std::vector<RooRealVar*> par;
+        std::vector<Double_t> val;
+        RooArgSet* params = comp->getParameters(obs);
+        TIterator* piter = params->createIterator();
+        while (RooAbsArg* p = (RooAbsArg*)piter->Next())
+        {
+            if (p->InheritsFrom("RooRealVar") && !p->isConstant())
+            {
+                par.push_back((RooRealVar*)p);
+                val.push_back(((RooRealVar*)p)->getVal());
+            }
+        }
+        delete piter;
+        delete params;
+
+        // skip components without floating parameters
+        if (par.empty())
+            continue;
+
+        // register component
+        fCompIsConv.push_back(comp->InheritsFrom("RooFFTConvPdf"));
+        fCompPar.push_back(par);
+        fCompVal.push_back(val);
+    }
+
+    // clean-up
+    delete iter;
+    delete comps;
+}
+
+//______________________________________________________________________________
+void FFRooNLLMonitor::TraceParameters()
+{
+    // Collect the floating parameters of the monitored function and register
+    // the function in the trace.
+
+    // collect floating parameters
+    std::vector<TString> names;
+    RooArgSet* params = fFunc.arg().getVariables();
+    TIterator* iter = params->createIterator();
+    while (RooAbsArg* p = (RooAbsArg*)iter->Next())
+    {
+        if (p->InheritsFrom("RooRealVar") && !p->isConstant())
+        {
+            fTracePar.push_back((RooRealVar*)p);
+            names.push_back(p->GetName());
+        }
+    }
+
+    // register function
+    fTraceFcn = fTrace->AddFunction(fFunc.arg().GetName(), names);
+
+    // clean-up
+    delete iter;
+    delete params;
+}
+
+//______________________________________________________________________________
+void FFRooNLLMonitor::CountComponents() const
+{
+    // Update the estimated evaluation counters of the tracked components.
+    // A component whose parameters changed since the last evaluation is
+    // assumed to recompute its normalization integral (and its FFT
+    // convolution if it is a convolution pdf), otherwise to reuse its
+    // caches. The actual calls made by RooFit are not counted.
+
+    // loop over components
+    for (UInt_t i = 0; i < fCompPar.size(); i++)
+    {
+        // check for changed parameters
+        Bool_t changed = kFALSE;
+        for (UInt_t j = 0; j < fCompPar[i].size(); j++)
+        {
+            Double_t v = fCompPar[i][j]->getVal();
+            if (v != fCompVal[i][j])
+            {
+                fCompVal[i][j] = v;
+                changed = kTRUE;
+            }
+        }
+
+        // count
+        if (changed)
+        {
+            fProfile->Count(FFRooFitProfile::kNormIntegral);
+            if (fCompIsConv[i])
+                fProfile->Count(FFRooFitProfile::kFFTConvol);
+        }
+        else
+        {
+            fProfile->Count(FFRooFitProfile::kCacheHit);
+        }
+    }
+}
+
+//______________________________________________________________________________
+Double_t FFRooNLLMonitor::evaluate() const
+{
+    // Evaluate the monitored function.
+
+    // update counters
+    if (fProfile)
+    {
+        fProfile->Count(FFRooFitProfile::kNLLEval);
+        CountComponents();
+    }
+
+    // evaluate without tracing
+    if (!fTrace)
+        return fFunc;
+
+    // evaluate and record call
+    Double_t start = FFRooFitProfile::Now();
+    Double_t val = fFunc;
+    Double_t dur = FFRooFitProfile::Now() - start;
+    std::vector<Double_t> par(fTracePar.size());
+    for (UInt_t i = 0; i < fTracePar.size(); i++)
+        par[i] = fTracePar[i]->getVal();
+    fTrace->AddCall(fTraceFcn, fProfile ? fProfile->GetPhase() : -1, start, dur, val, par);
+
+    return val;
+}
+
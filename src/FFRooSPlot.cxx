@@ -15,10 +15,15 @@
 #include "TMath.h"
 #include "RooStats/SPlot.h"
 #include "RooAbsPdf.h"
+#include "RooArgList.h"
+#include "RooDataSet.h"
 
 #include "FFRooSPlot.h"
 #include "FFRooModel.h"
+#include "FFRooModelSum.h"
+#include "FFRooUnbinnedNLL.h"
 #include "FFFooFit.h"
+#include "FFColumnStats.h"
 
 ClassImp(FFRooSPlot)
 
@@ -87,6 +92,19 @@ Bool_t FFRooSPlot::CheckEventID()
     // check if all event ID numbers do not have more than 15 significant digits
     //
 
+    // user info
+    Info("CheckEventID", "Checking event IDs of %.9e events...", (Double_t)fTree->GetEntries());
+
+    // check the maximum event ID
+    FFColumnStats stats("EventIDStats", "Event ID statistics");
+    stats.AddColumn(fEventID->GetName());
+    if (stats.Fill(fTree, 0, FFFooFit::gUseNCPU) && !(stats.GetMaximum(0) >= 1e15))
+        return kTRUE;
+
+    //
+    // locate invalid event IDs
+    //
+
     // read event ID
     Double_t event_id;
     fTree->SetBranchAddress(fEventID->GetName(), &event_id);
@@ -95,9 +113,6 @@ Bool_t FFRooSPlot::CheckEventID()
     fTree->SetBranchStatus("*", 0);
     fTree->SetBranchStatus(fEventID->GetName(), 1);
 
-    // user info
-    Info("CheckEventID", "Checking event IDs of %.9e events...", (Double_t)fTree->GetEntries());
-
     Int_t nerror = 0;
     for (Long64_t i = 0; i < fTree->GetEntries(); i++)
     {
@@ -217,9 +232,19 @@ Bool_t FFRooSPlot::Fit(const Char_t* opt)
             yieldParList.add(*fModel->GetPar(i));
     }
 
-    // create the sPlot object
-    fSPlot = new RooStats::SPlot("splot_fit", "FFRooSPlot Fit", *((RooDataSet*)fData),
-                                 fModel->GetPdf(), yieldParList, RooArgSet(), kTRUE, kTRUE);
+    // delete old sWeights
+    if (fSPlot)
+        delete fSPlot;
+    fSPlot = 0;
+    fSWeight.clear();
+
+    // solve the yields and calculate the sWeights natively, otherwise
+    // create the sPlot object (fitting the yields)
+    if (!SolveSWeights(yieldParList))
+    {
+        fSPlot = new RooStats::SPlot("splot_fit", "FFRooSPlot Fit", *((RooDataSet*)fData),
+                                     fModel->GetPdf(), yieldParList, RooArgSet(), kTRUE, kTRUE);
+    }
 
     // user info
     for (Int_t i = 0; i < fNSpec; i++)
@@ -227,9 +252,70 @@ Bool_t FFRooSPlot::Fit(const Char_t* opt)
         // only non-constant yield parameters
         if (!fModel->IsParConstant(i))
         {
+            Double_t sum = 0;
+            if (fSPlot)
+            {
+                sum = fSPlot->GetYieldFromSWeight(fModel->GetParName(i));
+            }
+            else
+            {
+                for (Int_t j = 0; j < GetNEvents(); j++)
+                    sum += GetSpeciesWeight(j, i);
+            }
             Info("Fit", "Species '%s' yield: %e (%s)  %e (SPlot)",
-                 fModel->GetParTitle(i), fModel->GetParameter(i), fModel->GetParName(i),
-                 fSPlot->GetYieldFromSWeight(fModel->GetParName(i)));
+                 fModel->GetParTitle(i), fModel->GetParameter(i), fModel->GetParName(i), sum);
+        }
+    }
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooSPlot::SolveSWeights(const RooArgList& yields)
+{
+    // Solve the floating species yields 'yields' directly using the native
+    // unbinned likelihood (see FFRooUnbinnedNLL::SolveYields()) and calculate
+    // the sWeights from the solution without fitting the yields again.
+    // Return kFALSE if the native likelihood cannot be used or the solver
+    // failed, otherwise kTRUE.
+
+    // check native likelihood
+    if (!FFRooUnbinnedNLL::IsApplicable(fModel, fData))
+        return kFALSE;
+
+    // solve the yields
+    FFRooUnbinnedNLL nll("nll_splot", "sPlot yield likelihood", (FFRooModelSum*)fModel,
+                         *((RooDataSet*)fData), fVar, fNVar, RooArgSet());
+    if (!nll.IsYieldOnly())
+        return kFALSE;
+    if (!nll.SolveYields())
+    {
+        Warning("SolveSWeights", "Yield solver failed - fitting the yields of the sPlot fit");
+        return kFALSE;
+    }
+    Info("SolveSWeights", "Yields of sPlot fit solved after %d Newton iterations (EDM: %e)",
+         nll.GetNSolverIter(), nll.GetSolverEDM());
+
+    // calculate the sWeights
+    std::vector<Double_t> sw;
+    if (!nll.ComputeSWeights(yields, sw))
+    {
+        Warning("SolveSWeights", "Singular yield covariance matrix - fitting the yields of the sPlot fit");
+        return kFALSE;
+    }
+
+    // store the sWeights of the species
+    const Int_t nEvent = fData->numEntries();
+    const Int_t nYield = yields.getSize();
+    fSWeight.assign(nEvent*fNSpec, 0);
+    for (Int_t j = 0; j < nYield; j++)
+    {
+        for (Int_t i = 0; i < fNSpec; i++)
+        {
+            if (yields.at(j) != fModel->GetPar(i))
+                continue;
+            for (Int_t e = 0; e < nEvent; e++)
+                fSWeight[e*fNSpec+i] = sw[e*nYield+j];
         }
     }
 
@@ -243,6 +329,8 @@ Int_t FFRooSPlot::GetNEvents() const
 
     if (fSPlot)
         return fSPlot->GetSDataSet()->numEntries();
+    else if (!fSWeight.empty())
+        return fData->numEntries();
     else
         return 0;
 }
@@ -254,6 +342,8 @@ Double_t FFRooSPlot::GetEventID(Int_t event) const
 
     if (fSPlot)
         return fSPlot->GetSDataSet()->get(event)->getRealValue(fEventID->GetName());
+    else if (!fSWeight.empty())
+        return fData->get(event)->getRealValue(fEventID->GetName());
     else
         return 0;
 }
@@ -266,8 +356,12 @@ Double_t FFRooSPlot::GetSpeciesWeight(Int_t event, Int_t i) const
     // check species index
     if (CheckSpecBounds(i, "GetSpeciesWeight()"))
     {
-        if (fSPlot && !fModel->IsParConstant(i))
+        if (fModel->IsParConstant(i))
+            return 0;
+        else if (fSPlot)
             return fSPlot->GetSWeight(event, fModel->GetParName(i));
+        else if (!fSWeight.empty())
+            return fSWeight[event*fNSpec+i];
         else
             return 0;
     }
@@ -286,7 +380,7 @@ TTree* FFRooSPlot::GetSpeciesWeightsTree(const Char_t* name,
     // species with indices 'spec' to the tree.
 
     // check fit
-    if (!fSPlot)
+    if (!fSPlot && fSWeight.empty())
         return 0;
 
     // number of events
@@ -0,0 +1,361 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooSparseHistPdf                                                   //
+//                                                                      //
+// N-dimensional histogram pdf storing only the occupied bins.          //
+//                                                                      //
+// The bins of a regular N-dimensional grid are addressed by a global   //
+// bin index and the contents of the occupied bins are kept in a hash   //
+// map, i.e. the memory scales with the number of occupied bins and not //
+// with the total number of bins. Values outside of the grid are        //
+// ignored when filling and evaluate to zero.                           //
+//                                                                      //
+// With interpolation order 1, the pdf is interpolated multi-linearly   //
+// between the 2^N neighbouring bin centers. Integrals over any subset  //
+// of the observables are calculated analytically by summing the        //
+// overlaps of the occupied bins with the integration ranges (exact for //
+// interpolation order 0, approximate for order 1).                     //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "TMath.h"
+#include "RooArgList.h"
+#include "RooArgSet.h"
+#include "RooRealVar.h"
+
+#include "FFRooSparseHistPdf.h"
+
+ClassImp(FFRooSparseHistPdf)
+
+//______________________________________________________________________________
+FFRooSparseHistPdf::FFRooSparseHistPdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                                       const Int_t* nBin, const Double_t* min, const Double_t* max,
+                                       Int_t intOrder)
+    : RooAbsPdf(name, title),
+      fObs("obs", "Observables", this)
+{
+    // Constructor using the observables 'obs' and the grid having 'nBin'
+    // bins in the ranges ['min','max'] in each dimension. Values are
+    // interpolated if 'intOrder' is 1.
+
+    // init members
+    fObs.add(obs);
+    fNDim = obs.getSize();
+    fInterpolOrder = intOrder;
+    if (fInterpolOrder < 0 || fInterpolOrder > 1)
+    {
+        Warning("FFRooSparseHistPdf", "Unsupported interpolation order %d - using linear interpolation",
+                fInterpolOrder);
+        fInterpolOrder = 1;
+    }
+    Init(nBin, min, max);
+}
+
+//______________________________________________________________________________
+FFRooSparseHistPdf::FFRooSparseHistPdf(const FFRooSparseHistPdf& other, const Char_t* name)
+    : RooAbsPdf(other, name),
+      fObs("obs", this, other.fObs)
+{
+    // Copy constructor.
+
+    // init members
+    fNDim = other.fNDim;
+    fInterpolOrder = other.fInterpolOrder;
+    Init(other.fNBin, other.fMin, other.fMax);
+    fContent = other.fContent;
+    fSumW = other.fSumW;
+}
+
+//______________________________________________________________________________
+FFRooSparseHistPdf::~FFRooSparseHistPdf()
+{
+    // Destructor.
+
+    if (fNBin)
+        delete [] fNBin;
+    if (fMin)
+        delete [] fMin;
+    if (fMax)
+        delete [] fMax;
+    if (fBinW)
+        delete [] fBinW;
+    if (fStride)
+        delete [] fStride;
+}
+
+//______________________________________________________________________________
+void FFRooSparseHistPdf::Init(const Int_t* nBin, const Double_t* min, const Double_t* max)
+{
+    // Init the grid having 'nBin' bins in the ranges ['min','max'] in each
+    // dimension.
+
+    fNBin = new Int_t[fNDim];
+    fMin = new Double_t[fNDim];
+    fMax = new Double_t[fNDim];
+    fBinW = new Double_t[fNDim];
+    fStride = new Long64_t[fNDim];
+    fBinVol = 1;
+    fSumW = 0;
+    Long64_t stride = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        fNBin[i] = TMath::Max(nBin[i], 1);
+        fMin[i] = min[i];
+        fMax[i] = max[i];
+        fBinW[i] = (fMax[i] - fMin[i]) / fNBin[i];
+        fBinVol *= fBinW[i];
+        fStride[i] = stride;
+
+        // check overflow of global bin index
+        if (stride > TMath::Limits<Long64_t>::Max() / fNBin[i])
+        {
+            Error("Init", "Too many bins in %d dimensions!", fNDim);
+            stride = 1;
+        }
+        stride *= fNBin[i];
+    }
+}
+
+//______________________________________________________________________________
+Long64_t FFRooSparseHistPdf::GetBinIndex(const Double_t* x) const
+{
+    // Return the global index of the bin containing the point 'x' or -1 if
+    // the point is outside of the grid.
+
+    Long64_t idx = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (!(x[i] >= fMin[i] && x[i] < fMax[i]))
+            return -1;
+        Int_t b = TMath::Min((Int_t)((x[i] - fMin[i]) / fBinW[i]), fNBin[i]-1);
+        idx += b * fStride[i];
+    }
+
+    return idx;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooSparseHistPdf::HasBinning(const Int_t* nBin, const Double_t* min, const Double_t* max) const
+{
+    // Check if the grid has 'nBin' bins in the ranges ['min','max'] in each
+    // dimension.
+
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (fNBin[i] != nBin[i] || fMin[i] != min[i] || fMax[i] != max[i])
+            return kFALSE;
+    }
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooSparseHistPdf::HasObservables(RooAbsReal** obs) const
+{
+    // Check if the pdf uses the observables 'obs'.
+
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (fObs.at(i) != obs[i])
+            return kFALSE;
+    }
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+void FFRooSparseHistPdf::Fill(const Double_t* x, Double_t w)
+{
+    // Fill the point 'x' with weight 'w'. Points outside of the grid are
+    // ignored.
+
+    Long64_t idx = GetBinIndex(x);
+    if (idx >= 0)
+        AddBinContent(idx, w);
+}
+
+//______________________________________________________________________________
+void FFRooSparseHistPdf::AddBinContent(Long64_t bin, Double_t w)
+{
+    // Add 'w' to the content of the bin with global index 'bin'.
+
+    fContent[bin] += w;
+    fSumW += w;
+    setValueDirty();
+}
+
+//______________________________________________________________________________
+void FFRooSparseHistPdf::Reset()
+{
+    // Remove all bin contents.
+
+    fContent.clear();
+    fSumW = 0;
+    setValueDirty();
+}
+
+//______________________________________________________________________________
+Double_t FFRooSparseHistPdf::GetContent(const Int_t* bin) const
+{
+    // Return the content of the bin with the bin indices 'bin'.
+
+    Long64_t idx = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+        idx += bin[i] * fStride[i];
+    auto it = fContent.find(idx);
+
+    return it == fContent.end() ? 0 : it->second;
+}
+
+//______________________________________________________________________________
+Double_t FFRooSparseHistPdf::evaluate() const
+{
+    // Calculate the value of the pdf.
+
+    // check content
+    if (fSumW <= 0)
+        return 0;
+
+    // nearest bins and interpolation fractions
+    Int_t lo[fNDim];
+    Double_t f[fNDim];
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        Double_t x = ((RooAbsReal*)fObs.at(i))->getVal();
+        if (!(x >= fMin[i] && x < fMax[i]))
+            return 0;
+
+        if (fInterpolOrder == 0)
+        {
+            lo[i] = TMath::Min((Int_t)((x - fMin[i]) / fBinW[i]), fNBin[i]-1);
+            f[i] = 0;
+        }
+        else
+        {
+            // position relative to the bin centers (constant beyond the
+            // outermost bin centers)
+            Double_t u = (x - fMin[i]) / fBinW[i] - 0.5;
+            lo[i] = (Int_t)TMath::Floor(u);
+            f[i] = u - lo[i];
+            if (lo[i] < 0)
+            {
+                lo[i] = 0;
+                f[i] = 0;
+            }
+            else if (lo[i] >= fNBin[i]-1)
+            {
+                lo[i] = fNBin[i]-1;
+                f[i] = 0;
+            }
+        }
+    }
+
+    // sum contributions of neighbouring bins
+    Double_t sum = 0;
+    Int_t bin[fNDim];
+    const Int_t nCorner = fInterpolOrder == 0 ? 1 : 1 << fNDim;
+    for (Int_t c = 0; c < nCorner; c++)
+    {
+        Double_t w = 1;
+        for (Int_t i = 0; i < fNDim && w > 0; i++)
+        {
+            Bool_t up = (c >> i) & 1;
+            w *= up ? f[i] : 1 - f[i];
+            bin[i] = lo[i] + up;
+        }
+        if (w > 0)
+            sum += w * GetContent(bin);
+    }
+
+    return sum / (fSumW * fBinVol);
+}
+
+//______________________________________________________________________________
+Int_t FFRooSparseHistPdf::getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars,
+                                                const char* rangeName) const
+{
+    // Advertise the analytical integration over any subset of the
+    // observables. The integration code is 1 + bit mask of the integrated
+    // observables.
+
+    Int_t mask = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (allVars.find(*fObs.at(i)))
+        {
+            mask |= 1 << i;
+            analVars.add(*fObs.at(i));
+        }
+    }
+
+    return mask ? mask + 1 : 0;
+}
+
+//______________________________________________________________________________
+Double_t FFRooSparseHistPdf::analyticalIntegral(Int_t code, const char* rangeName) const
+{
+    // Calculate the integral over the observables selected by 'code' (see
+    // getAnalyticalIntegral()) in the range 'rangeName'. The other
+    // observables are fixed to the bins of their current values.
+
+    // check content
+    if (fSumW <= 0)
+        return 0;
+
+    // integration ranges and bins of the fixed observables
+    const Int_t mask = code - 1;
+    Double_t lo[fNDim];
+    Double_t hi[fNDim];
+    Int_t bin[fNDim];
+    Double_t norm = fSumW;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (mask & (1 << i))
+        {
+            RooRealVar* var = (RooRealVar*)fObs.at(i);
+            lo[i] = TMath::Max(var->getMin(rangeName), fMin[i]);
+            hi[i] = TMath::Min(var->getMax(rangeName), fMax[i]);
+            if (hi[i] <= lo[i])
+                return 0;
+        }
+        else
+        {
+            Double_t x = ((RooAbsReal*)fObs.at(i))->getVal();
+            if (!(x >= fMin[i] && x < fMax[i]))
+                return 0;
+            bin[i] = TMath::Min((Int_t)((x - fMin[i]) / fBinW[i]), fNBin[i]-1);
+            norm *= fBinW[i];
+        }
+    }
+
+    // sum overlaps of occupied bins with integration ranges
+    Double_t sum = 0;
+    for (auto it = fContent.begin(); it != fContent.end(); ++it)
+    {
+        Double_t frac = 1;
+        for (Int_t i = 0; i < fNDim; i++)
+        {
+            Int_t b = (it->first / fStride[i]) % fNBin[i];
+            if (mask & (1 << i))
+            {
+                Double_t blo = fMin[i] + b * fBinW[i];
+                Double_t overlap = TMath::Min(hi[i], blo + fBinW[i]) - TMath::Max(lo[i], blo);
+                frac *= overlap > 0 ? overlap / fBinW[i] : 0;
+            }
+            else if (b != bin[i])
+            {
+                frac = 0;
+            }
+            if (frac == 0)
+                break;
+        }
+        sum += frac * it->second;
+    }
+
+    return sum / norm;
+}
@@ -0,0 +1,590 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooTemplatePdf                                                     //
+//                                                                      //
+// Histogram template pdf with lookup tables for event evaluation.      //
+//                                                                      //
+// The bin contents of a 1-, 2- or 3-dimensional histogram with fixed   //
+// bin sizes are stored in a contiguous grid (see IsSupported()).       //
+// Values are looked up via the fixed binning without searching and     //
+// interpolated using a stencil of 1 (order 0), 2 (order 1, linear) or  //
+// 4 (order 3, cubic) nodes per dimension placed at the bin centers.    //
+// The stencil is shifted inwards at the grid edges, the interpolation  //
+// is not extrapolated beyond the outermost bin centers and negative    //
+// values are set to zero.                                              //
+//                                                                      //
+// For a fixed set of events, the base cells of the stencils and the    //
+// interpolation weights can be tabulated once via TabulateEvents().    //
+// EvaluateEvents() then only gathers the bin contents and accumulates  //
+// the weighted sums, normalized by a constant per template.            //
+// Both loops over the events are split among FFFooFit::gUseNCPU        //
+// threads.                                                             //
+//                                                                      //
+// Integrals over any subset of the observables are calculated          //
+// analytically from the bin contents (exact for order 0, approximate   //
+// otherwise).                                                          //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "TMath.h"
+#include "TH1.h"
+#include "RooArgList.h"
+#include "RooArgSet.h"
+#include "RooRealVar.h"
+
+#include "FFRooTemplatePdf.h"
+#include "FFFooFit.h"
+
+ClassImp(FFRooTemplatePdf)
+
+//______________________________________________________________________________
+FFRooTemplatePdf::FFRooTemplatePdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                                   const TH1* hist, Int_t intOrder)
+    : RooAbsPdf(name, title),
+      fObs("obs", "Observables", this)
+{
+    // Constructor using the observables 'obs' and the bin contents of the
+    // histogram 'hist'. Values are interpolated linearly if 'intOrder' is 1
+    // and cubically if 'intOrder' is 3. Other interpolation orders and
+    // histograms with variable bin sizes are not supported.
+
+    // init members
+    fObs.add(obs);
+    fNDim = obs.getSize();
+    fInterpolOrder = intOrder <= 0 ? 0 : intOrder;
+    fNEvent = 0;
+    fEvOwner = 0;
+
+    // check dimensions
+    if (fNDim < 1 || fNDim > 3 || hist->GetDimension() != fNDim)
+    {
+        Error("FFRooTemplatePdf", "Inconsistent dimensions of observables and histogram!");
+        fNDim = 0;
+    }
+    else if (!IsSupported(hist, intOrder))
+    {
+        Error("FFRooTemplatePdf", "Variable bin sizes or interpolation order %d not supported!", intOrder);
+        fNDim = 0;
+    }
+
+    // init grid
+    Init(hist);
+}
+
+//______________________________________________________________________________
+FFRooTemplatePdf::FFRooTemplatePdf(const Char_t* name, const Char_t* title, const RooArgList& obs,
+                                   Int_t intOrder)
+    : RooAbsPdf(name, title),
+      fObs("obs", "Observables", this)
+{
+    // Constructor for derived classes using the observables 'obs' and the
+    // interpolation order 'intOrder' (0, 1 or 3). The grid has to be
+    // initialized by the derived class via InitGrid().
+
+    // init members
+    fObs.add(obs);
+    fNDim = obs.getSize();
+    fInterpolOrder = intOrder <= 0 ? 0 : intOrder;
+    fNBin = 0;
+    fMin = 0;
+    fMax = 0;
+    fBinW = 0;
+    fNCell = 0;
+    fGrid = 0;
+    fGridErr2 = 0;
+    fNTap = 1;
+    fBinVol = 0;
+    fNEvent = 0;
+    fEvOwner = 0;
+
+    // check dimensions
+    if (fNDim < 1 || fNDim > 3)
+    {
+        Error("FFRooTemplatePdf", "Unsupported number of dimensions (%d)!", fNDim);
+        fNDim = 0;
+    }
+    else if (fInterpolOrder == 2 || fInterpolOrder > 3)
+    {
+        Error("FFRooTemplatePdf", "Unsupported interpolation order %d!", fInterpolOrder);
+        fNDim = 0;
+    }
+}
+
+//______________________________________________________________________________
+FFRooTemplatePdf::FFRooTemplatePdf(const FFRooTemplatePdf& other, const Char_t* name)
+    : RooAbsPdf(other, name),
+      fObs("obs", this, other.fObs)
+{
+    // Copy constructor.
+
+    // init members
+    fNDim = other.fNDim;
+    fInterpolOrder = other.fInterpolOrder;
+    fNTap = other.fNTap;
+    fBinVol = other.fBinVol;
+    fNCell = other.fNCell;
+    fNBin = new Int_t[fNDim];
+    fMin = new Double_t[fNDim];
+    fMax = new Double_t[fNDim];
+    fBinW = new Double_t[fNDim];
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        fNBin[i] = other.fNBin[i];
+        fMin[i] = other.fMin[i];
+        fMax[i] = other.fMax[i];
+        fBinW[i] = other.fBinW[i];
+    }
+    fGrid = new Double_t[fNCell];
+    fGridErr2 = new Double_t[fNCell];
+    for (Int_t c = 0; c < fNCell; c++)
+    {
+        fGrid[c] = other.fGrid[c];
+        fGridErr2[c] = other.fGridErr2[c];
+    }
+    fOff = other.fOff;
+    fNEvent = other.fNEvent;
+    fEvBase = other.fEvBase;
+    fEvW = other.fEvW;
+    fEvOwner = other.fEvOwner;
+}
+
+//______________________________________________________________________________
+FFRooTemplatePdf::~FFRooTemplatePdf()
+{
+    // Destructor.
+
+    if (fNBin)
+        delete [] fNBin;
+    if (fMin)
+        delete [] fMin;
+    if (fMax)
+        delete [] fMax;
+    if (fBinW)
+        delete [] fBinW;
+    if (fGrid)
+        delete [] fGrid;
+    if (fGridErr2)
+        delete [] fGridErr2;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooTemplatePdf::IsSupported(const TH1* hist, Int_t intOrder)
+{
+    // Check if the histogram 'hist' and the interpolation order 'intOrder'
+    // can be used by this pdf, i.e. if the histogram has 1 to 3 dimensions
+    // with fixed bin sizes and the interpolation order is 0, 1 or 3.
+    // Return kTRUE if supported, otherwise kFALSE.
+
+    // check interpolation order
+    if (intOrder == 2 || intOrder > 3)
+        return kFALSE;
+
+    // check dimensions
+    Int_t nDim = hist->GetDimension();
+    if (nDim < 1 || nDim > 3)
+        return kFALSE;
+
+    // check binning
+    const TAxis* haxes[3] = { hist->GetXaxis(), hist->GetYaxis(), hist->GetZaxis() };
+    for (Int_t i = 0; i < nDim; i++)
+    {
+        if (haxes[i]->IsVariableBinSize())
+            return kFALSE;
+    }
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+void FFRooTemplatePdf::Init(const TH1* hist)
+{
+    // Init the grid using the binning and the bin contents of the histogram
+    // 'hist'.
+
+    // binning
+    Int_t nBin[3];
+    Double_t min[3];
+    Double_t max[3];
+    const TAxis* haxes[3] = { hist->GetXaxis(), hist->GetYaxis(), hist->GetZaxis() };
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        nBin[i] = haxes[i]->GetNbins();
+        min[i] = haxes[i]->GetXmin();
+        max[i] = haxes[i]->GetXmax();
+    }
+    InitGrid(nBin, min, max);
+
+    // bin contents and errors (last dimension running fastest)
+    for (Int_t c = 0; c < fNCell; c++)
+    {
+        Int_t bin[3] = { 0, 0, 0 };
+        Int_t r = c;
+        for (Int_t i = fNDim-1; i >= 0; i--)
+        {
+            bin[i] = r % fNBin[i] + 1;
+            r /= fNBin[i];
+        }
+        Int_t b = hist->GetBin(bin[0], bin[1], bin[2]);
+        Double_t err = hist->GetBinError(b);
+        fGrid[c] = hist->GetBinContent(b);
+        fGridErr2[c] = err * err;
+    }
+}
+
+//______________________________________________________________________________
+void FFRooTemplatePdf::InitGrid(const Int_t* nBin, const Double_t* min, const Double_t* max)
+{
+    // Init an empty grid with 'nBin[i]' bins in the range ['min[i]', 'max[i]']
+    // in dimension i.
+
+    // binning
+    fNBin = new Int_t[fNDim];
+    fMin = new Double_t[fNDim];
+    fMax = new Double_t[fNDim];
+    fBinW = new Double_t[fNDim];
+    fNCell = fNDim ? 1 : 0;
+    fBinVol = 1;
+    fNTap = fInterpolOrder + 1;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        fNBin[i] = nBin[i];
+        fMin[i] = min[i];
+        fMax[i] = max[i];
+        fBinW[i] = (fMax[i] - fMin[i]) / fNBin[i];
+        fNCell *= fNBin[i];
+        fBinVol *= fBinW[i];
+        fNTap = TMath::Min(fNTap, fNBin[i]);
+    }
+
+    // empty bin contents and errors
+    fGrid = new Double_t[fNCell];
+    fGridErr2 = new Double_t[fNCell];
+    for (Int_t c = 0; c < fNCell; c++)
+    {
+        fGrid[c] = 0;
+        fGridErr2[c] = 0;
+    }
+
+    // cell offsets of the stencil nodes
+    Int_t nNode = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+        nNode *= fNTap;
+    fOff.assign(fNDim ? nNode : 0, 0);
+    for (Int_t c = 0; c < (Int_t)fOff.size(); c++)
+    {
+        Int_t r = c;
+        Int_t stride = 1;
+        for (Int_t i = fNDim-1; i >= 0; i--)
+        {
+            fOff[c] += (r % fNTap) * stride;
+            r /= fNTap;
+            stride *= fNBin[i];
+        }
+    }
+}
+
+//______________________________________________________________________________
+Bool_t FFRooTemplatePdf::ComputeStencil(const Double_t* x, Int_t* base, Double_t* w) const
+{
+    // Compute the base cell 'base' of the interpolation stencil of the point
+    // 'x' and the interpolation weights 'w' of the stencil nodes in each
+    // dimension [fNDim*fNTap].
+    // Return kFALSE if the point is outside of the grid, otherwise kTRUE.
+
+    Int_t b = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        // check range
+        if (!(x[i] >= fMin[i] && x[i] < fMax[i]))
+            return kFALSE;
+
+        // no interpolation
+        Double_t* wi = w + i*fNTap;
+        Int_t b0;
+        if (fNTap == 1)
+        {
+            b0 = TMath::Min((Int_t)((x[i] - fMin[i]) / fBinW[i]), fNBin[i]-1);
+            wi[0] = 1;
+        }
+        else
+        {
+            // first node of the stencil (shifted inwards at the edges)
+            Double_t u = (x[i] - fMin[i]) / fBinW[i] - 0.5;
+            b0 = (Int_t)TMath::Floor(u) - (fNTap/2 - 1);
+            b0 = TMath::Max(0, TMath::Min(b0, fNBin[i] - fNTap));
+
+            // Lagrange weights of the nodes (no extrapolation)
+            Double_t t = TMath::Max(0., TMath::Min(u - b0, fNTap - 1.));
+            for (Int_t j = 0; j < fNTap; j++)
+            {
+                wi[j] = 1;
+                for (Int_t m = 0; m < fNTap; m++)
+                    if (m != j) wi[j] *= (t - m) / (j - m);
+            }
+        }
+        b = b * fNBin[i] + b0;
+    }
+    *base = b;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Double_t FFRooTemplatePdf::EvaluateStencil(Int_t base, const Double_t* w) const
+{
+    // Return the interpolated bin content using the stencil with the base
+    // cell 'base' and the interpolation weights 'w'.
+
+    const Double_t* g = fGrid + base;
+    const Int_t nNode = fOff.size();
+    Double_t sum = 0;
+    if (fNDim == 1)
+    {
+        for (Int_t c = 0; c < nNode; c++)
+            sum += w[c] * g[fOff[c]];
+    }
+    else if (fNDim == 2)
+    {
+        for (Int_t c = 0; c < nNode; c++)
+            sum += w[c / fNTap] * w[fNTap + c % fNTap] * g[fOff[c]];
+    }
+    else
+    {
+        for (Int_t c = 0; c < nNode; c++)
+            sum += w[c / (fNTap*fNTap)] * w[fNTap + (c / fNTap) % fNTap] *
+                   w[2*fNTap + c % fNTap] * g[fOff[c]];
+    }
+
+    return sum > 0 ? sum : 0;
+}
+
+//______________________________________________________________________________
+Double_t FFRooTemplatePdf::evaluate() const
+{
+    // Calculate the value of the pdf.
+
+    // check grid
+    if (!fNCell)
+        return 0;
+    UpdateGrid();
+
+    // current point
+    Double_t x[3];
+    for (Int_t i = 0; i < fNDim; i++)
+        x[i] = ((RooAbsReal*)fObs.at(i))->getVal();
+
+    // interpolate
+    Int_t base;
+    Double_t w[12];
+    if (!ComputeStencil(x, &base, w))
+        return 0;
+
+    return EvaluateStencil(base, w) / fBinVol;
+}
+
+//______________________________________________________________________________
+Double_t FFRooTemplatePdf::GetNormalization(const char* rangeName) const
+{
+    // Return the integral of the pdf over all observables in the range
+    // 'rangeName'.
+
+    return fNDim ? analyticalIntegral(1 << fNDim, rangeName) : 0;
+}
+
+//______________________________________________________________________________
+Double_t FFRooTemplatePdf::GetRelError2(const Double_t* x) const
+{
+    // Return the squared relative statistical error of the bin content of
+    // the template bin containing the point 'x' (0 outside of the grid or
+    // for empty bins).
+
+    // check grid
+    if (!fNCell)
+        return 0;
+    UpdateGrid();
+
+    // locate bin
+    Int_t c = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (!(x[i] >= fMin[i] && x[i] < fMax[i]))
+            return 0;
+        c = c * fNBin[i] + TMath::Min((Int_t)((x[i] - fMin[i]) / fBinW[i]), fNBin[i]-1);
+    }
+
+    return fGrid[c] != 0 ? fGridErr2[c] / (fGrid[c] * fGrid[c]) : 0;
+}
+
+//______________________________________________________________________________
+Long64_t FFRooTemplatePdf::TabulateEvents(Long64_t n, const Double_t* x, const TObject* owner)
+{
+    // Tabulate the base cells and interpolation weights of the 'n' events
+    // having the observable values 'x' [n*fNDim] for the evaluation via
+    // EvaluateEvents(). The optional 'owner' of the tables can be used to
+    // check if they are still valid for the events of the owner (see
+    // GetEventOwner()).
+    // Return the number of events inside the grid.
+
+    // check grid
+    if (!fNCell)
+        return 0;
+
+    // tabulate events (slices in parallel)
+    const Int_t nW = fNDim*fNTap;
+    fNEvent = n;
+    fEvOwner = owner;
+    fEvBase.assign(n, -1);
+    fEvW.assign(n*nW, 0);
+    std::vector<Long64_t> nIn(TMath::Max(FFFooFit::gUseNCPU, 1), 0);
+    FFFooFit::ParallelFor(n, FFFooFit::gUseNCPU, [&](Int_t t, Long64_t start, Long64_t end)
+    {
+        for (Long64_t e = start; e < end; e++)
+        {
+            if (ComputeStencil(x + e*fNDim, &fEvBase[e], &fEvW[e*nW]))
+                nIn[t]++;
+            else
+                fEvBase[e] = -1;
+        }
+    });
+
+    Long64_t nTot = 0;
+    for (UInt_t t = 0; t < nIn.size(); t++)
+        nTot += nIn[t];
+
+    return nTot;
+}
+
+//______________________________________________________________________________
+void FFRooTemplatePdf::EvaluateEvents(Double_t* out, const char* rangeName) const
+{
+    // Evaluate the pdf normalized in the range 'rangeName' of the observables
+    // for all events tabulated via TabulateEvents() and store the values in
+    // 'out' [GetNEvent()].
+
+    // normalization constant of the template
+    UpdateGrid();
+    Double_t norm = GetNormalization(rangeName);
+    norm = norm > 0 ? 1. / (norm * fBinVol) : 0;
+
+    // gather and accumulate (slices in parallel)
+    const Int_t nW = fNDim*fNTap;
+    const Int_t* base = fEvBase.data();
+    const Double_t* w = fEvW.data();
+    FFFooFit::ParallelFor(fNEvent, FFFooFit::gUseNCPU, [&](Int_t, Long64_t start, Long64_t end)
+    {
+        if (fNTap == 1)
+        {
+            for (Long64_t e = start; e < end; e++)
+                out[e] = base[e] < 0 ? 0 : fGrid[base[e]] * norm;
+        }
+        else
+        {
+            for (Long64_t e = start; e < end; e++)
+                out[e] = base[e] < 0 ? 0 : EvaluateStencil(base[e], w + e*nW) * norm;
+        }
+    });
+}
+
+//______________________________________________________________________________
+void FFRooTemplatePdf::ClearEvents()
+{
+    // Remove the tabulated events.
+
+    fNEvent = 0;
+    fEvOwner = 0;
+    fEvBase.clear();
+    fEvW.clear();
+}
+
+//______________________________________________________________________________
+Int_t FFRooTemplatePdf::getAnalyticalIntegral(RooArgSet& allVars, RooArgSet& analVars,
+                                              const char* rangeName) const
+{
+    // Advertise the analytical integration over any subset of the
+    // observables. The integration code is 1 + bit mask of the integrated
+    // observables.
+
+    Int_t mask = 0;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (allVars.find(*fObs.at(i)))
+        {
+            mask |= 1 << i;
+            analVars.add(*fObs.at(i));
+        }
+    }
+
+    return mask ? mask + 1 : 0;
+}
+
+//______________________________________________________________________________
+Double_t FFRooTemplatePdf::analyticalIntegral(Int_t code, const char* rangeName) const
+{
+    // Calculate the integral over the observables selected by 'code' (see
+    // getAnalyticalIntegral()) in the range 'rangeName'. The other
+    // observables are fixed to the bins of their current values.
+
+    // check grid
+    if (!fNCell)
+        return 0;
+    UpdateGrid();
+
+    // integration ranges and bins of the fixed observables
+    const Int_t mask = code - 1;
+    Double_t lo[3];
+    Double_t hi[3];
+    Int_t fix[3];
+    Double_t norm = 1;
+    for (Int_t i = 0; i < fNDim; i++)
+    {
+        if (mask & (1 << i))
+        {
+            RooRealVar* var = (RooRealVar*)fObs.at(i);
+            lo[i] = TMath::Max(var->getMin(rangeName), fMin[i]);
+            hi[i] = TMath::Min(var->getMax(rangeName), fMax[i]);
+            if (hi[i] <= lo[i])
+                return 0;
+        }
+        else
+        {
+            Double_t x = ((RooAbsReal*)fObs.at(i))->getVal();
+            if (!(x >= fMin[i] && x < fMax[i]))
+                return 0;
+            fix[i] = TMath::Min((Int_t)((x - fMin[i]) / fBinW[i]), fNBin[i]-1);
+            norm *= fBinW[i];
+        }
+    }
+
+    // sum overlaps of bins with integration ranges
+    Double_t sum = 0;
+    for (Int_t c = 0; c < fNCell; c++)
+    {
+        if (fGrid[c] == 0)
+            continue;
+        Double_t frac = 1;
+        Int_t r = c;
+        for (Int_t i = fNDim-1; i >= 0 && frac > 0; i--)
+        {
+            Int_t b = r % fNBin[i];
+            r /= fNBin[i];
+            if (mask & (1 << i))
+            {
+                Double_t blo = fMin[i] + b * fBinW[i];
+                Double_t overlap = TMath::Min(hi[i], blo + fBinW[i]) - TMath::Max(lo[i], blo);
+                frac *= overlap > 0 ? overlap / fBinW[i] : 0;
+            }
+            else if (b != fix[i])
+            {
+                frac = 0;
+            }
+        }
+        sum += frac * fGrid[c];
+    }
+
+    return sum / norm;
+}
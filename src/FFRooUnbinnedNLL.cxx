@@ -0,0 +1,884 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFRooUnbinnedNLL                                                     //
+//                                                                      //
+// Native extended negative log-likelihood of a sum of models and       //
+// unbinned data using cached per-event component densities.            //
+//                                                                      //
+// The observable values and weights of the events are stored in        //
+// contiguous arrays. The normalized densities of each component are    //
+// tabulated for all events in one contiguous column per component and  //
+// only recomputed if a parameter of the component changed. The         //
+// columns of components without floating shape parameters (e.g.        //
+// histogram or kernel estimation templates) are thus computed only     //
+// once, and a change of the yields only requires the weighted log-sum  //
+// over the cached columns.                                             //
+//                                                                      //
+// Components of type FFRooTemplatePdf are tabulated using the event    //
+// lookup tables of the template (see                                   //
+// FFRooTemplatePdf::EvaluateEvents), which are filled once at          //
+// initialization and kept, and components of type FFRooIndexedKeysPdf  //
+// are evaluated for all events in parallel instead of evaluating the   //
+// pdf event by event.                                                  //
+//                                                                      //
+// If only yields are floating (see IsYieldOnly()), the likelihood is   //
+// convex in the yields and can be minimized directly via SolveYields() //
+// using Newton iterations with the analytical gradient and Hessian     //
+// calculated from the cached density columns. ComputeSWeights()        //
+// calculates the sWeights of the events from the solved yields without //
+// another fit.                                                         //
+//                                                                      //
+// NOTE: the likelihood is evaluated in the calling process only, i.e.  //
+// FFFooFit::gUseNCPU is ignored. FFRooFit therefore uses it only if a  //
+// component has no floating shape parameters (see                      //
+// HasCachedComponent()).                                               //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include "TMath.h"
+#include "RooRealVar.h"
+#include "RooArgList.h"
+#include "RooAbsPdf.h"
+#include "RooDataSet.h"
+
+#include "FFRooUnbinnedNLL.h"
+#include "FFRooModelSum.h"
+#include "FFRooTemplatePdf.h"
+#include "FFRooIndexedKeysPdf.h"
+#include "FFFooFit.h"
+
+ClassImp(FFRooUnbinnedNLL)
+
+//______________________________________________________________________________
+FFRooUnbinnedNLL::FFRooUnbinnedNLL(const Char_t* name, const Char_t* title, FFRooModelSum* model,
+                                   RooDataSet& data, RooRealVar** obs, Int_t nObs,
+                                   const RooArgSet& constr)
+    : RooAbsReal(name, title),
+      fComp("comp", "Component pdfs", this),
+      fCoef("coef", "Component yields", this),
+      fConstr("constr", "Constraint pdfs", this)
+{
+    // Constructor using the sum of models 'model', the unbinned data 'data',
+    // the 'nObs' observables 'obs' and the constraint pdfs 'constr'.
+
+    // init members
+    fModel = model;
+    fNObs = nObs;
+    fObs = new RooRealVar*[fNObs];
+    for (Int_t i = 0; i < fNObs; i++)
+    {
+        fObs[i] = obs[i];
+        fObsSet.add(*obs[i]);
+    }
+    fWeightSq = kFALSE;
+
+    // register components, yields and constraints
+    for (Int_t i = 0; i < fModel->GetNModel(); i++)
+    {
+        fComp.add(*fModel->GetModel(i)->GetPdf());
+        fCoef.add(*fModel->GetPar(i));
+    }
+    fConstr.add(constr);
+
+    // load the events
+    LoadEvents(data);
+
+    // init caches
+    Init();
+}
+
+//______________________________________________________________________________
+FFRooUnbinnedNLL::FFRooUnbinnedNLL(const FFRooUnbinnedNLL& other, const Char_t* name)
+    : RooAbsReal(other, name),
+      fComp("comp", this, other.fComp),
+      fCoef("coef", this, other.fCoef),
+      fConstr("constr", this, other.fConstr)
+{
+    // Copy constructor.
+
+    // init members
+    fModel = other.fModel;
+    fNObs = other.fNObs;
+    fObs = new RooRealVar*[fNObs];
+    for (Int_t i = 0; i < fNObs; i++)
+    {
+        fObs[i] = other.fObs[i];
+        fObsSet.add(*other.fObs[i]);
+    }
+    fNEvent = other.fNEvent;
+    fEvX = new Double_t[fNEvent*fNObs];
+    fEvW = new Double_t[fNEvent];
+    fEvW2 = new Double_t[fNEvent];
+    for (Long64_t i = 0; i < fNEvent*fNObs; i++)
+        fEvX[i] = other.fEvX[i];
+    for (Long64_t i = 0; i < fNEvent; i++)
+    {
+        fEvW[i] = other.fEvW[i];
+        fEvW2[i] = other.fEvW2[i];
+    }
+    fSumW = other.fSumW;
+    fSumW2 = other.fSumW2;
+    fWeightSq = other.fWeightSq;
+
+    // init caches
+    Init();
+}
+
+//______________________________________________________________________________
+FFRooUnbinnedNLL::~FFRooUnbinnedNLL()
+{
+    // Destructor.
+
+    // clear the event lookup tables of template components
+    for (Int_t k = 0; k < fComp.getSize(); k++)
+    {
+        RooAbsArg* c = fComp.at(k);
+        if (c->InheritsFrom("FFRooTemplatePdf") && ((FFRooTemplatePdf*)c)->GetEventOwner() == this)
+            ((FFRooTemplatePdf*)c)->ClearEvents();
+    }
+
+    if (fObs)
+        delete [] fObs;
+    if (fEvX)
+        delete [] fEvX;
+    if (fEvW)
+        delete [] fEvW;
+    if (fEvW2)
+        delete [] fEvW2;
+    if (fProb)
+        delete [] fProb;
+    if (fMu)
+        delete [] fMu;
+    for (UInt_t i = 0; i < fConstrNorm.size(); i++)
+        delete fConstrNorm[i];
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::IsApplicable(FFRooModel* model, RooAbsData* data)
+{
+    // Check if the native unbinned likelihood can be used for the model
+    // 'model' and the data 'data'.
+
+    // check data
+    if (!data || !data->InheritsFrom("RooDataSet"))
+        return kFALSE;
+
+    // check model
+    if (!model || !model->InheritsFrom("FFRooModelSum") || !model->GetPdf())
+        return kFALSE;
+
+    // check sub-models
+    FFRooModelSum* sum = (FFRooModelSum*)model;
+    for (Int_t i = 0; i < sum->GetNModel(); i++)
+        if (!sum->GetModel(i) || !sum->GetModel(i)->GetPdf()) return kFALSE;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::HasCachedComponent(FFRooModel* model, RooAbsData* data)
+{
+    // Check if the sum of models 'model' has at least one component without
+    // floating shape parameters for the data 'data', i.e. a component whose
+    // densities would be computed only once by this likelihood.
+
+    // check model
+    if (!model || !data || !model->InheritsFrom("FFRooModelSum"))
+        return kFALSE;
+
+    // loop over sub-models
+    FFRooModelSum* sum = (FFRooModelSum*)model;
+    for (Int_t i = 0; i < sum->GetNModel(); i++)
+    {
+        if (!sum->GetModel(i) || !sum->GetModel(i)->GetPdf())
+            continue;
+
+        // count floating parameters
+        Int_t nFloat = 0;
+        RooArgSet* params = sum->GetModel(i)->GetPdf()->getParameters(*data);
+        TIterator* iter = params->createIterator();
+        while (RooAbsArg* p = (RooAbsArg*)iter->Next())
+            if (p->InheritsFrom("RooRealVar") && !p->isConstant()) nFloat++;
+        delete iter;
+        delete params;
+        if (!nFloat)
+            return kTRUE;
+    }
+
+    return kFALSE;
+}
+
+//______________________________________________________________________________
+void FFRooUnbinnedNLL::LoadEvents(RooDataSet& data)
+{
+    // Copy the observable values and the weights of all events of the data
+    // 'data' into contiguous arrays.
+
+    // create arrays
+    fNEvent = data.numEntries();
+    fEvX = new Double_t[fNEvent*fNObs];
+    fEvW = new Double_t[fNEvent];
+    fEvW2 = new Double_t[fNEvent];
+    fSumW = 0;
+    fSumW2 = 0;
+
+    // copy events
+    for (Long64_t i = 0; i < fNEvent; i++)
+    {
+        const RooArgSet* row = data.get(i);
+        for (Int_t j = 0; j < fNObs; j++)
+        {
+            RooAbsReal* x = (RooAbsReal*)row->find(fObs[j]->GetName());
+            fEvX[i*fNObs+j] = x ? x->getVal() : 0;
+        }
+        fEvW[i] = data.weight();
+        fEvW2[i] = data.weightSquared();
+        fSumW += fEvW[i];
+        fSumW2 += fEvW2[i];
+    }
+}
+
+//______________________________________________________________________________
+void FFRooUnbinnedNLL::Init()
+{
+    // Create the caches of the component densities and event expectations
+    // and collect the parameters.
+
+    fNComp = fComp.getSize();
+    fProb = new Double_t[fNComp*fNEvent];
+    fMu = new Double_t[fNEvent];
+    fLastVal = 0;
+    fLastValid = kFALSE;
+    fNCompEval = 0;
+    fNSolverIter = 0;
+    fSolverEDM = 0;
+    CollectParameters();
+
+    // tabulate the events of template components once
+    for (Int_t k = 0; k < fNComp; k++)
+        TabulateTemplate(k);
+}
+
+//______________________________________________________________________________
+void FFRooUnbinnedNLL::CollectParameters()
+{
+    // Collect the floating parameters of the components, of the constraints
+    // and of the full likelihood.
+
+    // floating parameters of components
+    fCompPar.clear();
+    fCompVal.clear();
+    fCompValid.clear();
+    for (Int_t i = 0; i < fNComp; i++)
+    {
+        std::vector<RooRealVar*> par;
+        RooArgSet* params = fComp.at(i)->getParameters(fObsSet);
+        TIterator* iter = params->createIterator();
+        while (RooAbsArg* p = (RooAbsArg*)iter->Next())
+            if (p->InheritsFrom("RooRealVar") && !p->isConstant()) par.push_back((RooRealVar*)p);
+        delete iter;
+        delete params;
+        fCompPar.push_back(par);
+        fCompVal.push_back(std::vector<Double_t>(par.size(), 0));
+        fCompValid.push_back(kFALSE);
+    }
+
+    // normalization sets of constraints (floating constrained parameters)
+    for (UInt_t i = 0; i < fConstrNorm.size(); i++)
+        delete fConstrNorm[i];
+    fConstrNorm.clear();
+    for (Int_t i = 0; i < fConstr.getSize(); i++)
+    {
+        RooArgSet* norm = new RooArgSet();
+        RooArgSet* vars = fConstr.at(i)->getVariables();
+        TIterator* iter = vars->createIterator();
+        while (RooAbsArg* p = (RooAbsArg*)iter->Next())
+            if (!p->isConstant()) norm->add(*p);
+        delete iter;
+        delete vars;
+        fConstrNorm.push_back(norm);
+    }
+
+    // floating parameters of the likelihood
+    fPar.clear();
+    RooArgSet* params = getParameters(fObsSet);
+    TIterator* iter = params->createIterator();
+    while (RooAbsArg* p = (RooAbsArg*)iter->Next())
+        if (p->InheritsFrom("RooRealVar") && !p->isConstant()) fPar.push_back((RooRealVar*)p);
+    delete iter;
+    delete params;
+    fParVal.assign(fPar.size(), 0);
+}
+
+//______________________________________________________________________________
+Int_t FFRooUnbinnedNLL::GetNCompCached() const
+{
+    // Return the number of components without floating shape parameters,
+    // i.e. the number of components whose densities are computed only once.
+
+    Int_t n = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+        if (fCompPar[k].empty()) n++;
+
+    return n;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::CollectEvents(const RooArgList& obs, std::vector<Double_t>& x) const
+{
+    // Collect the values of the observables 'obs' of all events in 'x'
+    // [fNEvent*nDim] in the order of 'obs'.
+    // Return kTRUE on success, kFALSE if an observable was not found.
+
+    // map observables
+    const Int_t nDim = obs.getSize();
+    if (!nDim)
+        return kFALSE;
+    Int_t map[nDim];
+    for (Int_t i = 0; i < nDim; i++)
+    {
+        map[i] = -1;
+        for (Int_t j = 0; j < fNObs; j++)
+            if (!strcmp(obs.at(i)->GetName(), fObs[j]->GetName())) map[i] = j;
+        if (map[i] == -1)
+            return kFALSE;
+    }
+
+    // collect values
+    x.resize(fNEvent*nDim);
+    for (Long64_t e = 0; e < fNEvent; e++)
+        for (Int_t i = 0; i < nDim; i++)
+            x[e*nDim+i] = fEvX[e*fNObs+map[i]];
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::TabulateTemplate(Int_t comp) const
+{
+    // Tabulate the events in the lookup tables of the template component
+    // 'comp' (owned by this likelihood until cleared in the destructor).
+    // Return kTRUE on success, otherwise kFALSE.
+
+    RooAbsArg* c = fComp.at(comp);
+    if (!c->InheritsFrom("FFRooTemplatePdf"))
+        return kFALSE;
+    FFRooTemplatePdf* pdf = (FFRooTemplatePdf*)c;
+
+    // tabulate events
+    std::vector<Double_t> x;
+    if (!CollectEvents(pdf->GetObservables(), x))
+        return kFALSE;
+    pdf->TabulateEvents(fNEvent, x.data(), this);
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::TabulateComponent(Int_t comp) const
+{
+    // Compute the densities of all events for the template component 'comp'
+    // using the event lookup tables of the template, or for the indexed
+    // kernel estimation component 'comp' using its batch evaluation.
+    // The lookup tables are tabulated once in Init() and kept, i.e. only
+    // the bin contents are gathered here (the events are tabulated again
+    // only if another likelihood took over the tables of the template).
+    // Return kTRUE on success, otherwise kFALSE.
+
+    RooAbsArg* c = fComp.at(comp);
+
+    // template lookup tables
+    if (c->InheritsFrom("FFRooTemplatePdf"))
+    {
+        FFRooTemplatePdf* pdf = (FFRooTemplatePdf*)c;
+        if (pdf->GetEventOwner() != this && !TabulateTemplate(comp))
+            return kFALSE;
+        pdf->EvaluateEvents(fProb + comp*fNEvent);
+        return kTRUE;
+    }
+
+    // indexed kernel estimation
+    if (c->InheritsFrom("FFRooIndexedKeysPdf"))
+    {
+        FFRooIndexedKeysPdf* pdf = (FFRooIndexedKeysPdf*)c;
+        std::vector<Double_t> x;
+        if (!pdf->GetNDim() || !CollectEvents(pdf->GetObservables(), x))
+            return kFALSE;
+        pdf->EvaluateEvents(fNEvent, x.data(), fProb + comp*fNEvent);
+        return kTRUE;
+    }
+
+    return kFALSE;
+}
+
+//______________________________________________________________________________
+void FFRooUnbinnedNLL::ComputeDensities(Int_t comp) const
+{
+    // Compute the normalized densities of all events for the component
+    // 'comp' using the event lookup tables of templates if possible,
+    // otherwise by evaluating the pdf event by event.
+    // NOTE: the values of the observables may be modified.
+
+    fNCompEval++;
+
+    // template lookup tables
+    if (TabulateComponent(comp))
+        return;
+
+    // events
+    RooAbsReal* pdf = (RooAbsReal*)fComp.at(comp);
+    Double_t* prob = fProb + comp*fNEvent;
+    for (Long64_t i = 0; i < fNEvent; i++)
+    {
+        for (Int_t j = 0; j < fNObs; j++)
+            fObs[j]->setVal(fEvX[i*fNObs+j]);
+        prob[i] = pdf->getVal(&fObsSet);
+    }
+}
+
+//______________________________________________________________________________
+void FFRooUnbinnedNLL::ApplyWeightSquared(Bool_t flag)
+{
+    // Use the squared event weights if 'flag' is kTRUE (used to correct the
+    // covariance matrix of weighted fits).
+
+    if (flag != fWeightSq)
+    {
+        fWeightSq = flag;
+        fLastValid = kFALSE;
+        setValueDirty();
+    }
+}
+
+//______________________________________________________________________________
+Double_t FFRooUnbinnedNLL::evaluate() const
+{
+    // Evaluate the negative log-likelihood.
+
+    // return cached value if no parameter changed
+    Bool_t changed = !fLastValid;
+    for (UInt_t i = 0; i < fPar.size(); i++)
+    {
+        Double_t v = fPar[i]->getVal();
+        if (v != fParVal[i])
+        {
+            fParVal[i] = v;
+            changed = kTRUE;
+        }
+    }
+    if (!changed)
+        return fLastVal;
+
+    // update the densities of the components with changed parameters
+    Double_t* obsVal = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        // check parameters
+        Bool_t compChanged = !fCompValid[k];
+        for (UInt_t j = 0; j < fCompPar[k].size(); j++)
+        {
+            Double_t v = fCompPar[k][j]->getVal();
+            if (v != fCompVal[k][j])
+            {
+                fCompVal[k][j] = v;
+                compChanged = kTRUE;
+            }
+        }
+        if (!compChanged)
+            continue;
+
+        // backup observable values
+        if (!obsVal)
+        {
+            obsVal = new Double_t[fNObs];
+            for (Int_t j = 0; j < fNObs; j++)
+                obsVal[j] = fObs[j]->getVal();
+        }
+
+        // compute densities
+        ComputeDensities(k);
+        fCompValid[k] = kTRUE;
+    }
+
+    // restore observable values
+    if (obsVal)
+    {
+        for (Int_t j = 0; j < fNObs; j++)
+            fObs[j]->setVal(obsVal[j]);
+        delete [] obsVal;
+    }
+
+    // calculate the event expectations
+    Double_t nExp = 0;
+    for (Long64_t i = 0; i < fNEvent; i++)
+        fMu[i] = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        const Double_t n = ((RooAbsReal*)fCoef.at(k))->getVal();
+        const Double_t* prob = fProb + k*fNEvent;
+        for (Long64_t i = 0; i < fNEvent; i++)
+            fMu[i] += n * prob[i];
+        nExp += n;
+    }
+
+    // extended likelihood
+    // (non-positive expectations are floored to yield a large but finite value)
+    Double_t nll = 0;
+    if (!fWeightSq)
+    {
+        nll = nExp;
+        for (Long64_t i = 0; i < fNEvent; i++)
+            nll -= fEvW[i] * TMath::Log(fMu[i] > 0 ? fMu[i] : 1e-300);
+    }
+    else
+    {
+        // squared weights
+        nll = fSumW != 0 ? fSumW2 / fSumW * nExp : nExp;
+        for (Long64_t i = 0; i < fNEvent; i++)
+            nll -= fEvW2[i] * TMath::Log(fMu[i] > 0 ? fMu[i] : 1e-300);
+    }
+
+    // constraints
+    for (Int_t i = 0; i < fConstr.getSize(); i++)
+        nll -= TMath::Log(((RooAbsReal*)fConstr.at(i))->getVal(fConstrNorm[i]));
+
+    // cache value
+    fLastVal = nll;
+    fLastValid = kTRUE;
+
+    return nll;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::IsYieldOnly() const
+{
+    // Check if the yields are the only floating parameters of the likelihood,
+    // i.e. if all component shapes are fixed and no floating parameter is
+    // constrained (see FFFooFit::IsYieldOnly()).
+
+    return FFFooFit::IsYieldOnly(fCompPar, fConstrNorm, fPar, fCoef);
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::ComputeYieldNLL(Int_t nFree, const Int_t* idx, const Double_t* n,
+                                         const Double_t* mu0, Double_t* nll) const
+{
+    // Calculate the event expectations and the likelihood (up to a constant)
+    // for the values 'n' of the 'nFree' floating yields of the components
+    // with indices 'idx' and the expectations of the fixed yields 'mu0'.
+    // Return kFALSE if the likelihood is undefined, otherwise kTRUE.
+
+    // event expectations
+    for (Long64_t i = 0; i < fNEvent; i++)
+        fMu[i] = mu0[i];
+    for (Int_t k = 0; k < nFree; k++)
+    {
+        const Double_t* prob = fProb + idx[k]*fNEvent;
+        for (Long64_t i = 0; i < fNEvent; i++)
+            fMu[i] += n[k] * prob[i];
+    }
+
+    // likelihood
+    Double_t sum = 0;
+    for (Int_t k = 0; k < nFree; k++)
+        sum += n[k];
+    for (Long64_t i = 0; i < fNEvent; i++)
+    {
+        if (fEvW[i] == 0)
+            continue;
+        if (!(fMu[i] > 0))
+            return kFALSE;
+        sum -= fEvW[i] * TMath::Log(fMu[i]);
+    }
+    *nll = sum;
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::SolveYields(Int_t maxIter, Double_t tol)
+{
+    // Minimize the likelihood with respect to the floating yields if they
+    // are the only floating parameters (see IsYieldOnly()). Starting from a
+    // few EM iterations, Newton steps using the analytical gradient and
+    // Hessian are performed until the estimated distance to the minimum is
+    // below 'tol' or 'maxIter' iterations were performed. The yields are
+    // kept within their limits: yields at a limit with the gradient pointing
+    // outwards are held fixed and the Newton steps and the estimated distance
+    // to the minimum use the remaining yields only (projected gradient, i.e.
+    // the KKT conditions are checked at the active limits).
+    // The yields are set to the solution on success. If the Hessian is
+    // ill-conditioned or no convergence was reached, the yields are left
+    // unchanged and kFALSE is returned.
+
+    fNSolverIter = 0;
+    fSolverEDM = 0;
+
+    // check parameters
+    if (!IsYieldOnly())
+        return kFALSE;
+
+    // make sure the densities are cached
+    getVal();
+
+    // collect floating yields
+    Int_t idx[fNComp];
+    Int_t nFree = 0;
+    for (Int_t k = 0; k < fNComp; k++)
+        if (!fCoef.at(k)->isConstant()) idx[nFree++] = k;
+    if (!nFree)
+        return kFALSE;
+
+    // expectations of the fixed yields
+    std::vector<Double_t> mu0(fNEvent, 0);
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        if (!fCoef.at(k)->isConstant())
+            continue;
+        const Double_t n = ((RooAbsReal*)fCoef.at(k))->getVal();
+        const Double_t* prob = fProb + k*fNEvent;
+        for (Long64_t i = 0; i < fNEvent; i++)
+            mu0[i] += n * prob[i];
+    }
+
+    // start values and limits
+    Double_t n[nFree];
+    Double_t nMin[nFree];
+    Double_t nMax[nFree];
+    Double_t nStart[nFree];
+    for (Int_t k = 0; k < nFree; k++)
+    {
+        RooRealVar* var = (RooRealVar*)fCoef.at(idx[k]);
+        nStart[k] = var->getVal();
+        nMin[k] = var->getMin();
+        nMax[k] = var->getMax();
+        n[k] = nStart[k] > 0 ? nStart[k] : (fSumW > 0 ? fSumW / nFree : 1);
+        n[k] = TMath::Max(nMin[k], TMath::Min(n[k], nMax[k]));
+    }
+
+    // EM iterations (only for non-negative weights)
+    Bool_t posW = kTRUE;
+    for (Long64_t i = 0; i < fNEvent && posW; i++)
+        if (fEvW[i] < 0) posW = kFALSE;
+    Double_t nll;
+    for (Int_t iter = 0; iter < 5 && posW; iter++)
+    {
+        if (!ComputeYieldNLL(nFree, idx, n, mu0.data(), &nll))
+            break;
+        for (Int_t k = 0; k < nFree; k++)
+        {
+            const Double_t* prob = fProb + idx[k]*fNEvent;
+            Double_t s = 0;
+            for (Long64_t i = 0; i < fNEvent; i++)
+                s += fEvW[i] * prob[i] / fMu[i];
+            n[k] = TMath::Max(nMin[k], TMath::Min(n[k] * s, nMax[k]));
+        }
+    }
+
+    // Newton iterations
+    std::vector<Double_t> r(fNEvent);
+    std::vector<Double_t> r2(fNEvent);
+    Double_t g[nFree];
+    Double_t h[nFree*nFree];
+    Double_t d[nFree];
+    Double_t trial[nFree];
+    Int_t inact[nFree];
+    Double_t hr[nFree*nFree];
+    Double_t dr[nFree];
+    Bool_t converged = kFALSE;
+    if (!ComputeYieldNLL(nFree, idx, n, mu0.data(), &nll))
+        return kFALSE;
+    for (fNSolverIter = 0; fNSolverIter < maxIter; fNSolverIter++)
+    {
+        // event terms of gradient and Hessian
+        for (Long64_t i = 0; i < fNEvent; i++)
+        {
+            r[i] = fEvW[i] != 0 ? fEvW[i] / fMu[i] : 0;
+            r2[i] = r[i] / (fEvW[i] != 0 ? fMu[i] : 1);
+        }
+
+        // gradient and Hessian
+        for (Int_t k = 0; k < nFree; k++)
+        {
+            const Double_t* pk = fProb + idx[k]*fNEvent;
+            Double_t s = 0;
+            for (Long64_t i = 0; i < fNEvent; i++)
+                s += r[i] * pk[i];
+            g[k] = 1 - s;
+            for (Int_t l = 0; l <= k; l++)
+            {
+                const Double_t* pl = fProb + idx[l]*fNEvent;
+                Double_t t = 0;
+                for (Long64_t i = 0; i < fNEvent; i++)
+                    t += r2[i] * pk[i] * pl[i];
+                h[k*nFree+l] = t;
+                h[l*nFree+k] = t;
+            }
+        }
+
+        // yields not held at a limit (the gradient points outwards at active limits)
+        Int_t nInact = 0;
+        for (Int_t k = 0; k < nFree; k++)
+        {
+            Bool_t active = (n[k] <= nMin[k] && g[k] > 0) || (n[k] >= nMax[k] && g[k] < 0);
+            if (!active)
+                inact[nInact++] = k;
+        }
+
+        // Newton step of the yields not held at a limit
+        for (Int_t k = 0; k < nInact; k++)
+        {
+            dr[k] = -g[inact[k]];
+            for (Int_t l = 0; l < nInact; l++)
+                hr[k*nInact+l] = h[inact[k]*nFree+inact[l]];
+        }
+        if (nInact && !FFFooFit::SolveCholesky(nInact, hr, dr))
+        {
+            fSolverEDM = 0;
+            return kFALSE;
+        }
+        for (Int_t k = 0; k < nFree; k++)
+            d[k] = 0;
+        for (Int_t k = 0; k < nInact; k++)
+            d[inact[k]] = dr[k];
+
+        // estimated distance to minimum (projected gradient)
+        fSolverEDM = 0;
+        for (Int_t k = 0; k < nFree; k++)
+            fSolverEDM -= 0.5 * g[k] * d[k];
+        if (fSolverEDM < tol)
+        {
+            converged = kTRUE;
+            break;
+        }
+
+        // line search within the limits
+        Bool_t accepted = kFALSE;
+        Double_t alpha = 1;
+        for (Int_t j = 0; j < 30; j++, alpha *= 0.5)
+        {
+            Double_t nllTrial;
+            for (Int_t k = 0; k < nFree; k++)
+                trial[k] = TMath::Max(nMin[k], TMath::Min(n[k] + alpha*d[k], nMax[k]));
+            if (ComputeYieldNLL(nFree, idx, trial, mu0.data(), &nllTrial) && nllTrial <= nll)
+            {
+                for (Int_t k = 0; k < nFree; k++)
+                    n[k] = trial[k];
+                nll = nllTrial;
+                accepted = kTRUE;
+                break;
+            }
+        }
+
+        // no further decrease possible without reaching the minimum
+        if (!accepted)
+            break;
+    }
+
+    // set solution
+    if (!converged)
+        return kFALSE;
+    for (Int_t k = 0; k < nFree; k++)
+        ((RooRealVar*)fCoef.at(idx[k]))->setVal(n[k]);
+
+    return kTRUE;
+}
+
+//______________________________________________________________________________
+Bool_t FFRooUnbinnedNLL::ComputeSWeights(const RooArgList& yields, std::vector<Double_t>& sw) const
+{
+    // Compute the sWeights of all events for the floating yields 'yields'
+    // using the current yields (e.g. solved via SolveYields()) and the cached
+    // densities, i.e. without fitting the yields again. As in
+    // RooStats::SPlot with event weights, the inverse covariance matrix of
+    // the floating yields is calculated from the weighted second derivatives
+    // of the likelihood. 'sw' is filled with the sWeights [event][yield].
+    // Return kFALSE if a yield is not a floating yield of the likelihood, an
+    // expectation is not positive or the covariance matrix is singular,
+    // otherwise kTRUE.
+
+    // make sure the densities are cached
+    getVal();
+
+    // collect floating yields
+    std::vector<Int_t> idx;
+    for (Int_t k = 0; k < fNComp; k++)
+        if (!fCoef.at(k)->isConstant()) idx.push_back(k);
+    const Int_t nFree = idx.size();
+    if (!nFree)
+        return kFALSE;
+
+    // map requested yields
+    const Int_t nYield = yields.getSize();
+    std::vector<Int_t> map(nYield, -1);
+    for (Int_t j = 0; j < nYield; j++)
+    {
+        for (Int_t k = 0; k < nFree; k++)
+            if (yields.at(j) == fCoef.at(idx[k])) map[j] = k;
+        if (map[j] == -1)
+            return kFALSE;
+    }
+
+    // event expectations
+    std::vector<Double_t> mu(fNEvent, 0);
+    for (Int_t k = 0; k < fNComp; k++)
+    {
+        const Double_t n = ((RooAbsReal*)fCoef.at(k))->getVal();
+        const Double_t* prob = fProb + k*fNEvent;
+        for (Long64_t i = 0; i < fNEvent; i++)
+            mu[i] += n * prob[i];
+    }
+    for (Long64_t i = 0; i < fNEvent; i++)
+        if (fEvW[i] != 0 && !(mu[i] > 0)) return kFALSE;
+
+    // inverse covariance matrix
+    std::vector<Double_t> h(nFree*nFree);
+    for (Int_t k = 0; k < nFree; k++)
+    {
+        const Double_t* pk = fProb + idx[k]*fNEvent;
+        for (Int_t l = 0; l <= k; l++)
+        {
+            const Double_t* pl = fProb + idx[l]*fNEvent;
+            Double_t t = 0;
+            for (Long64_t i = 0; i < fNEvent; i++)
+                if (fEvW[i] != 0) t += fEvW[i] * pk[i] * pl[i] / (mu[i] * mu[i]);
+            h[k*nFree+l] = t;
+            h[l*nFree+k] = t;
+        }
+    }
+
+    // covariance matrix (column by column)
+    std::vector<Double_t> cov(nFree*nFree);
+    for (Int_t l = 0; l < nFree; l++)
+    {
+        std::vector<Double_t> a(h);
+        std::vector<Double_t> e(nFree, 0);
+        e[l] = 1;
+        if (!FFFooFit::SolveCholesky(nFree, a.data(), e.data()))
+            return kFALSE;
+        for (Int_t k = 0; k < nFree; k++)
+            cov[k*nFree+l] = e[k];
+    }
+
+    // sWeights
+    sw.assign(fNEvent*nYield, 0);
+    for (Long64_t i = 0; i < fNEvent; i++)
+    {
+        if (!(mu[i] > 0))
+            continue;
+        for (Int_t j = 0; j < nYield; j++)
+        {
+            Double_t s = 0;
+            for (Int_t l = 0; l < nFree; l++)
+                s += cov[map[j]*nFree+l] * fProb[idx[l]*fNEvent+i];
+            sw[i*nYield+j] = s / mu[i];
+        }
+    }
+
+    return kTRUE;
+}
@@ -0,0 +1,328 @@
+/*************************************************************************
+ * Author: Dominik Werthmueller, 2019
+ *************************************************************************/
+
+//////////////////////////////////////////////////////////////////////////
+//                                                                      //
+// FFTemplateFiller                                                     //
+//                                                                      //
+// Class for filling template histograms from trees in parallel.        //
+//                                                                      //
+// Fill jobs (histogram, tree, variables, weight) are registered via    //
+// AddJob() and processed together by Fill() in one scheduling pass.    //
+// The files of all chains are distributed among the threads, which     //
+// read the variables directly from their branches and accumulate       //
+// partial histograms that are merged at the end. This requires the     //
+// thread safety of ROOT to be enabled by the caller (see               //
+// FFFooFit::SetNCPU()), otherwise all files are read by the calling    //
+// thread. Trees that are not chains are read by the calling thread.    //
+// Jobs using formulas instead of plain tree variables are filled via   //
+// TTree::Draw().                                                       //
+// Sparse N-dimensional histograms (FFRooSparseHistPdf) are filled via  //
+// per-thread hash maps of the occupied bins.                           //
+//                                                                      //
+//////////////////////////////////////////////////////////////////////////
+
+
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
+#include "TMath.h"
+#include "TFile.h"
+#include "TChain.h"
+#include "TChainElement.h"
+#include "TTree.h"
+#include "TH1.h"
+#include "TArrayD.h"
+
+#include "FFTemplateFiller.h"
+#include "FFRooSparseHistPdf.h"
+#include "FFFooFit.h"
+
+ClassImp(FFTemplateFiller)
+
+//______________________________________________________________________________
+FFTemplateFiller::FFTemplateFiller(const Char_t* name, const Char_t* title)
+    : TNamed(name, title)
+{
+    // Constructor.
+
+}
+
+//______________________________________________________________________________
+void FFTemplateFiller::AddJob(TH1* hist, FFRooSparseHistPdf* sparse, TTree* tree, Int_t nDim,
+                              const Char_t** vars, const Char_t* weight)
+{
+    // Register the filling of the 'nDim'-dimensional histogram 'hist' or of
+    // the sparse histogram 'sparse' with the variables 'vars' of the tree
+    // 'tree' weighted by the optional event weight variable 'weight'.
+
+    // check dimension
+    if (nDim < 1 || (hist && nDim > 3) || (sparse && nDim != sparse->GetNDim()))
+    {
+        Error("AddJob", "Cannot fill histograms of dimension %d!", nDim);
+        return;
+    }
+
+    // create job
+    Job job;
+    job.fHist = hist;
+    job.fSparse = sparse;
+    job.fTree = tree;
+    job.fNDim = nDim;
+    for (Int_t i = 0; i < nDim; i++)
+        job.fVar.push_back(vars[i]);
+    job.fWeight = weight ? weight : "";
+    fJob.push_back(job);
+}
+
+//______________________________________________________________________________
+Bool_t FFTemplateFiller::FillDraw(const Job& job) const
+{
+    // Fill the histogram of the job 'job' using TTree::Draw().
+    // Return kTRUE on success, otherwise kFALSE.
+
+    // check histogram
+    if (!job.fHist)
+    {
+        Error("FillDraw", "Cannot fill sparse histogram '%s' with formula input!",
+              job.fSparse->GetName());
+        return kFALSE;
+    }
+
+    // format variable expression
+    TString expr = job.fVar[0];
+    for (Int_t i = 1; i < job.fNDim; i++)
+        expr = job.fVar[i] + ":" + expr;
+
+    // fill the histogram
+    Long64_t n = job.fTree->Draw(TString::Format("%s>>%s", expr.Data(), job.fHist->GetName()).Data(),
+                                 job.fWeight.Data());
+
+    return n >= 0;
+}
+
+//______________________________________________________________________________
+Bool_t FFTemplateFiller::Fill(Int_t nThreads)
+{
+    // Fill the histograms of all registered jobs using 'nThreads' threads.
+    // The histograms are filled in addition to their current content.
+    // Return kTRUE on success, otherwise kFALSE.
+
+    const Int_t nJob = fJob.size();
+    nThreads = TMath::Max(nThreads, 1);
+    Bool_t res = kTRUE;
+
+    // work unit: a file of a chain or a complete tree of a job
+    class Unit
+    {
+    public:
+        Int_t fJob;                 // job index
+        TString fFile;              // file name (empty for complete tree)
+        TString fTree;              // tree name in file
+    };
+
+    // thread safety of ROOT (needed to read files in parallel)
+    const Bool_t threadSafe = FFFooFit::IsThreadSafe();
+    Bool_t warned = kFALSE;
+
+    // collect work units
+    std::vector<Unit> units;
+    std::vector<Unit> unitsMain;
+    std::vector<Bool_t> compiled(nJob, kTRUE);
+    for (Int_t j = 0; j < nJob; j++)
+    {
+        const Job& job = fJob[j];
+
+        // jobs with formulas are filled via TTree::Draw()
+        for (Int_t i = 0; i < job.fNDim; i++)
+            if (!FFFooFit::IsTreeLeaf(job.fTree, job.fVar[i].Data())) compiled[j] = kFALSE;
+        if (job.fWeight != "" && !FFFooFit::IsTreeLeaf(job.fTree, job.fWeight.Data()))
+            compiled[j] = kFALSE;
+        if (!compiled[j])
+        {
+            if (job.fHist)
+                Info("Fill", "Filling histogram '%s' via TTree::Draw() (formula input)", job.fHist->GetName());
+            if (!FillDraw(job))
+                res = kFALSE;
+            continue;
+        }
+
+        // distribute the files of chains, read other trees in this thread
+        if (nThreads > 1 && !threadSafe && !warned && job.fTree->InheritsFrom("TChain"))
+        {
+            Warning("Fill", "ROOT thread safety not enabled (see FFFooFit::SetNCPU()), "
+                    "reading all files in the calling thread");
+            warned = kTRUE;
+        }
+        if (nThreads > 1 && threadSafe && job.fTree->InheritsFrom("TChain"))
+        {
+            TObjArray* list = ((TChain*)job.fTree)->GetListOfFiles();
+            for (Int_t i = 0; i < list->GetEntriesFast(); i++)
+            {
+                Unit u;
+                u.fJob = j;
+                u.fFile = ((TChainElement*)list->At(i))->GetTitle();
+                u.fTree = ((TChainElement*)list->At(i))->GetName();
+                units.push_back(u);
+            }
+        }
+        else
+        {
+            Unit u;
+            u.fJob = j;
+            unitsMain.push_back(u);
+        }
+    }
+
+    // partial histograms per thread and job
+    std::vector<std::vector<std::vector<Double_t> > > sumw(nThreads, std::vector<std::vector<Double_t> >(nJob));
+    std::vector<std::vector<std::vector<Double_t> > > sumw2(nThreads, std::vector<std::vector<Double_t> >(nJob));
+    typedef std::unordered_map<Long64_t, Double_t> SparseMap_t;
+    std::vector<std::vector<SparseMap_t> > sparse(nThreads, std::vector<SparseMap_t>(nJob));
+    std::vector<std::vector<Long64_t> > nFill(nThreads, std::vector<Long64_t>(nJob, 0));
+
+    // fill a tree into the partial histogram of a thread
+    auto fillTree = [&](Int_t t, Int_t j, TTree* tree) -> Bool_t
+    {
+        const Job& job = fJob[j];
+        const Bool_t weighted = job.fWeight != "";
+        Long64_t& n = nFill[t][j];
+
+        // columns
+        std::vector<const Char_t*> cols(job.fNDim + 1, 0);
+        for (Int_t i = 0; i < job.fNDim; i++)
+            cols[i] = job.fVar[i].Data();
+        cols[job.fNDim] = weighted ? job.fWeight.Data() : 0;
+
+        // fill sparse histogram
+        if (job.fSparse)
+        {
+            SparseMap_t& sc = sparse[t][j];
+            return FFFooFit::ReadTreeColumns(tree, job.fNDim + 1, cols.data(), [&](const Double_t* x)
+            {
+                const Double_t w = x[job.fNDim];
+                if (w == 0)
+                    return;
+                const Long64_t c = job.fSparse->GetBinIndex(x);
+                if (c >= 0)
+                    sc[c] += w;
+                n++;
+            }) >= 0;
+        }
+
+        // create partial histogram
+        if (sumw[t][j].empty())
+        {
+            sumw[t][j].assign(job.fHist->GetNcells(), 0);
+            if (weighted)
+                sumw2[t][j].assign(job.fHist->GetNcells(), 0);
+        }
+        Double_t* sw = sumw[t][j].data();
+        Double_t* sw2 = weighted ? sumw2[t][j].data() : 0;
+        const TAxis* axes[3] = { job.fHist->GetXaxis(), job.fHist->GetYaxis(), job.fHist->GetZaxis() };
+
+        // loop over entries
+        Long64_t nRead = FFFooFit::ReadTreeColumns(tree, job.fNDim + 1, cols.data(), [&](const Double_t* x)
+        {
+            const Double_t w = x[job.fNDim];
+            if (w == 0)
+                return;
+            Int_t bin[3] = { 0, 0, 0 };
+            for (Int_t i = 0; i < job.fNDim; i++)
+                bin[i] = axes[i]->FindFixBin(x[i]);
+            const Int_t c = job.fHist->GetBin(bin[0], bin[1], bin[2]);
+            sw[c] += w;
+            if (sw2)
+                sw2[c] += w*w;
+            n++;
+        });
+
+        return nRead >= 0;
+    };
+
+    // process the work units
+    std::atomic<Int_t> next(0);
+    std::atomic<Bool_t> ok(kTRUE);
+    auto work = [&](Int_t t)
+    {
+        for (Int_t u = next++; u < (Int_t)units.size(); u = next++)
+        {
+            // open file
+            TFile* file = TFile::Open(units[u].fFile.Data());
+            TTree* tree = 0;
+            if (file && !file->IsZombie())
+                file->GetObject(units[u].fTree.Data(), tree);
+            if (!tree || !fillTree(t, units[u].fJob, tree))
+            {
+                Error("Fill", "Could not read tree '%s' from file '%s'!",
+                      units[u].fTree.Data(), units[u].fFile.Data());
+                ok = kFALSE;
+            }
+
+            // clean-up
+            delete file;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (Int_t t = 1; t < nThreads && t <= (Int_t)units.size(); t++)
+        threads.push_back(std::thread(work, t));
+    for (UInt_t u = 0; u < unitsMain.size(); u++)
+    {
+        if (!fillTree(0, unitsMain[u].fJob, fJob[unitsMain[u].fJob].fTree))
+            ok = kFALSE;
+    }
+    work(0);
+    for (UInt_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+    if (!ok)
+        res = kFALSE;
+
+    // merge partial histograms
+    Long64_t nTot = 0;
+    for (Int_t j = 0; j < nJob; j++)
+    {
+        if (!compiled[j])
+            continue;
+
+        // sparse histograms
+        if (fJob[j].fSparse)
+        {
+            for (Int_t t = 0; t < nThreads; t++)
+            {
+                for (auto it = sparse[t][j].begin(); it != sparse[t][j].end(); ++it)
+                    fJob[j].fSparse->AddBinContent(it->first, it->second);
+                nTot += nFill[t][j];
+            }
+            continue;
+        }
+
+        TH1* h = fJob[j].fHist;
+        if (fJob[j].fWeight != "" && !h->GetSumw2N())
+            h->Sumw2();
+        Double_t entries = h->GetEntries();
+        for (Int_t t = 0; t < nThreads; t++)
+        {
+            if (sumw[t][j].empty())
+                continue;
+            for (Int_t c = 0; c < h->GetNcells(); c++)
+            {
+                if (sumw[t][j][c] != 0)
+                    h->AddBinContent(c, sumw[t][j][c]);
+                if (h->GetSumw2N())
+                    h->GetSumw2()->GetArray()[c] += sumw2[t][j].empty() ? sumw[t][j][c] : sumw2[t][j][c];
+            }
+            entries += nFill[t][j];
+            nTot += nFill[t][j];
+        }
+        h->ResetStats();
+        h->SetEntries(entries);
+    }
+
+    // user info
+    Info("Fill", "Filled %d template(s) with %lld entries using %d thread(s)",
+         nJob, nTot, nThreads);
+
+    return res;
+}